@@ -89,6 +89,25 @@ function HangulIme() {
    */
   this.hangulLengths_ = [];
 
+  /**
+   * Raw input text kept by the session of NaCl module, or null if it is
+   * unknown. Edits of the raw input are sent to the session incrementally.
+   *
+   * @type {?string}
+   * @private
+   */
+  this.sessionText_ = null;
+
+  /**
+   * Sequence number of the current composition, which is increased whenever
+   * the composition is cleared. Requests are tagged with it and the context
+   * ID, so that the responses of an old composition or context are dropped.
+   *
+   * @type {number}
+   * @private
+   */
+  this.composeSequence_ = 0;
+
   /**
    * Segment information.
    *
@@ -129,6 +148,15 @@ function HangulIme() {
    */
   this.naclModule_ = null;
 
+  /**
+   * Timer of saving the selections of hanja candidates, which are saved in
+   * batches.
+   *
+   * @type {?number}
+   * @private
+   */
+  this.saveFrequencyTimer_ = null;
+
   /**
    * Ignore key table not to handle some keys.
    *
@@ -290,6 +318,8 @@ HangulIme.prototype.clear_ = function() {
   this.commitText_ = null;
   this.hangul_ = '';
   this.hangulLengths_ = [];
+  this.sessionText_ = null;
+  this.composeSequence_++;
   this.resetSegment_();
   this.cursor_ = 0;
   if (this.state_ !== HangulIme.State.ENGLISH) {
@@ -343,16 +373,81 @@ HangulIme.prototype.requestCandidates_ = function(opt_text) {
   if (!text) {
     return;
   }
-  var request = JSON.stringify({
-    'text': text,
-    'num': 0
-  });
+  var request;
+  if (opt_text) {
+    request = {
+      'text': text,
+      'num': 0
+    };
+  } else {
+    request = this.getSessionRequest_(text);
+    this.sessionText_ = text;
+  }
+  // Responses are encoded in binary, see HangulIme.decodeBinaryResponse_
+  request['binary'] = true;
+  request['context'] = this.getContextID_();
+  request['sequence'] = this.composeSequence_;
+  request = JSON.stringify(request);
 
   // this.updateCandidates will be called after NaCl responded
   this.naclModule_.postMessage(request);
 };
 
 
+/**
+ * Gets the request to edit the raw input kept by the session of NaCl module
+ * into text.
+ *
+ * @param {string} text raw input text.
+ * @return {Object} the session request.
+ * @private
+ */
+HangulIme.prototype.getSessionRequest_ = function(text) {
+  var request = {
+    'context': this.getContextID_()
+  };
+  var sessionText = this.sessionText_;
+  if (sessionText !== null && text.length > sessionText.length &&
+      text.slice(0, sessionText.length) === sessionText) {
+    request['session'] = 'append';
+    request['keys'] = text.slice(sessionText.length);
+  } else if (sessionText !== null &&
+      text.length + 1 === sessionText.length &&
+      sessionText.slice(0, text.length) === text) {
+    request['session'] = 'backspace';
+  } else {
+    request['session'] = 'set';
+    request['keys'] = text;
+  }
+  return request;
+};
+
+
+/**
+ * Gets the ID of the current context, or 0 if there is no context.
+ *
+ * @return {number} context ID.
+ * @private
+ */
+HangulIme.prototype.getContextID_ = function() {
+  return this.context_ ? this.context_.contextID : 0;
+};
+
+
+/**
+ * Determines if a response is of the current composition and context.
+ *
+ * @param {number} context context ID the request was tagged with.
+ * @param {number} sequence compose sequence the request was tagged with.
+ * @return {boolean} true if the response is not stale.
+ * @private
+ */
+HangulIme.prototype.isCurrentResponse_ = function(context, sequence) {
+  return context === this.getContextID_() &&
+      sequence === this.composeSequence_;
+};
+
+
 /**
  * Updates candidates
  *
@@ -363,6 +458,8 @@ HangulIme.prototype.requestCandidates_ = function(opt_text) {
  *        data[3] is an object containing other properties, which are:
  *                matched_length, same as data[2].
  *                annotations, annotation of every candidate.
+ *                offset, index of the first hangul character in data[1] if
+ *                    only the changed characters of a session are sent.
  */
 HangulIme.prototype.updateCandidates = function(data) {
   var segment = this.segment_;
@@ -374,6 +471,20 @@ HangulIme.prototype.updateCandidates = function(data) {
   var otherProps = data[3];
   var annotations = otherProps['annotation'];
 
+  var offset = otherProps['offset'];
+  if (offset !== undefined) {
+    if (offset > this.hangul_.length) {
+      // The response doesn't follow the current hangul text, converts the
+      // whole raw input again.
+      this.sessionText_ = null;
+      this.requestCandidates_();
+      return;
+    }
+    candidatesList = this.hangul_.slice(0, offset).split('').concat(
+        candidatesList);
+    matched = this.hangulLengths_.slice(0, offset).concat(matched);
+  }
+
   // Determine if results are Hanja by seeing if original text is Hangul
   var isHanja = false;
   var asciiRegex = /^[\000-\255]*$/;
@@ -593,6 +704,12 @@ HangulIme.prototype.commitCandidate_ = function() {
     var segment = this.segment_;
     if (segment.candidates.length > segment.focusedIndex) {
       var candidate = segment.candidates[segment.focusedIndex];
+      // Let NaCl rank the candidate higher next time
+      this.naclModule_.postMessage(JSON.stringify({
+        'select': candidate.text,
+        'hangul': this.hangul_.slice(0, candidate.matchedLength)
+      }));
+      this.scheduleSaveFrequency_();
       if (candidate.matchedLength === this.hangul_.length) {
         this.clear_();
       } else {
@@ -977,6 +1094,7 @@ HangulIme.prototype.onActivate = function(engineID) {
  * @param {string} engineID engine ID.
  */
 HangulIme.prototype.onDeactivated = function(engineID) {
+  this.saveFrequency_();
   this.clear_();
   this.engineID_ = '';
 };
@@ -1000,6 +1118,10 @@ HangulIme.prototype.onFocus = function(context) {
  * @param {number} contextID ID of the context.
  */
 HangulIme.prototype.onBlur = function(contextID) {
+  this.naclModule_.postMessage(JSON.stringify({
+    'session': 'close',
+    'context': contextID
+  }));
   this.clear_();
   this.updateCandidatesWindow_();
   this.context_ = null;
@@ -1137,6 +1259,8 @@ HangulIme.prototype.switchKeyboard = function(engineID) {
   }
   if (keyboard != null && keyboard != this.currentKeyboard_) {
     this.currentKeyboard_ = keyboard;
+    // The raw input is converted again by the new layout
+    this.sessionText_ = null;
     // Send message to NaCl to switch keyboard layout
     var request = JSON.stringify({
       'keyboard': keyboard.name
@@ -1154,6 +1278,69 @@ HangulIme.prototype.setNaclModule = function(naclModule) {
   this.naclModule_ = naclModule;
   var handleNaclMessage = HangulIme.prototype.handleNaclMessage.bind(this);
   naclModule.addEventListener('message', handleNaclMessage, true);
+  // Restore the selections of hanja candidates
+  var frequency = window.localStorage.getItem(HangulIme.FREQUENCY_KEY_);
+  if (frequency) {
+    naclModule.postMessage(JSON.stringify({
+      'frequency': frequency
+    }));
+  }
+};
+
+
+/**
+ * The key of local storage where the selections of hanja candidates are
+ * persisted.
+ *
+ * @const
+ * @type {string}
+ * @private
+ */
+HangulIme.FREQUENCY_KEY_ = 'hanjaFrequency';
+
+
+/**
+ * The delay in milliseconds of saving the selections of hanja candidates
+ * after one is selected.
+ *
+ * @const
+ * @type {number}
+ * @private
+ */
+HangulIme.SAVE_FREQUENCY_DELAY_ = 30000;
+
+
+/**
+ * Saves the selections of hanja candidates later, unless the saving is already
+ * scheduled.
+ *
+ * @private
+ */
+HangulIme.prototype.scheduleSaveFrequency_ = function() {
+  if (this.saveFrequencyTimer_ !== null) {
+    return;
+  }
+  this.saveFrequencyTimer_ = window.setTimeout(
+      this.saveFrequency_.bind(this), HangulIme.SAVE_FREQUENCY_DELAY_);
+};
+
+
+/**
+ * Asks Native Client module for the selections of hanja candidates to
+ * persist. It responds only if anything is selected since the last save.
+ *
+ * @private
+ */
+HangulIme.prototype.saveFrequency_ = function() {
+  if (this.saveFrequencyTimer_ !== null) {
+    window.clearTimeout(this.saveFrequencyTimer_);
+    this.saveFrequencyTimer_ = null;
+  }
+  if (this.naclModule_) {
+    this.naclModule_.postMessage(JSON.stringify({
+      'save': 'frequency'
+    }));
+  }
 };
 
 
@@ -1163,18 +1350,88 @@ HangulIme.prototype.setNaclModule = function(naclModule) {
  * @param {string} message
  */
 HangulIme.prototype.handleNaclMessage = function(message) {
+  if (message['data'] instanceof ArrayBuffer) {
+    var header = new Uint32Array(message['data'], 0,
+                                 HangulIme.BINARY_HEADER_WORDS_);
+    if (this.isCurrentResponse_(header[4], header[5])) {
+      this.updateCandidates(HangulIme.decodeBinaryResponse_(message['data']));
+    }
+    return;
+  }
   var response = JSON.parse(message['data']);
+  if (response && response[0] === 'FREQUENCY') {
+    window.localStorage.setItem(HangulIme.FREQUENCY_KEY_, response[1]);
+    return;
+  }
   if (!response || response[0] !== 'SUCCESS') {
     console.error('Error from NaCl:');
     console.error(response);
     return;
   }
+  // Tagged responses carry the tag of the request as the third element
+  var tag = response[2];
+  if (tag && !this.isCurrentResponse_(tag['context'], tag['sequence'])) {
+    return;
+  }
   var payload = response[1];
   var data = payload[0];
   this.updateCandidates(data);
 };
 
 
+/**
+ * The number of words in the header of binary responses: the number of
+ * candidates, flags, offset, size, and the context ID and compose sequence
+ * of the request.
+ *
+ * @const
+ * @type {number}
+ * @private
+ */
+HangulIme.BINARY_HEADER_WORDS_ = 6;
+
+
+/**
+ * Decodes a binary response of Native Client module into the same data as
+ * the JSON response. See nacl/binary_response.h for the format.
+ *
+ * @param {ArrayBuffer} buffer binary response.
+ * @return {Array} data of candidates, see HangulIme.updateCandidates.
+ * @private
+ */
+HangulIme.decodeBinaryResponse_ = function(buffer) {
+  var headerWords = HangulIme.BINARY_HEADER_WORDS_;
+  var header = new Uint32Array(buffer, 0, headerWords);
+  var numCandidates = header[0];
+  var hasAnnotations = (header[1] & 1) !== 0;
+  var numStrings = 1 + numCandidates * (hasAnnotations ? 2 : 1);
+  var words = new Uint32Array(buffer, 0,
+                              headerWords + numCandidates + numStrings);
+  var bytes = new Uint8Array(buffer, words.byteLength);
+  var decoder = HangulIme.textDecoder_ ||
+      (HangulIme.textDecoder_ = new TextDecoder('utf-8'));
+  var strings = [];
+  var begin = 0;
+  for (var i = 0; i < numStrings; i++) {
+    var end = words[headerWords + numCandidates + i];
+    strings.push(decoder.decode(bytes.subarray(begin, end)));
+    begin = end;
+  }
+  var matched = Array.prototype.slice.call(words, headerWords,
+                                           headerWords + numCandidates);
+  var otherProps = {
+    'matched_length': matched,
+    'offset': header[2],
+    'size': header[3]
+  };
+  if (hasAnnotations) {
+    otherProps['annotation'] = strings.slice(1 + numCandidates);
+  }
+  return [strings[0], strings.slice(1, 1 + numCandidates), matched,
+          otherProps];
+};
+
+
 /**
  * Initializes IME.
  */
@@ -0,0 +1,113 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+
+#include "binary_response.h"
+
+namespace {
+
+const size_t kHeaderWords = 6;
+// The words of the request tag in the header
+const size_t kContextWord = 4;
+const size_t kSequenceWord = 5;
+
+void WriteWord(uint32_t value, char *output) {
+  output[0] = static_cast<char>(value & 0xFF);
+  output[1] = static_cast<char>((value >> 8) & 0xFF);
+  output[2] = static_cast<char>((value >> 16) & 0xFF);
+  output[3] = static_cast<char>((value >> 24) & 0xFF);
+}
+
+// Appends the strings to output and writes their ends into words.
+void WriteStrings(const std::vector<const char *> &strings,
+                  size_t strings_begin,
+                  char *words,
+                  string *output) {
+  for (size_t i = 0; i < strings.size(); ++i) {
+    output->append(strings[i]);
+    WriteWord(output->size() - strings_begin, words + i * 4);
+  }
+}
+
+}  // namespace
+
+namespace binary_response {
+
+void Encode(const string &original,
+            const std::vector<const char *> &candidates,
+            const std::vector<size_t> &matched_length,
+            const std::vector<const char *> *annotations,
+            size_t offset,
+            size_t size,
+            string *output) {
+  size_t num_candidates = candidates.size();
+  size_t num_words = kHeaderWords + num_candidates * 2 + 1;
+  if (annotations) {
+    num_words += num_candidates;
+  }
+  // Reserve space for the strings to avoid reallocation in most cases
+  output->reserve(num_words * 4 + original.size() + num_candidates * 16);
+  output->assign(num_words * 4, '\0');
+
+  WriteWord(num_candidates, &(*output)[0]);
+  WriteWord(annotations ? kHasAnnotations : 0, &(*output)[4]);
+  WriteWord(offset, &(*output)[8]);
+  WriteWord(size, &(*output)[12]);
+  size_t word = kHeaderWords;
+  for (size_t i = 0; i < num_candidates; ++i, ++word) {
+    WriteWord(matched_length[i], &(*output)[word * 4]);
+  }
+
+  // The ends are written after the strings are appended, and appending may
+  // reallocate the output, so they are kept aside first.
+  string ends((num_candidates * 2 + 1) * 4, '\0');
+  size_t strings_begin = output->size();
+  output->append(original);
+  WriteWord(output->size() - strings_begin, &ends[0]);
+  WriteStrings(candidates, strings_begin, &ends[4], output);
+  if (annotations) {
+    WriteStrings(*annotations, strings_begin, &ends[4 + num_candidates * 4],
+                 output);
+  }
+  memcpy(&(*output)[word * 4], ends.data(),
+         (num_words - word) * 4);
+}
+
+void SetTag(uint32_t context, uint32_t sequence, string *output) {
+  if (output->size() < kHeaderWords * 4) {
+    return;
+  }
+  WriteWord(context, &(*output)[kContextWord * 4]);
+  WriteWord(sequence, &(*output)[kSequenceWord * 4]);
+}
+
+}  // namespace binary_response
@@ -0,0 +1,88 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef BINARY_RESPONSE_H_
+#define BINARY_RESPONSE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+
+// The compact encoding of conversion responses, which is sent to the input
+// method as an ArrayBuffer instead of JSON. All the numbers are uint32 in
+// little-endian, and the layout is:
+//   num_candidates, flags, offset, size, context, sequence
+//   matched_length[num_candidates]
+//   the end of original
+//   the ends of candidates[num_candidates]
+//   the ends of annotations[num_candidates], if flags has kHasAnnotations
+//   UTF-8 strings: original, candidates, annotations
+// The ends are byte offsets from the start of the UTF-8 strings, and each
+// string starts at the end of the previous one. offset and size are the
+// index of the first candidate and the number of all the candidates of a
+// session response, or 0 and num_candidates otherwise. context and sequence
+// are the tag of the request, see SetTag.
+namespace binary_response {
+
+enum Flags {
+  kHasAnnotations = 1
+};
+
+// Encodes a response
+// @param[in]  original       The original text converted.
+// @param[in]  candidates     The candidates in UTF-8.
+// @param[in]  matched_length The matched length of every candidate.
+// @param[in]  annotations    The annotation of every candidate, or NULL if
+//                            there is no annotation.
+// @param[in]  offset         The index of the first candidate.
+// @param[in]  size           The number of all the candidates.
+// @param[out] output         The encoded response.
+void Encode(const string &original,
+            const std::vector<const char *> &candidates,
+            const std::vector<size_t> &matched_length,
+            const std::vector<const char *> *annotations,
+            size_t offset,
+            size_t size,
+            string *output);
+
+// Sets the tag of the request echoed in an encoded response, which is 0 when
+// the response is encoded.
+// @param[in]     context  The context of the request.
+// @param[in]     sequence The sequence of the request.
+// @param[in,out] output   The encoded response.
+void SetTag(uint32_t context, uint32_t sequence, string *output);
+
+}  // namespace binary_response
+
+#endif  // BINARY_RESPONSE_H_
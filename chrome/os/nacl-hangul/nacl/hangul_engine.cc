@@ -0,0 +1,515 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <algorithm>
+
+#include "binary_response.h"
+#include "hangul_engine.h"
+
+namespace {
+
+const char kResponseSuccess[] = "SUCCESS";
+const char kResponseError[] = "ERROR";
+const char kResponseFrequency[] = "FREQUENCY";
+// The maximum number of sessions kept at the same time. Sessions are closed by
+// the input method when the input contexts lose focus, so there are usually
+// only one or two of them.
+const size_t kMaxSessions = 8;
+// The maximum number of hanja responses cached
+const size_t kHanjaCacheSize = 256;
+// The maximum number of hanja selections kept, about 16KB persisted
+const size_t kMaxHanjaSelections = 2048;
+// The maximum number of hanja requests waiting for the dictionaries. The input
+// method only shows the response of the latest composition, so the oldest
+// requests are dropped beyond it.
+const size_t kMaxPendingHanjaRequests = 8;
+
+// Determines if all characters in text are ACSII characters
+bool IsAllAscii(const string &text) {
+  size_t text_len = text.length();
+  for (size_t i = 0; i < text_len; i++) {
+    unsigned char ch = text[i];
+    if (ch > 0x7F) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Appends tag to the outer array of a JSON response
+void AppendJsonTag(const Json::Value &tag, string *output) {
+  size_t end = output->rfind(']');
+  if (end == string::npos) {
+    return;
+  }
+  Json::FastWriter writer;
+  string tag_json = writer.write(tag);
+  // FastWriter ends the output with a newline
+  tag_json.resize(tag_json.size() - 1);
+  output->insert(end, "," + tag_json);
+}
+
+HangulEngine::ResponseFormat GetResponseFormat(const Json::Value &request) {
+  const Json::Value binary_field = request["binary"];
+  return binary_field.isBool() && binary_field.asBool() ?
+      HangulEngine::BINARY_RESPONSE : HangulEngine::JSON_RESPONSE;
+}
+
+}  // namespace
+
+HangulEngine::Response::Response()
+    : has_annotations(false),
+      is_session(false),
+      context(0),
+      offset(0),
+      size(0) {
+}
+
+HangulEngine::RequestTag::RequestTag()
+    : tagged(false),
+      context(0),
+      sequence(0) {
+}
+
+HangulEngine::HangulEngine(Delegate *delegate)
+    : delegate_(delegate),
+      keyboard_("2"),
+      hanja_frequency_(kMaxHanjaSelections),
+      hanja_frequency_changed_(false),
+      hanja_cache_(kHanjaCacheSize),
+      hanja_cache_generation_(0) {
+  // Initialize Hangul. By default keyboard is 2-set
+  hangul_input_ = hangul_ic_new(keyboard_.c_str());
+  hanja_lookup_.SetLoadedCallback(&HangulEngine::OnHanjaLoaded, this);
+  hanja_lookup_.SetFrequency(&hanja_frequency_);
+}
+
+HangulEngine::~HangulEngine() {
+  hangul_ic_delete(hangul_input_);
+  for (std::map<int, HangulSession *>::iterator it = sessions_.begin();
+       it != sessions_.end(); ++it) {
+    delete it->second;
+  }
+}
+
+void HangulEngine::HandleRequest(const string &json_string) {
+  // Parse JSON format request
+  Json::Value request;
+  Json::Reader reader;
+  if (!reader.parse(json_string, request)) {
+    ReportError("Failed to parse request json");
+    return;
+  }
+
+  const Json::Value context_field = request["context"];
+  const Json::Value sequence_field = request["sequence"];
+  request_tag_.tagged = sequence_field.isInt();
+  request_tag_.context = context_field.isInt() ? context_field.asInt() : 0;
+  request_tag_.sequence = request_tag_.tagged ? sequence_field.asInt() : 0;
+
+  const Json::Value text_field = request["text"];
+  if (text_field.isString()) {
+    string text = text_field.asString();
+    HandleConversionRequest(text, request, GetResponseFormat(request));
+    return;
+  }
+
+  const Json::Value session_field = request["session"];
+  if (session_field.isString()) {
+    HandleSessionRequest(session_field.asString(), request);
+    return;
+  }
+
+  const Json::Value keyboard_field = request["keyboard"];
+  if (keyboard_field.isString()) {
+    // Set the keyboard layout
+    keyboard_ = keyboard_field.asString();
+    hangul_ic_select_keyboard(hangul_input_, keyboard_.c_str());
+    for (std::map<int, HangulSession *>::iterator it = sessions_.begin();
+         it != sessions_.end(); ++it) {
+      it->second->SelectKeyboard(keyboard_.c_str());
+    }
+    return;
+  }
+
+  if (HandleSettingRequest(request)) {
+    return;
+  }
+
+  ReportError("Invalid request: " + json_string);
+}
+
+bool HangulEngine::HandleSettingRequest(const Json::Value &request) {
+  const Json::Value select_field = request["select"];
+  const Json::Value hangul_field = request["hangul"];
+  if (select_field.isString() && hangul_field.isString()) {
+    const string hangul = hangul_field.asString();
+    hanja_frequency_.Record(hangul, select_field.asString());
+    hanja_frequency_changed_ = true;
+    // Only the cached responses including the candidates of hangul may be
+    // ranked differently
+    hanja_cache_.RemovePrefixed(hangul);
+    return true;
+  }
+
+  const Json::Value save_field = request["save"];
+  if (save_field.isString() && save_field.asString() == "frequency") {
+    if (hanja_frequency_changed_) {
+      Json::Value response;
+      response.append(kResponseFrequency);
+      string data;
+      hanja_frequency_.Serialize(&data);
+      response.append(data);
+      PostResponse(response);
+      hanja_frequency_changed_ = false;
+    }
+    return true;
+  }
+
+  const Json::Value frequency_field = request["frequency"];
+  if (frequency_field.isString()) {
+    if (!hanja_frequency_.Load(frequency_field.asString())) {
+      ReportError("Invalid hanja frequency data");
+    }
+    hanja_frequency_changed_ = false;
+    hanja_cache_.Clear();
+    return true;
+  }
+  return false;
+}
+
+void HangulEngine::HandleConversionRequest(const string &text,
+                                           const Json::Value &request,
+                                           ResponseFormat format) {
+  const Json::Value num_field = request["num"];
+  if (!num_field.isInt()) {
+    ReportError("Invalid format: property 'num' isn't integer");
+    return;
+  }
+  size_t num_candidates = num_field.asInt();
+  // If raw input characters are all ASCII, they would be transliterated into
+  // hangul characters. Otherwise text must be valid hangul characters and
+  // hanja candidates will be returned.
+  bool is_all_ascii = IsAllAscii(text);
+  if (is_all_ascii) {
+    MatchHangul(text, num_candidates, format);
+  } else if (hanja_lookup_.has_sources() && !hanja_lookup_.loaded()) {
+    // Hanja requests are answered once all the dictionaries are ready, so
+    // that no incomplete candidate list is returned. Without any dictionary
+    // requested they are answered right away, as nothing would load.
+    if (pending_hanja_requests_.size() >= kMaxPendingHanjaRequests) {
+      pending_hanja_requests_.erase(pending_hanja_requests_.begin());
+    }
+    PendingRequest pending;
+    pending.text = text;
+    pending.num_candidates = num_candidates;
+    pending.format = format;
+    pending.tag = request_tag_;
+    pending_hanja_requests_.push_back(pending);
+  } else {
+    MatchHanja(text, num_candidates, format);
+  }
+}
+
+void HangulEngine::HandleSessionRequest(const string &operation,
+                                        const Json::Value &request) {
+  const Json::Value context_field = request["context"];
+  if (!context_field.isInt()) {
+    ReportError("Invalid format: property 'context' isn't integer");
+    return;
+  }
+  int context = context_field.asInt();
+  if (operation == "close") {
+    std::map<int, HangulSession *>::iterator it = sessions_.find(context);
+    if (it != sessions_.end()) {
+      delete it->second;
+      sessions_.erase(it);
+    }
+    return;
+  }
+
+  const Json::Value keys_field = request["keys"];
+  bool has_keys = keys_field.isString() && IsAllAscii(keys_field.asString());
+  HangulSession *session = GetSession(context);
+  size_t first;
+  if (operation == "append" && has_keys) {
+    first = session->Append(keys_field.asString());
+  } else if (operation == "set" && has_keys) {
+    first = session->Set(keys_field.asString());
+  } else if (operation == "backspace") {
+    first = session->Backspace();
+  } else if (operation == "commit") {
+    GenerateSessionResponse(context, *session, 0, GetResponseFormat(request));
+    session->Reset();
+    return;
+  } else {
+    ReportError("Invalid session request: " + operation);
+    return;
+  }
+  GenerateSessionResponse(context, *session, first,
+                          GetResponseFormat(request));
+}
+
+HangulSession *HangulEngine::GetSession(int context) {
+  std::map<int, HangulSession *>::iterator it = sessions_.find(context);
+  if (it != sessions_.end()) {
+    return it->second;
+  }
+  if (sessions_.size() >= kMaxSessions) {
+    // Context IDs increase, so the first one is the oldest
+    delete sessions_.begin()->second;
+    sessions_.erase(sessions_.begin());
+  }
+  HangulSession *session = new HangulSession(keyboard_.c_str());
+  sessions_[context] = session;
+  return session;
+}
+
+void HangulEngine::GenerateSessionResponse(int context,
+                                           const HangulSession &session,
+                                           size_t first,
+                                           ResponseFormat format) {
+  const UCSString &characters = session.characters();
+  first = std::min(first, characters.length());
+  std::vector<string> hangul(characters.length() - first);
+  Response response;
+  for (size_t i = first; i < characters.length(); i++) {
+    hangul[i - first] = unicode_util::Ucs4ToUtf8(characters.c_str() + i, 1);
+    response.candidates.push_back(hangul[i - first].c_str());
+    response.matched_length.push_back(session.matched_length(i));
+  }
+  // Only the raw input of the changed characters is sent back
+  if (first < characters.length()) {
+    response.original = session.keys().substr(session.key_offset(first));
+  }
+  response.is_session = true;
+  response.context = context;
+  response.offset = first;
+  response.size = characters.length();
+  string output;
+  EncodeResponse(response, format, &output);
+  PostResponse(output, format);
+}
+
+void HangulEngine::OnHanjaLoaded(void *engine_ptr) {
+  HangulEngine *engine = static_cast<HangulEngine *>(engine_ptr);
+  std::vector<PendingRequest> requests;
+  requests.swap(engine->pending_hanja_requests_);
+  // The dictionaries may be loaded while handling another request
+  RequestTag tag = engine->request_tag_;
+  for (size_t i = 0; i < requests.size(); ++i) {
+    engine->request_tag_ = requests[i].tag;
+    engine->MatchHanja(requests[i].text, requests[i].num_candidates,
+                       requests[i].format);
+  }
+  engine->request_tag_ = tag;
+}
+
+void HangulEngine::MatchHangul(const string &text,
+                               size_t num_candidates,
+                               ResponseFormat format) {
+  const string &input = text;
+  Response response;
+  response.original = text;
+
+  // Transliterate the input, and remember after each byte how many characters
+  // have been committed and the first character of the preedit
+  hangul_ic_reset(hangul_input_);
+  size_t input_len = input.length();
+  UCSString hangul;
+  std::vector<size_t> committed(input_len);
+  UCSString preedit(input_len, 0);
+  for (size_t i = 0; i < input_len; i++) {
+    hangul_ic_process(hangul_input_, input[i]);
+    hangul += hangul_ic_get_commit_string(hangul_input_);
+    committed[i] = hangul.length();
+    preedit[i] = hangul_ic_get_preedit_string(hangul_input_)[0];
+  }
+  hangul += hangul_ic_flush(hangul_input_);
+
+  // The segment of a character is the shortest run of input from the end of
+  // the previous segment after which the character has been committed or is
+  // being composed, the same as HangulSession::MatchedLength() finds by
+  // transliterating the segment again. The last segment takes the rest of the
+  // input.
+  size_t hangul_len = hangul.length();
+  std::vector<string> characters(hangul_len);
+  size_t offset = 0;
+  for (size_t i = 0; i < hangul_len; i++) {
+    characters[i] = unicode_util::Ucs4ToUtf8(hangul.c_str() + i, 1);
+    response.candidates.push_back(characters[i].c_str());
+    size_t len;
+    for (len = 1; offset + len < input_len; len++) {
+      size_t end = offset + len - 1;
+      if (i < committed[end] ||
+          (i == committed[end] && preedit[end] == hangul[i])) {
+        break;
+      }
+    }
+    response.matched_length.push_back(len);
+    offset += len;
+  }
+  string output;
+  EncodeResponse(response, format, &output);
+  PostResponse(output, format);
+}
+
+UCSString HangulEngine::Transliterate(const string &text) {
+  // Clear inner state of libhangul and process every character
+  hangul_ic_reset(hangul_input_);
+  size_t text_len = text.length();
+  UCSString hangul_text;
+  for (size_t i = 0; i < text_len; i++) {
+    hangul_ic_process(hangul_input_, text[i]);
+    hangul_text += hangul_ic_get_commit_string(hangul_input_);
+  }
+  // Get committed hangul characters and hanja candidates
+  hangul_text += hangul_ic_flush(hangul_input_);
+  return hangul_text;
+}
+
+void HangulEngine::MatchHanja(const string &text,
+                              size_t num_candidates,
+                              ResponseFormat format) {
+  // Responses built from the previous dictionaries are stale
+  if (hanja_cache_generation_ != hanja_lookup_.generation()) {
+    hanja_cache_.Clear();
+    hanja_cache_generation_ = hanja_lookup_.generation();
+  }
+  const string *cached = hanja_cache_.Lookup(text, num_candidates, format);
+  if (cached) {
+    PostResponse(*cached, format);
+    return;
+  }
+
+  Response response;
+  response.original = text;
+  response.has_annotations = true;
+  // Match every prefix of text, the longest first
+  hanja_items_.clear();
+  hanja_lookup_.MatchPrefixes(text, num_candidates, &hanja_items_,
+                              &response.matched_length, &hanja_match_buffer_);
+  for (size_t i = 0; i < hanja_items_.size(); i++) {
+    response.candidates.push_back(hanja_items_[i].hanja);
+    response.annotations.push_back(hanja_items_[i].comment);
+  }
+  string output;
+  EncodeResponse(response, format, &output);
+  hanja_cache_.Insert(text, num_candidates, format, output);
+  PostResponse(output, format);
+}
+
+void HangulEngine::EncodeResponse(const Response &response,
+                                  ResponseFormat format,
+                                  string *output) {
+  if (format == BINARY_RESPONSE) {
+    binary_response::Encode(response.original,
+                            response.candidates,
+                            response.matched_length,
+                            response.has_annotations ?
+                                &response.annotations : NULL,
+                            response.offset,
+                            response.is_session ?
+                                response.size : response.candidates.size(),
+                            output);
+    return;
+  }
+
+  Json::Value candidates(Json::arrayValue);
+  Json::Value matched_length(Json::arrayValue);
+  Json::Value annotation(Json::arrayValue);
+  for (size_t i = 0; i < response.candidates.size(); i++) {
+    candidates.append(response.candidates[i]);
+    matched_length.append(response.matched_length[i]);
+    if (response.has_annotations) {
+      annotation.append(response.annotations[i]);
+    }
+  }
+  Json::Value additional_fields;
+  additional_fields["matched_length"] = matched_length;
+  if (response.has_annotations) {
+    additional_fields["annotation"] = annotation;
+  }
+  if (response.is_session) {
+    additional_fields["context"] = response.context;
+    additional_fields["offset"] = response.offset;
+    additional_fields["size"] = response.size;
+  }
+  // Generate result
+  Json::Value result;
+  result.append(response.original);
+  result.append(candidates);
+  result.append(matched_length);
+  result.append(additional_fields);
+  Json::Value payload;
+  payload.append(result);
+  Json::Value json_response;
+  json_response.append(kResponseSuccess);
+  json_response.append(payload);
+  Json::FastWriter writer;
+  *output = writer.write(json_response);
+}
+
+void HangulEngine::PostResponse(const string &output, ResponseFormat format) {
+  if (!request_tag_.tagged) {
+    if (format == BINARY_RESPONSE) {
+      delegate_->PostBinaryResponse(output);
+    } else {
+      delegate_->PostResponse(output);
+    }
+    return;
+  }
+  // The output may be cached, so the tag is set on a copy
+  string tagged = output;
+  if (format == BINARY_RESPONSE) {
+    binary_response::SetTag(request_tag_.context, request_tag_.sequence,
+                            &tagged);
+    delegate_->PostBinaryResponse(tagged);
+  } else {
+    Json::Value tag;
+    tag["context"] = request_tag_.context;
+    tag["sequence"] = request_tag_.sequence;
+    AppendJsonTag(tag, &tagged);
+    delegate_->PostResponse(tagged);
+  }
+}
+
+void HangulEngine::PostResponse(const Json::Value &response) {
+  Json::FastWriter writer;
+  delegate_->PostResponse(writer.write(response));
+}
+
+void HangulEngine::ReportError(const string &error_message) {
+  Json::Value response;
+  response.append(kResponseError);
+  response.append(error_message);
+  PostResponse(response);
+}
@@ -0,0 +1,236 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HANGUL_ENGINE_H_
+#define HANGUL_ENGINE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <hangul-1.0/hangul.h>
+#include <json/json.h>
+
+#include "hangul_session.h"
+#include "hanja.h"
+#include "hanja_cache.h"
+#include "hanja_frequency.h"
+#include "unicode_util.h"
+
+using std::string;
+
+// The platform-neutral conversion engine of the Korean input method. It
+// handles the JSON requests from the input method, transliterates raw input
+// into hangul characters, looks up hanja candidates, and builds the JSON or
+// binary responses. It doesn't depend on PPAPI, so it can be built and tested
+// on the build machine.
+class HangulEngine {
+ public:
+  // Receives the responses built by the engine.
+  class Delegate {
+   public:
+    virtual ~Delegate() {}
+    // Sends a JSON response to the input method.
+    virtual void PostResponse(const string &response) = 0;
+    // Sends a response encoded by binary_response to the input method.
+    virtual void PostBinaryResponse(const string &response) = 0;
+  };
+
+  // The formats of conversion responses. Errors are always reported in JSON.
+  enum ResponseFormat {
+    JSON_RESPONSE,
+    BINARY_RESPONSE
+  };
+
+  explicit HangulEngine(Delegate *delegate);
+  ~HangulEngine();
+
+  // Returns the hanja lookup, whose dictionaries are loaded by the owner of
+  // the engine.
+  HanjaLookup *hanja_lookup() {
+    return &hanja_lookup_;
+  }
+
+  // There are three kinds of requests. One is to set keyboard layout, where
+  // the format is {"keyboard": layout}. Other settings are also requests of
+  // this kind, see HandleSettingRequest.
+  // Another is to convert raw input to hangul or hangul to hanja,
+  // where the format is like:
+  // {"text":"ganji", "num":10}
+  // The last is to edit the raw input of a session, see HandleSessionRequest.
+  // Conversion and session requests with "binary":true are responded in the
+  // format of binary_response instead of JSON.
+  // Conversion and session requests may be tagged with "context" and
+  // "sequence" integers, which are echoed in their responses so that the
+  // input method can drop the responses of stale requests. JSON responses
+  // carry the tag as the third element:
+  // ["SUCCESS", payload, {"context":1, "sequence":2}]
+  // Responses are sent to the delegate. Hanja requests received before all
+  // the dictionaries are loaded are answered once they are loaded.
+  void HandleRequest(const string &request);
+
+  // Handles the requests about the selections of hanja candidates, where the
+  // format is like:
+  // {"select":"韓", "hangul":"한"}
+  // {"save":"frequency"}
+  // {"frequency":data}
+  // The first records that the user selected a candidate, which is ranked
+  // higher afterwards. The second responds with ["FREQUENCY", data] for the
+  // input method to persist if anything is selected since the last save, so
+  // selections are persisted in batches. The last loads the data persisted.
+  // @return False if request isn't one of them.
+  bool HandleSettingRequest(const Json::Value &request);
+
+  // Edits the raw input kept by the session of an input context, where the
+  // format is like:
+  // {"session":"append", "context":1, "keys":"g"}
+  // {"session":"backspace", "context":1}
+  // {"session":"set", "context":1, "keys":"gksrmf"}
+  // {"session":"commit", "context":1}
+  // {"session":"close", "context":1}
+  // The response is the same as the one of raw input conversion, except that
+  // it only contains the characters starting at the first changed one. Its
+  // additional fields contain "offset", the index of the first changed
+  // character, and "size", the number of all the characters. "commit"
+  // responds with all the characters and clears the raw input, and "close"
+  // releases the session without response.
+  void HandleSessionRequest(const string &operation,
+                            const Json::Value &request);
+
+  // Converts raw input into hangul characters and responds with the
+  // characters and the length of input matched by each of them.
+  void MatchHangul(const string &text,
+                   size_t num_candidates,
+                   ResponseFormat format);
+
+  // Looks up hanja candidates of every prefix of the hangul text and responds
+  // with at most num_candidates of them, 0 means no limit.
+  void MatchHanja(const string &text,
+                  size_t num_candidates,
+                  ResponseFormat format);
+
+  // Converts raw input into hangul characters
+  UCSString Transliterate(const string &text);
+
+  // Returns the selection frequency of hanja candidates.
+  HanjaFrequency *hanja_frequency() {
+    return &hanja_frequency_;
+  }
+
+  // Returns the cache of hanja responses.
+  HanjaCache *hanja_cache() {
+    return &hanja_cache_;
+  }
+
+  // Responds with an error message.
+  void ReportError(const string &error_message);
+
+ private:
+  // The candidates of a conversion response, which are encoded in the
+  // requested format.
+  struct Response {
+    Response();
+
+    string original;
+    std::vector<const char *> candidates;
+    std::vector<size_t> matched_length;
+    bool has_annotations;
+    std::vector<const char *> annotations;
+    // The fields of session responses
+    bool is_session;
+    int context;
+    size_t offset;
+    size_t size;
+  };
+
+  // The tag of a conversion or session request echoed in its response
+  struct RequestTag {
+    RequestTag();
+
+    bool tagged;
+    int context;
+    int sequence;
+  };
+
+  // A hanja request received before the dictionaries are loaded
+  struct PendingRequest {
+    string text;
+    size_t num_candidates;
+    ResponseFormat format;
+    RequestTag tag;
+  };
+
+  void HandleConversionRequest(const string &text,
+                               const Json::Value &request,
+                               ResponseFormat format);
+  static void OnHanjaLoaded(void *engine_ptr);
+  // Returns the session of context, creating it if it doesn't exist.
+  HangulSession *GetSession(int context);
+  // Responds with the characters of session starting at first.
+  void GenerateSessionResponse(int context,
+                               const HangulSession &session,
+                               size_t first,
+                               ResponseFormat format);
+  // Encodes the response in format.
+  void EncodeResponse(const Response &response,
+                      ResponseFormat format,
+                      string *output);
+  // Posts a conversion or session response with the tag of the request being
+  // handled.
+  void PostResponse(const string &output, ResponseFormat format);
+  void PostResponse(const Json::Value &response);
+
+  Delegate *delegate_;
+  HangulInputContext *hangul_input_;
+  string keyboard_;
+  // Sessions of input contexts keyed by the context IDs
+  std::map<int, HangulSession *> sessions_;
+  HanjaLookup hanja_lookup_;
+  HanjaFrequency hanja_frequency_;
+  // Whether hanja_frequency_ is changed since it was last saved
+  bool hanja_frequency_changed_;
+  HanjaCache hanja_cache_;
+  // The generation of hanja_lookup_ that the cached responses are built from
+  size_t hanja_cache_generation_;
+  // Hanja requests waiting for the dictionaries, at most
+  // kMaxPendingHanjaRequests of them
+  std::vector<PendingRequest> pending_hanja_requests_;
+  // Reused by MatchHanja to match without allocating
+  std::vector<HanjaLookup::Item> hanja_items_;
+  HanjaLookup::MatchBuffer hanja_match_buffer_;
+  // The tag of the request being handled
+  RequestTag request_tag_;
+
+  HangulEngine(const HangulEngine &);
+  void operator=(const HangulEngine &);
+};
+
+#endif  // HANGUL_ENGINE_H_
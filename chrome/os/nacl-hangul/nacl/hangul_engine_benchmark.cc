@@ -0,0 +1,265 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Benchmark of HangulEngine requests end to end, from the JSON request to the
+// JSON response, with the hanja dictionary loaded from a local file. It also
+// compares typing the raw input a key at a time with requests of the whole
+// text and with session requests.
+//
+// Usage: hangul_engine_benchmark dictionary.bin
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hangul_engine.h"
+
+using std::string;
+
+namespace {
+
+const int kNumRequests = 10000;
+const size_t kRequestLengths[] = {1, 2, 4, 8, 16};
+const size_t kNumCandidates = 10;
+// Keys typed as romanized input by the 2-set keyboard
+const char kRomanizedKeys[] = "rRseEfaqQtTdwWczxvgkoiOjpuPhynbml";
+
+double NowMs() {
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec * 1000.0 + time.tv_usec / 1000.0;
+}
+
+// Counts the responses without keeping them.
+class ResponseCounter : public HangulEngine::Delegate {
+ public:
+  ResponseCounter() : num_responses(0), num_bytes(0) {}
+
+  virtual void PostResponse(const string &response) {
+    ++num_responses;
+    num_bytes += response.size();
+  }
+
+  virtual void PostBinaryResponse(const string &response) {
+    ++num_responses;
+    num_bytes += response.size();
+  }
+
+  size_t num_responses;
+  size_t num_bytes;
+};
+
+string BuildRequest(const string &text, size_t num_candidates) {
+  std::ostringstream request;
+  request << "{\"text\":\"" << text << "\",\"num\":" << num_candidates << "}";
+  return request.str();
+}
+
+// Builds requests of |length| random keys of romanized input.
+void BuildHangulRequests(size_t length, std::vector<string> *requests) {
+  requests->clear();
+  for (int i = 0; i < kNumRequests; ++i) {
+    string text;
+    for (size_t j = 0; j < length; ++j) {
+      text += kRomanizedKeys[rand() % (sizeof(kRomanizedKeys) - 1)];
+    }
+    requests->push_back(BuildRequest(text, kNumCandidates));
+  }
+}
+
+// Builds requests of |length| hangul characters by transliterating random
+// romanized input, so that the requests look like the ones sent by the input
+// method.
+void BuildHanjaRequests(HangulEngine *engine,
+                        size_t length,
+                        std::vector<string> *requests,
+                        size_t num_candidates,
+                        std::vector<string> *texts) {
+  requests->clear();
+  if (texts) {
+    texts->clear();
+  }
+  for (int i = 0; i < kNumRequests; ++i) {
+    UCSString hangul;
+    while (hangul.length() < length) {
+      string text;
+      for (int j = 0; j < 3; ++j) {
+        text += kRomanizedKeys[rand() % (sizeof(kRomanizedKeys) - 1)];
+      }
+      hangul += engine->Transliterate(text);
+    }
+    string text = unicode_util::Ucs4ToUtf8(hangul.c_str(), length);
+    requests->push_back(BuildRequest(text, num_candidates));
+    if (texts) {
+      texts->push_back(text);
+    }
+  }
+}
+
+// Builds the requests of typing |length| random keys a key at a time, with
+// the whole text in each request or with session requests.
+void BuildTypingRequests(size_t length,
+                         std::vector<string> *text_requests,
+                         std::vector<string> *session_requests) {
+  text_requests->clear();
+  session_requests->clear();
+  for (int i = 0; i < kNumRequests / static_cast<int>(length); ++i) {
+    string text;
+    for (size_t j = 0; j < length; ++j) {
+      char key = kRomanizedKeys[rand() % (sizeof(kRomanizedKeys) - 1)];
+      text += key;
+      text_requests->push_back(BuildRequest(text, kNumCandidates));
+      session_requests->push_back(
+          (j == 0 ? "{\"session\":\"set\",\"context\":1,\"keys\":\"" :
+                    "{\"session\":\"append\",\"context\":1,\"keys\":\"") +
+          string(1, key) + "\"}");
+    }
+  }
+}
+
+// Records a selection of the last candidate of the longest prefix of each
+// text, which is moved to the front by ranking.
+void RecordSelections(HangulEngine *engine, const std::vector<string> &texts) {
+  std::vector<HanjaLookup::Item> items;
+  std::vector<size_t> lengths;
+  HanjaLookup::MatchBuffer buffer;
+  for (size_t i = 0; i < texts.size(); ++i) {
+    items.clear();
+    lengths.clear();
+    engine->hanja_lookup()->MatchPrefixes(texts[i], 0, &items, &lengths,
+                                          &buffer);
+    size_t last = 0;
+    while (last + 1 < items.size() && lengths[last + 1] == lengths[0]) {
+      ++last;
+    }
+    if (!items.empty()) {
+      engine->hanja_frequency()->Record(items[last].hangul, items[last].hanja);
+    }
+  }
+}
+
+// Returns the average microseconds per request.
+double Run(HangulEngine *engine, const std::vector<string> &requests) {
+  double start = NowMs();
+  for (size_t i = 0; i < requests.size(); ++i) {
+    engine->HandleRequest(requests[i]);
+  }
+  return (NowMs() - start) * 1000 / requests.size();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " dictionary.bin" << std::endl;
+    return 1;
+  }
+  ResponseCounter counter;
+  HangulEngine engine(&counter);
+  double start = NowMs();
+  if (!engine.hanja_lookup()->LoadFromFile(argv[1])) {
+    return 1;
+  }
+  printf("Loaded %s in %.3f ms, %u bytes\n", argv[1], NowMs() - start,
+         static_cast<unsigned>(engine.hanja_lookup()->memory_usage()));
+
+  srand(0);
+  std::vector<string> requests;
+  printf("%8s %12s %12s %12s\n", "chars", "hangul(us)", "hanja(us)",
+         "cached(us)");
+  for (size_t i = 0; i < sizeof(kRequestLengths) / sizeof(kRequestLengths[0]);
+       ++i) {
+    BuildHangulRequests(kRequestLengths[i], &requests);
+    double hangul_us = Run(&engine, requests);
+    BuildHanjaRequests(&engine, kRequestLengths[i], &requests, kNumCandidates,
+                       NULL);
+    double hanja_us = Run(&engine, requests);
+    // Requests repeated right away are answered by the cache
+    std::vector<string> repeated(requests.end() - kNumRequests / 100,
+                                 requests.end());
+    double cached_us = Run(&engine, repeated);
+    printf("%8u %12.3f %12.3f %12.3f\n",
+           static_cast<unsigned>(kRequestLengths[i]), hangul_us, hanja_us,
+           cached_us);
+  }
+  const HanjaCache &cache = *engine.hanja_cache();
+  printf("Hanja cache: %u hits, %u misses, hit rate %.3f\n",
+         static_cast<unsigned>(cache.hits()),
+         static_cast<unsigned>(cache.misses()), cache.hit_rate());
+
+  // Compares the formats of hanja responses without cache, so that every
+  // response is built and encoded, and the binary responses ranked by the
+  // selections of the same requests
+  size_t capacity = engine.hanja_cache()->capacity();
+  engine.hanja_cache()->set_capacity(0);
+  std::vector<string> texts;
+  printf("%8s %12s %12s %12s %12s %12s\n", "chars", "json(us)", "json(bytes)",
+         "binary(us)", "binary(bytes)", "ranked(us)");
+  for (size_t i = 0; i < sizeof(kRequestLengths) / sizeof(kRequestLengths[0]);
+       ++i) {
+    BuildHanjaRequests(&engine, kRequestLengths[i], &requests, 0, &texts);
+    counter.num_bytes = 0;
+    double json_us = Run(&engine, requests);
+    size_t json_bytes = counter.num_bytes;
+    for (size_t j = 0; j < requests.size(); ++j) {
+      requests[j].insert(requests[j].size() - 1, ",\"binary\":true");
+    }
+    counter.num_bytes = 0;
+    double binary_us = Run(&engine, requests);
+    size_t binary_bytes = counter.num_bytes;
+    RecordSelections(&engine, texts);
+    double ranked_us = Run(&engine, requests);
+    engine.hanja_frequency()->Clear();
+    printf("%8u %12.3f %12.1f %12.3f %12.1f %12.3f\n",
+           static_cast<unsigned>(kRequestLengths[i]),
+           json_us, static_cast<double>(json_bytes) / requests.size(),
+           binary_us, static_cast<double>(binary_bytes) / requests.size(),
+           ranked_us);
+  }
+  engine.hanja_cache()->set_capacity(capacity);
+
+  std::vector<string> session_requests;
+  printf("%8s %12s %12s\n", "keys", "text(us)", "session(us)");
+  for (size_t i = 0; i < sizeof(kRequestLengths) / sizeof(kRequestLengths[0]);
+       ++i) {
+    BuildTypingRequests(kRequestLengths[i] * 4, &requests, &session_requests);
+    double text_us = Run(&engine, requests);
+    double session_us = Run(&engine, session_requests);
+    printf("%8u %12.3f %12.3f\n",
+           static_cast<unsigned>(kRequestLengths[i] * 4), text_us, session_us);
+  }
+  return 0;
+}
@@ -0,0 +1,703 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Native tests of HangulEngine, built and run on the build machine with
+// "make test_engine".
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+#include "binary_response.h"
+#include "hangul_engine.h"
+#include "hanja_cache.h"
+#include "hanja_dictionary.h"
+#include "hanja_frequency.h"
+
+using std::string;
+
+namespace {
+
+int failures = 0;
+
+#define EXPECT_TRUE(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: Failure: %s\n", __FILE__, __LINE__, \
+              #condition); \
+      ++failures; \
+    } \
+  } while (0)
+
+#define EXPECT_EQ(expected, actual) EXPECT_TRUE((expected) == (actual))
+
+const char kDictionary[] =
+    "# comment\n"
+    "\n"
+    "한:韓:나라 한\n"
+    "글:契:맺을 계\n"
+    "한:漢:한수 한\n"
+    "한글:韓契:\n"
+    "국:國:나라 국\n";
+
+class ResponseCollector : public HangulEngine::Delegate {
+ public:
+  virtual void PostResponse(const string &response) {
+    responses.push_back(response);
+  }
+
+  virtual void PostBinaryResponse(const string &response) {
+    binary_responses.push_back(response);
+  }
+
+  // Parses the result of the last response, which is
+  // ["SUCCESS", [[original, candidates, matched_length, fields]]].
+  Json::Value LastResult() {
+    Json::Value response;
+    Json::Reader reader;
+    if (responses.empty() || !reader.parse(responses.back(), response) ||
+        response[0u].asString() != "SUCCESS") {
+      return Json::Value();
+    }
+    return response[1u][0u];
+  }
+
+  std::vector<string> responses;
+  std::vector<string> binary_responses;
+};
+
+uint32_t ReadWord(const string &data, size_t word) {
+  const unsigned char *bytes =
+      reinterpret_cast<const unsigned char *>(data.data()) + word * 4;
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+// The number of words in the header of binary responses
+const size_t kBinaryHeaderWords = 6;
+
+// Decodes a binary response into the result of the JSON response.
+Json::Value DecodeBinaryResponse(const string &data) {
+  size_t num_candidates = ReadWord(data, 0);
+  bool has_annotations = ReadWord(data, 1) & binary_response::kHasAnnotations;
+  Json::Value matched_length(Json::arrayValue);
+  for (size_t i = 0; i < num_candidates; ++i) {
+    matched_length.append(
+        static_cast<int>(ReadWord(data, kBinaryHeaderWords + i)));
+  }
+  size_t ends_word = kBinaryHeaderWords + num_candidates;
+  size_t num_strings = 1 + num_candidates * (has_annotations ? 2 : 1);
+  size_t strings_begin = (ends_word + num_strings) * 4;
+  std::vector<string> strings;
+  size_t begin = 0;
+  for (size_t i = 0; i < num_strings; ++i) {
+    size_t end = ReadWord(data, ends_word + i);
+    strings.push_back(data.substr(strings_begin + begin, end - begin));
+    begin = end;
+  }
+  Json::Value candidates(Json::arrayValue);
+  Json::Value annotation(Json::arrayValue);
+  for (size_t i = 0; i < num_candidates; ++i) {
+    candidates.append(strings[1 + i]);
+    if (has_annotations) {
+      annotation.append(strings[1 + num_candidates + i]);
+    }
+  }
+  Json::Value fields;
+  fields["matched_length"] = matched_length;
+  if (has_annotations) {
+    fields["annotation"] = annotation;
+  }
+  fields["offset"] = ReadWord(data, 2);
+  fields["size"] = ReadWord(data, 3);
+  Json::Value result;
+  result.append(strings[0]);
+  result.append(candidates);
+  result.append(matched_length);
+  result.append(fields);
+  return result;
+}
+
+void LoadDictionary(HangulEngine *engine) {
+  string text(kDictionary);
+  engine->hanja_lookup()->LoadFromMemory(&text);
+}
+
+void TestDictionaryFormat() {
+  string binary;
+  size_t invalid_lines = 0;
+  HanjaDictionary::Compile(string(kDictionary) + "invalid\n", &binary,
+                           &invalid_lines);
+  EXPECT_EQ(1u, invalid_lines);
+  EXPECT_TRUE(HanjaDictionary::IsBinary(binary));
+
+  HanjaDictionary dictionary;
+  string buffer = binary;
+  EXPECT_TRUE(dictionary.Load(&buffer));
+  EXPECT_TRUE(buffer.empty());
+  EXPECT_EQ(5u, dictionary.size());
+  size_t begin, end;
+  dictionary.Match("한", &begin, &end);
+  EXPECT_EQ(2u, end - begin);
+  // Entries with the same hangul keep their order in text
+  EXPECT_EQ(string("韓"), dictionary.hanja(begin));
+  EXPECT_EQ(string("漢"), dictionary.hanja(begin + 1));
+  EXPECT_EQ(string("한수 한"), dictionary.comment(begin + 1));
+  dictionary.Match("없음", &begin, &end);
+  EXPECT_EQ(begin, end);
+
+  string prefix("한글과");
+  std::vector<HanjaDictionary::PrefixRange> ranges;
+  dictionary.MatchPrefixes(prefix.data(), prefix.size(), &ranges);
+  EXPECT_EQ(2u, ranges.size());
+  EXPECT_EQ(3u, ranges[0].length);
+  EXPECT_EQ(2u, ranges[0].end - ranges[0].begin);
+  EXPECT_EQ(6u, ranges[1].length);
+
+  // Truncated buffers are rejected
+  buffer = binary.substr(0, binary.size() - 1);
+  EXPECT_TRUE(!dictionary.Load(&buffer));
+  EXPECT_EQ(0u, dictionary.size());
+}
+
+void TestTransliterate() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  UCSString hangul = engine.Transliterate("gksrmf");
+  EXPECT_EQ(string("한글"), unicode_util::Ucs4ToUtf8(hangul.c_str(), 0));
+
+  engine.HandleRequest("{\"text\":\"gksrmf\",\"num\":10}");
+  Json::Value result = collector.LastResult();
+  EXPECT_EQ(string("gksrmf"), result[0u].asString());
+  EXPECT_EQ(2u, result[1u].size());
+  EXPECT_EQ(string("한"), result[1u][0u].asString());
+  EXPECT_EQ(string("글"), result[1u][1u].asString());
+  EXPECT_EQ(3, result[2u][0u].asInt());
+  EXPECT_EQ(3, result[2u][1u].asInt());
+
+  // The final consonant moves to the next syllable
+  engine.HandleRequest("{\"text\":\"gksk\",\"num\":10}");
+  result = collector.LastResult();
+  EXPECT_EQ(string("하"), result[1u][0u].asString());
+  EXPECT_EQ(string("나"), result[1u][1u].asString());
+  EXPECT_EQ(2, result[2u][0u].asInt());
+  EXPECT_EQ(2, result[2u][1u].asInt());
+}
+
+void TestMatchHanja() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  LoadDictionary(&engine);
+
+  engine.HandleRequest("{\"text\":\"한글\",\"num\":0}");
+  Json::Value result = collector.LastResult();
+  // Longer prefixes come first
+  EXPECT_EQ(3u, result[1u].size());
+  EXPECT_EQ(string("韓契"), result[1u][0u].asString());
+  EXPECT_EQ(string("韓"), result[1u][1u].asString());
+  EXPECT_EQ(string("漢"), result[1u][2u].asString());
+  EXPECT_EQ(2, result[2u][0u].asInt());
+  EXPECT_EQ(1, result[2u][1u].asInt());
+  EXPECT_EQ(string("나라 한"),
+            result[3u]["annotation"][1u].asString());
+
+  engine.HandleRequest("{\"text\":\"한글\",\"num\":2}");
+  result = collector.LastResult();
+  EXPECT_EQ(2u, result[1u].size());
+
+  engine.HandleRequest("{\"text\":\"한글\"}");
+  EXPECT_TRUE(collector.responses.back().find("ERROR") != string::npos);
+}
+
+void TestPendingHanjaRequests() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  HanjaLookup *lookup = engine.hanja_lookup();
+  size_t first = lookup->AddSource("first");
+  size_t second = lookup->AddSource("second");
+
+  engine.HandleRequest("{\"text\":\"국\",\"num\":0}");
+  EXPECT_TRUE(collector.responses.empty());
+
+  // Results follow the order of adding sources, not of finishing them
+  string symbols("국:㊀:\n");
+  lookup->FinishSource(second, &symbols);
+  EXPECT_TRUE(!lookup->loaded());
+  EXPECT_TRUE(collector.responses.empty());
+  string hanja(kDictionary);
+  lookup->FinishSource(first, &hanja);
+  EXPECT_TRUE(lookup->loaded());
+  EXPECT_EQ(1u, collector.responses.size());
+  Json::Value result = collector.LastResult();
+  EXPECT_EQ(2u, result[1u].size());
+  EXPECT_EQ(string("國"), result[1u][0u].asString());
+  EXPECT_EQ(string("㊀"), result[1u][1u].asString());
+}
+
+void TestHanjaCache() {
+  HanjaCache cache(2);
+  EXPECT_TRUE(cache.Lookup("한", 0, 0) == NULL);
+  cache.Insert("한", 0, 0, "a");
+  cache.Insert("한", 1, 0, "b");
+  EXPECT_EQ(string("a"), *cache.Lookup("한", 0, 0));
+  // ("한", 1) is the least recently used one
+  cache.Insert("글", 0, 0, "c");
+  EXPECT_EQ(2u, cache.size());
+  EXPECT_TRUE(cache.Lookup("한", 1, 0) == NULL);
+  EXPECT_EQ(string("a"), *cache.Lookup("한", 0, 0));
+  EXPECT_EQ(string("c"), *cache.Lookup("글", 0, 0));
+  EXPECT_TRUE(cache.Lookup("글", 0, 1) == NULL);
+  EXPECT_EQ(3u, cache.hits());
+  EXPECT_EQ(3u, cache.misses());
+  EXPECT_TRUE(cache.hit_rate() > 0.49 && cache.hit_rate() < 0.51);
+  cache.Clear();
+  EXPECT_EQ(0u, cache.size());
+  EXPECT_TRUE(cache.Lookup("글", 0, 0) == NULL);
+
+  // Only the responses of the texts with the prefix are removed
+  HanjaCache prefixed(4);
+  prefixed.Insert("한", 0, 0, "a");
+  prefixed.Insert("한글", 1, 1, "b");
+  prefixed.Insert("하", 0, 0, "c");
+  prefixed.Insert("글", 0, 0, "d");
+  prefixed.RemovePrefixed("한");
+  EXPECT_EQ(2u, prefixed.size());
+  EXPECT_TRUE(prefixed.Lookup("한글", 1, 1) == NULL);
+  EXPECT_EQ(string("c"), *prefixed.Lookup("하", 0, 0));
+  // The evicted entries are unlinked from the recently used list
+  prefixed.Insert("한", 0, 0, "e");
+  prefixed.Insert("한글", 0, 0, "f");
+  prefixed.Insert("글자", 0, 0, "g");
+  EXPECT_EQ(4u, prefixed.size());
+  EXPECT_EQ(string("c"), *prefixed.Lookup("하", 0, 0));
+  EXPECT_TRUE(prefixed.Lookup("글", 0, 0) == NULL);
+}
+
+void TestHanjaResponsesAreCached() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  LoadDictionary(&engine);
+  engine.HandleRequest("{\"text\":\"한\",\"num\":0}");
+  engine.HandleRequest("{\"text\":\"한\",\"num\":1}");
+  engine.HandleRequest("{\"text\":\"한\",\"num\":0}");
+  EXPECT_EQ(1u, engine.hanja_cache()->hits());
+  EXPECT_EQ(2u, engine.hanja_cache()->misses());
+  EXPECT_EQ(collector.responses[0], collector.responses[2]);
+  EXPECT_EQ(2u, collector.LastResult()[1u].size());
+
+  // Loading another dictionary invalidates the cached responses
+  string symbols("한:㊀:\n");
+  engine.hanja_lookup()->LoadFromMemory(&symbols);
+  engine.HandleRequest("{\"text\":\"한\",\"num\":0}");
+  EXPECT_EQ(1u, engine.hanja_cache()->hits());
+  EXPECT_EQ(3u, collector.LastResult()[1u].size());
+}
+
+void TestHanjaFrequency() {
+  HanjaFrequency frequency(4);
+  uint32_t han = HanjaFrequency::Hash("한", 3, "韓");
+  EXPECT_EQ(0u, frequency.Count(han));
+  frequency.Record("한", "韓");
+  frequency.Record("한", "韓");
+  frequency.Record("한글", "韓契");
+  EXPECT_EQ(2u, frequency.Count(han));
+  EXPECT_EQ(1u, frequency.Count(HanjaFrequency::Hash("한글과", 6, "韓契")));
+  EXPECT_EQ(0u, frequency.Count(HanjaFrequency::Hash("한", 3, "漢")));
+
+  string data;
+  frequency.Serialize(&data);
+  HanjaFrequency loaded(4);
+  EXPECT_TRUE(loaded.Load(data));
+  EXPECT_EQ(2u, loaded.size());
+  EXPECT_EQ(2u, loaded.Count(han));
+  EXPECT_TRUE(!loaded.Load("invalid"));
+  EXPECT_TRUE(!loaded.Load(data.substr(0, data.size() - 4)));
+  EXPECT_EQ(2u, loaded.size());
+
+  // The number of selections is bounded, the least selected ones make room
+  // for new selections
+  for (int i = 0; i < 100; ++i) {
+    frequency.Record("가", string(1, 'a' + i % 26));
+    EXPECT_EQ(i == 0 ? 3u : 4u, frequency.size());
+  }
+  EXPECT_EQ(2u, frequency.Count(han));
+  EXPECT_EQ(1u, frequency.Count(HanjaFrequency::Hash("가", 3, "v")));
+
+  // The counts are halved when one saturates
+  HanjaFrequency saturated(4);
+  saturated.Record("한", "韓");
+  saturated.Record("한", "韓");
+  saturated.Record("한", "漢");
+  uint32_t hangeul = HanjaFrequency::Hash("한글", 6, "韓契");
+  for (int i = 0; i < 0xFFFF; ++i) {
+    saturated.Record("한글", "韓契");
+  }
+  EXPECT_EQ(0xFFFFu, saturated.Count(hangeul));
+  saturated.Record("한글", "韓契");
+  EXPECT_EQ(0x8000u, saturated.Count(hangeul));
+  EXPECT_EQ(1u, saturated.Count(han));
+  EXPECT_EQ(2u, saturated.size());
+
+  // Data saved with a larger table keeps its most selected entries
+  saturated.Serialize(&data);
+  HanjaFrequency smaller(1);
+  EXPECT_TRUE(smaller.Load(data));
+  EXPECT_EQ(1u, smaller.size());
+  EXPECT_EQ(0x8000u, smaller.Count(hangeul));
+}
+
+void TestSelectionsRankCandidates() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  LoadDictionary(&engine);
+  engine.HandleRequest("{\"text\":\"한글\",\"num\":2}");
+  Json::Value result = collector.LastResult();
+  EXPECT_EQ(string("韓"), result[1u][1u].asString());
+
+  engine.HandleRequest("{\"text\":\"글\",\"num\":1}");
+  size_t num_responses = collector.responses.size();
+  engine.HandleRequest("{\"select\":\"漢\",\"hangul\":\"한\"}");
+  // Selections are persisted when the input method saves them
+  EXPECT_EQ(num_responses, collector.responses.size());
+  engine.HandleRequest("{\"save\":\"frequency\"}");
+  Json::Value response;
+  Json::Reader reader;
+  EXPECT_TRUE(reader.parse(collector.responses.back(), response));
+  EXPECT_EQ(string("FREQUENCY"), response[0u].asString());
+  string data = response[1u].asString();
+  engine.HandleRequest("{\"save\":\"frequency\"}");
+  EXPECT_EQ(num_responses + 1, collector.responses.size());
+
+  // The selected candidate is ranked first among the ones of its prefix, and
+  // the cached responses of the other texts are kept
+  size_t hits = engine.hanja_cache()->hits();
+  engine.HandleRequest("{\"text\":\"글\",\"num\":1}");
+  EXPECT_EQ(hits + 1, engine.hanja_cache()->hits());
+  engine.HandleRequest("{\"text\":\"한글\",\"num\":2}");
+  EXPECT_EQ(hits + 1, engine.hanja_cache()->hits());
+  result = collector.LastResult();
+  EXPECT_EQ(2u, result[1u].size());
+  EXPECT_EQ(string("韓契"), result[1u][0u].asString());
+  EXPECT_EQ(string("漢"), result[1u][1u].asString());
+  EXPECT_EQ(1, result[2u][1u].asInt());
+  EXPECT_EQ(string("한수 한"), result[3u]["annotation"][1u].asString());
+
+  // The persisted data restores the ranking
+  ResponseCollector restored_collector;
+  HangulEngine restored(&restored_collector);
+  LoadDictionary(&restored);
+  restored.HandleRequest("{\"frequency\":\"" + data + "\"}");
+  EXPECT_TRUE(restored_collector.responses.empty());
+  restored.HandleRequest("{\"text\":\"한\",\"num\":1}");
+  EXPECT_EQ(string("漢"), restored_collector.LastResult()[1u][0u].asString());
+  restored.HandleRequest("{\"frequency\":\"!\"}");
+  EXPECT_TRUE(restored_collector.responses.back().find("ERROR") !=
+              string::npos);
+}
+
+// Compares the binary responses with the JSON responses of the same requests.
+void TestBinaryResponses() {
+  const char *kRequests[] = {
+    "\"text\":\"gksrmf\",\"num\":0",
+    "\"text\":\"한글\",\"num\":0",
+    "\"text\":\"한글\",\"num\":2",
+    "\"text\":\"없음\",\"num\":0",
+    "\"session\":\"set\",\"context\":1,\"keys\":\"gksrm\"",
+    "\"session\":\"append\",\"context\":1,\"keys\":\"f\"",
+  };
+  ResponseCollector json_collector;
+  HangulEngine json_engine(&json_collector);
+  LoadDictionary(&json_engine);
+  ResponseCollector binary_collector;
+  HangulEngine binary_engine(&binary_collector);
+  LoadDictionary(&binary_engine);
+  for (size_t i = 0; i < sizeof(kRequests) / sizeof(kRequests[0]); ++i) {
+    json_engine.HandleRequest(string("{") + kRequests[i] + "}");
+    binary_engine.HandleRequest(string("{") + kRequests[i] +
+                                ",\"binary\":true}");
+    EXPECT_EQ(i + 1, binary_collector.binary_responses.size());
+    if (binary_collector.binary_responses.size() != i + 1) {
+      return;
+    }
+    Json::Value expected = json_collector.LastResult();
+    Json::Value actual =
+        DecodeBinaryResponse(binary_collector.binary_responses.back());
+    EXPECT_EQ(expected[0u], actual[0u]);
+    EXPECT_EQ(expected[1u], actual[1u]);
+    EXPECT_EQ(expected[2u], actual[2u]);
+    EXPECT_EQ(expected[3u]["annotation"], actual[3u]["annotation"]);
+    if (expected[3u].isMember("offset")) {
+      EXPECT_EQ(expected[3u]["offset"].asUInt(),
+                actual[3u]["offset"].asUInt());
+      EXPECT_EQ(expected[3u]["size"].asUInt(), actual[3u]["size"].asUInt());
+    }
+  }
+  // The cache keeps the responses of the two formats apart
+  binary_engine.HandleRequest("{\"text\":\"한글\",\"num\":0}");
+  EXPECT_EQ(1u, binary_collector.responses.size());
+  EXPECT_EQ(json_collector.responses[1], binary_collector.responses.back());
+}
+
+// Compares the session with the stateless conversion of its raw input after
+// random edits.
+void TestSessionMatchesStatelessConversion() {
+  const char kKeys[] = "rRseEfaqQtTdwWczxvgkoiOjpuPhynbml";
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  HangulSession session("2");
+  srand(0);
+  for (int i = 0; i < 5000; ++i) {
+    if (rand() % 3 == 0) {
+      session.Backspace();
+    } else {
+      session.Append(string(1, kKeys[rand() % (sizeof(kKeys) - 1)]));
+    }
+    if (session.keys().length() > 12) {
+      session.Set(session.keys().substr(6));
+    }
+    engine.MatchHangul(session.keys(), 0, HangulEngine::JSON_RESPONSE);
+    Json::Value result = collector.LastResult();
+    const UCSString &characters = session.characters();
+    bool matched = result[1u].size() == characters.length();
+    for (Json::ArrayIndex j = 0; matched && j < characters.length(); ++j) {
+      matched =
+          result[1u][j].asString() ==
+              unicode_util::Ucs4ToUtf8(characters.c_str() + j, 1) &&
+          result[2u][j].asUInt() == session.matched_length(j);
+    }
+    if (!matched) {
+      fprintf(stderr, "Session differs for input: %s\n",
+              session.keys().c_str());
+      ++failures;
+      return;
+    }
+  }
+}
+
+// Parses the tag of a JSON response, which is the third element.
+Json::Value ParseTag(const string &response) {
+  Json::Value value;
+  Json::Reader reader;
+  if (!reader.parse(response, value) || value.size() < 3) {
+    return Json::Value();
+  }
+  return value[2u];
+}
+
+void TestRequestTags() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  HanjaLookup *lookup = engine.hanja_lookup();
+  size_t source = lookup->AddSource("hanja");
+
+  // Untagged requests are responded as before
+  engine.HandleRequest("{\"text\":\"gks\",\"num\":0}");
+  EXPECT_TRUE(ParseTag(collector.responses.back()).isNull());
+  EXPECT_EQ(string("한"), collector.LastResult()[1u][0u].asString());
+
+  engine.HandleRequest("{\"session\":\"set\",\"context\":3,"
+                       "\"keys\":\"gks\",\"sequence\":7}");
+  Json::Value tag = ParseTag(collector.responses.back());
+  EXPECT_EQ(3, tag["context"].asInt());
+  EXPECT_EQ(7, tag["sequence"].asInt());
+  EXPECT_EQ(string("한"), collector.LastResult()[1u][0u].asString());
+
+  // A pending hanja request keeps its tag
+  engine.HandleRequest("{\"text\":\"한\",\"num\":0,\"context\":3,"
+                       "\"sequence\":8,\"binary\":true}");
+  engine.HandleRequest("{\"text\":\"gks\",\"num\":0,\"context\":3,"
+                       "\"sequence\":9}");
+  EXPECT_TRUE(collector.binary_responses.empty());
+  string hanja(kDictionary);
+  lookup->FinishSource(source, &hanja);
+  EXPECT_EQ(1u, collector.binary_responses.size());
+  EXPECT_EQ(3u, ReadWord(collector.binary_responses.back(), 4));
+  EXPECT_EQ(8u, ReadWord(collector.binary_responses.back(), 5));
+  EXPECT_EQ(2u, DecodeBinaryResponse(
+      collector.binary_responses.back())[1u].size());
+
+  // Cached responses are tagged with the new request
+  engine.HandleRequest("{\"text\":\"한\",\"num\":0,\"context\":4,"
+                       "\"sequence\":10,\"binary\":true}");
+  EXPECT_EQ(1u, engine.hanja_cache()->hits());
+  EXPECT_EQ(4u, ReadWord(collector.binary_responses.back(), 4));
+  EXPECT_EQ(10u, ReadWord(collector.binary_responses.back(), 5));
+  engine.HandleRequest("{\"text\":\"한\",\"num\":0,\"context\":4,"
+                       "\"sequence\":11}");
+  engine.HandleRequest("{\"text\":\"한\",\"num\":0,\"context\":4,"
+                       "\"sequence\":12}");
+  EXPECT_EQ(2u, engine.hanja_cache()->hits());
+  EXPECT_EQ(12, ParseTag(collector.responses.back())["sequence"].asInt());
+  EXPECT_EQ(2u, collector.LastResult()[1u].size());
+}
+
+void TestSessionRequests() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  engine.HandleRequest("{\"session\":\"append\",\"context\":1,"
+                       "\"keys\":\"gksrm\"}");
+  Json::Value result = collector.LastResult();
+  EXPECT_EQ(string("gksrm"), result[0u].asString());
+  EXPECT_EQ(2u, result[1u].size());
+  EXPECT_EQ(0, result[3u]["offset"].asInt());
+  EXPECT_EQ(2, result[3u]["size"].asInt());
+
+  // Only the last character is changed
+  engine.HandleRequest("{\"session\":\"append\",\"context\":1,"
+                       "\"keys\":\"f\"}");
+  result = collector.LastResult();
+  EXPECT_EQ(string("rmf"), result[0u].asString());
+  EXPECT_EQ(1u, result[1u].size());
+  EXPECT_EQ(string("글"), result[1u][0u].asString());
+  EXPECT_EQ(3, result[2u][0u].asInt());
+  EXPECT_EQ(1, result[3u]["offset"].asInt());
+  EXPECT_EQ(2, result[3u]["size"].asInt());
+
+  // Sessions of different contexts are independent
+  engine.HandleRequest("{\"session\":\"set\",\"context\":2,"
+                       "\"keys\":\"gksk\"}");
+  result = collector.LastResult();
+  EXPECT_EQ(string("하"), result[1u][0u].asString());
+  EXPECT_EQ(string("나"), result[1u][1u].asString());
+
+  // The consonant moves back to the previous character
+  engine.HandleRequest("{\"session\":\"backspace\",\"context\":2}");
+  result = collector.LastResult();
+  EXPECT_EQ(0, result[3u]["offset"].asInt());
+  EXPECT_EQ(1, result[3u]["size"].asInt());
+  EXPECT_EQ(string("한"), result[1u][0u].asString());
+  EXPECT_EQ(3, result[2u][0u].asInt());
+
+  engine.HandleRequest("{\"session\":\"commit\",\"context\":1}");
+  result = collector.LastResult();
+  EXPECT_EQ(2u, result[1u].size());
+  EXPECT_EQ(string("한"), result[1u][0u].asString());
+  engine.HandleRequest("{\"session\":\"backspace\",\"context\":1}");
+  result = collector.LastResult();
+  EXPECT_EQ(0u, result[1u].size());
+  EXPECT_EQ(0, result[3u]["size"].asInt());
+
+  size_t num_responses = collector.responses.size();
+  engine.HandleRequest("{\"session\":\"close\",\"context\":2}");
+  EXPECT_EQ(num_responses, collector.responses.size());
+  engine.HandleRequest("{\"session\":\"append\",\"context\":1}");
+  EXPECT_TRUE(collector.responses.back().find("ERROR") != string::npos);
+}
+
+void TestHanjaRequestsWithoutSources() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  // Nothing would load the dictionaries, so the request isn't kept waiting
+  engine.HandleRequest("{\"text\":\"한\",\"num\":0}");
+  EXPECT_EQ(1u, collector.responses.size());
+  EXPECT_EQ(0u, collector.LastResult()[1u].size());
+}
+
+void TestPendingHanjaRequestLimit() {
+  ResponseCollector collector;
+  HangulEngine engine(&collector);
+  HanjaLookup *lookup = engine.hanja_lookup();
+  size_t source = lookup->AddSource("hanja");
+  const int kNumRequests = 20;
+  for (int i = 0; i < kNumRequests; ++i) {
+    char request[64];
+    snprintf(request, sizeof(request),
+             "{\"text\":\"한\",\"num\":0,\"context\":1,\"sequence\":%d}", i);
+    engine.HandleRequest(request);
+  }
+  EXPECT_TRUE(collector.responses.empty());
+  string hanja(kDictionary);
+  lookup->FinishSource(source, &hanja);
+  // Only the latest requests are answered, in order
+  EXPECT_TRUE(collector.responses.size() < static_cast<size_t>(kNumRequests));
+  EXPECT_TRUE(!collector.responses.empty());
+  int sequence = kNumRequests - static_cast<int>(collector.responses.size());
+  for (size_t i = 0; i < collector.responses.size(); ++i) {
+    EXPECT_EQ(sequence++, ParseTag(collector.responses[i])["sequence"].asInt());
+  }
+}
+
+void TestMatchPrefixesReusesBuffer() {
+  HanjaLookup lookup;
+  string text(kDictionary);
+  lookup.LoadFromMemory(&text);
+  HanjaLookup::MatchBuffer buffer;
+  std::vector<HanjaLookup::Item> items;
+  std::vector<size_t> lengths;
+  lookup.MatchPrefixes("한글", 0, &items, &lengths, &buffer);
+  EXPECT_EQ(3u, items.size());
+  size_t capacity = buffer.ranges.capacity();
+
+  // Results don't depend on the previous contents of the buffer
+  items.clear();
+  lengths.clear();
+  lookup.MatchPrefixes("국", 0, &items, &lengths, &buffer);
+  EXPECT_EQ(1u, items.size());
+  EXPECT_EQ(string("國"), items[0].hanja);
+  items.clear();
+  lengths.clear();
+  lookup.MatchPrefixes("한글", 0, &items, &lengths, &buffer);
+  EXPECT_EQ(3u, items.size());
+  EXPECT_EQ(string("韓契"), items[0].hanja);
+  EXPECT_EQ(2u, lengths[0]);
+  EXPECT_EQ(1u, lengths[2]);
+  EXPECT_EQ(capacity, buffer.ranges.capacity());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  TestDictionaryFormat();
+  TestTransliterate();
+  TestMatchHanja();
+  TestPendingHanjaRequests();
+  TestHanjaCache();
+  TestHanjaResponsesAreCached();
+  TestBinaryResponses();
+  TestHanjaFrequency();
+  TestSelectionsRankCandidates();
+  TestSessionMatchesStatelessConversion();
+  TestSessionRequests();
+  TestRequestTags();
+  TestHanjaRequestsWithoutSources();
+  TestPendingHanjaRequestLimit();
+  TestMatchPrefixesReusesBuffer();
+  if (failures > 0) {
+    fprintf(stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf("All tests passed\n");
+  return 0;
+}
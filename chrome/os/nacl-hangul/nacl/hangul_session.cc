@@ -0,0 +1,162 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <algorithm>
+
+#include "hangul_session.h"
+
+HangulSession::HangulSession(const char *keyboard)
+    : hangul_input_(hangul_ic_new(keyboard)),
+      scratch_input_(hangul_ic_new(keyboard)),
+      pending_offset_(0) {
+}
+
+HangulSession::~HangulSession() {
+  hangul_ic_delete(hangul_input_);
+  hangul_ic_delete(scratch_input_);
+}
+
+void HangulSession::SelectKeyboard(const char *keyboard) {
+  hangul_ic_select_keyboard(hangul_input_, keyboard);
+  hangul_ic_select_keyboard(scratch_input_, keyboard);
+  string keys;
+  keys.swap(keys_);
+  Set(keys);
+}
+
+size_t HangulSession::Append(const string &keys) {
+  size_t old_size = characters_.size();
+  // The character being composed is the first one that may change
+  size_t first = offsets_.size();
+  for (size_t i = 0; i < keys.length(); i++) {
+    keys_ += keys[i];
+    ProcessKey(keys_.length() - 1);
+  }
+  UpdatePreedit();
+  return FirstChanged(first, old_size);
+}
+
+size_t HangulSession::Backspace() {
+  size_t old_size = characters_.size();
+  if (keys_.empty()) {
+    return old_size;
+  }
+  keys_.erase(keys_.length() - 1);
+  // Removing a key may move a consonant back to the last committed
+  // character, e.g. "gksk" is "하나" but "gks" is "한", so it is composed
+  // again with the rest of the raw input.
+  if (!offsets_.empty()) {
+    pending_offset_ = offsets_.back();
+    offsets_.pop_back();
+  }
+  size_t first = offsets_.size();
+  ProcessPendingKeys();
+  return FirstChanged(first, old_size);
+}
+
+size_t HangulSession::Set(const string &keys) {
+  keys_ = keys;
+  offsets_.clear();
+  pending_offset_ = 0;
+  ProcessPendingKeys();
+  return 0;
+}
+
+void HangulSession::Reset() {
+  Set("");
+}
+
+size_t HangulSession::MatchedLength(HangulInputContext *context,
+                                    const string &input,
+                                    size_t offset,
+                                    ucschar character) {
+  // The segment is fed into libhangul one byte at a time, and the first
+  // character of the output so far is the first committed character, or the
+  // first preedit character if nothing is committed yet.
+  size_t input_len = input.length();
+  hangul_ic_reset(context);
+  ucschar first_committed = 0;
+  size_t len;
+  for (len = 1; offset + len < input_len; len++) {
+    hangul_ic_process(context, input[offset + len - 1]);
+    if (!first_committed) {
+      first_committed = hangul_ic_get_commit_string(context)[0];
+    }
+    ucschar first = first_committed ?
+        first_committed : hangul_ic_get_preedit_string(context)[0];
+    if (first == character) {
+      break;
+    }
+  }
+  return len;
+}
+
+void HangulSession::ProcessPendingKeys() {
+  hangul_ic_reset(hangul_input_);
+  characters_.resize(offsets_.size());
+  for (size_t i = pending_offset_; i < keys_.length(); i++) {
+    ProcessKey(i);
+  }
+  UpdatePreedit();
+}
+
+void HangulSession::ProcessKey(size_t offset) {
+  hangul_ic_process(hangul_input_, keys_[offset]);
+  const ucschar *committed = hangul_ic_get_commit_string(hangul_input_);
+  if (!committed[0]) {
+    return;
+  }
+  // Split the uncommitted keys among the committed characters. Only the keys
+  // of the last few characters are uncommitted, so it takes constant time.
+  characters_.resize(offsets_.size());
+  for (size_t i = 0; committed[i]; i++) {
+    offsets_.push_back(pending_offset_);
+    characters_ += committed[i];
+    pending_offset_ += MatchedLength(scratch_input_, keys_, pending_offset_,
+                                     committed[i]);
+    pending_offset_ = std::min(pending_offset_, keys_.length());
+  }
+}
+
+void HangulSession::UpdatePreedit() {
+  characters_.resize(offsets_.size());
+  characters_ += hangul_ic_get_preedit_string(hangul_input_);
+}
+
+size_t HangulSession::FirstChanged(size_t first, size_t old_size) const {
+  if (old_size > 0) {
+    first = std::min(first, old_size - 1);
+  }
+  if (!characters_.empty()) {
+    first = std::min(first, characters_.size() - 1);
+  }
+  return first;
+}
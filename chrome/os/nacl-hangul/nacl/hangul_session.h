@@ -0,0 +1,140 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HANGUL_SESSION_H_
+#define HANGUL_SESSION_H_
+
+#include <string>
+#include <vector>
+
+#include <hangul-1.0/hangul.h>
+
+#include "unicode_util.h"
+
+using std::string;
+
+// The composition state of an input context. It keeps the raw input and its
+// hangul characters, and applies the edits of the raw input incrementally:
+// the characters committed by libhangul are kept as they are, and only the
+// keys of the last one or two characters are processed again. So the cost of
+// an edit is proportional to the edit rather than the raw input.
+class HangulSession {
+ public:
+  // @param[in] keyboard The keyboard layout passed to libhangul.
+  explicit HangulSession(const char *keyboard);
+  ~HangulSession();
+
+  // Changes the keyboard layout and converts the raw input again.
+  void SelectKeyboard(const char *keyboard);
+
+  // Appends keys to the raw input.
+  // @param[in] keys The raw input keys.
+  // @return         The index of the first character that is changed.
+  size_t Append(const string &keys);
+
+  // Removes the last key of the raw input.
+  // @return The index of the first character that is changed.
+  size_t Backspace();
+
+  // Replaces the raw input.
+  // @param[in] keys The raw input keys.
+  // @return         The index of the first character that is changed, which
+  //                 is always 0.
+  size_t Set(const string &keys);
+
+  // Clears the raw input.
+  void Reset();
+
+  // The raw input.
+  const string &keys() const {
+    return keys_;
+  }
+
+  // The hangul characters converted from the raw input, including the one
+  // being composed.
+  const UCSString &characters() const {
+    return characters_;
+  }
+
+  // Returns the offset of the raw input that character i starts at.
+  size_t key_offset(size_t i) const {
+    return i < offsets_.size() ? offsets_[i] : pending_offset_;
+  }
+
+  // Returns the length of the raw input converted into character i. The last
+  // character takes the rest of the raw input.
+  size_t matched_length(size_t i) const {
+    size_t end = i + 1 < characters_.size() ? key_offset(i + 1) : keys_.size();
+    return end - key_offset(i);
+  }
+
+  // Finds out the length of the shortest segment of input starting at offset
+  // whose transliteration starts with character.
+  // @param[in] context   The libhangul context used to transliterate, whose
+  //                      state is reset.
+  // @param[in] input     The raw input.
+  // @param[in] offset    The offset of the segment in input.
+  // @param[in] character The first character of the segment.
+  // @return              The length of the segment. The last segment takes
+  //                      the rest of the input.
+  static size_t MatchedLength(HangulInputContext *context,
+                              const string &input,
+                              size_t offset,
+                              ucschar character);
+
+ private:
+  // Processes the keys of the raw input starting at pending_offset_ with a
+  // fresh state of libhangul.
+  void ProcessPendingKeys();
+  // Processes the key of the raw input at offset.
+  void ProcessKey(size_t offset);
+  // Replaces the character being composed by the preedit of libhangul.
+  void UpdatePreedit();
+  // Extends the index of the first changed character to the last characters
+  // before and after the edit, whose matched length may change.
+  size_t FirstChanged(size_t first, size_t old_size) const;
+
+  HangulInputContext *hangul_input_;
+  // Used to split the raw input among the committed characters
+  HangulInputContext *scratch_input_;
+  string keys_;
+  // The committed characters followed by the one being composed, if any
+  UCSString characters_;
+  // The offsets of raw input of the committed characters
+  std::vector<size_t> offsets_;
+  // The offset of raw input that is not committed yet
+  size_t pending_offset_;
+
+  HangulSession(const HangulSession &);
+  void operator=(const HangulSession &);
+};
+
+#endif  // HANGUL_SESSION_H_
@@ -29,100 +29,202 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
-#include <iostream>
 #include <algorithm>
-
-#include <ppapi/cpp/instance.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
 
 #include "hanja.h"
-#include "url_loader_util.h"
 
-namespace {
+HanjaLookup::HanjaLookup()
+    : num_pending_sources_(0),
+      generation_(0),
+      frequency_(NULL),
+      loaded_callback_(NULL),
+      loaded_callback_data_(NULL) {
+}
 
+HanjaLookup::~HanjaLookup() {
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    delete sources_[i].dictionary;
+  }
+}
 
-// The number of items of Hanja Table. This is not needed to be a precise number
-// It is just used as a hint when allocating memory
-const int kTableNumItemsEstimation = 305000;
+void HanjaLookup::SetFrequency(const HanjaFrequency *frequency) {
+  frequency_ = frequency;
+}
 
-static void OnDataLoaded(void *hanja_lookup_ptr,
-                         const string &url,
-                         bool result,
-                         string *buffer) {
-  HanjaLookup *hanja_lookup = static_cast<HanjaLookup *>(hanja_lookup_ptr);
-  hanja_lookup->LoadFromMemory(*buffer);
-  // Release memory of buffer
-  string("").swap(*buffer);
+void HanjaLookup::SetLoadedCallback(LoadedCallback callback, void *user_data) {
+  loaded_callback_ = callback;
+  loaded_callback_data_ = user_data;
 }
 
-static bool ItemCmp(const HanjaLookup::Item &a, const HanjaLookup::Item &b) {
-  return a.hangul < b.hangul;
+size_t HanjaLookup::AddSource(const string &name) {
+  Source source;
+  source.name = name;
+  source.dictionary = NULL;
+  source.finished = false;
+  sources_.push_back(source);
+  ++num_pending_sources_;
+  return sources_.size() - 1;
 }
 
-}  // namespace
+void HanjaLookup::LoadFromMemory(string *memory) {
+  FinishSource(AddSource("memory"), memory);
+}
 
-void HanjaLookup::LoadFromURL(const char *url) {
-  loaded_ = false;
-  URLLoaderUtil::StartDownload(
-      instance_,
-      url,
-      &OnDataLoaded,
-      this);
+bool HanjaLookup::LoadFromFile(const char *path) {
+  size_t index = AddSource(path);
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  std::ostringstream content;
+  content << file.rdbuf();
+  string buffer;
+  if (file) {
+    buffer = content.str();
+  } else {
+    std::cerr << "Failed to read hanja table: " << path << std::endl;
+  }
+  FinishSource(index, &buffer);
+  return sources_[index].dictionary != NULL;
 }
 
-void HanjaLookup::LoadFromMemory(const string &memory) {
-  loaded_ = false;
-  if (items_.size() == 0) {
-    // Reserve memory for faster loading
-    items_.reserve(kTableNumItemsEstimation);
+void HanjaLookup::FinishSource(size_t index, string *buffer) {
+  if (index >= sources_.size() || sources_[index].finished) {
+    return;
   }
-  for (int offset = 0;;) {
-    size_t new_line_pos = memory.find('\n', offset);
-    // Skip empty lines or lines with start of #
-    if (memory[offset] != '#' && memory[offset] != '\n') {
-      bool append_succuss = AppendItem(memory, offset, new_line_pos);
-      if (!append_succuss) {
-        std::cerr << "Invalid hanja table: "
-             << memory.substr(offset, new_line_pos - offset) << std::endl;
-        return;
-      }
+  // The dictionary takes the buffer without copying it
+  if (!buffer->empty()) {
+    HanjaDictionary *dictionary = new HanjaDictionary;
+    if (dictionary->Load(buffer)) {
+      sources_[index].dictionary = dictionary;
+    } else {
+      std::cerr << "Invalid hanja table: " << sources_[index].name << std::endl;
+      delete dictionary;
+    }
+  }
+  sources_[index].finished = true;
+  --num_pending_sources_;
+  ++generation_;
+  if (num_pending_sources_ == 0 && loaded_callback_) {
+    loaded_callback_(loaded_callback_data_);
+  }
+}
+
+void HanjaLookup::Match(const string &hangul,
+                        std::vector<Item> *items) const {
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    const HanjaDictionary *dictionary = sources_[i].dictionary;
+    if (!dictionary) {
+      continue;
     }
-    // End of memory chunk
-    if (new_line_pos == string::npos) {
-      break;
+    size_t begin, end;
+    dictionary->Match(hangul.c_str(), &begin, &end);
+    for (size_t j = begin; j < end; ++j) {
+      Item item;
+      item.hangul = dictionary->hangul(j);
+      item.hanja = dictionary->hanja(j);
+      item.comment = dictionary->comment(j);
+      items->push_back(item);
     }
-    offset = new_line_pos + 1;
   }
-  std::sort(items_.begin(), items_.end(), ItemCmp);
-  loaded_ = true;
 }
 
-bool HanjaLookup::AppendItem(const string &memory, int start, int end) {
-  // Find first separator
-  size_t sep_pos = memory.find(':', start);
-  if (sep_pos == string::npos) {
-    return false;
+void HanjaLookup::MatchPrefixes(const string &hangul,
+                                size_t max_items,
+                                std::vector<Item> *items,
+                                std::vector<size_t> *lengths,
+                                MatchBuffer *buffer) const {
+  std::vector<HanjaDictionary::PrefixRange> &ranges = buffer->ranges;
+  std::vector<size_t> &cursors = buffer->cursors;
+  std::vector<size_t> &ends = buffer->ends;
+  ranges.clear();
+  cursors.resize(sources_.size());
+  ends.resize(sources_.size());
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    cursors[i] = ranges.size();
+    if (sources_[i].dictionary) {
+      sources_[i].dictionary->MatchPrefixes(hangul.data(), hangul.size(),
+                                            &ranges);
+      std::reverse(ranges.begin() + cursors[i], ranges.end());
+    }
+    ends[i] = ranges.size();
   }
-  // Find second separator
-  size_t sep_pos_2 = memory.find(':', sep_pos + 1);
-  if (sep_pos_2 == string::npos) {
-    return false;
+  size_t first_item = items->size();
+  for (size_t length = hangul.size(); length > 0; --length) {
+    size_t group_begin = items->size();
+    for (size_t i = 0; i < sources_.size(); ++i) {
+      if (cursors[i] == ends[i] || ranges[cursors[i]].length != length) {
+        continue;
+      }
+      const HanjaDictionary *dictionary = sources_[i].dictionary;
+      const HanjaDictionary::PrefixRange &range = ranges[cursors[i]++];
+      for (size_t j = range.begin; j < range.end; ++j) {
+        Item item;
+        item.hangul = dictionary->hangul(j);
+        item.hanja = dictionary->hanja(j);
+        item.comment = dictionary->comment(j);
+        items->push_back(item);
+      }
+    }
+    if (group_begin == items->size()) {
+      continue;
+    }
+    // Items of the same prefix are ranked before the list is truncated, so
+    // that frequently selected ones are always returned.
+    if (frequency_) {
+      RankItems(hangul, length, group_begin, items);
+    }
+    // The number of characters of the prefix
+    size_t num_chars = 0;
+    for (size_t j = 0; j < length; ++j) {
+      if ((hangul[j] & 0xC0) != 0x80) {
+        ++num_chars;
+      }
+    }
+    lengths->resize(lengths->size() + items->size() - group_begin, num_chars);
+    if (max_items > 0 && items->size() - first_item >= max_items) {
+      size_t excess = items->size() - first_item - max_items;
+      items->resize(items->size() - excess);
+      lengths->resize(lengths->size() - excess);
+      return;
+    }
   }
-  // Split line
-  Item item;
-  item.hangul = memory.substr(start, sep_pos - start);
-  item.hanja = memory.substr(sep_pos + 1, sep_pos_2 - sep_pos - 1);
-  item.comment = memory.substr(sep_pos_2 + 1, end - sep_pos_2 - 1);
-  items_.push_back(item);
-  return true;
 }
 
-void HanjaLookup::Match(const string &hangul,
-  std::vector<Item>::const_iterator *begin,
-  std::vector<Item>::const_iterator *end) const {
-  Item pattern;
-  pattern.hangul = hangul;
-  // Binary search: find the first item not less than the pattern
-  *begin = std::lower_bound(items_.begin(), items_.end(), pattern, ItemCmp);
-  // Binary search: find the first item greater than the pattern
-  *end = std::upper_bound(items_.begin(), items_.end(), pattern, ItemCmp);
+void HanjaLookup::RankItems(const string &hangul,
+                            size_t length,
+                            size_t begin,
+                            std::vector<Item> *items) const {
+  // Moves the selected items to the front in place, keeping the order of the
+  // others. Only a few items of a prefix are ever selected, so it is nearly
+  // linear and takes no allocation.
+  size_t num_selected = 0;
+  for (size_t i = begin; i < items->size(); ++i) {
+    uint32_t count = frequency_->Count(
+        HanjaFrequency::Hash(hangul.data(), length, (*items)[i].hanja));
+    if (count == 0) {
+      continue;
+    }
+    // Insertion sort of the selected items by count, the ties keep their
+    // order in the dictionaries.
+    size_t position = begin + num_selected;
+    while (position > begin &&
+           frequency_->Count(HanjaFrequency::Hash(
+               hangul.data(), length, (*items)[position - 1].hanja)) < count) {
+      --position;
+    }
+    std::rotate(items->begin() + position, items->begin() + i,
+                items->begin() + i + 1);
+    ++num_selected;
+  }
+}
+
+size_t HanjaLookup::memory_usage() const {
+  size_t usage = 0;
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    if (sources_[i].dictionary) {
+      usage += sources_[i].dictionary->memory_usage();
+    }
+  }
+  return usage;
 }
@@ -35,6 +35,9 @@
 #include <string>
 #include <vector>
 
+#include "hanja_dictionary.h"
+#include "hanja_frequency.h"
+
 using std::string;
 
 class HanjaLookup {
@@ -43,49 +46,133 @@ class HanjaLookup {
   // hangul is the key of the table, which means korean character
   // hanja means Chinese characters
   // comments contains the description of this item
+  // The strings point into the loaded dictionaries.
   struct Item {
-    string hangul;
-    string hanja;
-    string comment;
+    const char *hangul;
+    const char *hanja;
+    const char *comment;
   };
 
-  explicit HanjaLookup(pp::Instance *instance) {
-    instance_ = instance;
-    loaded_ = false;
-  }
-  virtual ~HanjaLookup() {}
+  // Scratch space of MatchPrefixes. A caller matching repeatedly keeps one and
+  // passes it to every call, so that nothing is allocated once it has grown.
+  struct MatchBuffer {
+    // Ranges of all dictionaries. The ranges of source i are in
+    // [cursors[i], ends[i]), from the longest prefix to the shortest.
+    std::vector<HanjaDictionary::PrefixRange> ranges;
+    std::vector<size_t> cursors;
+    std::vector<size_t> ends;
+  };
+
+  // Callback type of SetLoadedCallback.
+  typedef void (*LoadedCallback)(void *user_data);
+
+  HanjaLookup();
+  virtual ~HanjaLookup();
 
-  // Returns true if dictionary is loaded
+  // Returns true if all the requested dictionaries are loaded or failed to
+  // load. Match only returns the results of loaded dictionaries, so results
+  // may be incomplete before it is true.
   bool loaded() const {
-    return loaded_;
+    return !sources_.empty() && num_pending_sources_ == 0;
+  }
+
+  // Returns true if any dictionary has been added, even if it isn't loaded.
+  bool has_sources() const {
+    return !sources_.empty();
+  }
+
+  // Returns a number that changes whenever a dictionary finishes loading, so
+  // that results cached by callers can be invalidated.
+  size_t generation() const {
+    return generation_;
   }
 
-  // Loads dictionary from url
-  // Note that this is a asynchronous method which will return immediately when
-  // calling. You must wait for the return value of loaded() to be true before
-  // you use other methods.
-  // @param[in] url The URL of dictionary file. If url is set to NULL, default
-  //                URL will be used.
-  void LoadFromURL(const char *url);
+  // Sets the selection frequency used to rank the items of MatchPrefixes, or
+  // NULL to return them in the order of dictionaries. It isn't owned by the
+  // lookup.
+  void SetFrequency(const HanjaFrequency *frequency);
+
+  // Sets the callback to be called when loaded() becomes true.
+  void SetLoadedCallback(LoadedCallback callback, void *user_data);
+
+  // Adds a dictionary to be loaded asynchronously, e.g. downloaded, by the
+  // caller, who must call FinishSource with the returned index when the data
+  // is ready or fails to load. Multiple dictionaries can be loaded at the same
+  // time, their results are returned in the order of adding them no matter
+  // which one finishes first.
+  // @param[in] name The name of dictionary used in error messages.
+  // @return         The index of the dictionary.
+  size_t AddSource(const string &name);
+
+  // Loads the dictionary added by AddSource from memory chunk
+  // @param[in] index  The index returned by AddSource.
+  // @param[in] buffer The memory chunk which contains a binary dictionary or
+  //                   dictionary text, or an empty chunk if the dictionary
+  //                   failed to load. Its content is taken by the lookup.
+  void FinishSource(size_t index, string *buffer);
 
   // Loads dictionary from memory chunk
-  // @param[in] memory The memory chunk which points to dictionary text.
-  void LoadFromMemory(const string &memory);
+  // @param[in] memory The memory chunk which contains a binary dictionary or
+  //                   dictionary text. Its content is taken by the lookup.
+  void LoadFromMemory(string *memory);
+
+  // Loads dictionary from a local file
+  // @param[in] path The path of dictionary file.
+  // @return         False if the file can't be read.
+  bool LoadFromFile(const char *path);
 
   // Matches hanja candidates with hangul characters
+  // Each dictionary is searched in its own index and the items are returned
+  // in the order of loading dictionaries.
   // @param[in]  hangul The key of hanja table.
-  // @param[out] begin  The begin iterator of matched results.
-  // @param[out] end    The end iterator.
-  void Match(const string &hangul,
-             std::vector<Item>::const_iterator *begin,
-             std::vector<Item>::const_iterator *end) const;
+  // @param[out] items  The matched items are appended to it.
+  void Match(const string &hangul, std::vector<Item> *items) const;
+
+  // Matches hanja candidates with every prefix of hangul characters in a
+  // single walk of each dictionary. Items of longer prefixes come first, and
+  // items of the same prefix are ranked by the selection frequency, then in
+  // the same order as Match.
+  // @param[in]  hangul    The hangul characters.
+  // @param[in]  max_items The maximum number of items to return, 0 means no
+  //                       limit.
+  // @param[out] items     The matched items are appended to it.
+  // @param[out] lengths   The number of characters of the prefix matched by
+  //                       each item is appended to it.
+  // @param[in]  buffer    The scratch space reused between calls.
+  void MatchPrefixes(const string &hangul,
+                     size_t max_items,
+                     std::vector<Item> *items,
+                     std::vector<size_t> *lengths,
+                     MatchBuffer *buffer) const;
+
+  // Returns the bytes of memory held by the loaded dictionaries.
+  size_t memory_usage() const;
 
  private:
-  bool AppendItem(const string &memory, int start, int end);
+  // A dictionary requested to be loaded. |dictionary| is NULL before it is
+  // loaded or if it fails to load.
+  struct Source {
+    string name;
+    HanjaDictionary *dictionary;
+    bool finished;
+  };
+
+  // Moves the items of prefix hangul[0, length) starting at begin that have
+  // been selected to the front, the most frequent first.
+  void RankItems(const string &hangul,
+                 size_t length,
+                 size_t begin,
+                 std::vector<Item> *items) const;
+
+  std::vector<Source> sources_;
+  size_t num_pending_sources_;
+  size_t generation_;
+  const HanjaFrequency *frequency_;
+  LoadedCallback loaded_callback_;
+  void *loaded_callback_data_;
 
-  bool loaded_;
-  std::vector<Item> items_;
-  pp::Instance *instance_;
+  HanjaLookup(const HanjaLookup &);
+  void operator=(const HanjaLookup &);
 };
 
 #endif  // HANJA_H_
@@ -0,0 +1,156 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Benchmark of looking up Hanja candidates for every prefix of the input,
+// comparing a binary search per prefix length with the single walk of
+// HanjaDictionary::MatchPrefixes.
+//
+// Usage: hanja_benchmark dictionary.bin
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hanja_dictionary.h"
+#include "unicode_util.h"
+
+using std::string;
+
+namespace {
+
+const int kNumQueries = 10000;
+const size_t kQueryLengths[] = {1, 2, 4, 8, 16};
+
+double NowMs() {
+  struct timeval time;
+  gettimeofday(&time, NULL);
+  return time.tv_sec * 1000.0 + time.tv_usec / 1000.0;
+}
+
+// Looks up the prefixes from the longest to the shortest by re-encoding each
+// prefix and searching it.
+size_t MatchEachPrefix(const HanjaDictionary &dictionary, const string &text) {
+  UCSString ucs4 = unicode_util::Utf8ToUcs4(text.c_str(), 0);
+  size_t num_matched = 0;
+  for (size_t len = ucs4.length(); len >= 1; len--) {
+    string prefix = unicode_util::Ucs4ToUtf8(ucs4.c_str(), len);
+    size_t begin, end;
+    dictionary.Match(prefix.c_str(), &begin, &end);
+    num_matched += end - begin;
+  }
+  return num_matched;
+}
+
+size_t MatchAllPrefixes(const HanjaDictionary &dictionary,
+                        const string &text,
+                        std::vector<HanjaDictionary::PrefixRange> *ranges) {
+  ranges->clear();
+  dictionary.MatchPrefixes(text.data(), text.size(), ranges);
+  size_t num_matched = 0;
+  for (size_t i = 0; i < ranges->size(); ++i) {
+    num_matched += (*ranges)[i].end - (*ranges)[i].begin;
+  }
+  return num_matched;
+}
+
+// Builds queries of |length| characters by joining random keys of the
+// dictionary, so that most prefixes have candidates like real input.
+void BuildQueries(const HanjaDictionary &dictionary,
+                  size_t length,
+                  std::vector<string> *queries) {
+  queries->clear();
+  for (int i = 0; i < kNumQueries; ++i) {
+    UCSString query;
+    while (query.length() < length) {
+      size_t index = rand() % dictionary.size();
+      query += unicode_util::Utf8ToUcs4(dictionary.hangul(index), 0);
+    }
+    query.resize(length);
+    queries->push_back(unicode_util::Ucs4ToUtf8(query.c_str(), length));
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " dictionary.bin" << std::endl;
+    return 1;
+  }
+  std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+  std::ostringstream content;
+  content << input.rdbuf();
+  string buffer = content.str();
+  HanjaDictionary dictionary;
+  if (!input || !dictionary.Load(&buffer) || dictionary.size() == 0) {
+    std::cerr << "Failed to load " << argv[1] << std::endl;
+    return 1;
+  }
+
+  srand(0);
+  std::vector<string> queries;
+  std::vector<HanjaDictionary::PrefixRange> ranges;
+  printf("%8s %12s %12s %10s\n", "chars", "each(us)", "walk(us)", "matched");
+  for (size_t i = 0; i < sizeof(kQueryLengths) / sizeof(kQueryLengths[0]);
+       ++i) {
+    BuildQueries(dictionary, kQueryLengths[i], &queries);
+    size_t matched_each = 0;
+    double start = NowMs();
+    for (size_t j = 0; j < queries.size(); ++j) {
+      matched_each += MatchEachPrefix(dictionary, queries[j]);
+    }
+    double each_ms = NowMs() - start;
+    size_t matched_walk = 0;
+    start = NowMs();
+    for (size_t j = 0; j < queries.size(); ++j) {
+      matched_walk += MatchAllPrefixes(dictionary, queries[j], &ranges);
+    }
+    double walk_ms = NowMs() - start;
+    if (matched_each != matched_walk) {
+      std::cerr << "Results differ: " << matched_each << " vs "
+                << matched_walk << std::endl;
+      return 1;
+    }
+    printf("%8u %12.3f %12.3f %10.1f\n",
+           static_cast<unsigned>(kQueryLengths[i]),
+           each_ms * 1000 / queries.size(),
+           walk_ms * 1000 / queries.size(),
+           static_cast<double>(matched_walk) / queries.size());
+  }
+  return 0;
+}
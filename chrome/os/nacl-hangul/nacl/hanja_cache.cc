@@ -0,0 +1,119 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <limits.h>
+
+#include "hanja_cache.h"
+
+HanjaCache::HanjaCache(size_t capacity)
+    : capacity_(capacity),
+      hits_(0),
+      misses_(0) {
+}
+
+HanjaCache::~HanjaCache() {
+}
+
+bool HanjaCache::Key::operator<(const Key &other) const {
+  int result = hangul.compare(other.hangul);
+  if (result != 0) {
+    return result < 0;
+  }
+  if (num_candidates != other.num_candidates) {
+    return num_candidates < other.num_candidates;
+  }
+  return format < other.format;
+}
+
+const string *HanjaCache::Lookup(const string &hangul,
+                                 size_t num_candidates,
+                                 int format) {
+  std::map<Key, EntryList::iterator>::iterator it =
+      index_.find(Key(hangul, num_candidates, format));
+  if (it == index_.end()) {
+    ++misses_;
+    return NULL;
+  }
+  ++hits_;
+  // Moving the entry to the front doesn't invalidate the iterator
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return &it->second->second;
+}
+
+void HanjaCache::Insert(const string &hangul,
+                        size_t num_candidates,
+                        int format,
+                        const string &response) {
+  if (capacity_ == 0) {
+    return;
+  }
+  Key key(hangul, num_candidates, format);
+  std::map<Key, EntryList::iterator>::iterator it = index_.find(key);
+  if (it != index_.end()) {
+    it->second->second = response;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+  if (index_.size() >= capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  entries_.push_front(std::make_pair(key, response));
+  index_[key] = entries_.begin();
+}
+
+void HanjaCache::set_capacity(size_t capacity) {
+  capacity_ = capacity;
+  while (index_.size() > capacity_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+void HanjaCache::Clear() {
+  entries_.clear();
+  index_.clear();
+}
+
+void HanjaCache::RemovePrefixed(const string &prefix) {
+  std::map<Key, EntryList::iterator>::iterator it =
+      index_.lower_bound(Key(prefix, 0, INT_MIN));
+  while (it != index_.end() &&
+         it->first.hangul.compare(0, prefix.length(), prefix) == 0) {
+    entries_.erase(it->second);
+    index_.erase(it++);
+  }
+}
+
+double HanjaCache::hit_rate() const {
+  size_t lookups = hits_ + misses_;
+  return lookups ? static_cast<double>(hits_) / lookups : 0;
+}
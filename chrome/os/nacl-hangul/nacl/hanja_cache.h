@@ -0,0 +1,125 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HANJA_CACHE_H_
+#define HANJA_CACHE_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+using std::string;
+
+// A bounded cache of hanja responses keyed by the hangul text, the number of
+// candidates requested and the format of the response. The least recently
+// used response is evicted when the cache is full.
+class HanjaCache {
+ public:
+  // @param[in] capacity The maximum number of responses kept.
+  explicit HanjaCache(size_t capacity);
+  ~HanjaCache();
+
+  // Looks up a response, and marks it as the most recently used one.
+  // @param[in] hangul         The hangul text.
+  // @param[in] num_candidates The number of candidates requested.
+  // @param[in] format         The format of the response, responses of
+  //                           different formats are cached separately.
+  // @return                   The cached response, or NULL if it isn't cached.
+  //                           It is valid until the cache is changed.
+  const string *Lookup(const string &hangul,
+                       size_t num_candidates,
+                       int format);
+
+  // Adds a response, evicting the least recently used one if the cache is
+  // full.
+  void Insert(const string &hangul,
+              size_t num_candidates,
+              int format,
+              const string &response);
+
+  // Removes all the responses, e.g. when dictionaries are loaded. The
+  // statistics are kept.
+  void Clear();
+
+  // Removes the responses of the hangul texts starting with prefix, whose
+  // candidates include the ones of prefix.
+  void RemovePrefixed(const string &prefix);
+
+  size_t size() const {
+    return index_.size();
+  }
+
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  // Changes the maximum number of responses kept, evicting the least recently
+  // used ones if needed. 0 disables the cache.
+  void set_capacity(size_t capacity);
+
+  // Statistics of Lookup
+  size_t hits() const {
+    return hits_;
+  }
+
+  size_t misses() const {
+    return misses_;
+  }
+
+  // Returns the ratio of hits to lookups, or 0 if nothing is looked up.
+  double hit_rate() const;
+
+ private:
+  struct Key {
+    Key(const string &hangul, size_t num_candidates, int format)
+        : hangul(hangul), num_candidates(num_candidates), format(format) {}
+    // Orders by hangul first, so the texts with the same prefix are adjacent
+    bool operator<(const Key &other) const;
+
+    string hangul;
+    size_t num_candidates;
+    int format;
+  };
+  // Entries from the most recently used to the least
+  typedef std::list<std::pair<Key, string> > EntryList;
+
+  size_t capacity_;
+  EntryList entries_;
+  std::map<Key, EntryList::iterator> index_;
+  size_t hits_;
+  size_t misses_;
+
+  HanjaCache(const HanjaCache &);
+  void operator=(const HanjaCache &);
+};
+
+#endif  // HANJA_CACHE_H_
@@ -0,0 +1,88 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+// Offline tool to compile a dictionary text, e.g. hanja.txt or symbol.txt,
+// into the binary format loaded by HanjaDictionary.
+//
+// Usage: hanja_dict_builder input.txt output.bin
+
+#include <stdio.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "hanja_dictionary.h"
+
+using std::string;
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " input.txt output.bin" << std::endl;
+    return 1;
+  }
+  std::ifstream input(argv[1], std::ios::in | std::ios::binary);
+  if (!input) {
+    std::cerr << "Failed to open " << argv[1] << std::endl;
+    return 1;
+  }
+  std::ostringstream text;
+  text << input.rdbuf();
+
+  string binary;
+  size_t invalid_lines = 0;
+  HanjaDictionary::Compile(text.str(), &binary, &invalid_lines);
+  if (invalid_lines > 0) {
+    std::cerr << "Skipped " << invalid_lines << " invalid lines in "
+              << argv[1] << std::endl;
+  }
+  // Verifies the output can be loaded.
+  string buffer = binary;
+  HanjaDictionary dictionary;
+  if (!dictionary.Load(&buffer)) {
+    std::cerr << "Failed to load compiled dictionary" << std::endl;
+    return 1;
+  }
+
+  std::ofstream output(argv[2], std::ios::out | std::ios::binary);
+  output.write(binary.data(), binary.size());
+  if (!output) {
+    std::cerr << "Failed to write " << argv[2] << std::endl;
+    return 1;
+  }
+  printf("%s: %u entries, %u bytes text, %u bytes binary\n",
+         argv[2],
+         static_cast<unsigned>(dictionary.size()),
+         static_cast<unsigned>(text.str().size()),
+         static_cast<unsigned>(binary.size()));
+  return 0;
+}
@@ -0,0 +1,291 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "hanja_dictionary.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+const char kMagic[] = {'H', 'N', 'J', '1'};
+// Magic, entry count and pool size.
+const size_t kHeaderSize = 3 * sizeof(uint32_t);
+const size_t kEntrySize = 3 * sizeof(uint32_t);
+
+struct TextEntry {
+  uint32_t hangul;
+  uint32_t hanja;
+  uint32_t comment;
+};
+
+// A field of a line in the dictionary text.
+struct TextSpan {
+  uint32_t start;
+  uint32_t length;
+};
+
+// Orders spans by their content in the dictionary text, which is the same
+// order as strcmp.
+class TextSpanLess {
+ public:
+  TextSpanLess(const char *text, const std::vector<TextSpan> &spans)
+      : text_(text), spans_(spans) {}
+  bool operator()(uint32_t a, uint32_t b) const {
+    const TextSpan &span_a = spans_[a];
+    const TextSpan &span_b = spans_[b];
+    int result = memcmp(text_ + span_a.start, text_ + span_b.start,
+                        std::min(span_a.length, span_b.length));
+    return result < 0 || (result == 0 && span_a.length < span_b.length);
+  }
+
+ private:
+  const char *text_;
+  const std::vector<TextSpan> &spans_;
+};
+
+bool TextEntryLess(const TextEntry &a, const TextEntry &b) {
+  return a.hangul < b.hangul;
+}
+
+void AppendUint32(uint32_t value, string *buffer) {
+  buffer->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+uint32_t ReadUint32(const string &buffer, size_t offset) {
+  uint32_t value;
+  memcpy(&value, buffer.data() + offset, sizeof(value));
+  return value;
+}
+
+}  // namespace
+
+HanjaDictionary::HanjaDictionary()
+    : entries_(NULL), pool_(NULL), entry_count_(0) {
+}
+
+bool HanjaDictionary::IsBinary(const string &buffer) {
+  return buffer.size() >= sizeof(kMagic) &&
+      memcmp(buffer.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+void HanjaDictionary::Compile(const string &text,
+                              string *binary,
+                              size_t *invalid_lines) {
+  if (invalid_lines) {
+    *invalid_lines = 0;
+  }
+  // Splits lines into spans, three spans for each entry
+  std::vector<TextSpan> spans;
+  for (size_t offset = 0; offset < text.size();) {
+    size_t new_line_pos = text.find('\n', offset);
+    if (new_line_pos == string::npos) {
+      new_line_pos = text.size();
+    }
+    // Skip empty lines or lines with start of #
+    if (new_line_pos != offset && text[offset] != '#') {
+      size_t sep_pos = text.find(':', offset);
+      size_t sep_pos_2 = sep_pos < new_line_pos ?
+          text.find(':', sep_pos + 1) : string::npos;
+      if (sep_pos_2 < new_line_pos) {
+        TextSpan span;
+        span.start = offset;
+        span.length = sep_pos - offset;
+        spans.push_back(span);
+        span.start = sep_pos + 1;
+        span.length = sep_pos_2 - sep_pos - 1;
+        spans.push_back(span);
+        span.start = sep_pos_2 + 1;
+        span.length = new_line_pos - sep_pos_2 - 1;
+        spans.push_back(span);
+      } else if (invalid_lines) {
+        ++*invalid_lines;
+      }
+    }
+    offset = new_line_pos + 1;
+  }
+
+  // Sorts the spans by content so that equal strings are adjacent and stored
+  // only once. The pool is in strcmp order as a result, so entries can be
+  // sorted by the offsets of their hangul.
+  std::vector<uint32_t> order(spans.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), TextSpanLess(text.data(), spans));
+  string pool;
+  std::vector<uint32_t> offsets(spans.size());
+  TextSpanLess span_less(text.data(), spans);
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (i == 0 || span_less(order[i - 1], order[i])) {
+      offsets[order[i]] = pool.size();
+      pool.append(text, spans[order[i]].start, spans[order[i]].length);
+      pool.push_back('\0');
+    } else {
+      offsets[order[i]] = offsets[order[i - 1]];
+    }
+  }
+  std::vector<TextEntry> entries(spans.size() / 3);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    entries[i].hangul = offsets[i * 3];
+    entries[i].hanja = offsets[i * 3 + 1];
+    entries[i].comment = offsets[i * 3 + 2];
+  }
+  std::stable_sort(entries.begin(), entries.end(), TextEntryLess);
+
+  binary->clear();
+  binary->reserve(kHeaderSize + entries.size() * kEntrySize + pool.size());
+  binary->append(kMagic, sizeof(kMagic));
+  AppendUint32(entries.size(), binary);
+  AppendUint32(pool.size(), binary);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    AppendUint32(entries[i].hangul, binary);
+    AppendUint32(entries[i].hanja, binary);
+    AppendUint32(entries[i].comment, binary);
+  }
+  binary->append(pool);
+}
+
+bool HanjaDictionary::Load(string *buffer) {
+  entries_ = NULL;
+  pool_ = NULL;
+  entry_count_ = 0;
+  if (IsBinary(*buffer)) {
+    buffer_.swap(*buffer);
+  } else {
+    Compile(*buffer, &buffer_, NULL);
+  }
+  string().swap(*buffer);
+
+  if (buffer_.size() < kHeaderSize) {
+    string().swap(buffer_);
+    return false;
+  }
+  uint32_t entry_count = ReadUint32(buffer_, sizeof(kMagic));
+  uint32_t pool_size = ReadUint32(buffer_, sizeof(kMagic) + sizeof(uint32_t));
+  size_t body_size = buffer_.size() - kHeaderSize;
+  if (entry_count > body_size / kEntrySize ||
+      pool_size != body_size - entry_count * kEntrySize ||
+      (entry_count > 0 &&
+       (pool_size == 0 || buffer_[buffer_.size() - 1] != '\0'))) {
+    string().swap(buffer_);
+    return false;
+  }
+  const Entry *entries = reinterpret_cast<const Entry *>(
+      buffer_.data() + kHeaderSize);
+  for (uint32_t i = 0; i < entry_count; ++i) {
+    if (entries[i].hangul >= pool_size ||
+        entries[i].hanja >= pool_size ||
+        entries[i].comment >= pool_size) {
+      string().swap(buffer_);
+      return false;
+    }
+  }
+  entries_ = entries;
+  pool_ = buffer_.data() + kHeaderSize + entry_count * kEntrySize;
+  entry_count_ = entry_count;
+  return true;
+}
+
+void HanjaDictionary::Match(const char *hangul,
+                            size_t *begin,
+                            size_t *end) const {
+  // Binary search: find the first entry not less than the key
+  size_t low = 0;
+  size_t high = entry_count_;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (strcmp(pool_ + entries_[middle].hangul, hangul) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  *begin = low;
+  // Binary search: find the first entry greater than the key
+  high = entry_count_;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (strcmp(pool_ + entries_[middle].hangul, hangul) <= 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  *end = low;
+}
+
+void HanjaDictionary::MatchPrefixes(const char *text,
+                                    size_t length,
+                                    std::vector<PrefixRange> *ranges) const {
+  size_t begin = 0;
+  size_t end = entry_count_;
+  for (size_t pos = 0; pos < length && begin < end; ++pos) {
+    // Narrow the range to the hangul with the same byte at pos
+    unsigned char byte = text[pos];
+    if (byte == 0) {
+      break;
+    }
+    begin = BytePartition(begin, end, pos, byte, true);
+    end = BytePartition(begin, end, pos, byte, false);
+    // Skip the bytes in the middle of a character
+    if (pos + 1 < length && (text[pos + 1] & 0xC0) == 0x80) {
+      continue;
+    }
+    // The hangul ending at pos + 1 sorts first in the range
+    PrefixRange range;
+    range.length = pos + 1;
+    range.begin = begin;
+    range.end = BytePartition(begin, end, pos + 1, 0, false);
+    if (range.begin < range.end) {
+      ranges->push_back(range);
+    }
+  }
+}
+
+size_t HanjaDictionary::BytePartition(size_t begin,
+                                      size_t end,
+                                      size_t pos,
+                                      unsigned char byte,
+                                      bool inclusive) const {
+  while (begin < end) {
+    size_t middle = begin + (end - begin) / 2;
+    unsigned char value = pool_[entries_[middle].hangul + pos];
+    if (value < byte || (!inclusive && value == byte)) {
+      begin = middle + 1;
+    } else {
+      end = middle;
+    }
+  }
+  return begin;
+}
@@ -0,0 +1,149 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HANJA_DICTIONARY_H_
+#define HANJA_DICTIONARY_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+
+// A read-only Hanja dictionary stored in a single buffer.
+//
+// Binary format, all integers are little-endian uint32:
+//   magic         "HNJ1"
+//   entry_count   number of entries
+//   pool_size     size of the string pool in bytes
+//   entries       entry_count * {hangul, hanja, comment}, offsets of the
+//                 fields in the string pool, sorted by hangul
+//   pool          deduplicated NUL-terminated UTF-8 strings
+//
+// Loading a binary dictionary only validates the buffer, entries are read in
+// place without any per-entry allocation.
+class HanjaDictionary {
+ public:
+  // Entries in [begin, end) whose hangul is the first |length| bytes of the
+  // text searched by MatchPrefixes.
+  struct PrefixRange {
+    size_t length;
+    size_t begin;
+    size_t end;
+  };
+
+  HanjaDictionary();
+  ~HanjaDictionary() {}
+
+  // Loads dictionary from memory chunk in either binary or text format. Text
+  // format is compiled into binary format first. The content of |buffer| is
+  // taken and |buffer| will be empty.
+  // @return False if the buffer is not a valid dictionary.
+  bool Load(string *buffer);
+
+  // Compiles dictionary text into binary format. Each line of the text is
+  // "hangul:hanja:comment", empty lines and lines starting with '#' are
+  // skipped. Entries with the same hangul are kept in text order.
+  // @param[in]  text          The dictionary text.
+  // @param[out] binary        The binary dictionary.
+  // @param[out] invalid_lines The number of lines skipped for not having two
+  //                           separators. Can be NULL.
+  static void Compile(const string &text,
+                      string *binary,
+                      size_t *invalid_lines);
+
+  // Returns true if |buffer| starts with the magic of binary format.
+  static bool IsBinary(const string &buffer);
+
+  // Finds the entries whose hangul equals to |hangul|.
+  // @param[in]  hangul The key to find.
+  // @param[out] begin  The index of the first matched entry.
+  // @param[out] end    The index after the last matched entry.
+  void Match(const char *hangul, size_t *begin, size_t *end) const;
+
+  // Finds the entries matching every prefix of |text| that ends at a UTF-8
+  // character boundary, in one walk of the text. Since entries are sorted by
+  // hangul, the entries sharing a prefix are adjacent and sorted by the next
+  // byte, so the range is narrowed byte by byte like walking down a trie.
+  // @param[in]  text   The UTF-8 text to search.
+  // @param[in]  length The length of text in bytes.
+  // @param[out] ranges The matched ranges are appended to it, from the
+  //                    shortest prefix to the longest.
+  void MatchPrefixes(const char *text,
+                     size_t length,
+                     std::vector<PrefixRange> *ranges) const;
+
+  size_t size() const {
+    return entry_count_;
+  }
+  const char *hangul(size_t index) const {
+    return pool_ + entries_[index].hangul;
+  }
+  const char *hanja(size_t index) const {
+    return pool_ + entries_[index].hanja;
+  }
+  const char *comment(size_t index) const {
+    return pool_ + entries_[index].comment;
+  }
+
+  // Returns the bytes of memory held by the dictionary.
+  size_t memory_usage() const {
+    return buffer_.capacity();
+  }
+
+ private:
+  struct Entry {
+    uint32_t hangul;
+    uint32_t hanja;
+    uint32_t comment;
+  };
+
+  // Returns the first entry in [begin, end) whose byte at |pos| of hangul is
+  // greater than |byte|, or not less than |byte| if |inclusive| is true. All
+  // the hangul in the range must be at least |pos| bytes long.
+  size_t BytePartition(size_t begin,
+                       size_t end,
+                       size_t pos,
+                       unsigned char byte,
+                       bool inclusive) const;
+
+  // Disallows copy and assign, entries point into |buffer_|.
+  HanjaDictionary(const HanjaDictionary &);
+  void operator=(const HanjaDictionary &);
+
+  string buffer_;
+  const Entry *entries_;
+  const char *pool_;
+  uint32_t entry_count_;
+};
+
+#endif  // HANJA_DICTIONARY_H_
@@ -0,0 +1,288 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "hanja_frequency.h"
+
+namespace {
+
+// The header of serialized data
+const char kMagic[] = "HNF1";
+const size_t kMagicSize = 4;
+// Counts are aged before they reach it
+const uint32_t kMaxCount = 0xFFFF;
+const char kBase64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+void AppendWord(uint32_t value, string *output) {
+  output->push_back(static_cast<char>(value & 0xFF));
+  output->push_back(static_cast<char>((value >> 8) & 0xFF));
+  output->push_back(static_cast<char>((value >> 16) & 0xFF));
+  output->push_back(static_cast<char>((value >> 24) & 0xFF));
+}
+
+uint32_t ReadWord(const string &data, size_t offset) {
+  const unsigned char *bytes =
+      reinterpret_cast<const unsigned char *>(data.data()) + offset;
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) |
+      (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+void EncodeBase64(const string &input, string *output) {
+  output->clear();
+  for (size_t i = 0; i < input.size(); i += 3) {
+    uint32_t value = static_cast<unsigned char>(input[i]) << 16;
+    if (i + 1 < input.size()) {
+      value |= static_cast<unsigned char>(input[i + 1]) << 8;
+    }
+    if (i + 2 < input.size()) {
+      value |= static_cast<unsigned char>(input[i + 2]);
+    }
+    output->push_back(kBase64Chars[(value >> 18) & 0x3F]);
+    output->push_back(kBase64Chars[(value >> 12) & 0x3F]);
+    output->push_back(i + 1 < input.size() ?
+                      kBase64Chars[(value >> 6) & 0x3F] : '=');
+    output->push_back(i + 2 < input.size() ? kBase64Chars[value & 0x3F] : '=');
+  }
+}
+
+bool DecodeBase64(const string &input, string *output) {
+  output->clear();
+  if (input.size() % 4 != 0) {
+    return false;
+  }
+  uint32_t value = 0;
+  size_t num_bits = 0;
+  for (size_t i = 0; i < input.size(); ++i) {
+    if (input[i] == '=') {
+      // Padding is only allowed at the end
+      return i + 2 >= input.size() &&
+          (i + 1 == input.size() || input[i + 1] == '=');
+    }
+    const char *position = strchr(kBase64Chars, input[i]);
+    if (!input[i] || !position) {
+      return false;
+    }
+    value = (value << 6) | (position - kBase64Chars);
+    num_bits += 6;
+    if (num_bits >= 8) {
+      num_bits -= 8;
+      output->push_back(static_cast<char>((value >> num_bits) & 0xFF));
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+HanjaFrequency::HanjaFrequency(size_t max_entries)
+    : max_entries_(max_entries > 0 ? max_entries : 1),
+      size_(0) {
+  size_t num_slots = 1;
+  while (num_slots < max_entries_ * 2) {
+    num_slots *= 2;
+  }
+  Slot empty = {0, 0};
+  slots_.assign(num_slots, empty);
+}
+
+HanjaFrequency::~HanjaFrequency() {
+}
+
+uint32_t HanjaFrequency::Hash(const char *hangul,
+                              size_t hangul_length,
+                              const char *hanja) {
+  // FNV-1a of hangul, a NUL separator and hanja
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < hangul_length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(hangul[i])) * 16777619u;
+  }
+  hash *= 16777619u;
+  for (const char *p = hanja; *p; ++p) {
+    hash = (hash ^ static_cast<unsigned char>(*p)) * 16777619u;
+  }
+  // 0 is reserved for empty slots
+  return hash ? hash : 1;
+}
+
+void HanjaFrequency::Record(const string &hangul, const string &hanja) {
+  uint32_t key = Hash(hangul.data(), hangul.size(), hanja.c_str());
+  Slot *slot = Find(key);
+  if (slot->key) {
+    if (slot->count >= kMaxCount) {
+      Age();
+      slot = Find(key);
+    }
+    if (slot->key) {
+      ++slot->count;
+      return;
+    }
+  }
+  if (size_ >= max_entries_) {
+    EvictLowest();
+  }
+  Insert(key, 1);
+}
+
+uint32_t HanjaFrequency::Count(uint32_t key) const {
+  if (size_ == 0) {
+    return 0;
+  }
+  return Find(key)->count;
+}
+
+void HanjaFrequency::Serialize(string *data) const {
+  string binary(kMagic, kMagicSize);
+  AppendWord(size_, &binary);
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i].key) {
+      AppendWord(slots_[i].key, &binary);
+      AppendWord(slots_[i].count, &binary);
+    }
+  }
+  EncodeBase64(binary, data);
+}
+
+bool HanjaFrequency::Load(const string &data) {
+  string binary;
+  if (!DecodeBase64(data, &binary) ||
+      binary.size() < kMagicSize + 4 ||
+      binary.compare(0, kMagicSize, kMagic) != 0) {
+    return false;
+  }
+  size_t num_entries = ReadWord(binary, kMagicSize);
+  if (binary.size() != kMagicSize + 4 + num_entries * 8) {
+    return false;
+  }
+  std::vector<Slot> entries;
+  entries.reserve(num_entries);
+  for (size_t i = 0; i < num_entries; ++i) {
+    size_t offset = kMagicSize + 4 + i * 8;
+    Slot entry = {ReadWord(binary, offset), ReadWord(binary, offset + 4)};
+    if (entry.key && entry.count) {
+      entry.count = std::min(entry.count, kMaxCount);
+      entries.push_back(entry);
+    }
+  }
+  // Data saved with a larger table keeps its most selected entries
+  if (entries.size() > max_entries_) {
+    std::stable_sort(entries.begin(), entries.end(), HasHigherCount);
+  }
+  Clear();
+  for (size_t i = 0; i < entries.size() && size_ < max_entries_; ++i) {
+    if (!Find(entries[i].key)->key) {
+      Insert(entries[i].key, entries[i].count);
+    }
+  }
+  return true;
+}
+
+void HanjaFrequency::Clear() {
+  Slot empty = {0, 0};
+  slots_.assign(slots_.size(), empty);
+  size_ = 0;
+}
+
+HanjaFrequency::Slot *HanjaFrequency::Find(uint32_t key) {
+  return const_cast<Slot *>(
+      static_cast<const HanjaFrequency *>(this)->Find(key));
+}
+
+const HanjaFrequency::Slot *HanjaFrequency::Find(uint32_t key) const {
+  // Linear probing, the table is never full
+  size_t mask = slots_.size() - 1;
+  size_t index = key & mask;
+  while (slots_[index].key && slots_[index].key != key) {
+    index = (index + 1) & mask;
+  }
+  return &slots_[index];
+}
+
+void HanjaFrequency::Insert(uint32_t key, uint32_t count) {
+  Slot *slot = Find(key);
+  slot->key = key;
+  slot->count = count;
+  ++size_;
+}
+
+bool HanjaFrequency::HasHigherCount(const Slot &left, const Slot &right) {
+  return left.count > right.count;
+}
+
+void HanjaFrequency::EvictLowest() {
+  size_t lowest = slots_.size();
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    if (slots_[i].key &&
+        (lowest == slots_.size() || slots_[i].count < slots_[lowest].count)) {
+      lowest = i;
+      if (slots_[i].count == 1) {
+        break;
+      }
+    }
+  }
+  if (lowest < slots_.size()) {
+    Remove(lowest);
+  }
+}
+
+void HanjaFrequency::Remove(size_t index) {
+  // Backward shift deletion: the following entries of the probing sequence
+  // are moved into the hole if it lies between their home slots and them, so
+  // no tombstone is needed.
+  size_t mask = slots_.size() - 1;
+  for (size_t next = (index + 1) & mask; slots_[next].key;
+       next = (next + 1) & mask) {
+    size_t home = slots_[next].key & mask;
+    if (((next - home) & mask) >= ((next - index) & mask)) {
+      slots_[index] = slots_[next];
+      index = next;
+    }
+  }
+  slots_[index].key = 0;
+  slots_[index].count = 0;
+  --size_;
+}
+
+void HanjaFrequency::Age() {
+  std::vector<Slot> slots;
+  slots.swap(slots_);
+  Slot empty = {0, 0};
+  slots_.assign(slots.size(), empty);
+  size_ = 0;
+  for (size_t i = 0; i < slots.size(); ++i) {
+    if (slots[i].key && slots[i].count / 2 > 0) {
+      Insert(slots[i].key, slots[i].count / 2);
+    }
+  }
+}
@@ -0,0 +1,117 @@
+// Copyright 2014 The ChromeOS IME Authors. All Rights Reserved.
+// limitations under the License.
+// See the License for the specific language governing permissions and
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// distributed under the License is distributed on an "AS-IS" BASIS,
+// Unless required by applicable law or agreed to in writing, software
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// You may obtain a copy of the License at
+// you may not use this file except in compliance with the License.
+// Licensed under the Apache License, Version 2.0 (the "License");
+//
+/*
+ * Copyright 2013 Google Inc. All Rights Reserved.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HANJA_FREQUENCY_H_
+#define HANJA_FREQUENCY_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+using std::string;
+
+// The numbers of times the user selected hanja candidates, which are used to
+// rank the candidates. Selections are keyed by 32-bit hashes of the hangul
+// and hanja, and kept in a fixed-size open addressing table, so looking up a
+// count takes no allocation. When the table is full, a selection with the
+// lowest count makes room for the new one. When a count is too large, all the
+// counts are halved and the ones that become 0 are dropped, so that recent
+// selections weigh more than old ones.
+class HanjaFrequency {
+ public:
+  // @param[in] max_entries The maximum number of selections kept.
+  explicit HanjaFrequency(size_t max_entries);
+  ~HanjaFrequency();
+
+  // Hashes a selection.
+  // @param[in] hangul        The hangul text.
+  // @param[in] hangul_length The length of hangul in bytes.
+  // @param[in] hanja         The selected hanja.
+  // @return                  The key of the selection.
+  static uint32_t Hash(const char *hangul,
+                       size_t hangul_length,
+                       const char *hanja);
+
+  // Records that the user selected hanja for hangul.
+  void Record(const string &hangul, const string &hanja);
+
+  // Returns the number of times of selecting the key returned by Hash, which
+  // may be reduced by aging.
+  uint32_t Count(uint32_t key) const;
+
+  // Returns the number of selections kept.
+  size_t size() const {
+    return size_;
+  }
+
+  // Serializes the selections into a compact text that can be persisted by
+  // the input method.
+  void Serialize(string *data) const;
+
+  // Loads the selections serialized by Serialize, replacing the current
+  // ones.
+  // @return False if data is invalid, and the current selections are kept.
+  bool Load(const string &data);
+
+  void Clear();
+
+ private:
+  struct Slot {
+    // 0 means the slot is empty
+    uint32_t key;
+    uint32_t count;
+  };
+  // Orders the selections from the most selected.
+  static bool HasHigherCount(const Slot &left, const Slot &right);
+
+  // Returns the slot of key, or the empty slot to insert it into.
+  Slot *Find(uint32_t key);
+  const Slot *Find(uint32_t key) const;
+  void Insert(uint32_t key, uint32_t count);
+  // Removes a selection with the lowest count.
+  void EvictLowest();
+  // Removes the selection in slots_[index].
+  void Remove(size_t index);
+  // Halves all the counts and drops the ones that become 0.
+  void Age();
+
+  size_t max_entries_;
+  // The number of slots is a power of 2 that is at least twice of
+  // max_entries_, so probing sequences are short.
+  std::vector<Slot> slots_;
+  size_t size_;
+
+  HanjaFrequency(const HanjaFrequency &);
+  void operator=(const HanjaFrequency &);
+};
+
+#endif  // HANJA_FREQUENCY_H_
@@ -32,6 +32,8 @@
 #ifndef UNICODE_UTIL_H_
 #define UNICODE_UTIL_H_
 
+#include <stdint.h>
+
 #include <string>
 
 using std::string;
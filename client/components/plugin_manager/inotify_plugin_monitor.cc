@@ -0,0 +1,211 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "components/plugin_manager/inotify_plugin_monitor.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "base/logging.h"
+#include "components/plugin_manager/plugin_manager_utils.h"
+
+namespace ime_goopy {
+namespace components {
+namespace {
+
+const uint32 kWatchMask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE |
+                          IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+// Size of the buffer to read inotify events, which is enough for at least 16
+// events with the longest file name.
+const size_t kEventBufferSize = 16 * (sizeof(inotify_event) + NAME_MAX + 1);
+
+}  // namespace
+
+InotifyPluginMonitor::InotifyPluginMonitor(
+    const std::string& path,
+    int debounce_ms,
+    PluginMonitorInterface::Delegate* delegate)
+    : path_(path),
+      debounce_ms_(debounce_ms),
+      delegate_(delegate),
+      inotify_fd_(-1),
+      thread_(base::kNullThreadHandle) {
+  DCHECK(delegate);
+  DCHECK_GE(debounce_ms, 0);
+  quit_pipe_[0] = quit_pipe_[1] = -1;
+}
+
+InotifyPluginMonitor::~InotifyPluginMonitor() {
+  Stop();
+}
+
+bool InotifyPluginMonitor::Start() {
+  if (thread_ != base::kNullThreadHandle)
+    return true;
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ < 0) {
+    DLOG(ERROR) << "Error initializing inotify: " << strerror(errno);
+    return false;
+  }
+  if (pipe(quit_pipe_) != 0) {
+    DLOG(ERROR) << "Error creating pipe: " << strerror(errno);
+    Stop();
+    return false;
+  }
+  AddWatchRecursively(path_, false);
+  if (watches_.empty() ||
+      !base::PlatformThread::Create(0, this, &thread_)) {
+    DLOG(ERROR) << "Error monitoring plugin path: " << path_;
+    thread_ = base::kNullThreadHandle;
+    Stop();
+    return false;
+  }
+  return true;
+}
+
+void InotifyPluginMonitor::Stop() {
+  if (thread_ != base::kNullThreadHandle) {
+    char quit = 0;
+    while (write(quit_pipe_[1], &quit, 1) < 0 && errno == EINTR) {}
+    base::PlatformThread::Join(thread_);
+    thread_ = base::kNullThreadHandle;
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (quit_pipe_[i] >= 0)
+      close(quit_pipe_[i]);
+    quit_pipe_[i] = -1;
+  }
+  if (inotify_fd_ >= 0)
+    close(inotify_fd_);
+  inotify_fd_ = -1;
+  watches_.clear();
+  changed_files_.clear();
+}
+
+void InotifyPluginMonitor::ThreadMain() {
+  base::PlatformThread::SetName("PluginMonitor");
+  while (true) {
+    struct pollfd fds[2] = {
+      { inotify_fd_, POLLIN, 0 },
+      { quit_pipe_[0], POLLIN, 0 },
+    };
+    // Waits for the debounce period if there are unreported changes, so that
+    // a burst of changes, e.g. installing a plugin, is reported only once.
+    int timeout = changed_files_.empty() ? -1 : debounce_ms_;
+    int result = poll(fds, arraysize(fds), timeout);
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      DLOG(ERROR) << "Error polling inotify: " << strerror(errno);
+      return;
+    }
+    if (fds[1].revents)
+      return;
+    if (result == 0) {
+      ReportChanges();
+      continue;
+    }
+    if (fds[0].revents & POLLIN)
+      ReadEvents();
+  }
+}
+
+void InotifyPluginMonitor::AddWatchRecursively(const std::string& dir,
+                                               bool report_files) {
+  int wd = inotify_add_watch(inotify_fd_, dir.c_str(), kWatchMask);
+  if (wd < 0) {
+    DLOG(ERROR) << "Error watching: " << dir << " " << strerror(errno);
+    return;
+  }
+  watches_[wd] = dir;
+  DIR* dir_handle = opendir(dir.c_str());
+  if (!dir_handle)
+    return;
+  while (struct dirent* entry = readdir(dir_handle)) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+    std::string file = dir + "/" + entry->d_name;
+    struct stat file_stat;
+    if (stat(file.c_str(), &file_stat) != 0)
+      continue;
+    if (S_ISDIR(file_stat.st_mode))
+      AddWatchRecursively(file, report_files);
+    else if (report_files && PluginManagerUtils::IsPluginFile(file))
+      changed_files_.insert(file);
+  }
+  closedir(dir_handle);
+}
+
+void InotifyPluginMonitor::ReadEvents() {
+  char buffer[kEventBufferSize]
+      __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  while (true) {
+    ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0)
+      return;
+    for (char* ptr = buffer; ptr < buffer + length;) {
+      const inotify_event* event = reinterpret_cast<inotify_event*>(ptr);
+      ptr += sizeof(inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        // Some events are lost, reports the root path so that all plugins are
+        // rescanned.
+        changed_files_.insert(path_);
+        continue;
+      }
+      std::map<int, std::string>::iterator watch = watches_.find(event->wd);
+      if (watch == watches_.end())
+        continue;
+      if (event->mask & IN_IGNORED) {
+        watches_.erase(watch);
+        continue;
+      }
+      if (!event->len)
+        continue;
+      std::string file = watch->second + "/" + event->name;
+      if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+          AddWatchRecursively(file, true);
+        } else if (event->mask & IN_MOVED_FROM) {
+          // The plugins in the directory are gone without per file events.
+          changed_files_.insert(file);
+        }
+      } else if (PluginManagerUtils::IsPluginFile(file) &&
+                 (event->mask & (IN_CLOSE_WRITE | IN_DELETE |
+                                 IN_MOVED_FROM | IN_MOVED_TO))) {
+        changed_files_.insert(file);
+      }
+    }
+  }
+}
+
+void InotifyPluginMonitor::ReportChanges() {
+  if (changed_files_.empty())
+    return;
+  std::vector<std::string> files(changed_files_.begin(),
+                                 changed_files_.end());
+  changed_files_.clear();
+  delegate_->PluginFilesChanged(files);
+}
+
+}  // namespace components
+}  // namespace ime_goopy
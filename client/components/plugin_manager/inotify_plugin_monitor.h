@@ -0,0 +1,76 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef GOOPY_COMPONENTS_PLUGIN_MANAGER_INOTIFY_PLUGIN_MONITOR_H_
+#define GOOPY_COMPONENTS_PLUGIN_MANAGER_INOTIFY_PLUGIN_MONITOR_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/threading/platform_thread.h"
+#include "components/plugin_manager/plugin_monitor_interface.h"
+
+namespace ime_goopy {
+namespace components {
+
+// A monitor that watches the plugin directory and its sub directories with
+// inotify. Changes are collected until no more change happens in
+// |debounce_ms|, and then the changed plugin files are reported to the
+// delegate with PluginFilesChanged.
+class InotifyPluginMonitor
+  : public PluginMonitorInterface,
+    public base::PlatformThread::Delegate {
+ public:
+  InotifyPluginMonitor(const std::string& path,
+                       int debounce_ms,
+                       PluginMonitorInterface::Delegate* delegate);
+  virtual ~InotifyPluginMonitor();
+  // Overridden from PluginMonitorInterface.
+  virtual bool Start() OVERRIDE;
+  virtual void Stop() OVERRIDE;
+  // Overridden from base::PlatformThread::Delegate.
+  virtual void ThreadMain() OVERRIDE;
+
+ private:
+  // Watches |dir| and all its sub directories. Plugin files found in newly
+  // watched directories are added to |changed_files_| if |report_files| is
+  // true, as they may have been created before the watch is added.
+  void AddWatchRecursively(const std::string& dir, bool report_files);
+  // Reads and handles all the pending inotify events.
+  void ReadEvents();
+  // Reports |changed_files_| to the delegate and clears it.
+  void ReportChanges();
+
+  std::string path_;
+  int debounce_ms_;
+  PluginMonitorInterface::Delegate* delegate_;
+  int inotify_fd_;
+  // A pipe used to wake up the monitor thread when stopping.
+  int quit_pipe_[2];
+  base::PlatformThreadHandle thread_;
+  // Maps watch descriptors to the watched directories.
+  std::map<int, std::string> watches_;
+  // Plugin files changed since the last report.
+  std::set<std::string> changed_files_;
+  DISALLOW_COPY_AND_ASSIGN(InotifyPluginMonitor);
+};
+
+}  // namespace components
+}  // namespace ime_goopy
+
+#endif  // GOOPY_COMPONENTS_PLUGIN_MANAGER_INOTIFY_PLUGIN_MONITOR_H_
@@ -0,0 +1,247 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+
+#include "components/plugin_manager/inotify_plugin_monitor.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <set>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include <gtest/gunit.h>
+
+namespace ime_goopy {
+namespace components {
+namespace {
+
+const int kDebounceMs = 100;
+const int kWaitTimeoutMs = 5000;
+const int kPollIntervalMs = 10;
+
+// Records the changes reported by the monitor.
+class RecordingDelegate : public PluginMonitorInterface::Delegate {
+ public:
+  RecordingDelegate() : report_count_(0) {
+  }
+
+  virtual void PluginChanged() OVERRIDE {
+    ADD_FAILURE() << "The monitor should report the changed files";
+  }
+
+  virtual void PluginFilesChanged(
+      const std::vector<std::string>& paths) OVERRIDE {
+    base::AutoLock auto_lock(lock_);
+    changed_files_.insert(paths.begin(), paths.end());
+    ++report_count_;
+  }
+
+  // Waits until some changes are reported, and moves the reported files to
+  // |files|. Returns the number of reports, or 0 on timeout.
+  int WaitForChanges(std::set<std::string>* files) {
+    files->clear();
+    for (int i = 0; i < kWaitTimeoutMs / kPollIntervalMs; ++i) {
+      {
+        base::AutoLock auto_lock(lock_);
+        if (report_count_) {
+          int report_count = report_count_;
+          files->swap(changed_files_);
+          report_count_ = 0;
+          return report_count;
+        }
+      }
+      base::PlatformThread::Sleep(kPollIntervalMs);
+    }
+    return 0;
+  }
+
+ private:
+  base::Lock lock_;
+  std::set<std::string> changed_files_;
+  int report_count_;
+  DISALLOW_COPY_AND_ASSIGN(RecordingDelegate);
+};
+
+class InotifyPluginMonitorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    char path[] = "/tmp/inotify_plugin_monitor_test.XXXXXX";
+    ASSERT_TRUE(mkdtemp(path) != NULL);
+    path_ = path;
+  }
+
+  virtual void TearDown() {
+    monitor_.reset(NULL);
+    Delete(path_);
+  }
+
+  void StartMonitor() {
+    monitor_.reset(new InotifyPluginMonitor(path_, kDebounceMs, &delegate_));
+    ASSERT_TRUE(monitor_->Start());
+  }
+
+  // Writes |content| to the file |name| under the monitored directory, and
+  // returns its path.
+  std::string WriteFile(const std::string& name, const std::string& content) {
+    std::string file = path_ + "/" + name;
+    FILE* stream = fopen(file.c_str(), "w");
+    EXPECT_TRUE(stream != NULL);
+    if (stream) {
+      fwrite(content.data(), 1, content.size(), stream);
+      fclose(stream);
+    }
+    return file;
+  }
+
+  std::string CreateDirectory(const std::string& name) {
+    std::string dir = path_ + "/" + name;
+    EXPECT_EQ(0, mkdir(dir.c_str(), 0700));
+    return dir;
+  }
+
+  static void Delete(const std::string& path) {
+    if (DIR* dir = opendir(path.c_str())) {
+      while (struct dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+          Delete(path + "/" + entry->d_name);
+      }
+      closedir(dir);
+      rmdir(path.c_str());
+    } else {
+      unlink(path.c_str());
+    }
+  }
+
+  std::string path_;
+  RecordingDelegate delegate_;
+  scoped_ptr<InotifyPluginMonitor> monitor_;
+};
+
+TEST_F(InotifyPluginMonitorTest, FailWithoutDirectory) {
+  InotifyPluginMonitor monitor(path_ + "/none", kDebounceMs, &delegate_);
+  EXPECT_FALSE(monitor.Start());
+}
+
+TEST_F(InotifyPluginMonitorTest, ReportAddedPlugin) {
+  StartMonitor();
+  std::string plugin = WriteFile("a.so", "plugin");
+  std::set<std::string> files;
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(1, files.size());
+  EXPECT_EQ(1, files.count(plugin));
+}
+
+TEST_F(InotifyPluginMonitorTest, ReportModifiedPlugin) {
+  std::string plugin = WriteFile("a.so", "plugin");
+  StartMonitor();
+  WriteFile("a.so", "new plugin");
+  std::set<std::string> files;
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(1, files.size());
+  EXPECT_EQ(1, files.count(plugin));
+}
+
+TEST_F(InotifyPluginMonitorTest, ReportRemovedPlugin) {
+  std::string plugin = WriteFile("a.so", "plugin");
+  StartMonitor();
+  ASSERT_EQ(0, unlink(plugin.c_str()));
+  std::set<std::string> files;
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(1, files.size());
+  EXPECT_EQ(1, files.count(plugin));
+}
+
+TEST_F(InotifyPluginMonitorTest, ReportRenamedPlugin) {
+  std::string plugin = WriteFile("a.so", "plugin");
+  StartMonitor();
+  std::string new_plugin = path_ + "/b.so";
+  ASSERT_EQ(0, rename(plugin.c_str(), new_plugin.c_str()));
+  std::set<std::string> files;
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(2, files.size());
+  EXPECT_EQ(1, files.count(plugin));
+  EXPECT_EQ(1, files.count(new_plugin));
+}
+
+TEST_F(InotifyPluginMonitorTest, IgnoreNonPluginFiles) {
+  StartMonitor();
+  WriteFile("readme.txt", "text");
+  std::string plugin = WriteFile("a.so", "plugin");
+  std::set<std::string> files;
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(1, files.size());
+  EXPECT_EQ(1, files.count(plugin));
+}
+
+TEST_F(InotifyPluginMonitorTest, DebounceChanges) {
+  StartMonitor();
+  std::string plugin1 = WriteFile("a.so", "plugin");
+  std::string plugin2 = WriteFile("b.so", "plugin");
+  WriteFile("a.so", "new plugin");
+  // All the changes within the debounce period are reported at once.
+  std::set<std::string> files;
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(2, files.size());
+  EXPECT_EQ(1, files.count(plugin1));
+  EXPECT_EQ(1, files.count(plugin2));
+}
+
+TEST_F(InotifyPluginMonitorTest, WatchNewDirectory) {
+  StartMonitor();
+  CreateDirectory("sub");
+  std::string plugin1 = WriteFile("sub/a.so", "plugin");
+  std::set<std::string> files;
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(1, files.count(plugin1));
+  // The new directory is watched as well.
+  std::string plugin2 = WriteFile("sub/b.so", "plugin");
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(1, files.size());
+  EXPECT_EQ(1, files.count(plugin2));
+}
+
+TEST_F(InotifyPluginMonitorTest, ReportMovedAwayDirectory) {
+  std::string dir = CreateDirectory("sub");
+  WriteFile("sub/a.so", "plugin");
+  StartMonitor();
+  std::string moved_dir = path_ + ".moved";
+  ASSERT_EQ(0, rename(dir.c_str(), moved_dir.c_str()));
+  // The plugins in the directory are reported by the directory.
+  std::set<std::string> files;
+  ASSERT_EQ(1, delegate_.WaitForChanges(&files));
+  EXPECT_EQ(1, files.size());
+  EXPECT_EQ(1, files.count(dir));
+  Delete(moved_dir);
+}
+
+}  // namespace
+}  // namespace components
+}  // namespace ime_goopy
+
+int main(int argc, char **argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,204 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// The plugin host process launched by PluginHostPool. It connects to the hub
+// at startup, and then starts the components of a plugin according to the
+// commands read from its standard input. The plugin is loaded when one of its
+// components receives the first message, and unloaded again when they are
+// idle if an idle timeout is given.
+
+#include <windows.h>
+#include <tchar.h>
+#include <stdlib.h>
+
+#include <map>
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/logging.h"
+#include "base/scoped_ptr.h"
+#include "base/stl_util.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+#include "base/time.h"
+#include "components/plugin_manager/plugin_host_pool.h"
+#include "components/plugin_wrapper/plugin_component_stub.h"
+#include "google/protobuf/text_format.h"
+#include "ipc/message_channel_client_win.h"
+#include "ipc/multi_component_host.h"
+
+namespace {
+
+using ime_goopy::components::PluginComponentStub;
+
+typedef std::map<std::string /*id*/, PluginComponentStub*> ComponentMap;
+
+// Reads a line from |file| without the line break. Returns false at the end of
+// the file.
+bool ReadLine(HANDLE file, std::string* line) {
+  line->clear();
+  char ch = 0;
+  DWORD read = 0;
+  while (::ReadFile(file, &ch, 1, &read, NULL) && read == 1) {
+    if (ch == '\n')
+      return true;
+    if (ch != '\r')
+      line->push_back(ch);
+  }
+  return !line->empty();
+}
+
+// A thread that periodically unloads the plugin from the idle components.
+// |lock| is shared with the command loop, which adds and removes the
+// components.
+class IdleUnloadThread : public base::PlatformThread::Delegate {
+ public:
+  IdleUnloadThread(ComponentMap* components,
+                   base::Lock* lock,
+                   const base::TimeDelta& timeout)
+      : components_(components),
+        lock_(lock),
+        timeout_(timeout),
+        quit_event_(true, false),
+        handle_(base::kNullThreadHandle) {
+  }
+
+  virtual ~IdleUnloadThread() {
+    Stop();
+  }
+
+  bool Start() {
+    return base::PlatformThread::Create(0, this, &handle_);
+  }
+
+  void Stop() {
+    if (handle_ == base::kNullThreadHandle)
+      return;
+    quit_event_.Signal();
+    base::PlatformThread::Join(handle_);
+    handle_ = base::kNullThreadHandle;
+  }
+
+  // Overridden from base::PlatformThread::Delegate.
+  virtual void ThreadMain() OVERRIDE {
+    base::PlatformThread::SetName("PluginIdleUnload");
+    // Checks twice per timeout, the same as PluginManager.
+    while (!quit_event_.TimedWait(timeout_ / 2)) {
+      base::AutoLock auto_lock(*lock_);
+      for (ComponentMap::iterator it = components_->begin();
+           it != components_->end();
+           ++it) {
+        it->second->UnloadIfIdle(timeout_);
+      }
+    }
+  }
+
+ private:
+  ComponentMap* components_;
+  base::Lock* lock_;
+  base::TimeDelta timeout_;
+  base::WaitableEvent quit_event_;
+  base::PlatformThreadHandle handle_;
+  DISALLOW_COPY_AND_ASSIGN(IdleUnloadThread);
+};
+
+}  // namespace
+
+int WINAPI _tWinMain(HINSTANCE instance,
+                     HINSTANCE prev_instance,
+                     LPTSTR command_line,
+                     int show_command) {
+  base::AtExitManager at_exit_manager;
+  scoped_ptr<ipc::MultiComponentHost> host(
+      new ipc::MultiComponentHost(true));
+  scoped_ptr<ipc::MessageChannelClientWin> channel(
+      new ipc::MessageChannelClientWin(host.get()));
+  if (!channel->Start())
+    return -1;
+
+  HANDLE input = ::GetStdHandle(STD_INPUT_HANDLE);
+  std::string plugin_path;
+  ComponentMap components;
+  base::Lock components_lock;
+  scoped_ptr<IdleUnloadThread> idle_unload_thread;
+  std::string line;
+  while (ReadLine(input, &line)) {
+    size_t separator = line.find(' ');
+    std::string command = line.substr(0, separator);
+    std::string argument =
+        separator == std::string::npos ? "" : line.substr(separator + 1);
+    if (command == ime_goopy::components::kPluginHostCommandLoad) {
+      DCHECK(plugin_path.empty());
+      plugin_path = argument;
+    } else if (command ==
+               ime_goopy::components::kPluginHostCommandIdleTimeout) {
+      int timeout_ms = atoi(argument.c_str());
+      if (idle_unload_thread.get() || timeout_ms <= 0)
+        continue;
+      idle_unload_thread.reset(new IdleUnloadThread(
+          &components,
+          &components_lock,
+          base::TimeDelta::FromMilliseconds(timeout_ms)));
+      if (!idle_unload_thread->Start()) {
+        DLOG(ERROR) << "Error starting idle unload thread";
+        idle_unload_thread.reset(NULL);
+      }
+    } else if (command == ime_goopy::components::kPluginHostCommandStart) {
+      ipc::proto::ComponentInfo info;
+      if (plugin_path.empty() ||
+          !google::protobuf::TextFormat::ParseFromString(argument, &info)) {
+        DLOG(ERROR) << "Invalid component:" << argument;
+        continue;
+      }
+      base::AutoLock auto_lock(components_lock);
+      if (components.count(info.string_id()))
+        continue;
+      // The stub is created from the ComponentInfo listed by the manager, so
+      // the plugin is loaded by the first message to the component.
+      scoped_ptr<PluginComponentStub> component(
+          new PluginComponentStub(plugin_path, info));
+      if (!component->IsInitialized()) {
+        DLOG(ERROR) << "Error starting component:" << info.string_id();
+        continue;
+      }
+      host->AddComponent(component.get());
+      components[info.string_id()] = component.release();
+    } else if (command == ime_goopy::components::kPluginHostCommandStop) {
+      base::AutoLock auto_lock(components_lock);
+      ComponentMap::iterator it = components.find(argument);
+      if (it == components.end())
+        continue;
+      host->RemoveComponent(it->second);
+      delete it->second;
+      components.erase(it);
+    } else if (command == ime_goopy::components::kPluginHostCommandQuit) {
+      break;
+    }
+  }
+
+  idle_unload_thread.reset(NULL);
+  for (ComponentMap::iterator it = components.begin();
+       it != components.end();
+       ++it) {
+    host->RemoveComponent(it->second);
+  }
+  STLDeleteContainerPairSecondPointers(components.begin(), components.end());
+  channel->Stop();
+  host.reset(NULL);
+  channel.reset(NULL);
+  return 0;
+}
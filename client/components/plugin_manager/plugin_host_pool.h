@@ -0,0 +1,188 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef GOOPY_COMPONENTS_PLUGIN_MANAGER_PLUGIN_HOST_POOL_H_
+#define GOOPY_COMPONENTS_PLUGIN_MANAGER_PLUGIN_HOST_POOL_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "base/basictypes.h"
+#include "base/compiler_specific.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
+#include "base/time.h"
+#include "ipc/protos/ipc.pb.h"
+
+namespace ime_goopy {
+namespace components {
+
+// Commands sent by PluginHostPool to the plugin host process through its
+// standard input, one command per line in the form of "<command> <argument>".
+// Assigns the plugin file in the argument to the process. Only one plugin can
+// be hosted in a plugin host process, and it is not loaded until one of its
+// components receives a message.
+static const char kPluginHostCommandLoad[] = "load";
+// Unloads the plugin again after its components have received no message for
+// the milliseconds in the argument.
+static const char kPluginHostCommandIdleTimeout[] = "idle";
+// Starts the component whose ComponentInfo is the argument, in single line
+// text format.
+static const char kPluginHostCommandStart[] = "start";
+// Stops the component whose string id is the argument.
+static const char kPluginHostCommandStop[] = "stop";
+// Stops all components and exits the process.
+static const char kPluginHostCommandQuit[] = "quit";
+
+// A pool of plugin host processes that run plugin components outside the
+// process of PluginManager, one process per plugin, so that a faulty plugin
+// can't take down other components.
+// A number of standby processes are launched in advance, they are connected
+// to the hub and wait for a plugin to load, so that a plugin can be started or
+// a crashed plugin can be replaced without waiting for a process to start.
+// A crashed plugin is restarted with an exponentially increasing delay, and is
+// marked as failed if it keeps crashing.
+class PluginHostPool : public base::PlatformThread::Delegate {
+ public:
+  // Resource usage of the process hosting a plugin.
+  struct PluginHostStats {
+    PluginHostStats()
+        : process_id(0),
+          cpu_time_ms(0),
+          memory_bytes(0),
+          restart_count(0),
+          failed(false) {
+    }
+    uint32 process_id;
+    // User and kernel cpu time used by the process.
+    int64 cpu_time_ms;
+    // Private bytes of the process.
+    int64 memory_bytes;
+    // Times that the plugin is restarted after its host process exits
+    // unexpectedly.
+    int restart_count;
+    // True if the plugin is not restarted any more because it kept crashing.
+    bool failed;
+  };
+  typedef std::map<std::string /*path*/, PluginHostStats> PluginHostStatsMap;
+
+  // |host_path| is the path of the plugin host executable.
+  // |standby_count| is the number of standby processes kept in the pool.
+  PluginHostPool(const std::wstring& host_path, int standby_count);
+  virtual ~PluginHostPool();
+  // Sets how a crashed plugin is restarted. The first restart happens after
+  // |restart_delay_ms|, and the delay doubles with each crash of the plugin
+  // within a short time after it is started. The plugin is marked as failed
+  // instead of being restarted once it crashes more than |max_restart_count|
+  // times in a row. Must be called before Init.
+  void SetRestartPolicy(int max_restart_count, int restart_delay_ms);
+  // Sets the period after which the host processes unload the plugins whose
+  // components are idle. Zero, the default, keeps the plugins loaded.
+  void SetIdleUnloadTimeout(int timeout_ms);
+  // Launches the standby processes and starts monitoring the processes.
+  bool Init();
+  // Starts the component described by |info| of the plugin in |plugin_path|.
+  // A standby process will be assigned to the plugin if it is not hosted yet.
+  // Returns false if the plugin has failed.
+  bool StartComponent(const std::string& plugin_path,
+                      const ipc::proto::ComponentInfo& info);
+  // Stops the component |id| of the plugin in |plugin_path|. The host process
+  // exits when all the components of the plugin are stopped.
+  void StopComponent(const std::string& plugin_path, const std::string& id);
+  // Forgets the crashes of the plugin in |plugin_path|, so that a failed plugin
+  // can be started again, e.g. after the plugin file is updated.
+  void ResetPlugin(const std::string& plugin_path);
+  // Gets the resource usage of the processes of all hosted plugins, and the
+  // failed plugins.
+  void GetStats(PluginHostStatsMap* stats);
+  // Overridden from base::PlatformThread::Delegate.
+  virtual void ThreadMain() OVERRIDE;
+
+ private:
+  struct HostProcess;
+  typedef std::map<std::string /*path*/, HostProcess*> PluginToProcessMap;
+  // A crashed plugin waiting to be restarted.
+  struct PendingRestart {
+    std::set<std::string> component_ids;
+    base::TimeTicks restart_time;
+  };
+  typedef std::map<std::string /*path*/, PendingRestart> PendingRestartMap;
+
+  // Launches a new plugin host process.
+  HostProcess* LaunchProcessUnlocked();
+  // Gets a standby process or launches a new one if there is none.
+  HostProcess* TakeStandbyProcessUnlocked();
+  // Launches standby processes until there are |standby_count_| of them.
+  void RefillStandbyProcessesUnlocked();
+  // Assigns |process| to the plugin in |plugin_path| and starts all the
+  // components in |component_ids| in the process.
+  bool AssignProcessUnlocked(HostProcess* process,
+                             const std::string& plugin_path,
+                             const std::set<std::string>& component_ids);
+  // Starts the component |id| in |process|.
+  bool StartComponentInProcessUnlocked(HostProcess* process,
+                                       const std::string& id);
+  // Called on a thread of the system thread pool when |process| exits.
+  void OnProcessSignaled(HostProcess* process);
+  // Handles the unexpected exit of a host process, and schedules the restart
+  // of its plugin.
+  void OnProcessExitedUnlocked(HostProcess* process);
+  // Restarts the crashed plugins whose restart time has come. |wait_time| is
+  // reduced to the time until the next pending restart.
+  void RestartPluginsUnlocked(base::TimeDelta* wait_time);
+  // Asks |process| to quit and releases it.
+  void QuitProcess(HostProcess* process);
+  bool SendCommand(HostProcess* process,
+                   const char* command,
+                   const std::string& argument);
+
+  std::wstring host_path_;
+  size_t standby_count_;
+  std::vector<HostProcess*> standby_processes_;
+  PluginToProcessMap plugin_processes_;
+  PendingRestartMap pending_restarts_;
+  // ComponentInfo of the started components in single line text format, which
+  // is sent to the host processes.
+  std::map<std::string /*id*/, std::string /*info*/> component_infos_;
+  int idle_unload_timeout_ms_;
+  // Restart counts of the plugins, kept after the plugin is stopped.
+  std::map<std::string, int> restart_counts_;
+  // Numbers of the crashes of the plugins since they last ran stably.
+  std::map<std::string, int> crash_counts_;
+  // Plugins that are not restarted any more.
+  std::set<std::string> failed_plugins_;
+  int max_restart_count_;
+  base::TimeDelta restart_delay_;
+  base::PlatformThreadHandle monitor_thread_;
+  // Signaled when the monitor thread needs to handle exited processes, update
+  // the standby processes or quit.
+  base::WaitableEvent wake_event_;
+  bool quit_;
+  base::Lock lock_;
+  // Processes that have exited and are not handled by the monitor thread yet.
+  // Protected by |exited_lock_| instead of |lock_|, because QuitProcess waits
+  // for the wait callbacks while holding |lock_|.
+  std::vector<HostProcess*> exited_processes_;
+  base::Lock exited_lock_;
+  DISALLOW_COPY_AND_ASSIGN(PluginHostPool);
+};
+
+}  // namespace components
+}  // namespace ime_goopy
+
+#endif  // GOOPY_COMPONENTS_PLUGIN_MANAGER_PLUGIN_HOST_POOL_H_
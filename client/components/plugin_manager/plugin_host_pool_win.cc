@@ -0,0 +1,483 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "components/plugin_manager/plugin_host_pool.h"
+
+#include <windows.h>
+#include <psapi.h>
+
+#include <algorithm>
+
+#include "base/logging.h"
+#include "base/stringprintf.h"
+#include "google/protobuf/text_format.h"
+
+namespace ime_goopy {
+namespace components {
+namespace {
+// Interval to check the standby processes if no process exits.
+const int kMonitorIntervalMs = 1000;
+// Default restart policy of the crashed plugins.
+const int kMaxRestartCount = 5;
+const int kRestartDelayMs = 1000;
+// The delay is not doubled any further after this many crashes.
+const int kMaxRestartBackoffShift = 6;
+// A plugin that crashes after running for this long is considered to have run
+// stably, and is restarted without delay.
+const int kStableRunTimeMs = 10 * 60 * 1000;
+
+int64 FileTimeToMilliseconds(const FILETIME& time) {
+  ULARGE_INTEGER value;
+  value.LowPart = time.dwLowDateTime;
+  value.HighPart = time.dwHighDateTime;
+  // FILETIME is in 100-nanosecond intervals.
+  return value.QuadPart / 10000;
+}
+}  // namespace
+
+struct PluginHostPool::HostProcess {
+  explicit HostProcess(PluginHostPool* owner)
+      : pool(owner),
+        process(NULL),
+        command_pipe(NULL),
+        wait_handle(NULL),
+        process_id(0) {
+  }
+
+  // Callback of RegisterWaitForSingleObject.
+  static VOID CALLBACK OnExited(PVOID context, BOOLEAN timed_out) {
+    HostProcess* process = static_cast<HostProcess*>(context);
+    process->pool->OnProcessSignaled(process);
+  }
+
+  PluginHostPool* pool;
+  HANDLE process;
+  // Write end of the standard input of the process.
+  HANDLE command_pipe;
+  // Registered wait of |process|, which is handled by the system thread pool,
+  // so the number of processes isn't limited by MAXIMUM_WAIT_OBJECTS.
+  HANDLE wait_handle;
+  DWORD process_id;
+  std::string plugin_path;
+  std::set<std::string> component_ids;
+  // The time when the plugin is assigned to the process.
+  base::TimeTicks assign_time;
+};
+
+PluginHostPool::PluginHostPool(const std::wstring& host_path,
+                               int standby_count)
+    : host_path_(host_path),
+      standby_count_(standby_count),
+      idle_unload_timeout_ms_(0),
+      max_restart_count_(kMaxRestartCount),
+      restart_delay_(base::TimeDelta::FromMilliseconds(kRestartDelayMs)),
+      monitor_thread_(base::kNullThreadHandle),
+      wake_event_(false, false),
+      quit_(false) {
+  DCHECK_GE(standby_count, 0);
+}
+
+PluginHostPool::~PluginHostPool() {
+  if (monitor_thread_ != base::kNullThreadHandle) {
+    {
+      base::AutoLock auto_lock(lock_);
+      quit_ = true;
+    }
+    wake_event_.Signal();
+    base::PlatformThread::Join(monitor_thread_);
+  }
+  for (size_t i = 0; i < standby_processes_.size(); ++i)
+    QuitProcess(standby_processes_[i]);
+  for (PluginToProcessMap::iterator it = plugin_processes_.begin();
+       it != plugin_processes_.end();
+       ++it) {
+    QuitProcess(it->second);
+  }
+}
+
+void PluginHostPool::SetRestartPolicy(int max_restart_count,
+                                      int restart_delay_ms) {
+  DCHECK_EQ(monitor_thread_, base::kNullThreadHandle);
+  DCHECK_GE(max_restart_count, 0);
+  max_restart_count_ = max_restart_count;
+  restart_delay_ = base::TimeDelta::FromMilliseconds(restart_delay_ms);
+}
+
+void PluginHostPool::SetIdleUnloadTimeout(int timeout_ms) {
+  base::AutoLock auto_lock(lock_);
+  idle_unload_timeout_ms_ = timeout_ms;
+}
+
+bool PluginHostPool::Init() {
+  {
+    base::AutoLock auto_lock(lock_);
+    RefillStandbyProcessesUnlocked();
+    if (standby_processes_.size() < standby_count_)
+      return false;
+  }
+  return base::PlatformThread::Create(0, this, &monitor_thread_);
+}
+
+bool PluginHostPool::StartComponent(const std::string& plugin_path,
+                                    const ipc::proto::ComponentInfo& info) {
+  const std::string& id = info.string_id();
+  google::protobuf::TextFormat::Printer printer;
+  printer.SetSingleLineMode(true);
+  std::string info_text;
+  if (!printer.PrintToString(info, &info_text))
+    return false;
+  base::AutoLock auto_lock(lock_);
+  if (failed_plugins_.count(plugin_path))
+    return false;
+  component_infos_[id] = info_text;
+  PendingRestartMap::iterator restart = pending_restarts_.find(plugin_path);
+  if (restart != pending_restarts_.end()) {
+    // Started together with the other components when the plugin restarts.
+    restart->second.component_ids.insert(id);
+    return true;
+  }
+  PluginToProcessMap::iterator it = plugin_processes_.find(plugin_path);
+  if (it != plugin_processes_.end()) {
+    if (it->second->component_ids.count(id))
+      return true;
+    if (!StartComponentInProcessUnlocked(it->second, id)) {
+      component_infos_.erase(id);
+      return false;
+    }
+    return true;
+  }
+  HostProcess* process = TakeStandbyProcessUnlocked();
+  std::set<std::string> component_ids;
+  component_ids.insert(id);
+  if (!process ||
+      !AssignProcessUnlocked(process, plugin_path, component_ids) ||
+      !process->component_ids.count(id)) {
+    component_infos_.erase(id);
+    if (process)
+      QuitProcess(process);
+    return false;
+  }
+  // Replaces the standby process taken by the plugin.
+  wake_event_.Signal();
+  return true;
+}
+
+void PluginHostPool::StopComponent(const std::string& plugin_path,
+                                   const std::string& id) {
+  HostProcess* process = NULL;
+  {
+    base::AutoLock auto_lock(lock_);
+    component_infos_.erase(id);
+    PendingRestartMap::iterator restart = pending_restarts_.find(plugin_path);
+    if (restart != pending_restarts_.end()) {
+      restart->second.component_ids.erase(id);
+      if (restart->second.component_ids.empty())
+        pending_restarts_.erase(restart);
+      return;
+    }
+    PluginToProcessMap::iterator it = plugin_processes_.find(plugin_path);
+    if (it == plugin_processes_.end() || !it->second->component_ids.count(id))
+      return;
+    it->second->component_ids.erase(id);
+    if (!it->second->component_ids.empty()) {
+      SendCommand(it->second, kPluginHostCommandStop, id);
+      return;
+    }
+    // The plugin can't be unloaded from the process safely, so the process is
+    // closed when the last component is stopped.
+    process = it->second;
+    plugin_processes_.erase(it);
+  }
+  wake_event_.Signal();
+  QuitProcess(process);
+}
+
+void PluginHostPool::ResetPlugin(const std::string& plugin_path) {
+  base::AutoLock auto_lock(lock_);
+  crash_counts_.erase(plugin_path);
+  failed_plugins_.erase(plugin_path);
+}
+
+void PluginHostPool::GetStats(PluginHostStatsMap* stats) {
+  base::AutoLock auto_lock(lock_);
+  stats->clear();
+  for (PluginToProcessMap::const_iterator it = plugin_processes_.begin();
+       it != plugin_processes_.end();
+       ++it) {
+    PluginHostStats& item = (*stats)[it->first];
+    item.process_id = it->second->process_id;
+    item.restart_count = restart_counts_[it->first];
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    if (::GetProcessTimes(it->second->process, &creation_time, &exit_time,
+                          &kernel_time, &user_time)) {
+      item.cpu_time_ms = FileTimeToMilliseconds(kernel_time) +
+                         FileTimeToMilliseconds(user_time);
+    }
+    PROCESS_MEMORY_COUNTERS_EX counters = {0};
+    counters.cb = sizeof(counters);
+    if (::GetProcessMemoryInfo(
+            it->second->process,
+            reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+            sizeof(counters))) {
+      item.memory_bytes = counters.PrivateUsage;
+    }
+  }
+  for (std::set<std::string>::const_iterator it = failed_plugins_.begin();
+       it != failed_plugins_.end();
+       ++it) {
+    PluginHostStats& item = (*stats)[*it];
+    item.restart_count = restart_counts_[*it];
+    item.failed = true;
+  }
+}
+
+void PluginHostPool::ThreadMain() {
+  base::PlatformThread::SetName("PluginHostPool");
+  while (true) {
+    base::TimeDelta wait_time =
+        base::TimeDelta::FromMilliseconds(kMonitorIntervalMs);
+    {
+      base::AutoLock auto_lock(lock_);
+      if (quit_)
+        return;
+      std::vector<HostProcess*> exited_processes;
+      {
+        base::AutoLock exited_lock(exited_lock_);
+        exited_processes.swap(exited_processes_);
+      }
+      for (size_t i = 0; i < exited_processes.size(); ++i)
+        OnProcessExitedUnlocked(exited_processes[i]);
+      RestartPluginsUnlocked(&wait_time);
+      RefillStandbyProcessesUnlocked();
+    }
+    wake_event_.TimedWait(wait_time);
+  }
+}
+
+PluginHostPool::HostProcess* PluginHostPool::LaunchProcessUnlocked() {
+  SECURITY_ATTRIBUTES attributes = { sizeof(attributes), NULL, TRUE };
+  HANDLE read_pipe = NULL;
+  HANDLE write_pipe = NULL;
+  if (!::CreatePipe(&read_pipe, &write_pipe, &attributes, 0)) {
+    DLOG(ERROR) << "Error creating pipe for plugin host:" << ::GetLastError();
+    return NULL;
+  }
+  // Only the read end is inherited by the plugin host process.
+  ::SetHandleInformation(write_pipe, HANDLE_FLAG_INHERIT, 0);
+  STARTUPINFO startup_info = {0};
+  startup_info.cb = sizeof(startup_info);
+  startup_info.dwFlags = STARTF_USESTDHANDLES;
+  startup_info.hStdInput = read_pipe;
+  startup_info.hStdOutput = INVALID_HANDLE_VALUE;
+  startup_info.hStdError = INVALID_HANDLE_VALUE;
+  PROCESS_INFORMATION process_info = {0};
+  std::wstring command_line = L"\"" + host_path_ + L"\"";
+  BOOL success = ::CreateProcess(host_path_.c_str(),
+                                 &command_line[0],
+                                 NULL,
+                                 NULL,
+                                 TRUE,
+                                 CREATE_NO_WINDOW,
+                                 NULL,
+                                 NULL,
+                                 &startup_info,
+                                 &process_info);
+  ::CloseHandle(read_pipe);
+  if (!success) {
+    DLOG(ERROR) << "Error launching plugin host:" << ::GetLastError();
+    ::CloseHandle(write_pipe);
+    return NULL;
+  }
+  ::CloseHandle(process_info.hThread);
+  HostProcess* process = new HostProcess(this);
+  process->process = process_info.hProcess;
+  process->process_id = process_info.dwProcessId;
+  process->command_pipe = write_pipe;
+  if (!::RegisterWaitForSingleObject(&process->wait_handle,
+                                     process->process,
+                                     &HostProcess::OnExited,
+                                     process,
+                                     INFINITE,
+                                     WT_EXECUTEONLYONCE)) {
+    DLOG(ERROR) << "Error monitoring plugin host:" << ::GetLastError();
+    process->wait_handle = NULL;
+    QuitProcess(process);
+    return NULL;
+  }
+  return process;
+}
+
+PluginHostPool::HostProcess* PluginHostPool::TakeStandbyProcessUnlocked() {
+  if (standby_processes_.empty())
+    return LaunchProcessUnlocked();
+  // Takes the oldest standby process, which is most likely to be ready.
+  HostProcess* process = standby_processes_.front();
+  standby_processes_.erase(standby_processes_.begin());
+  return process;
+}
+
+void PluginHostPool::RefillStandbyProcessesUnlocked() {
+  while (standby_processes_.size() < standby_count_) {
+    HostProcess* process = LaunchProcessUnlocked();
+    if (!process)
+      return;
+    standby_processes_.push_back(process);
+  }
+}
+
+bool PluginHostPool::AssignProcessUnlocked(
+    HostProcess* process,
+    const std::string& plugin_path,
+    const std::set<std::string>& component_ids) {
+  if (!SendCommand(process, kPluginHostCommandLoad, plugin_path))
+    return false;
+  process->plugin_path = plugin_path;
+  process->assign_time = base::TimeTicks::Now();
+  if (idle_unload_timeout_ms_ > 0) {
+    SendCommand(process, kPluginHostCommandIdleTimeout,
+                StringPrintf("%d", idle_unload_timeout_ms_));
+  }
+  for (std::set<std::string>::const_iterator it = component_ids.begin();
+       it != component_ids.end();
+       ++it) {
+    StartComponentInProcessUnlocked(process, *it);
+  }
+  plugin_processes_[plugin_path] = process;
+  return true;
+}
+
+bool PluginHostPool::StartComponentInProcessUnlocked(HostProcess* process,
+                                                     const std::string& id) {
+  std::map<std::string, std::string>::const_iterator info =
+      component_infos_.find(id);
+  if (info == component_infos_.end() ||
+      !SendCommand(process, kPluginHostCommandStart, info->second)) {
+    return false;
+  }
+  process->component_ids.insert(id);
+  return true;
+}
+
+void PluginHostPool::OnProcessSignaled(HostProcess* process) {
+  {
+    base::AutoLock auto_lock(exited_lock_);
+    exited_processes_.push_back(process);
+  }
+  wake_event_.Signal();
+}
+
+void PluginHostPool::OnProcessExitedUnlocked(HostProcess* process) {
+  // |process| may have been released by QuitProcess since it was signaled, so
+  // it is only used after it is found in the lists.
+  for (size_t i = 0; i < standby_processes_.size(); ++i) {
+    if (standby_processes_[i] == process) {
+      DLOG(ERROR) << "Standby plugin host exited unexpectedly";
+      standby_processes_.erase(standby_processes_.begin() + i);
+      QuitProcess(process);
+      return;
+    }
+  }
+  for (PluginToProcessMap::iterator it = plugin_processes_.begin();
+       it != plugin_processes_.end();
+       ++it) {
+    if (it->second != process)
+      continue;
+    std::string plugin_path = process->plugin_path;
+    std::set<std::string> component_ids;
+    component_ids.swap(process->component_ids);
+    bool stable = base::TimeTicks::Now() - process->assign_time >=
+                  base::TimeDelta::FromMilliseconds(kStableRunTimeMs);
+    plugin_processes_.erase(it);
+    QuitProcess(process);
+    // The components in the crashed process are deregistered by the hub when
+    // the channel is closed, the new process will register them again.
+    int& crash_count = crash_counts_[plugin_path];
+    if (stable)
+      crash_count = 0;
+    if (++crash_count > max_restart_count_) {
+      DLOG(ERROR) << "Plugin host exited unexpectedly " << crash_count
+                  << " times, giving up:" << plugin_path;
+      failed_plugins_.insert(plugin_path);
+      return;
+    }
+    DLOG(ERROR) << "Plugin host exited unexpectedly, restarting:"
+                << plugin_path;
+    // Doubles the delay with each crash, and restarts a plugin that has run
+    // stably right away.
+    PendingRestart& restart = pending_restarts_[plugin_path];
+    restart.component_ids.swap(component_ids);
+    restart.restart_time = base::TimeTicks::Now();
+    if (!stable) {
+      restart.restart_time += restart_delay_ *
+          (1 << std::min(crash_count - 1, kMaxRestartBackoffShift));
+    }
+    return;
+  }
+}
+
+void PluginHostPool::RestartPluginsUnlocked(base::TimeDelta* wait_time) {
+  base::TimeTicks now = base::TimeTicks::Now();
+  PendingRestartMap::iterator it = pending_restarts_.begin();
+  while (it != pending_restarts_.end()) {
+    if (now < it->second.restart_time) {
+      *wait_time = std::min(*wait_time, it->second.restart_time - now);
+      ++it;
+      continue;
+    }
+    const std::string& plugin_path = it->first;
+    ++restart_counts_[plugin_path];
+    HostProcess* process = TakeStandbyProcessUnlocked();
+    if (!process || !AssignProcessUnlocked(process, plugin_path,
+                                           it->second.component_ids)) {
+      DLOG(ERROR) << "Error restarting plugin:" << plugin_path;
+      if (process)
+        QuitProcess(process);
+      failed_plugins_.insert(plugin_path);
+    }
+    pending_restarts_.erase(it++);
+  }
+}
+
+void PluginHostPool::QuitProcess(HostProcess* process) {
+  SendCommand(process, kPluginHostCommandQuit, "");
+  // Closing the pipe also makes the process quit if it didn't receive the
+  // command.
+  ::CloseHandle(process->command_pipe);
+  if (process->wait_handle) {
+    // Waits for the running callback, if any, and drops the exit notification
+    // so that the monitor thread never sees a released process.
+    ::UnregisterWaitEx(process->wait_handle, INVALID_HANDLE_VALUE);
+    base::AutoLock auto_lock(exited_lock_);
+    exited_processes_.erase(std::remove(exited_processes_.begin(),
+                                        exited_processes_.end(),
+                                        process),
+                            exited_processes_.end());
+  }
+  ::CloseHandle(process->process);
+  delete process;
+}
+
+bool PluginHostPool::SendCommand(HostProcess* process,
+                                 const char* command,
+                                 const std::string& argument) {
+  std::string line = std::string(command) + " " + argument + "\n";
+  DWORD written = 0;
+  return ::WriteFile(process->command_pipe, line.data(), line.size(),
+                     &written, NULL) && written == line.size();
+}
+
+}  // namespace components
+}  // namespace ime_goopy
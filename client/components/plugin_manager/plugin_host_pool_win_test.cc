@@ -0,0 +1,205 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "components/plugin_manager/plugin_host_pool.h"
+
+#include <windows.h>
+#include <string.h>
+
+#include <string>
+#include "base/basictypes.h"
+#include "base/scoped_ptr.h"
+#include "base/stringprintf.h"
+#include <gtest/gunit.h>
+
+namespace ime_goopy {
+namespace components {
+namespace {
+
+// The test executable works as a fake plugin host process if this environment
+// variable is set, which is inherited by the processes launched by the pool.
+const wchar_t kFakeHostVariable[] = L"PLUGIN_HOST_POOL_TEST_HOST";
+const int kMaxRestartCount = 2;
+const int kRestartDelayMs = 10;
+const int kWaitTimeoutMs = 10000;
+const int kPollIntervalMs = 10;
+
+// Reads the commands from the standard input until the pool quits the process
+// or closes the pipe.
+int RunFakeHost() {
+  HANDLE input = ::GetStdHandle(STD_INPUT_HANDLE);
+  std::string line;
+  char ch = 0;
+  DWORD read = 0;
+  while (::ReadFile(input, &ch, 1, &read, NULL) && read == 1) {
+    if (ch != '\n') {
+      line.push_back(ch);
+      continue;
+    }
+    if (line.compare(0, strlen(kPluginHostCommandQuit),
+                     kPluginHostCommandQuit) == 0) {
+      break;
+    }
+    line.clear();
+  }
+  return 0;
+}
+
+class PluginHostPoolTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    CreatePool(kRestartDelayMs);
+  }
+
+  virtual void TearDown() {
+    pool_.reset(NULL);
+  }
+
+  // Creates a pool with one standby process, whose host processes run the test
+  // executable as the fake plugin host.
+  void CreatePool(int restart_delay_ms) {
+    pool_.reset(NULL);
+    wchar_t path[MAX_PATH] = {0};
+    ::GetModuleFileName(NULL, path, MAX_PATH);
+    pool_.reset(new PluginHostPool(path, 1));
+    pool_->SetRestartPolicy(kMaxRestartCount, restart_delay_ms);
+    ASSERT_TRUE(pool_->Init());
+  }
+
+  // Starts the only component of the plugin in |plugin_path|, which has the
+  // path as its string id.
+  bool StartComponent(const std::string& plugin_path) {
+    ipc::proto::ComponentInfo info;
+    info.set_string_id(plugin_path);
+    return pool_->StartComponent(plugin_path, info);
+  }
+
+  PluginHostPool::PluginHostStats GetStats(const std::string& plugin_path) {
+    PluginHostPool::PluginHostStatsMap stats;
+    pool_->GetStats(&stats);
+    return stats[plugin_path];
+  }
+
+  // Terminates the host process of |plugin_path| as if it crashed, and returns
+  // the id of the process.
+  uint32 KillHost(const std::string& plugin_path) {
+    uint32 process_id = GetStats(plugin_path).process_id;
+    EXPECT_NE(0U, process_id);
+    HANDLE process = ::OpenProcess(PROCESS_TERMINATE | SYNCHRONIZE,
+                                   FALSE,
+                                   process_id);
+    EXPECT_TRUE(process != NULL);
+    if (!process)
+      return process_id;
+    EXPECT_TRUE(::TerminateProcess(process, 1));
+    EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(process, kWaitTimeoutMs));
+    ::CloseHandle(process);
+    return process_id;
+  }
+
+  // Waits until the plugin in |plugin_path| is hosted by a process other than
+  // |process_id| or marked as failed. Returns false on timeout.
+  bool WaitForRestart(const std::string& plugin_path, uint32 process_id) {
+    for (int i = 0; i < kWaitTimeoutMs / kPollIntervalMs; ++i) {
+      PluginHostPool::PluginHostStats stats = GetStats(plugin_path);
+      if (stats.failed ||
+          (stats.process_id && stats.process_id != process_id)) {
+        return true;
+      }
+      ::Sleep(kPollIntervalMs);
+    }
+    return false;
+  }
+
+  scoped_ptr<PluginHostPool> pool_;
+};
+
+TEST_F(PluginHostPoolTest, RestartCrashedPlugin) {
+  const std::string plugin_path = "plugin.dll";
+  ASSERT_TRUE(StartComponent(plugin_path));
+  uint32 process_id = KillHost(plugin_path);
+  ASSERT_TRUE(WaitForRestart(plugin_path, process_id));
+  PluginHostPool::PluginHostStats stats = GetStats(plugin_path);
+  EXPECT_FALSE(stats.failed);
+  EXPECT_EQ(1, stats.restart_count);
+  EXPECT_NE(process_id, stats.process_id);
+}
+
+TEST_F(PluginHostPoolTest, FailPluginAfterRestartCap) {
+  const std::string plugin_path = "plugin.dll";
+  ASSERT_TRUE(StartComponent(plugin_path));
+  for (int i = 0; i <= kMaxRestartCount; ++i) {
+    EXPECT_FALSE(GetStats(plugin_path).failed);
+    uint32 process_id = KillHost(plugin_path);
+    ASSERT_TRUE(WaitForRestart(plugin_path, process_id));
+  }
+  PluginHostPool::PluginHostStats stats = GetStats(plugin_path);
+  EXPECT_TRUE(stats.failed);
+  EXPECT_EQ(kMaxRestartCount, stats.restart_count);
+  EXPECT_EQ(0U, stats.process_id);
+  EXPECT_FALSE(StartComponent(plugin_path));
+  // The plugin can be started again after it is reset.
+  pool_->ResetPlugin(plugin_path);
+  EXPECT_TRUE(StartComponent(plugin_path));
+  EXPECT_NE(0U, GetStats(plugin_path).process_id);
+}
+
+TEST_F(PluginHostPoolTest, StopComponentWaitingForRestart) {
+  const std::string plugin_path = "plugin.dll";
+  // Keeps the plugin waiting for the restart during the test.
+  CreatePool(kWaitTimeoutMs * 10);
+  ASSERT_TRUE(StartComponent(plugin_path));
+  KillHost(plugin_path);
+  // Waits for the monitor thread to handle the exit.
+  for (int i = 0; i < kWaitTimeoutMs / kPollIntervalMs; ++i) {
+    PluginHostPool::PluginHostStatsMap stats;
+    pool_->GetStats(&stats);
+    if (stats.empty())
+      break;
+    ::Sleep(kPollIntervalMs);
+  }
+  pool_->StopComponent(plugin_path, plugin_path);
+  // The component is started again right away instead of waiting for the
+  // restart of the crashed plugin.
+  ASSERT_TRUE(StartComponent(plugin_path));
+  EXPECT_NE(0U, GetStats(plugin_path).process_id);
+}
+
+TEST_F(PluginHostPoolTest, MonitorMoreProcessesThanWaitObjects) {
+  const int kPluginCount = MAXIMUM_WAIT_OBJECTS + 2;
+  for (int i = 0; i < kPluginCount; ++i) {
+    ASSERT_TRUE(StartComponent(StringPrintf("plugin%d.dll", i)));
+  }
+  const std::string plugin_path = StringPrintf("plugin%d.dll",
+                                               kPluginCount - 1);
+  uint32 process_id = KillHost(plugin_path);
+  ASSERT_TRUE(WaitForRestart(plugin_path, process_id));
+  EXPECT_EQ(1, GetStats(plugin_path).restart_count);
+}
+
+}  // namespace
+}  // namespace components
+}  // namespace ime_goopy
+
+int main(int argc, char **argv) {
+  if (::GetEnvironmentVariable(
+          ime_goopy::components::kFakeHostVariable, NULL, 0)) {
+    return ime_goopy::components::RunFakeHost();
+  }
+  ::SetEnvironmentVariable(ime_goopy::components::kFakeHostVariable, L"1");
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
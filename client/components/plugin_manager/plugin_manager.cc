@@ -16,8 +16,12 @@
 
 #include "components/plugin_manager/plugin_manager.h"
 
+#include <algorithm>
+
 #include "base/logging.h"
 #include "base/stl_util.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/platform_thread.h"
 #include "components/common/file_utils.h"
 #include "components/plugin_manager/plugin_manager_utils.h"
 #include "components/plugin_wrapper/plugin_component_stub.h"
@@ -26,19 +30,137 @@
 
 namespace ime_goopy {
 namespace components {
+namespace {
+// Maximum number of threads used to scan plugin files.
+const size_t kMaxScanThreads = 4;
+}  // namespace
+
+// The plugin files scanned by the workers of a ScanPluginFiles call.
+struct PluginManager::ScanJob {
+  ScanJob(int id, const std::vector<std::string>& files)
+      : id(id),
+        files(files),
+        next(0) {
+  }
+
+  // The sequence number of the ScanPluginFiles call.
+  int id;
+  const std::vector<std::string>& files;
+  // The index of the next file to scan, protected by |lock|.
+  size_t next;
+  base::Lock lock;
+};
+
+// A worker thread that scans plugin files taken from a shared job.
+class PluginManager::ScanWorker : public base::PlatformThread::Delegate {
+ public:
+  ScanWorker(PluginManager* manager, ScanJob* job)
+      : manager_(manager),
+        job_(job),
+        handle_(base::kNullThreadHandle) {
+  }
+
+  bool Start() {
+    return base::PlatformThread::Create(0, this, &handle_);
+  }
+
+  void Join() {
+    if (handle_ == base::kNullThreadHandle)
+      return;
+    base::PlatformThread::Join(handle_);
+    handle_ = base::kNullThreadHandle;
+  }
+
+  // Scans the plugin files until all of them are taken, and registers each
+  // plugin as soon as it is scanned.
+  void Run() {
+    while (true) {
+      ScanRecord record;
+      record.scan_id = job_->id;
+      {
+        base::AutoLock auto_lock(job_->lock);
+        if (job_->next >= job_->files.size())
+          return;
+        record.index = job_->next++;
+      }
+      base::TimeTicks begin = base::TimeTicks::Now();
+      ipc::proto::PluginInfo* plugin =
+          manager_->ScanPluginFile(job_->files[record.index]);
+      record.init_time = base::TimeTicks::Now() - begin;
+      if (plugin)
+        manager_->RegisterScannedPlugin(plugin, record);
+    }
+  }
+
+  // Overridden from base::PlatformThread::Delegate.
+  virtual void ThreadMain() OVERRIDE {
+    base::PlatformThread::SetName("PluginScan");
+    Run();
+  }
+
+ private:
+  PluginManager* manager_;
+  ScanJob* job_;
+  base::PlatformThreadHandle handle_;
+  DISALLOW_COPY_AND_ASSIGN(ScanWorker);
+};
+
+// A thread that periodically asks the manager to unload idle components.
+class PluginManager::IdleUnloadThread : public base::PlatformThread::Delegate {
+ public:
+  IdleUnloadThread(PluginManager* manager, const base::TimeDelta& interval)
+      : manager_(manager),
+        interval_(interval),
+        quit_event_(true, false),
+        handle_(base::kNullThreadHandle) {
+  }
+
+  virtual ~IdleUnloadThread() {
+    Stop();
+  }
+
+  bool Start() {
+    return base::PlatformThread::Create(0, this, &handle_);
+  }
+
+  void Stop() {
+    if (handle_ == base::kNullThreadHandle)
+      return;
+    quit_event_.Signal();
+    base::PlatformThread::Join(handle_);
+    handle_ = base::kNullThreadHandle;
+  }
+
+  // Overridden from base::PlatformThread::Delegate.
+  virtual void ThreadMain() OVERRIDE {
+    base::PlatformThread::SetName("PluginIdleUnload");
+    while (!quit_event_.TimedWait(interval_))
+      manager_->UnloadIdleComponents();
+  }
+
+ private:
+  PluginManager* manager_;
+  base::TimeDelta interval_;
+  base::WaitableEvent quit_event_;
+  base::PlatformThreadHandle handle_;
+  DISALLOW_COPY_AND_ASSIGN(IdleUnloadThread);
+};
 
 PluginManager::PluginManager(const std::string& path,
                              ipc::ComponentHost* host,
                              PluginManager::Delegate* delegate)
   : path_(path),
     host_(host),
-    delegate_(delegate) {
+    delegate_(delegate),
+    unloading_idle_count_(0),
+    scan_count_(0) {
   DCHECK(!path_.empty());
   DCHECK(host);
   DCHECK(delegate_);
 }
 
 PluginManager::~PluginManager() {
+  idle_unload_thread_.reset(NULL);
   for (int i = 0; i < monitors_.size(); ++i)
     monitors_[i]->Stop();
   STLDeleteElements(&monitors_);
@@ -47,11 +169,59 @@ PluginManager::~PluginManager() {
   StopAndClearAllPlugins();
 }
 
-bool PluginManager::Init() {
+void PluginManager::SetIdleUnloadTimeout(int timeout_ms) {
+  DCHECK(!idle_unload_thread_.get());
+  idle_unload_timeout_ = base::TimeDelta::FromMilliseconds(timeout_ms);
+}
+
+#ifdef OS_WINDOWS
+void PluginManager::SetPluginHostPool(PluginHostPool* pool) {
+  DCHECK(file_to_info_map_.empty());
+  host_pool_.reset(pool);
+}
+
+void PluginManager::GetPluginHostStats(
+    PluginHostPool::PluginHostStatsMap* stats) {
+  stats->clear();
+  if (host_pool_.get())
+    host_pool_->GetStats(stats);
+}
+#endif
+
+void PluginManager::GetPluginInitTimes(PluginInitTimeMap* times) {
+  times->clear();
   base::AutoLock auto_lock(lock_);
-  if (!ScanAllPluginFilesUnlocked())
+  for (ScanRecordMap::const_iterator it = scan_records_.begin();
+       it != scan_records_.end();
+       ++it) {
+    (*times)[it->first] = it->second.init_time;
+  }
+}
+
+bool PluginManager::Init() {
+#ifdef OS_WINDOWS
+  if (host_pool_.get())
+    host_pool_->SetIdleUnloadTimeout(
+        static_cast<int>(idle_unload_timeout_.InMilliseconds()));
+#endif
+  if (!ScanAllPluginFiles())
     return false;
-  AutoStartComponentsUnlocked();
+  {
+    base::AutoLock auto_lock(lock_);
+    AutoStartComponentsUnlocked();
+  }
+  RunPoolOperations();
+  if (idle_unload_timeout_ > base::TimeDelta() &&
+      !idle_unload_thread_.get()) {
+    // Checks twice per timeout so that a component is unloaded no later than
+    // 1.5 times of the timeout after its last message.
+    idle_unload_thread_.reset(
+        new IdleUnloadThread(this, idle_unload_timeout_ / 2));
+    if (!idle_unload_thread_->Start()) {
+      DLOG(ERROR) << "Error starting idle unload thread";
+      idle_unload_thread_.reset(NULL);
+    }
+  }
   return true;
 }
 
@@ -67,43 +237,37 @@ int PluginManager::GetComponents(ComponentInfos* info) {
 }
 
 bool PluginManager::StartComponent(const std::string& id) {
-  base::AutoLock auto_lock(lock_);
-  StringIDToInfoMap::const_iterator it = string_id_to_info_map_.find(id);
-  if (it == string_id_to_info_map_.end())
-    return false;
-  if (started_components_map_.find(id) == started_components_map_.end()) {
-    const std::string& path = it->second.first->path();
-    return StartComponentUnlocked(path, id);
+  bool started = true;
+  {
+    base::AutoLock auto_lock(lock_);
+    StringIDToInfoMap::const_iterator it = string_id_to_info_map_.find(id);
+    if (it == string_id_to_info_map_.end())
+      return false;
+    if (started_components_map_.find(id) == started_components_map_.end()) {
+      const std::string& path = it->second.first->path();
+      started = StartComponentUnlocked(path, id);
+    }
   }
-  return true;
+  RunPoolOperations();
+  return started;
 }
 
 bool PluginManager::StopComponent(const std::string& id) {
-  base::AutoLock auto_lock(lock_);
-  StopComponentUnlocked(id);
+  {
+    base::AutoLock auto_lock(lock_);
+    StopComponentUnlocked(id);
+  }
+  RunPoolOperations();
   return true;
 }
 
 bool PluginManager::UnloadPlugin(const std::string& path) {
   {
     base::AutoLock auto_lock(lock_);
-    PluginInfoMap::iterator it = file_to_info_map_.find(path);
-    if (it == file_to_info_map_.end())
+    if (!UnloadPluginUnlocked(path))
       return false;
-    for (int i = 0; i < it->second->component_infos_size(); ++i) {
-      const std::string& id = it->second->component_infos(i).string_id();
-      StringIDToInfoMap::const_iterator component =
-          string_id_to_info_map_.find(id);
-      DCHECK(component != string_id_to_info_map_.end());
-      DCHECK_EQ(component->second.first->path(), path);
-      if (component != string_id_to_info_map_.end() &&
-          component->second.first->path() == path) {
-        StopComponentUnlocked(id);
-        string_id_to_info_map_.erase(id);
-      }
-    }
-    file_to_info_map_.erase(it);
   }
+  RunPoolOperations();
   delegate_->PluginComponentChanged();
   // TODO(synch): we need to remember the unloaded plugin when we are able to
   // find which plugin is changed to prevent the change of other component from
@@ -120,75 +284,255 @@ void PluginManager::AddMonitor(PluginMonitorInterface* monitor) {
   }
 }
 
+void PluginManager::UnloadIdleComponents() {
+  // Unloading calls into the plugins, which may send messages back to the
+  // manager, so it is done without holding |lock_|. The components stopped in
+  // the meantime are deleted after all the candidates are checked.
+  std::vector<PluginComponentStub*> components;
+  {
+    base::AutoLock auto_lock(lock_);
+    for (StartedComponentsMap::const_iterator it =
+             started_components_map_.begin();
+         it != started_components_map_.end();
+         ++it) {
+      if (it->second)
+        components.push_back(it->second);
+    }
+    if (components.empty())
+      return;
+    ++unloading_idle_count_;
+  }
+  for (size_t i = 0; i < components.size(); ++i) {
+    if (components[i]->UnloadIfIdle(idle_unload_timeout_))
+      DLOG(INFO) << "Unloaded idle component:" << components[i]->id();
+  }
+  std::vector<PluginComponentStub*> stopped_components;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (--unloading_idle_count_ == 0)
+      stopped_components.swap(stopped_components_);
+  }
+  STLDeleteElements(&stopped_components);
+}
+
 void PluginManager::PluginChanged() {
+  ScanAllPluginFiles();
   {
     base::AutoLock auto_lock(lock_);
-    ScanAllPluginFilesUnlocked();
     AutoStartComponentsUnlocked();
   }
+  RunPoolOperations();
+  delegate_->PluginComponentChanged();
+}
+
+void PluginManager::PluginFilesChanged(
+    const std::vector<std::string>& paths) {
+  std::vector<std::string> changed_files;
+  {
+    base::AutoLock auto_lock(lock_);
+    for (size_t i = 0; i < paths.size(); ++i) {
+      const std::string& path = paths[i];
+      if (PluginManagerUtils::IsDirectory(path)) {
+        // A directory is changed, unloads all the plugins in it and rescans
+        // it.
+        UnloadPluginsInDirectoryUnlocked(path);
+        std::vector<std::string> files;
+        PluginManagerUtils::ListPluginFile(path, &files);
+        changed_files.insert(changed_files.end(), files.begin(), files.end());
+      } else if (PluginManagerUtils::IsPluginFile(path)) {
+        // Unloads the old version of a modified or removed plugin, the new
+        // version will be scanned below if the file still exists.
+        UnloadPluginUnlocked(path);
+        changed_files.push_back(path);
+      } else if (!PluginManagerUtils::PathExists(path)) {
+        // A removed or renamed directory, whose plugins are gone as well.
+        UnloadPluginsInDirectoryUnlocked(path);
+      }
+    }
+  }
+  ScanPluginFiles(&changed_files);
+  RunPoolOperations();
   delegate_->PluginComponentChanged();
 }
 
-bool PluginManager::ScanAllPluginFilesUnlocked() {
+void PluginManager::UnloadPluginsInDirectoryUnlocked(const std::string& path) {
+  std::string dir = path + "/";
+  std::vector<std::string> plugins;
+  for (PluginInfoMap::const_iterator it = file_to_info_map_.begin();
+       it != file_to_info_map_.end();
+       ++it) {
+    if (it->first.compare(0, dir.size(), dir) == 0)
+      plugins.push_back(it->first);
+  }
+  for (size_t i = 0; i < plugins.size(); ++i)
+    UnloadPluginUnlocked(plugins[i]);
+}
+
+bool PluginManager::ScanAllPluginFiles() {
   std::vector<std::string> plugin_files;
   if (!PluginManagerUtils::ListPluginFile(path_, &plugin_files)) {
     DLOG(ERROR) << "Error listing plugin files in:" << path_;
     return false;
   }
-  for (size_t i = 0; i < plugin_files.size(); ++i) {
-    if (file_to_info_map_.find(plugin_files[i]) != file_to_info_map_.end()) {
+  std::vector<std::string> new_files;
+  {
+    base::AutoLock auto_lock(lock_);
+    for (size_t i = 0; i < plugin_files.size(); ++i) {
       // If the plugin file is already in the map, then the plugin is not
       // updated because it is locked.
-      continue;
+      if (file_to_info_map_.find(plugin_files[i]) == file_to_info_map_.end())
+        new_files.push_back(plugin_files[i]);
     }
-    PluginInstance instance(plugin_files[i]);
-    if (!instance.IsInitialized())
-      continue;
-    ipc::proto::MessagePayload payload;
-    instance.ListComponents(&payload);
-    if (payload.component_info_size()) {
-      ipc::proto::PluginInfo* info = new ipc::proto::PluginInfo;
-      info->set_path(plugin_files[i]);
-      info->mutable_component_infos()->Swap(payload.mutable_component_info());
-      file_to_info_map_[plugin_files[i]] = info;
-      for (int j = 0; j < info->component_infos_size(); ++j) {
-        const std::string& id = info->component_infos(j).string_id();
-        if (string_id_to_info_map_.find(id) != string_id_to_info_map_.end()) {
-          NOTREACHED() << "Duplicated component string id:" << id
-                       << " in file:" << plugin_files[i]
-                       << " and:" << string_id_to_info_map_[id].first->path();
-        } else {
-          string_id_to_info_map_[id].first = info;
-          string_id_to_info_map_[id].second = j;
-        }
-      }
+  }
+  ScanPluginFiles(&new_files);
+  return true;
+}
+
+void PluginManager::ScanPluginFiles(std::vector<std::string>* files) {
+  if (files->empty())
+    return;
+  int scan_id = 0;
+  {
+    base::AutoLock auto_lock(lock_);
+    scan_id = ++scan_count_;
+  }
+  ScanJob job(scan_id, *files);
+  size_t thread_count = std::min(files->size(), kMaxScanThreads);
+  std::vector<ScanWorker*> workers;
+  for (size_t i = 0; i < thread_count; ++i) {
+    scoped_ptr<ScanWorker> worker(new ScanWorker(this, &job));
+    if (!worker->Start()) {
+      DLOG(ERROR) << "Error starting plugin scan thread";
+      break;
     }
+    workers.push_back(worker.release());
+  }
+  if (workers.empty()) {
+    ScanWorker current_worker(this, &job);
+    current_worker.Run();
   }
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i]->Join();
+  STLDeleteElements(&workers);
+  files->clear();
+}
+
+bool PluginManager::ListPluginComponents(const std::string& path,
+                                         ipc::proto::MessagePayload* payload) {
+  PluginInstance instance(path);
+  if (!instance.IsInitialized())
+    return false;
+  instance.ListComponents(payload);
   return true;
 }
 
+ipc::proto::PluginInfo* PluginManager::ScanPluginFile(
+    const std::string& path) {
+  ipc::proto::MessagePayload payload;
+  if (!ListPluginComponents(path, &payload) || !payload.component_info_size())
+    return NULL;
+  ipc::proto::PluginInfo* info = new ipc::proto::PluginInfo;
+  info->set_path(path);
+  info->mutable_component_infos()->Swap(payload.mutable_component_info());
+  return info;
+}
+
+void PluginManager::RegisterScannedPlugin(ipc::proto::PluginInfo* plugin,
+                                          const ScanRecord& record) {
+  DLOG(INFO) << "Plugin:" << plugin->path() << " initialized in "
+             << record.init_time.InMilliseconds() << "ms";
+  {
+    base::AutoLock auto_lock(lock_);
+    RegisterPluginUnlocked(plugin, record);
+  }
+  RunPoolOperations();
+}
+
+void PluginManager::RegisterPluginUnlocked(ipc::proto::PluginInfo* plugin,
+                                           const ScanRecord& record) {
+  const std::string& path = plugin->path();
+  if (file_to_info_map_.find(path) != file_to_info_map_.end()) {
+    // Registered by another scan at the same time.
+    delete plugin;
+    return;
+  }
+  file_to_info_map_[path] = plugin;
+  scan_records_[path] = record;
+  for (int j = 0; j < plugin->component_infos_size(); ++j) {
+    const std::string& id = plugin->component_infos(j).string_id();
+    StringIDToInfoMap::const_iterator it = string_id_to_info_map_.find(id);
+    if (it != string_id_to_info_map_.end()) {
+      const std::string& owner = it->second.first->path();
+      DCHECK(scan_records_.find(owner) != scan_records_.end());
+      if (scan_records_[owner].IsBefore(record)) {
+        DLOG(ERROR) << "Duplicated component string id:" << id
+                    << " in file:" << path
+                    << " ignored, registered by:" << owner;
+        continue;
+      }
+      // The plugin listed later was scanned first, the id is moved to this
+      // plugin, so that it doesn't depend on the scanning speed.
+      DLOG(ERROR) << "Duplicated component string id:" << id
+                  << " in file:" << owner
+                  << " replaced, registered by:" << path;
+      StopComponentUnlocked(id);
+    }
+    string_id_to_info_map_[id].first = plugin;
+    string_id_to_info_map_[id].second = j;
+  }
+  AutoStartPluginComponentsUnlocked(*plugin);
+}
+
 void PluginManager::AutoStartComponentsUnlocked() {
+  for (PluginInfoMap::const_iterator it = file_to_info_map_.begin();
+       it != file_to_info_map_.end();
+       ++it) {
+    AutoStartPluginComponentsUnlocked(*it->second);
+  }
+}
+
+void PluginManager::AutoStartPluginComponentsUnlocked(
+    const ipc::proto::PluginInfo& plugin) {
   // TODO(synch): Now we don't have settings UI, so we start all available
   // components. Later we need to load autostart components from settingstore.
-  for (StringIDToInfoMap::const_iterator it = string_id_to_info_map_.begin();
-       it != string_id_to_info_map_.end();
-       ++it) {
-    const std::string& id = it->first;
-    if (started_components_map_.find(id) == started_components_map_.end()) {
-      const std::string& path = it->second.first->path();
-      if (!StartComponentUnlocked(path, id))
-        DLOG(ERROR) << "Error starting component:" << id;
+  for (int i = 0; i < plugin.component_infos_size(); ++i) {
+    const std::string& id = plugin.component_infos(i).string_id();
+    StringIDToInfoMap::const_iterator it = string_id_to_info_map_.find(id);
+    // Skips the duplicated ids registered for other plugins.
+    if (it == string_id_to_info_map_.end() || it->second.first != &plugin)
+      continue;
+    if (started_components_map_.find(id) == started_components_map_.end() &&
+        !StartComponentUnlocked(plugin.path(), id)) {
+      DLOG(ERROR) << "Error starting component:" << id;
     }
   }
 }
 
 bool PluginManager::StartComponentUnlocked(const std::string& path,
                                            const std::string& id) {
+  StringIDToInfoMap::const_iterator it = string_id_to_info_map_.find(id);
+  if (it == string_id_to_info_map_.end())
+    return false;
+  DCHECK(started_components_map_.find(id) == started_components_map_.end());
+  const ipc::proto::ComponentInfo& info =
+      it->second.first->component_infos(it->second.second);
+#ifdef OS_WINDOWS
+  if (host_pool_.get()) {
+    // The host process is assigned by RunPoolOperations after |lock_| is
+    // released, and it loads the plugin when the first message arrives.
+    PoolOperation operation;
+    operation.start = true;
+    operation.path = path;
+    operation.info.CopyFrom(info);
+    pool_operations_.push_back(operation);
+    started_components_map_[id] = NULL;
+    return true;
+  }
+#endif
   scoped_ptr<PluginComponentStub> component(
-      new PluginComponentStub(path, id.c_str()));
+      new PluginComponentStub(path, info));
   if (!component->IsInitialized())
     return false;
-  DCHECK(started_components_map_.find(id) == started_components_map_.end());
   host_->AddComponent(component.get());
   started_components_map_[id] = component.release();
   return true;
@@ -199,22 +543,102 @@ void PluginManager::StopComponentUnlocked(const std::string& id) {
   if (it != started_components_map_.end()) {
     PluginComponentStub* component = it->second;
     started_components_map_.erase(it);
-    host_->RemoveComponent(component);
-    delete component;
+    if (component) {
+      host_->RemoveComponent(component);
+      if (unloading_idle_count_)
+        stopped_components_.push_back(component);
+      else
+        delete component;
+      return;
+    }
+#ifdef OS_WINDOWS
+    StringIDToInfoMap::const_iterator info = string_id_to_info_map_.find(id);
+    if (host_pool_.get() && info != string_id_to_info_map_.end()) {
+      PoolOperation operation;
+      operation.start = false;
+      operation.path = info->second.first->path();
+      operation.info.set_string_id(id);
+      pool_operations_.push_back(operation);
+    }
+#endif
+  }
+}
+
+bool PluginManager::UnloadPluginUnlocked(const std::string& path) {
+  PluginInfoMap::iterator it = file_to_info_map_.find(path);
+  if (it == file_to_info_map_.end())
+    return false;
+  for (int i = 0; i < it->second->component_infos_size(); ++i) {
+    const std::string& id = it->second->component_infos(i).string_id();
+    StringIDToInfoMap::const_iterator component =
+        string_id_to_info_map_.find(id);
+    // A duplicated id is registered for the plugin scanned first.
+    if (component != string_id_to_info_map_.end() &&
+        component->second.first == it->second) {
+      StopComponentUnlocked(id);
+      string_id_to_info_map_.erase(id);
+    }
+  }
+#ifdef OS_WINDOWS
+  // Gives a plugin that kept crashing another chance after it is changed.
+  if (host_pool_.get()) {
+    PoolOperation operation;
+    operation.start = false;
+    operation.path = path;
+    pool_operations_.push_back(operation);
+  }
+#endif
+  scan_records_.erase(path);
+  delete it->second;
+  file_to_info_map_.erase(it);
+  return true;
+}
+
+void PluginManager::RunPoolOperations() {
+#ifdef OS_WINDOWS
+  if (!host_pool_.get())
+    return;
+  // Keeps the operations queued by different threads in order.
+  base::AutoLock pool_auto_lock(pool_lock_);
+  std::vector<PoolOperation> operations;
+  {
+    base::AutoLock auto_lock(lock_);
+    operations.swap(pool_operations_);
+  }
+  for (size_t i = 0; i < operations.size(); ++i) {
+    const PoolOperation& operation = operations[i];
+    const std::string& id = operation.info.string_id();
+    if (operation.start) {
+      if (!host_pool_->StartComponent(operation.path, operation.info))
+        DLOG(ERROR) << "Error starting component:" << id;
+    } else if (!id.empty()) {
+      host_pool_->StopComponent(operation.path, id);
+    } else {
+      host_pool_->ResetPlugin(operation.path);
+    }
   }
+#endif
 }
 
 void PluginManager::StopAndClearAllPlugins() {
   for (StartedComponentsMap::const_iterator i = started_components_map_.begin();
        i != started_components_map_.end();
        ++i) {
-    i->second->RemoveFromHost();
+    if (i->second)
+      i->second->RemoveFromHost();
   }
   STLDeleteContainerPairSecondPointers(file_to_info_map_.begin(),
                                        file_to_info_map_.end());
   STLDeleteContainerPairSecondPointers(started_components_map_.begin(),
                                        started_components_map_.end());
+  STLDeleteElements(&stopped_components_);
+#ifdef OS_WINDOWS
+  // Quits all the plugin host processes.
+  host_pool_.reset(NULL);
+#endif
   file_to_info_map_.clear();
+  scan_records_.clear();
+  started_components_map_.clear();
   string_id_to_info_map_.clear();
 }
 }  // namespace components
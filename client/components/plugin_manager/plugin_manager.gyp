@@ -8,10 +8,24 @@
         '<(DEPTH)/ipc/protos/protos.gyp:protos-cpp'
       ],
       'sources': [
+        'inotify_plugin_monitor.cc',
+        'plugin_host_pool_win.cc',
         'plugin_manager.cc',
         'plugin_manager_utils.cc',
         'plugin_manager_component.cc',
       ],
+      'conditions': [
+        ['OS!="linux"', {
+          'sources!': [
+            'inotify_plugin_monitor.cc',
+          ],
+        }],
+        ['OS!="win"', {
+          'sources/': [
+            ['exclude', '_win\\.cc$'],
+          ],
+        }],
+      ],
     },
     {
       'target_name': 'plugin_manager_unittests',
@@ -26,4 +40,52 @@
       ],
     },
   ],
+  'conditions': [
+    ['OS=="win"', {
+      'targets': [
+        {
+          'target_name': 'plugin_host',
+          'type': 'executable',
+          'dependencies': [
+            '<(DEPTH)/base/base.gyp:base',
+            '<(DEPTH)/components/plugin_wrapper/plugin_wrapper.gyp:plugin_component_stub',
+            '<(DEPTH)/ipc/ipc.gyp:ipc',
+            '<(DEPTH)/ipc/protos/protos.gyp:protos-cpp',
+          ],
+          'sources': [
+            'plugin_host_main_win.cc',
+          ],
+        },
+        {
+          'target_name': 'plugin_host_pool_unittests',
+          'type': 'executable',
+          'dependencies': [
+            'plugin_manager',
+            '<(DEPTH)/base/base.gyp:base',
+            '<(DEPTH)/ipc/protos/protos.gyp:protos-cpp',
+            '<(DEPTH)/third_party/gtest/gtest.gyp:gtest',
+          ],
+          'sources': [
+            'plugin_host_pool_win_test.cc',
+          ],
+        },
+      ],
+    }],
+    ['OS=="linux"', {
+      'targets': [
+        {
+          'target_name': 'inotify_plugin_monitor_unittests',
+          'type': 'executable',
+          'dependencies': [
+            'plugin_manager',
+            '<(DEPTH)/base/base.gyp:base',
+            '<(DEPTH)/third_party/gtest/gtest.gyp:gtest',
+          ],
+          'sources': [
+            'inotify_plugin_monitor_test.cc',
+          ],
+        },
+      ],
+    }],
+  ],
 }
@@ -22,10 +22,16 @@
 #include <vector>
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
+#include "base/scoped_ptr.h"
 #include "base/synchronization/lock.h"
+#include "base/time.h"
 #include "components/plugin_manager/plugin_monitor_interface.h"
 #include "ipc/protos/ipc.pb.h"
 
+#ifdef OS_WINDOWS
+#include "components/plugin_manager/plugin_host_pool.h"
+#endif
+
 namespace google {
 namespace protobuf {
 template <class T> class RepeatedPtrField;
@@ -47,6 +53,9 @@ typedef google::protobuf::RepeatedPtrField<ipc::proto::ComponentInfo>
 // A PluginManager that manages all the plugin components.
 // It is responsible for managing the information of all plugin components and
 // starting/stopping plugin components.
+// Started components are added to the host as lazy PluginComponentStub
+// objects created from the cached ComponentInfo, so the plugin file is only
+// loaded when a message actually targets the component.
 class PluginManager : public PluginMonitorInterface::Delegate {
  public:
   class Delegate {
@@ -68,6 +77,23 @@ class PluginManager : public PluginMonitorInterface::Delegate {
                 ipc::ComponentHost* host,
                 PluginManager::Delegate* delegate);
   virtual ~PluginManager();
+  // Sets the period after which an idle component gets its plugin unloaded.
+  // The component stays in the host and the plugin will be loaded again by the
+  // next message targeting it. Zero, the default, disables idle unloading.
+  // Must be called before Init.
+  void SetIdleUnloadTimeout(int timeout_ms);
+#ifdef OS_WINDOWS
+  // Runs the started components in the plugin host processes of |pool|
+  // instead of in the host of the manager. The manager will own |pool|.
+  // Must be called before Init.
+  void SetPluginHostPool(PluginHostPool* pool);
+  // Gets the resource usage of the plugins running in the host pool.
+  void GetPluginHostStats(PluginHostPool::PluginHostStatsMap* stats);
+#endif
+  typedef std::map<std::string /*path*/, base::TimeDelta> PluginInitTimeMap;
+  // Gets the time each loaded plugin took to initialize when it was scanned,
+  // i.e. to load the plugin file and list its components.
+  void GetPluginInitTimes(PluginInitTimeMap* times);
   // Initialize the PluginManager. Returns false if initialization failed.
   bool Init();
   // Gets the ComponentInfo objects of all the components in all plugins.
@@ -84,15 +110,81 @@ class PluginManager : public PluginMonitorInterface::Delegate {
   // any of the plugins are changed.
   // The manager will own the |monitor| object.
   void AddMonitor(PluginMonitorInterface* monitor);
+  // Unloads the plugins of all components that have been idle for longer than
+  // the idle unload timeout.
+  void UnloadIdleComponents();
   // Overriden from PluginMonitorInterface::Delegate.
   virtual void PluginChanged() OVERRIDE;
+  virtual void PluginFilesChanged(
+      const std::vector<std::string>& paths) OVERRIDE;
+
+ protected:
+  // Loads the plugin file in |path| and lists its components in |payload|.
+  // Called on the scan worker threads. Virtual for testing.
+  virtual bool ListPluginComponents(const std::string& path,
+                                    ipc::proto::MessagePayload* payload);
 
  private:
-  bool ScanAllPluginFilesUnlocked();
+  class IdleUnloadThread;
+  class ScanWorker;
+  struct ScanJob;
+  // How a registered plugin was scanned.
+  struct ScanRecord {
+    ScanRecord() : scan_id(0), index(0) { }
+    // Returns true if this plugin was listed to be scanned before |other|,
+    // by an earlier ScanPluginFiles call or earlier in the same list.
+    bool IsBefore(const ScanRecord& other) const {
+      return scan_id < other.scan_id ||
+             (scan_id == other.scan_id && index < other.index);
+    }
+    // The sequence number of the ScanPluginFiles call and the index of the
+    // plugin in its list of files.
+    int scan_id;
+    size_t index;
+    // The time spent loading the plugin file and listing its components.
+    base::TimeDelta init_time;
+  };
+  // Lists the plugin files under |path_| and scans the new ones on a bounded
+  // number of worker threads. The components of each plugin are registered
+  // and started as soon as the plugin is scanned. |lock_| must not be held by
+  // the caller.
+  bool ScanAllPluginFiles();
+  // Scans the plugin |files| on a bounded number of worker threads, which
+  // register each plugin as soon as it is scanned. Returns after all the
+  // plugins are registered. |files| will be emptied.
+  void ScanPluginFiles(std::vector<std::string>* files);
+  // Loads the plugin file in |path| and returns its information, or NULL if
+  // it isn't a valid plugin. Only gathers the information without touching
+  // the maps, so it can run on the worker threads.
+  ipc::proto::PluginInfo* ScanPluginFile(const std::string& path);
+  // Registers the scanned |plugin| and runs the pool operations it queued.
+  // Called on the scan worker threads, |lock_| must not be held by the caller.
+  void RegisterScannedPlugin(ipc::proto::PluginInfo* plugin,
+                             const ScanRecord& record);
+  // Records the components of the scanned |plugin| and starts them
+  // automatically. A duplicated component id belongs to the plugin listed to
+  // be scanned first according to |record|, no matter which plugin finishes
+  // scanning first. The manager will own |plugin|.
+  void RegisterPluginUnlocked(ipc::proto::PluginInfo* plugin,
+                              const ScanRecord& record);
   void AutoStartComponentsUnlocked();
+  // Starts the components registered for |plugin| that should be started
+  // automatically.
+  void AutoStartPluginComponentsUnlocked(const ipc::proto::PluginInfo& plugin);
+  // Starts the component |id| of the plugin in |path|. With a plugin host
+  // pool, the component is only queued to be started by RunPoolOperations.
   bool StartComponentUnlocked(const std::string& path, const std::string& id);
   void StopComponentUnlocked(const std::string& id);
+  // Stops the components of the plugin in |path| and removes the plugin.
+  // Returns false if the plugin is not loaded.
+  bool UnloadPluginUnlocked(const std::string& path);
+  // Unloads all the plugins under the directory |path|.
+  void UnloadPluginsInDirectoryUnlocked(const std::string& path);
   void StopAndClearAllPlugins();
+  // Runs the operations queued for the plugin host pool. Must be called
+  // without holding |lock_|, because the pool launches processes and writes to
+  // their pipes.
+  void RunPoolOperations();
 
   typedef std::map<std::string /*path*/, ipc::proto::PluginInfo* /*info*/>
           PluginInfoMap;
@@ -101,14 +193,44 @@ class PluginManager : public PluginMonitorInterface::Delegate {
           StringIDToInfoMap;
   typedef std::map<std::string /*id*/, PluginComponentStub* /*component*/>
           StartedComponentsMap;
+  typedef std::map<std::string /*path*/, ScanRecord> ScanRecordMap;
   PluginInfoMap file_to_info_map_;
+  // The scan records of the plugins in |file_to_info_map_|.
+  ScanRecordMap scan_records_;
   StringIDToInfoMap string_id_to_info_map_;
+  // Components hosted in the plugin host pool have NULL stubs. Their plugins
+  // are loaded and unloaded by the host processes.
   StartedComponentsMap started_components_map_;
   std::vector<PluginMonitorInterface*> monitors_;
   std::string path_;
   ipc::ComponentHost* host_;
   base::Lock lock_;
   PluginManager::Delegate* delegate_;
+  base::TimeDelta idle_unload_timeout_;
+  scoped_ptr<IdleUnloadThread> idle_unload_thread_;
+  // Number of UnloadIdleComponents calls that are checking the components
+  // without holding |lock_|.
+  int unloading_idle_count_;
+  // Components stopped during UnloadIdleComponents, which are deleted when no
+  // call is checking them any more.
+  std::vector<PluginComponentStub*> stopped_components_;
+  // Number of ScanPluginFiles calls, which numbers the scans.
+  int scan_count_;
+#ifdef OS_WINDOWS
+  // An operation on |host_pool_|: starting the component in |info|, stopping
+  // the component |info.string_id()|, or resetting the plugin in |path| if the
+  // id is empty.
+  struct PoolOperation {
+    bool start;
+    std::string path;
+    ipc::proto::ComponentInfo info;
+  };
+  scoped_ptr<PluginHostPool> host_pool_;
+  // Operations queued under |lock_| and run by RunPoolOperations.
+  std::vector<PoolOperation> pool_operations_;
+  // Held while running the operations.
+  base::Lock pool_lock_;
+#endif
   DISALLOW_COPY_AND_ASSIGN(PluginManager);
 };
 
@@ -26,11 +26,13 @@
 #ifdef OS_WINDOWS
 #include "common/app_utils.h"
 #include "common/registry.h"
+#include "components/plugin_manager/plugin_host_pool.h"
 #include "components/plugin_manager/registry_monitor_wrapper.h"
 #else
 #include "common/windows_types.h"
 #include "common/app_utils_posix.h"
 #include "base/logging.h"
+#include "components/plugin_manager/inotify_plugin_monitor.h"
 #endif
 
 namespace ime_goopy {
@@ -49,8 +51,24 @@ const int kConsumeMessages[] = {
 };
 
 static const char kStringID[] = "com.google.input_tools.plugin_manager";
+#ifdef OS_WINDOWS
+// DWORD value under the system registry key that overrides the idle unload
+// timeout in milliseconds.
+static const wchar_t kIdleUnloadTimeoutValue[] = L"PluginIdleUnloadTimeout";
+// File name of the plugin host executable, which is installed in the binary
+// directory. Plugins run in-process if it doesn't exist.
+static const wchar_t kPluginHostFileName[] = L"plugin_host.exe";
+// Number of plugin host processes kept ready for starting or restarting a
+// plugin.
+static const int kPluginHostStandbyCount = 1;
+#endif
+#if defined(OS_LINUX)
+// Changes of plugin files within this period are reported together.
+static const int kPluginChangeDebounceMs = 500;
+#endif
 
-PluginManagerComponent::PluginManagerComponent() {
+PluginManagerComponent::PluginManagerComponent()
+    : idle_unload_timeout_ms_(0) {
 }
 
 PluginManagerComponent::~PluginManagerComponent() {
@@ -69,13 +87,36 @@ void PluginManagerComponent::OnRegistered() {
       FileUtils::GetSystemPluginPath(), host(), this));
 #ifdef OS_WINDOWS
   scoped_ptr<RegistryKey> parent(AppUtils::OpenSystemRegistry(true));
+  DWORD idle_unload_timeout_ms = 0;
+  if (parent->QueryDWORDValue(kIdleUnloadTimeoutValue,
+                              idle_unload_timeout_ms) == ERROR_SUCCESS) {
+    idle_unload_timeout_ms_ = idle_unload_timeout_ms;
+  }
   RegistryMonitorWrapper* monitor_ = new RegistryMonitorWrapper(
       parent->Detach(), kPluginRegistryKey, manager_.get());
   manager_->AddMonitor(monitor_);
+  std::wstring host_path = AppUtils::GetBinaryFilePath(kPluginHostFileName);
+  if (::GetFileAttributes(host_path.c_str()) != INVALID_FILE_ATTRIBUTES) {
+    scoped_ptr<PluginHostPool> pool(
+        new PluginHostPool(host_path, kPluginHostStandbyCount));
+    if (pool->Init())
+      manager_->SetPluginHostPool(pool.release());
+  }
+#elif defined(OS_LINUX)
+  manager_->AddMonitor(new InotifyPluginMonitor(
+      FileUtils::GetSystemPluginPath(),
+      kPluginChangeDebounceMs,
+      manager_.get()));
 #endif
+  manager_->SetIdleUnloadTimeout(idle_unload_timeout_ms_);
   manager_->Init();
 }
 
+void PluginManagerComponent::SetIdleUnloadTimeout(int timeout_ms) {
+  DCHECK(!manager_.get());
+  idle_unload_timeout_ms_ = timeout_ms;
+}
+
 void PluginManagerComponent::OnDeregistered() {
   manager_.reset(NULL);
 }
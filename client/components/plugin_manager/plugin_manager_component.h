@@ -37,6 +37,11 @@ class PluginManagerComponent
   virtual void OnDeregistered() OVERRIDE;
   // Overridden from PluginManager::Delegate.
   virtual void PluginComponentChanged();
+  // Sets the period after which the plugin of an idle component is unloaded to
+  // save memory. Zero, the default, keeps the plugins loaded. On Windows, the
+  // PluginIdleUnloadTimeout value in the system registry overrides it.
+  // Must be called before the component is registered.
+  void SetIdleUnloadTimeout(int timeout_ms);
 
  private:
   void OnMsgPluginQueryComponents(ipc::proto::Message* message);
@@ -45,6 +50,7 @@ class PluginManagerComponent
   void OnMsgPluginUnload(ipc::proto::Message* message);
   void OnMsgPluginInstalled(ipc::proto::Message* message);
   scoped_ptr<PluginManager> manager_;
+  int idle_unload_timeout_ms_;
 };
 
 }  // namespace components
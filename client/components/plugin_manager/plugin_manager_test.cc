@@ -16,14 +16,26 @@
 
 #include "components/plugin_manager/plugin_manager.h"
 
+#ifndef OS_WINDOWS
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <algorithm>
+#include <map>
 #include <set>
 #include <vector>
 #include "base/basictypes.h"
 #include "base/compiler_specific.h"
 #include "base/scoped_handle.h"
 #include "base/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
 #include "common/string_utils.h"
+#include "components/plugin_manager/plugin_manager_utils.h"
 #include "ipc/component.h"
 #include "ipc/component_host.h"
 #include <gtest/gunit.h>
@@ -53,9 +65,21 @@ class MockedMultiComponentHost : public ipc::ComponentHost {
     }
     return component_ids->size();
   }
+  // Gets the ids of the components in the order they are added.
+  const std::vector<std::string>& added_ids() {
+    return added_ids_;
+  }
+  // Gets the threads that added components.
+  const std::set<base::PlatformThreadId>& adding_threads() {
+    return adding_threads_;
+  }
   virtual bool AddComponent(ipc::Component* component) OVERRIDE {
     EXPECT_EQ(components_.end(), components_.find(component));
     components_.insert(component);
+    ipc::proto::ComponentInfo info;
+    component->GetInfo(&info);
+    added_ids_.push_back(info.string_id());
+    adding_threads_.insert(base::PlatformThread::CurrentId());
     return true;
   }
   virtual bool RemoveComponent(ipc::Component* component) OVERRIDE {
@@ -79,6 +103,73 @@ class MockedMultiComponentHost : public ipc::ComponentHost {
 
  private:
   std::set<ipc::Component*> components_;
+  std::vector<std::string> added_ids_;
+  std::set<base::PlatformThreadId> adding_threads_;
+};
+
+// A plugin manager that lists fake components instead of loading the plugin
+// files. The components of a plugin have the path of the plugin as their name.
+class FakePluginManager : public PluginManager {
+ public:
+  FakePluginManager(ipc::ComponentHost* host, PluginManager::Delegate* delegate)
+      : PluginManager("plugins", host, delegate),
+        scan_count_(0) {
+  }
+
+  // Adds a fake plugin in |path| with the components |ids|, which takes
+  // |delay_ms| to scan.
+  void AddPlugin(const std::string& path,
+                 const std::vector<std::string>& ids,
+                 int delay_ms) {
+    base::AutoLock auto_lock(lock_);
+    plugins_[path] = std::make_pair(ids, delay_ms);
+  }
+
+  // Removes the fake plugin in |path|, which can't be scanned any more.
+  void RemovePlugin(const std::string& path) {
+    base::AutoLock auto_lock(lock_);
+    plugins_.erase(path);
+  }
+
+  // Gets the threads that scanned the plugins.
+  std::set<base::PlatformThreadId> scanning_threads() {
+    base::AutoLock auto_lock(lock_);
+    return scanning_threads_;
+  }
+
+  // Gets the number of plugin files scanned, including the invalid ones.
+  int scan_count() {
+    base::AutoLock auto_lock(lock_);
+    return scan_count_;
+  }
+
+ protected:
+  virtual bool ListPluginComponents(
+      const std::string& path,
+      ipc::proto::MessagePayload* payload) OVERRIDE {
+    std::pair<std::vector<std::string>, int> plugin;
+    {
+      base::AutoLock auto_lock(lock_);
+      scanning_threads_.insert(base::PlatformThread::CurrentId());
+      ++scan_count_;
+      if (!plugins_.count(path))
+        return false;
+      plugin = plugins_[path];
+    }
+    base::PlatformThread::Sleep(plugin.second);
+    for (size_t i = 0; i < plugin.first.size(); ++i) {
+      ipc::proto::ComponentInfo* info = payload->add_component_info();
+      info->set_string_id(plugin.first[i]);
+      info->set_name(path);
+    }
+    return true;
+  }
+
+ private:
+  base::Lock lock_;
+  std::map<std::string, std::pair<std::vector<std::string>, int> > plugins_;
+  std::set<base::PlatformThreadId> scanning_threads_;
+  int scan_count_;
 };
 
 class PluginManagerTest
@@ -239,6 +330,294 @@ TEST_F(PluginManagerTest, PluginManagerTest) {
   // the manager exits.
 }
 
+class PluginScanTest
+  : public PluginManager::Delegate,
+    public ::testing::Test {
+ public:
+  void PluginComponentChanged() OVERRIDE {
+  }
+
+ protected:
+  void SetUp() {
+    manager_.reset(new FakePluginManager(&host_, this));
+  }
+
+  void TearDown() {
+    manager_.reset(NULL);
+  }
+
+  // Adds a fake plugin with one or two components, empty ids are omitted.
+  void AddPlugin(const std::string& path,
+                 const std::string& id1,
+                 const std::string& id2,
+                 int delay_ms) {
+    std::vector<std::string> ids;
+    if (!id1.empty())
+      ids.push_back(id1);
+    if (!id2.empty())
+      ids.push_back(id2);
+    manager_->AddPlugin(path, ids, delay_ms);
+  }
+
+  // Scans the plugins as if the files in |paths| are changed, empty paths are
+  // omitted.
+  void ScanPlugins(const std::string& path1,
+                   const std::string& path2,
+                   const std::string& path3) {
+    std::vector<std::string> paths;
+    paths.push_back(path1);
+    if (!path2.empty())
+      paths.push_back(path2);
+    if (!path3.empty())
+      paths.push_back(path3);
+    manager_->PluginFilesChanged(paths);
+  }
+
+  // Gets the plugin path of the registered component |id|, or an empty string
+  // if it isn't registered.
+  std::string GetComponentPlugin(const std::string& id) {
+    ipc::proto::MessagePayload payload;
+    manager_->GetComponents(payload.mutable_component_info());
+    for (int i = 0; i < payload.component_info_size(); ++i) {
+      if (payload.component_info(i).string_id() == id)
+        return payload.component_info(i).name();
+    }
+    return "";
+  }
+
+  scoped_ptr<FakePluginManager> manager_;
+  MockedMultiComponentHost host_;
+};
+
+#ifdef OS_WINDOWS
+#define PLUGIN_FILE(name) name ".dll"
+#else
+#define PLUGIN_FILE(name) name ".so"
+#endif
+
+TEST_F(PluginScanTest, RegisterPluginsAsSoonAsScanned) {
+  // The first plugin is scanned last.
+  AddPlugin(PLUGIN_FILE("a"), "a1", "a2", 200);
+  AddPlugin(PLUGIN_FILE("b"), "b1", "", 0);
+  AddPlugin(PLUGIN_FILE("c"), "c1", "", 0);
+  ScanPlugins(PLUGIN_FILE("a"), PLUGIN_FILE("b"), PLUGIN_FILE("c"));
+  ASSERT_EQ(4, host_.ComponentCount());
+  // The fast plugins don't wait for the slow one before them.
+  const std::vector<std::string>& ids = host_.added_ids();
+  EXPECT_EQ("a1", ids[2]);
+  EXPECT_EQ("a2", ids[3]);
+  // The components are started by the workers scanning the plugins.
+  EXPECT_EQ(0, host_.adding_threads().count(
+      base::PlatformThread::CurrentId()));
+  EXPECT_EQ(0, manager_->scanning_threads().count(
+      base::PlatformThread::CurrentId()));
+}
+
+TEST_F(PluginScanTest, ResolveDuplicatedIdsInScanOrder) {
+  // The duplicated id belongs to the first plugin even if it's scanned last.
+  AddPlugin(PLUGIN_FILE("a"), "dup", "a1", 200);
+  AddPlugin(PLUGIN_FILE("b"), "dup", "b1", 0);
+  ScanPlugins(PLUGIN_FILE("a"), PLUGIN_FILE("b"), "");
+  EXPECT_EQ(PLUGIN_FILE("a"), GetComponentPlugin("dup"));
+  EXPECT_EQ(PLUGIN_FILE("b"), GetComponentPlugin("b1"));
+  EXPECT_EQ(3, host_.ComponentCount());
+  // Unloading the plugin that lost the id keeps the registered component.
+  EXPECT_TRUE(manager_->UnloadPlugin(PLUGIN_FILE("b")));
+  EXPECT_EQ(PLUGIN_FILE("a"), GetComponentPlugin("dup"));
+  EXPECT_EQ(2, host_.ComponentCount());
+  // A plugin scanned later doesn't take the id even if it's listed first.
+  AddPlugin(PLUGIN_FILE("0"), "dup", "", 0);
+  ScanPlugins(PLUGIN_FILE("0"), PLUGIN_FILE("b"), "");
+  EXPECT_EQ(PLUGIN_FILE("a"), GetComponentPlugin("dup"));
+  EXPECT_TRUE(manager_->UnloadPlugin(PLUGIN_FILE("a")));
+  EXPECT_EQ("", GetComponentPlugin("dup"));
+  EXPECT_EQ(1, host_.ComponentCount());
+}
+
+TEST_F(PluginScanTest, GetPluginInitTimes) {
+  AddPlugin(PLUGIN_FILE("a"), "a1", "", 200);
+  AddPlugin(PLUGIN_FILE("b"), "b1", "", 0);
+  ScanPlugins(PLUGIN_FILE("a"), PLUGIN_FILE("b"), PLUGIN_FILE("c"));
+  PluginManager::PluginInitTimeMap times;
+  manager_->GetPluginInitTimes(&times);
+  // Invalid plugins aren't loaded.
+  ASSERT_EQ(2, times.size());
+  EXPECT_LE(200, times[PLUGIN_FILE("a")].InMilliseconds());
+  EXPECT_EQ(1, times.count(PLUGIN_FILE("b")));
+  EXPECT_TRUE(manager_->UnloadPlugin(PLUGIN_FILE("a")));
+  manager_->GetPluginInitTimes(&times);
+  EXPECT_EQ(1, times.size());
+  EXPECT_EQ(1, times.count(PLUGIN_FILE("b")));
+}
+
+TEST_F(PluginScanTest, AutoStartOnlyScannedPlugins) {
+  AddPlugin(PLUGIN_FILE("a"), "a1", "", 0);
+  AddPlugin(PLUGIN_FILE("b"), "b1", "", 0);
+  AddPlugin(PLUGIN_FILE("c"), "c1", "", 0);
+  ScanPlugins(PLUGIN_FILE("a"), PLUGIN_FILE("b"), "");
+  EXPECT_EQ(2, host_.ComponentCount());
+  EXPECT_TRUE(manager_->StopComponent("a1"));
+  EXPECT_EQ(1, host_.ComponentCount());
+  // Scanning other plugins doesn't start the stopped component again.
+  ScanPlugins(PLUGIN_FILE("b"), PLUGIN_FILE("c"), "");
+  EXPECT_EQ(2, host_.ComponentCount());
+  std::set<std::string> started_ids;
+  host_.GetComponents(&started_ids);
+  EXPECT_EQ(0, started_ids.count("a1"));
+  EXPECT_EQ(1, started_ids.count("b1"));
+  EXPECT_EQ(1, started_ids.count("c1"));
+}
+
+TEST_F(PluginScanTest, ReloadModifiedPlugin) {
+  AddPlugin(PLUGIN_FILE("a"), "a1", "", 0);
+  ScanPlugins(PLUGIN_FILE("a"), PLUGIN_FILE("b"), "");
+  EXPECT_EQ(PLUGIN_FILE("a"), GetComponentPlugin("a1"));
+  // The new version of the plugin replaces the old one.
+  AddPlugin(PLUGIN_FILE("a"), "a2", "", 0);
+  ScanPlugins(PLUGIN_FILE("a"), PLUGIN_FILE("b"), "");
+  EXPECT_EQ("", GetComponentPlugin("a1"));
+  EXPECT_EQ(PLUGIN_FILE("a"), GetComponentPlugin("a2"));
+  EXPECT_EQ(1, host_.ComponentCount());
+  // A removed plugin is unloaded even though its file can't be found.
+  manager_->RemovePlugin(PLUGIN_FILE("a"));
+  ScanPlugins(PLUGIN_FILE("a"), PLUGIN_FILE("b"), "");
+  EXPECT_EQ("", GetComponentPlugin("a2"));
+  EXPECT_EQ(0, host_.ComponentCount());
+}
+
+#ifndef OS_WINDOWS
+// Creates a temporary directory for the test and deletes it with all its
+// contents when destroyed.
+class ScopedTempDir {
+ public:
+  ScopedTempDir() {
+    char path[] = "/tmp/plugin_manager_test.XXXXXX";
+    EXPECT_TRUE(mkdtemp(path) != NULL);
+    path_ = path;
+  }
+
+  ~ScopedTempDir() {
+    Delete(path_);
+  }
+
+  const std::string& path() const { return path_; }
+
+  // Creates the file |name| under the directory, and returns its path.
+  std::string CreateFile(const std::string& name) {
+    std::string file = path_ + "/" + name;
+    FILE* stream = fopen(file.c_str(), "w");
+    EXPECT_TRUE(stream != NULL);
+    if (stream)
+      fclose(stream);
+    return file;
+  }
+
+  // Creates the sub directory |name|, and returns its path.
+  std::string CreateDirectory(const std::string& name) {
+    std::string dir = path_ + "/" + name;
+    EXPECT_EQ(0, mkdir(dir.c_str(), 0700));
+    return dir;
+  }
+
+  static void Delete(const std::string& path) {
+    if (DIR* dir = opendir(path.c_str())) {
+      while (struct dirent* entry = readdir(dir)) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+          Delete(path + "/" + entry->d_name);
+      }
+      closedir(dir);
+      rmdir(path.c_str());
+    } else {
+      unlink(path.c_str());
+    }
+  }
+
+ private:
+  std::string path_;
+  DISALLOW_COPY_AND_ASSIGN(ScopedTempDir);
+};
+
+TEST(PluginManagerUtilsTest, ListSharedObjects) {
+  ScopedTempDir dir;
+  std::set<std::string> expected;
+  expected.insert(dir.CreateFile("a.so"));
+  dir.CreateFile("a.so.txt");
+  dir.CreateFile("b.dll");
+  dir.CreateDirectory("sub");
+  expected.insert(dir.CreateFile("sub/c.so"));
+  // A directory with the plugin extension is listed as a directory.
+  dir.CreateDirectory("d.so");
+  expected.insert(dir.CreateFile("d.so/e.so"));
+  std::vector<std::string> files;
+  ASSERT_TRUE(PluginManagerUtils::ListPluginFile(dir.path(), &files));
+  EXPECT_EQ(expected.size(), files.size());
+  EXPECT_TRUE(SetEqual(expected,
+                       std::set<std::string>(files.begin(), files.end())));
+  EXPECT_FALSE(PluginManagerUtils::ListPluginFile(dir.path() + "/none",
+                                                  &files));
+}
+
+TEST(PluginManagerUtilsTest, FileTypes) {
+  ScopedTempDir dir;
+  std::string file = dir.CreateFile("a.so");
+  std::string sub_dir = dir.CreateDirectory("b.so");
+  EXPECT_TRUE(PluginManagerUtils::IsPluginFile(file));
+  EXPECT_FALSE(PluginManagerUtils::IsDirectory(file));
+  EXPECT_TRUE(PluginManagerUtils::PathExists(file));
+  EXPECT_TRUE(PluginManagerUtils::IsDirectory(sub_dir));
+  EXPECT_TRUE(PluginManagerUtils::PathExists(sub_dir));
+  EXPECT_FALSE(PluginManagerUtils::IsDirectory(dir.path() + "/none"));
+  EXPECT_FALSE(PluginManagerUtils::PathExists(dir.path() + "/none"));
+  EXPECT_FALSE(PluginManagerUtils::IsPluginFile(dir.path() + "/a.so.txt"));
+}
+
+TEST_F(PluginScanTest, RescanChangedDirectory) {
+  ScopedTempDir dir;
+  std::string sub_dir = dir.CreateDirectory("sub");
+  std::string plugin1 = dir.CreateFile("sub/a.so");
+  std::string plugin2 = dir.CreateFile("sub/b.so");
+  AddPlugin(plugin1, "a1", "", 0);
+  AddPlugin(plugin2, "b1", "", 0);
+  ScanPlugins(sub_dir, "", "");
+  EXPECT_EQ(plugin1, GetComponentPlugin("a1"));
+  EXPECT_EQ(plugin2, GetComponentPlugin("b1"));
+  // A removed directory unloads the plugins in it.
+  ScopedTempDir::Delete(sub_dir);
+  int scan_count = manager_->scan_count();
+  ScanPlugins(sub_dir, "", "");
+  EXPECT_EQ(scan_count, manager_->scan_count());
+  EXPECT_EQ("", GetComponentPlugin("a1"));
+  EXPECT_EQ("", GetComponentPlugin("b1"));
+  EXPECT_EQ(0, host_.ComponentCount());
+}
+
+TEST_F(PluginScanTest, ScanDirectoryWithPluginExtension) {
+  ScopedTempDir dir;
+  std::string sub_dir = dir.CreateDirectory("sub.so");
+  std::string plugin = dir.CreateFile("sub.so/a.so");
+  AddPlugin(plugin, "a1", "", 0);
+  ScanPlugins(sub_dir, "", "");
+  EXPECT_EQ(plugin, GetComponentPlugin("a1"));
+  // The directory itself is not scanned as a plugin.
+  EXPECT_EQ(1, manager_->scan_count());
+}
+
+TEST_F(PluginScanTest, IgnoreChangedNonPluginFile) {
+  ScopedTempDir dir;
+  dir.CreateDirectory("sub");
+  std::string plugin = dir.CreateFile("sub/a.so");
+  std::string file = dir.CreateFile("sub/readme.txt");
+  AddPlugin(plugin, "a1", "", 0);
+  ScanPlugins(plugin, "", "");
+  ASSERT_EQ(1, manager_->scan_count());
+  // Neither unloads nor rescans any plugin.
+  ScanPlugins(file, "", "");
+  EXPECT_EQ(1, manager_->scan_count());
+  EXPECT_EQ(plugin, GetComponentPlugin("a1"));
+  EXPECT_EQ(1, host_.ComponentCount());
+}
+#endif  // OS_WINDOWS
+
 }  // namespace components
 }  // namespace ime_goopy
 
@@ -20,6 +20,8 @@
 #include <shlwapi.h>
 #include <string.h>
 #else
+#include <dirent.h>
+#include <sys/stat.h>
 #include "common/windows_types.h"
 #endif
 #include "base/logging.h"
@@ -31,30 +33,83 @@ namespace ime_goopy {
 namespace components {
 namespace {
 
-static const wchar_t kPluginFileExtension[] = L".dll";
-inline bool IsPluginFile(const std::wstring& name) {
 #ifdef OS_WINDOWS
+static const wchar_t kPluginFileExtension[] = L".dll";
+inline bool IsPluginFileW(const std::wstring& name) {
   wchar_t* extension = PathFindExtension(name.c_str());
   return extension != NULL && _wcsicmp(extension, kPluginFileExtension) == 0;
+}
 #else
-  // We don't use DLL extension for other platforms.
-  // Leave it here and return False for now
-  return false;
-#endif
+static const char kPluginFileExtension[] = ".so";
+
+bool ListPluginFileRecursively(const std::string& path,
+                               std::vector<std::string>* files) {
+  DIR* dir = opendir(path.c_str());
+  if (!dir)
+    return false;
+  while (struct dirent* entry = readdir(dir)) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+    std::string file = path + "/" + entry->d_name;
+    struct stat file_stat;
+    if (stat(file.c_str(), &file_stat) != 0)
+      continue;
+    if (S_ISDIR(file_stat.st_mode))
+      ListPluginFileRecursively(file, files);
+    else if (S_ISREG(file_stat.st_mode) &&
+             PluginManagerUtils::IsPluginFile(file))
+      files->push_back(file);
+  }
+  closedir(dir);
+  return true;
 }
+#endif
 }  // namespace
 
 bool PluginManagerUtils::ListPluginFile(const std::string& path,
                                         std::vector<std::string>* files) {
   DCHECK(files);
   files->clear();
+#ifdef OS_WINDOWS
   std::vector<std::wstring> files_utf16;
   std::wstring path_utf16 = Utf8ToWide(path);
-  if (!AppUtils::GetFileList(path_utf16.c_str(), &files_utf16, IsPluginFile))
+  if (!AppUtils::GetFileList(path_utf16.c_str(), &files_utf16, IsPluginFileW))
     return false;
   for (int i = 0; i < files_utf16.size(); ++i)
     files->push_back(WideToUtf8(files_utf16[i]));
   return true;
+#else
+  return ListPluginFileRecursively(path, files);
+#endif
+}
+
+bool PluginManagerUtils::IsPluginFile(const std::string& path) {
+#ifdef OS_WINDOWS
+  return IsPluginFileW(Utf8ToWide(path));
+#else
+  const size_t extension_length = arraysize(kPluginFileExtension) - 1;
+  return path.size() > extension_length &&
+         path.compare(path.size() - extension_length, extension_length,
+                      kPluginFileExtension) == 0;
+#endif
+}
+
+bool PluginManagerUtils::IsDirectory(const std::string& path) {
+#ifdef OS_WINDOWS
+  return ::PathIsDirectory(Utf8ToWide(path).c_str()) != FALSE;
+#else
+  struct stat file_stat;
+  return stat(path.c_str(), &file_stat) == 0 && S_ISDIR(file_stat.st_mode);
+#endif
+}
+
+bool PluginManagerUtils::PathExists(const std::string& path) {
+#ifdef OS_WINDOWS
+  return ::PathFileExists(Utf8ToWide(path).c_str()) != FALSE;
+#else
+  struct stat file_stat;
+  return stat(path.c_str(), &file_stat) == 0;
+#endif
 }
 
 }  // namespace components
@@ -28,6 +28,13 @@ class PluginManagerUtils {
   // List all the plugin files in |path|, including the sub directory.
   static bool ListPluginFile(const std::string& path,
                              std::vector<std::string>* files);
+  // Returns true if |path| has the file extension of plugins on the current
+  // platform, which is ".dll" on Windows and ".so" on other platforms.
+  static bool IsPluginFile(const std::string& path);
+  // Returns true if |path| exists and is a directory.
+  static bool IsDirectory(const std::string& path);
+  // Returns true if a file or a directory exists in |path|.
+  static bool PathExists(const std::string& path);
 };
 }  // namespace components
 }  // namespace ime_goopy
@@ -17,6 +17,9 @@
 #ifndef GOOPY_COMPONENTS_PLUGIN_MANAGER_PLUGIN_MONITOR_INTERFACE_H_
 #define GOOPY_COMPONENTS_PLUGIN_MANAGER_PLUGIN_MONITOR_INTERFACE_H_
 
+#include <string>
+#include <vector>
+
 namespace ime_goopy {
 namespace components {
 
@@ -28,6 +31,12 @@ class PluginMonitorInterface {
     virtual ~Delegate() { }
     // Notifies that plugin files have been change.
     virtual void PluginChanged() = 0;
+    // Notifies that the plugin files in |paths| have been added, modified or
+    // removed. Monitors that know exactly which files are changed should call
+    // this method so that only the affected plugins are rescanned.
+    virtual void PluginFilesChanged(const std::vector<std::string>& paths) {
+      PluginChanged();
+    }
   };
   virtual bool Start() = 0;
   virtual void Stop() = 0;
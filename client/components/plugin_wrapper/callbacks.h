@@ -37,6 +37,17 @@ typedef void (API_CALL* ResumeMessageHandlingCallback)(ComponentOwner owner);
 typedef bool (API_CALL* RemoveComponentCallback)(ComponentOwner owner,
                                                  ComponentInstance instance);
 typedef void (API_CALL* FreeBufferCallback)(char* buffer);
+// Callbacks of plugin api version 2, |message| and |reply| are
+// ipc::proto::Message objects.
+typedef bool (API_CALL* SendMessageCallback)(
+    ComponentOwner owner,
+    void* message,
+    uint32* serial);
+typedef bool (API_CALL* SendMessageWithReplyCallback)(
+    ComponentOwner owner,
+    void* message,
+    int time_out,
+    void** reply);
 };
 
 // A set of callback functions that will be called in the plugin.
@@ -54,4 +65,18 @@ struct ComponentCallbacks {
   FreeBufferCallback free_buffer;
 };
 
+// Callbacks added in plugin api version 2. They can only be used if the
+// |message_runtime| of the owner equals to CurrentMessageRuntime() of the
+// plugin, see message_runtime.h.
+struct ComponentCallbacksV2 {
+  // Identifies the protobuf runtime used by the owner.
+  const void* message_runtime;
+  // Sends a message to the PluginComponentStub, the ownership of the message
+  // is transferred to the stub.
+  SendMessageCallback send_message;
+  // Sends a message to the PluginComponentStub and waits for reply. The
+  // caller owns the reply message.
+  SendMessageWithReplyCallback send_message_with_reply;
+};
+
 #endif  // GOOPY_COMPONENTS_PLUGIN_WRAPPER_CALLBACKS_H_
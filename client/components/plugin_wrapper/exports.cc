@@ -21,6 +21,7 @@
 #else
 #include "common/app_utils_posix.h"
 #endif
+#include "components/plugin_wrapper/message_runtime.h"
 #include "components/plugin_wrapper/plugin_component_host.h"
 #include "components/plugin_wrapper/plugin_definition.h"
 #include "ipc/component.h"
@@ -31,11 +32,9 @@ extern "C" {
 int API_CALL ListComponents(char** buffer, int* size) {
   ipc::proto::MessagePayload payload;
   int component_count = GetAvailableComponentInfos(&payload);
-  std::string buffer_str;
-  payload.SerializeToString(&buffer_str);
-  *size = buffer_str.size();
+  *size = payload.ByteSize();
   *buffer = new char[*size];
-  memcpy(*buffer, buffer_str.c_str(), *size);
+  payload.SerializeWithCachedSizesToArray(reinterpret_cast<uint8*>(*buffer));
   return component_count;
 }
 
@@ -84,4 +83,27 @@ void API_CALL HandleMessage(ComponentInstance instance,
 void API_CALL FreeBuffer(char* buffer) {
   delete[] buffer;
 }
+
+int API_CALL GetApiVersion() {
+  return kPluginApiVersion;
+}
+
+const void* API_CALL GetMessageRuntime() {
+  return CurrentMessageRuntime();
+}
+
+void API_CALL SetCallbacksV2(ComponentInstance instance,
+                             const ComponentCallbacksV2* callbacks) {
+  DCHECK(instance);
+  DCHECK(callbacks);
+  reinterpret_cast<ime_goopy::components::PluginComponentAdaptor*>(
+      instance)->SetCallbacksV2(*callbacks);
+}
+
+void API_CALL HandleMessageObject(ComponentInstance instance, void* message) {
+  DCHECK(instance);
+  reinterpret_cast<ime_goopy::components::PluginComponentAdaptor*>(
+      instance)->HandleMessageObject(
+          reinterpret_cast<ipc::proto::Message*>(message));
+}
 };
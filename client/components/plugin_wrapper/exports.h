@@ -22,6 +22,14 @@
 #include "components/plugin_wrapper/callbacks.h"
 #include "components/plugin_wrapper/plugin_wrapper.h"
 
+// Version of the plugin api implemented by the wrapper. Plugins that don't
+// export GetApiVersion implement version 1, in which all messages are passed
+// as serialized buffers.
+// Version 2 adds GetMessageRuntime, SetCallbacksV2 and HandleMessageObject to
+// pass message objects by pointer when the host and the plugin share the same
+// protobuf runtime.
+static const int kPluginApiVersion = 2;
+
 extern "C" {
 // Lists the components in the plugin. The ComponentInfo of the components will
 // be stored in a MessagePayload object and serialized to |buffer|. The |buffer|
@@ -67,6 +75,31 @@ static const char kHandleMessageProcName[] = "HandleMessage";
 // Frees the buffer created in the DLL.
 typedef void (API_CALL* FreeBufferProc)(char* buffer);
 static const char kFreeBufferProcName[] = "FreeBuffer";
+
+// Functions below are optional and only available since plugin api version 2.
+
+// Gets the plugin api version implemented by the plugin.
+typedef int (API_CALL* GetApiVersionProc)();
+static const char kGetApiVersionProcName[] = "GetApiVersion";
+
+// Gets the token of the protobuf runtime used by the plugin, see
+// CurrentMessageRuntime in message_runtime.h.
+typedef const void* (API_CALL* GetMessageRuntimeProc)();
+static const char kGetMessageRuntimeProcName[] = "GetMessageRuntime";
+
+// Sets the version 2 callbacks of the component |instance|. The instance will
+// use the callbacks to send message objects if the message runtime matches.
+typedef void (API_CALL* SetCallbacksV2Proc)(
+    ComponentInstance instance,
+    const ComponentCallbacksV2* callbacks);
+static const char kSetCallbacksV2ProcName[] = "SetCallbacksV2";
+
+// Sends an ipc::proto::Message object to the component |instance|, which takes
+// the ownership of |message|. Can only be called if the message runtime of the
+// plugin is the same as the caller's.
+typedef void (API_CALL* HandleMessageObjectProc)(ComponentInstance instance,
+                                                 void* message);
+static const char kHandleMessageObjectProcName[] = "HandleMessageObject";
 };
 
 #endif  // GOOPY_COMPONENTS_PLUGIN_WRAPPER_EXPORTS_H_
@@ -0,0 +1,32 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Identifies the protobuf runtime linked into a module, which decides whether
+// message objects can be passed across the plugin api by pointer.
+#ifndef GOOPY_COMPONENTS_PLUGIN_WRAPPER_MESSAGE_RUNTIME_H_
+#define GOOPY_COMPONENTS_PLUGIN_WRAPPER_MESSAGE_RUNTIME_H_
+
+#include "ipc/protos/ipc.pb.h"
+
+// Returns a token that identifies the protobuf runtime and the ipc messages
+// linked into the current module. Two modules returning the same token share
+// the same implementation of ipc::proto::Message, so message objects can be
+// passed between them by pointer instead of being serialized.
+inline const void* CurrentMessageRuntime() {
+  return &ipc::proto::Message::default_instance();
+}
+
+#endif  // GOOPY_COMPONENTS_PLUGIN_WRAPPER_MESSAGE_RUNTIME_H_
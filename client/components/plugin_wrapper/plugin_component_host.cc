@@ -21,6 +21,7 @@
 #include "google/protobuf/message.h"
 #include "base/logging.h"
 #include "common/debug.h"
+#include "components/plugin_wrapper/message_runtime.h"
 #include "ipc/component.h"
 #include "ipc/constants.h"
 #include "ipc/message_types.h"
@@ -34,7 +35,9 @@ PluginComponentAdaptor::PluginComponentAdaptor(
     ipc::Component* component)
     : component_(component),
       callbacks_(callbacks),
+      share_message_runtime_(false),
       registered_(false) {
+  memset(&callbacks_v2_, 0, sizeof(callbacks_v2_));
   DCHECK(component_.get());
   DCHECK(callbacks_.owner);
   DCHECK(callbacks_.send);
@@ -65,6 +68,8 @@ bool PluginComponentAdaptor::RemoveComponent(ipc::Component* component) {
 bool PluginComponentAdaptor::Send(ipc::Component* component,
                                   ipc::proto::Message* message,
                                   uint32* serial) {
+  if (share_message_runtime_)
+    return (*callbacks_v2_.send_message)(callbacks_.owner, message, serial);
   std::string message_str;
   message->SerializeToString(&message_str);
   delete message;
@@ -80,6 +85,14 @@ bool PluginComponentAdaptor::SendWithReply(ipc::Component* component,
                                            ipc::proto::Message** reply) {
   DCHECK(timeout);
   DCHECK(reply);
+  if (share_message_runtime_) {
+    void* reply_message = NULL;
+    bool success = (*callbacks_v2_.send_message_with_reply)(
+        callbacks_.owner, message, timeout, &reply_message);
+    *reply = reinterpret_cast<ipc::proto::Message*>(reply_message);
+    DLOG_IF(ERROR, !success) << __SHORT_FUNCTION__ << "SendWithReply failed";
+    return success;
+  }
   std::string message_str;
   message->SerializeToString(&message_str);
   delete message;
@@ -120,11 +133,9 @@ void PluginComponentAdaptor::GetComponentInfo(char** buffer, int* size) {
   DCHECK(size);
   ipc::proto::ComponentInfo info;
   component_->GetInfo(&info);
-  std::string info_str;
-  info.SerializeToString(&info_str);
-  (*size) = info_str.size();
+  (*size) = info.ByteSize();
   (*buffer) = new char[*size + 1];
-  memcpy(*buffer, info_str.c_str(), *size);
+  info.SerializeWithCachedSizesToArray(reinterpret_cast<uint8*>(*buffer));
 }
 
 void PluginComponentAdaptor::HandleMessage(const char* buffer, int size) {
@@ -137,6 +148,22 @@ void PluginComponentAdaptor::HandleMessage(const char* buffer, int size) {
   component_->Handle(mptr.release());
 }
 
+void PluginComponentAdaptor::SetCallbacksV2(
+    const ComponentCallbacksV2& callbacks) {
+  DCHECK(callbacks.send_message);
+  DCHECK(callbacks.send_message_with_reply);
+  callbacks_v2_ = callbacks;
+  share_message_runtime_ =
+      callbacks_v2_.message_runtime == CurrentMessageRuntime();
+}
+
+void PluginComponentAdaptor::HandleMessageObject(
+    ipc::proto::Message* message) {
+  DCHECK(share_message_runtime_);
+  DCHECK(component_.get() && registered_);
+  component_->Handle(message);
+}
+
 void PluginComponentAdaptor::Registered(int id) {
   DCHECK_GT(id, ipc::kComponentDefault);
   DCHECK(component_.get());
@@ -58,6 +58,12 @@ class PluginComponentAdaptor : public ipc::ComponentHost {
   // Lets the PluginComponentHost handle a message. The message is serialized
   // into buffer with length size.
   void HandleMessage(const char* buffer, int size);
+  // Sets the callbacks of plugin api version 2. Messages will be sent to the
+  // owner by pointer if the owner shares the same message runtime.
+  void SetCallbacksV2(const ComponentCallbacksV2& callbacks);
+  // Lets the PluginComponentHost handle a message object, which is only called
+  // by an owner sharing the same message runtime.
+  void HandleMessageObject(ipc::proto::Message* message);
   // Called when the component is registered to the hub.
   void Registered(int id);
   // Called when the component is deregistered from the hub.
@@ -66,6 +72,9 @@ class PluginComponentAdaptor : public ipc::ComponentHost {
  private:
   scoped_ptr<ipc::Component> component_;
   ComponentCallbacks callbacks_;
+  ComponentCallbacksV2 callbacks_v2_;
+  // True if message objects can be passed to the owner by pointer.
+  bool share_message_runtime_;
   bool has_component_;
   bool registered_;
   DISALLOW_COPY_AND_ASSIGN(PluginComponentAdaptor);
@@ -16,16 +16,88 @@
 
 #include "components/plugin_wrapper/plugin_component_stub.h"
 
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "base/logging.h"
+#include "base/singleton.h"
+#include "base/synchronization/lock.h"
 #include "components/plugin_wrapper/callbacks.h"
+#include "components/plugin_wrapper/message_runtime.h"
 #include "ipc/constants.h"
 #include "ipc/message_types.h"
+#include "ipc/message_util.h"
 
 namespace ime_goopy {
 namespace components {
 namespace {
+const size_t kMinReplyBufferSize = 256;
+// Larger reply buffers are deleted when freed instead of being kept.
+const size_t kMaxPooledReplyBufferSize = 64 * 1024;
+const size_t kMaxPooledReplyBuffers = 8;
+
+// The reply buffers returned to the plugins by SendWithReplyProcedure, which
+// are recycled when the plugins free them instead of being allocated for every
+// reply. Each buffer is preceded by a header recording its capacity.
+class ReplyBufferPool {
+ public:
+  static ReplyBufferPool* GetInstance() {
+    return Singleton<ReplyBufferPool,
+                     LeakySingletonTraits<ReplyBufferPool> >::get();
+  }
+
+  // Returns a buffer that can hold at least |size| bytes.
+  char* Acquire(int size) {
+    size_t capacity = std::max(static_cast<size_t>(size), kMinReplyBufferSize);
+    {
+      base::AutoLock auto_lock(lock_);
+      for (size_t i = 0; i < free_buffers_.size(); ++i) {
+        char* buffer = free_buffers_[i];
+        if (GetCapacity(buffer) < capacity)
+          continue;
+        free_buffers_[i] = free_buffers_.back();
+        free_buffers_.pop_back();
+        return buffer;
+      }
+    }
+    char* block = new char[sizeof(Header) + capacity];
+    reinterpret_cast<Header*>(block)->capacity = capacity;
+    return block + sizeof(Header);
+  }
+
+  // Takes back |buffer| returned by Acquire. Buffers exceeding the pooled
+  // count or size are deleted.
+  void Release(char* buffer) {
+    if (!buffer)
+      return;
+    if (GetCapacity(buffer) <= kMaxPooledReplyBufferSize) {
+      base::AutoLock auto_lock(lock_);
+      if (free_buffers_.size() < kMaxPooledReplyBuffers) {
+        free_buffers_.push_back(buffer);
+        return;
+      }
+    }
+    delete[] (buffer - sizeof(Header));
+  }
+
+ private:
+  friend struct DefaultSingletonTraits<ReplyBufferPool>;
+  struct Header {
+    size_t capacity;
+  };
+
+  ReplyBufferPool() { }
+
+  static size_t GetCapacity(char* buffer) {
+    return reinterpret_cast<Header*>(buffer - sizeof(Header))->capacity;
+  }
+
+  std::vector<char*> free_buffers_;
+  base::Lock lock_;
+  DISALLOW_COPY_AND_ASSIGN(ReplyBufferPool);
+};
+
 extern "C" {
 bool API_CALL SendProcedure(
     ComponentOwner owner,
@@ -51,17 +123,38 @@ bool API_CALL SendWithReplyProcedure(
       reinterpret_cast<ime_goopy::components::PluginComponentStub*>(owner);
   if (!component->SendWithReply(mptr.release(), time_out, &reply))
     return false;
-  std::string reply_str;
-  if (!reply->SerializeToString(&reply_str)) {
-    delete reply;
-    return false;
-  }
-  *reply_buf = new char[reply_str.size()];
-  *reply_length = reply_str.size();
-  memcpy(*reply_buf, reply_str.c_str(), reply_str.size());
+  scoped_ptr<ipc::proto::Message> reply_ptr(reply);
+  // Serializes the reply into a pooled buffer directly, which is recycled when
+  // the plugin frees it by FreeBufferProcedure.
+  *reply_length = reply_ptr->ByteSize();
+  *reply_buf = ReplyBufferPool::GetInstance()->Acquire(*reply_length);
+  reply_ptr->SerializeWithCachedSizesToArray(
+      reinterpret_cast<uint8*>(*reply_buf));
   return true;
 }
 
+bool API_CALL SendMessageProcedure(ComponentOwner owner,
+                                   void* message,
+                                   uint32* serial) {
+  return reinterpret_cast<ime_goopy::components::PluginComponentStub*>(
+      owner)->Send(reinterpret_cast<ipc::proto::Message*>(message), serial);
+}
+
+bool API_CALL SendMessageWithReplyProcedure(ComponentOwner owner,
+                                            void* message,
+                                            int time_out,
+                                            void** reply) {
+  ipc::proto::Message* reply_message = NULL;
+  bool success =
+      reinterpret_cast<ime_goopy::components::PluginComponentStub*>(
+          owner)->SendWithReply(
+              reinterpret_cast<ipc::proto::Message*>(message),
+              time_out,
+              &reply_message);
+  *reply = reply_message;
+  return success;
+}
+
 void API_CALL PauseMessageHandlingProcedure(ComponentOwner owner) {
   reinterpret_cast<ime_goopy::components::PluginComponentStub*>(
       owner)->PauseMessageHandling();
@@ -79,20 +172,13 @@ bool API_CALL RemoveComponentProcedure(ComponentOwner owner,
 }
 
 void API_CALL FreeBufferProcedure(char* buffer) {
-  delete[] buffer;
+  ReplyBufferPool::GetInstance()->Release(buffer);
 }
 }
-}  // namespace
 
-PluginComponentStub::PluginComponentStub(const std::string& dll_path,
-                                         const char* id)
-    : component_(NULL),
-      plugin_instance_(dll_path.c_str()),
-      initialized_(false) {
-  if (!plugin_instance_.IsInitialized())
-    return;
+ComponentCallbacks GetCallbacks(ComponentOwner owner) {
   ComponentCallbacks callbacks = {
-    this,
+    owner,
     SendProcedure,
     SendWithReplyProcedure,
     PauseMessageHandlingProcedure,
@@ -100,24 +186,73 @@ PluginComponentStub::PluginComponentStub(const std::string& dll_path,
     RemoveComponentProcedure,
     FreeBufferProcedure,
   };
-  component_ = plugin_instance_.CreateInstance(callbacks, id);
+  return callbacks;
+}
+
+ComponentCallbacksV2 GetCallbacksV2() {
+  ComponentCallbacksV2 callbacks = {
+    CurrentMessageRuntime(),
+    SendMessageProcedure,
+    SendMessageWithReplyProcedure,
+  };
+  return callbacks;
+}
+}  // namespace
+
+PluginComponentStub::PluginComponentStub(const std::string& dll_path,
+                                         const char* id)
+    : dll_path_(dll_path),
+      lazy_(false),
+      component_(NULL),
+      plugin_instance_(new PluginInstance(dll_path)),
+      initialized_(false),
+      loading_(false),
+      handling_count_(0),
+      not_unloading_event_(true, true) {
+  if (!plugin_instance_->IsInitialized())
+    return;
+  component_ = plugin_instance_->CreateInstance(GetCallbacks(this), id);
   DCHECK(component_);
+  if (component_ && plugin_instance_->SharesMessageRuntime())
+    plugin_instance_->SetCallbacksV2(component_, GetCallbacksV2());
   initialized_ = component_ &&
-                 plugin_instance_.IsInitialized();
+                 plugin_instance_->IsInitialized();
+}
+
+PluginComponentStub::PluginComponentStub(
+    const std::string& dll_path,
+    const ipc::proto::ComponentInfo& info)
+    : dll_path_(dll_path),
+      lazy_(true),
+      component_(NULL),
+      initialized_(info.has_string_id()),
+      loading_(false),
+      handling_count_(0),
+      not_unloading_event_(true, true) {
+  DCHECK(initialized_);
+  cached_info_.CopyFrom(info);
 }
 
 PluginComponentStub::~PluginComponentStub() {
+  while (!pending_messages_.empty()) {
+    delete pending_messages_.front();
+    pending_messages_.pop();
+  }
   if (component_)
-    plugin_instance_.DestroyInstance(component_);
+    plugin_instance_->DestroyInstance(component_);
 }
 
 void PluginComponentStub::GetInfo(ipc::proto::ComponentInfo* info) {
   if (!initialized_) return;
+  if (lazy_) {
+    info->CopyFrom(cached_info_);
+    return;
+  }
   char* buffer = NULL;
   int size = 0;
-  plugin_instance_.GetInfo(component_, &buffer, &size);
+  plugin_instance_->GetInfo(component_, &buffer, &size);
   info->ParseFromArray(buffer, size);
-  plugin_instance_.FreeBuffer(buffer);
+  plugin_instance_->FreeBuffer(buffer);
 }
 
 void PluginComponentStub::Handle(ipc::proto::Message* message) {
@@ -125,25 +260,149 @@ void PluginComponentStub::Handle(ipc::proto::Message* message) {
     delete message;
     return;
   }
-  std::string str;
-  message->SerializeToString(&str);
-  delete message;
-  plugin_instance_.HandleMessage(component_, str.c_str(), str.size());
+  if (!EnsureLoaded(message))
+    return;
+  HandleLoaded(message);
+  // Handles the messages received during loading.
+  while (true) {
+    ipc::proto::Message* pending = NULL;
+    {
+      base::AutoLock auto_lock(lock_);
+      if (pending_messages_.empty()) {
+        --handling_count_;
+        last_active_ = base::TimeTicks::Now();
+        break;
+      }
+      pending = pending_messages_.front();
+      pending_messages_.pop();
+    }
+    HandleLoaded(pending);
+  }
 }
 
 void PluginComponentStub::OnRegistered() {
-  if (!initialized_) return;
-  plugin_instance_.Registered(component_, id());
+  if (!initialized_ || !IsLoaded()) return;
+  plugin_instance_->Registered(component_, id());
 }
 
 void PluginComponentStub::OnDeregistered() {
-  if (!initialized_) return;
-  plugin_instance_.Deregistered(component_);
+  if (!initialized_ || !IsLoaded()) return;
+  plugin_instance_->Deregistered(component_);
 }
 
 bool PluginComponentStub::IsInitialized() {
   return initialized_;
 }
 
+bool PluginComponentStub::IsLoaded() {
+  base::AutoLock auto_lock(lock_);
+  return component_ != NULL;
+}
+
+bool PluginComponentStub::UnloadIfIdle(const base::TimeDelta& idle_timeout) {
+  ComponentInstance component = NULL;
+  scoped_ptr<PluginInstance> instance;
+  {
+    base::AutoLock auto_lock(lock_);
+    if (!lazy_ || !component_ || loading_ || handling_count_)
+      return false;
+    if (base::TimeTicks::Now() - last_active_ < idle_timeout)
+      return false;
+    component = component_;
+    component_ = NULL;
+    instance.swap(plugin_instance_);
+    not_unloading_event_.Reset();
+  }
+  if (id() != ipc::kComponentDefault)
+    instance->Deregistered(component);
+  instance->DestroyInstance(component);
+  instance.reset(NULL);
+  not_unloading_event_.Signal();
+  return true;
+}
+
+bool PluginComponentStub::EnsureLoaded(ipc::proto::Message* message) {
+  // Waits for UnloadIfIdle called from another thread to finish, so that the
+  // old instance is always destroyed before a new one is created.
+  not_unloading_event_.Wait();
+  {
+    base::AutoLock auto_lock(lock_);
+    if (component_) {
+      ++handling_count_;
+      return true;
+    }
+    if (loading_) {
+      // The dll is being loaded by another thread or in the current call
+      // stack, the message will be handled as soon as the loading is finished.
+      pending_messages_.push(message);
+      return false;
+    }
+    loading_ = lazy_;
+  }
+  if (!lazy_) {
+    DropMessage(message);
+    return false;
+  }
+  scoped_ptr<PluginInstance> instance(new PluginInstance(dll_path_));
+  ComponentInstance component = NULL;
+  if (instance->IsInitialized()) {
+    component = instance->CreateInstance(GetCallbacks(this),
+                                         cached_info_.string_id().c_str());
+    if (component && instance->SharesMessageRuntime())
+      instance->SetCallbacksV2(component, GetCallbacksV2());
+  }
+  DLOG_IF(ERROR, !component) << "Error loading component:"
+                             << cached_info_.string_id()
+                             << " from:" << dll_path_;
+  std::queue<ipc::proto::Message*> dropped_messages;
+  {
+    base::AutoLock auto_lock(lock_);
+    loading_ = false;
+    if (component) {
+      component_ = component;
+      plugin_instance_.swap(instance);
+      ++handling_count_;
+    } else {
+      dropped_messages.swap(pending_messages_);
+    }
+  }
+  if (!component) {
+    // Replies errors to the messages queued during loading as well, so that
+    // none of their senders waits for a reply that will never come.
+    DropMessage(message);
+    while (!dropped_messages.empty()) {
+      DropMessage(dropped_messages.front());
+      dropped_messages.pop();
+    }
+    return false;
+  }
+  if (id() != ipc::kComponentDefault)
+    plugin_instance_->Registered(component_, id());
+  return true;
+}
+
+void PluginComponentStub::HandleLoaded(ipc::proto::Message* message) {
+  if (plugin_instance_->SharesMessageRuntime()) {
+    plugin_instance_->HandleMessageObject(component_, message);
+    return;
+  }
+  // The plugin parses the buffer before handling the message, so the buffer
+  // can be reused even if HandleMessage is called re-entrantly.
+  message->SerializeToString(&message_buffer_);
+  delete message;
+  plugin_instance_->HandleMessage(component_,
+                                  message_buffer_.data(),
+                                  message_buffer_.size());
+}
+
+void PluginComponentStub::DropMessage(ipc::proto::Message* message) {
+  if (ipc::MessageNeedReply(message)) {
+    ReplyError(message, ipc::proto::Error::COMPONENT_NOT_FOUND,
+               "Plugin component can not be loaded");
+  } else {
+    delete message;
+  }
+}
+
 }  // namespace ime_goopy
 }  // namespace components
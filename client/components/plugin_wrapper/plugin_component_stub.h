@@ -17,7 +17,13 @@
 #ifndef GOOPY_COMPONENTS_PLUGIN_WRAPPER_PLUGIN_COMPONENT_STUB_H_
 #define GOOPY_COMPONENTS_PLUGIN_WRAPPER_PLUGIN_COMPONENT_STUB_H_
 
+#include <queue>
+#include <string>
+
 #include "base/scoped_ptr.h"
+#include "base/synchronization/lock.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/time.h"
 #include "components/plugin_wrapper/plugin_instance.h"
 #include "ipc/component_base.h"
 
@@ -26,10 +32,18 @@ namespace components {
 
 // A stub component that can loads an actual component from a given dll and
 // deliver the messages between hub and the component.
+// A stub can be created in lazy mode from a cached ComponentInfo, in which
+// case the dll is not loaded until the first message targets the component,
+// and can be unloaded again after the component has been idle for a while.
 class PluginComponentStub : public ipc::ComponentBase {
  public:
+  // Loads the dll in |dll_path| and creates the component |id| immediately.
   PluginComponentStub(const std::string& dll_path,
                       const char* id);
+  // Creates a lazy stub of the component described by |info|, which must be
+  // the ComponentInfo listed by the plugin in |dll_path|.
+  PluginComponentStub(const std::string& dll_path,
+                      const ipc::proto::ComponentInfo& info);
   virtual ~PluginComponentStub();
   // Overridden from ComponentBase:
   virtual void GetInfo(ipc::proto::ComponentInfo* info) OVERRIDE;
@@ -38,11 +52,50 @@ class PluginComponentStub : public ipc::ComponentBase {
   virtual void OnDeregistered() OVERRIDE;
   ComponentInstance component();
   bool IsInitialized();
+  // Returns true if the dll is loaded and the component instance is created.
+  bool IsLoaded();
+  // Destroys the component instance and unloads the dll if the stub is lazy
+  // and no message has been handled in the last |idle_timeout|. The dll will
+  // be loaded again when the next message arrives.
+  // Returns true if the dll is unloaded.
+  bool UnloadIfIdle(const base::TimeDelta& idle_timeout);
 
  private:
+  // Loads the dll and creates the component instance if it is not loaded yet,
+  // and increases |handling_count_| to prevent the instance from being
+  // unloaded until Handle decreases it again.
+  // Returns false if |message| is taken: it is queued if the dll is being
+  // loaded by another thread or in the current call stack, or dropped along
+  // with all the queued messages if the dll can not be loaded.
+  bool EnsureLoaded(ipc::proto::Message* message);
+  // Delivers |message| to the loaded component instance. Must be called
+  // between a successful EnsureLoaded and the corresponding decrement of
+  // |handling_count_|.
+  void HandleLoaded(ipc::proto::Message* message);
+  // Drops |message| because the component can not be loaded.
+  void DropMessage(ipc::proto::Message* message);
+
+  std::string dll_path_;
+  // Valid only in lazy mode.
+  ipc::proto::ComponentInfo cached_info_;
+  bool lazy_;
   ComponentInstance component_;
-  PluginInstance plugin_instance_;
+  scoped_ptr<PluginInstance> plugin_instance_;
   bool initialized_;
+  // True while the dll is being loaded in EnsureLoaded.
+  bool loading_;
+  // Number of messages being handled by the component instance.
+  int handling_count_;
+  // The time when the last message was handled.
+  base::TimeTicks last_active_;
+  // A reusable buffer to serialize messages to the plugin when message objects
+  // can't be passed by pointer.
+  std::string message_buffer_;
+  // Messages received while the dll is being loaded.
+  std::queue<ipc::proto::Message*> pending_messages_;
+  // Signaled when the stub is not being unloaded by UnloadIfIdle.
+  base::WaitableEvent not_unloading_event_;
+  base::Lock lock_;
   DISALLOW_COPY_AND_ASSIGN(PluginComponentStub);
 };
 
@@ -47,10 +47,26 @@ class PluginInstance {
                      const char* message_buffer,
                      int buffer_length);
   void FreeBuffer(char* buffer);
+  // Functions of plugin api version 2, which must only be called if
+  // SharesMessageRuntime returns true.
+  void SetCallbacksV2(ComponentInstance instance,
+                      const ComponentCallbacksV2& callbacks);
+  void HandleMessageObject(ComponentInstance instance,
+                           ipc::proto::Message* message);
 
   bool IsInitialized();
+  // Returns the plugin api version implemented by the plugin.
+  int api_version() const { return api_version_; }
+  // Returns true if the plugin uses the same message runtime as the caller, so
+  // message objects can be passed to the plugin by pointer.
+  bool SharesMessageRuntime() const { return share_message_runtime_; }
 
  private:
+  // Platform dependent functions implemented in plugin_instance_win.cc and
+  // plugin_instance_posix.cc.
+  // Loads the plugin file in |path| and returns its handle, or NULL on error.
+  static void* LoadPluginFile(const std::string& path);
+  static void UnloadPluginFile(void* handle);
   void* GetProcAddress(const char* proc_name);
   template<typename ProcType>
   ProcType GetProcAddress(const char* proc_name) {
@@ -65,6 +81,10 @@ class PluginInstance {
   FreeBufferProc free_buffer_;
   RegisteredProc registered_;
   DeregisteredProc deregistered_;
+  SetCallbacksV2Proc set_callbacks_v2_;
+  HandleMessageObjectProc handle_message_object_;
+  int api_version_;
+  bool share_message_runtime_;
   bool initialized_;
 };
 
@@ -25,8 +25,9 @@
       ],
       'sources': [
         'plugin_component_stub.cc',
+        'plugin_instance.cc',
         'plugin_instance_win.cc',
-        #'plugin_instance_posix.cc',
+        'plugin_instance_posix.cc',
       ],
       'conditions': [
         ['OS=="win"', {
@@ -37,7 +38,12 @@
         ['OS=="linux" or OS=="mac"', {
           'sources/': [
             ['exclude', '_win\\.cc$'],
-          ]
+          ],
+          'link_settings': {
+            'libraries': [
+              '-ldl',
+            ],
+          },
         }],
       ],
     }
@@ -16,7 +16,11 @@
 
 #include "base/logging.h"
 
+#include <queue>
+
+#include "components/plugin_wrapper/message_runtime.h"
 #include "components/plugin_wrapper/mocked_plugin_component.h"
+#include "components/plugin_wrapper/plugin_component_host.h"
 #include "components/plugin_wrapper/plugin_component_stub.h"
 #include "ipc/constants.h"
 #include "ipc/message_types.h"
@@ -32,6 +36,144 @@ using ipc::NewMessageForTest;
 static const char kPluginName[] = PLUGIN_NAME;
 static const int kComponentID = ipc::MockComponentHost::kMockComponentId;
 
+// Records the messages sent by a PluginComponentAdaptor through the callbacks,
+// acting as the owner of the adaptor in place of a PluginComponentStub.
+struct CallbackRecorder {
+  CallbackRecorder()
+      : serialized_count(0), object_count(0), freed_buffer_count(0) {
+  }
+  ~CallbackRecorder() {
+    while (!messages.empty()) {
+      delete messages.front();
+      messages.pop();
+    }
+  }
+  std::queue<ipc::proto::Message*> messages;
+  // The reply of the next message sent with reply.
+  scoped_ptr<ipc::proto::Message> next_reply;
+  // Number of messages sent as serialized buffers.
+  int serialized_count;
+  // Number of messages sent by pointer.
+  int object_count;
+  int freed_buffer_count;
+};
+
+CallbackRecorder* GetRecorder(ComponentOwner owner) {
+  return reinterpret_cast<CallbackRecorder*>(owner);
+}
+
+bool API_CALL RecordSend(ComponentOwner owner,
+                         const char* message_buf, int length,
+                         uint32* serial) {
+  scoped_ptr<ipc::proto::Message> mptr(new ipc::proto::Message);
+  if (!mptr->ParseFromArray(message_buf, length))
+    return false;
+  GetRecorder(owner)->messages.push(mptr.release());
+  ++GetRecorder(owner)->serialized_count;
+  return true;
+}
+
+bool API_CALL RecordSendWithReply(ComponentOwner owner,
+                                  const char* message_buf, int length,
+                                  int time_out,
+                                  char** reply_buf, int* reply_length) {
+  CallbackRecorder* recorder = GetRecorder(owner);
+  if (!RecordSend(owner, message_buf, length, NULL) ||
+      !recorder->next_reply.get()) {
+    return false;
+  }
+  *reply_length = recorder->next_reply->ByteSize();
+  *reply_buf = new char[*reply_length];
+  recorder->next_reply->SerializeWithCachedSizesToArray(
+      reinterpret_cast<uint8*>(*reply_buf));
+  recorder->next_reply.reset(NULL);
+  return true;
+}
+
+void API_CALL IgnorePauseResume(ComponentOwner owner) {
+}
+
+bool API_CALL IgnoreRemoveComponent(ComponentOwner owner,
+                                    ComponentInstance instance) {
+  return false;
+}
+
+// Only buffers created by RecordSendWithReply are freed in the test.
+CallbackRecorder* g_freeing_recorder = NULL;
+
+void API_CALL RecordFreeBuffer(char* buffer) {
+  if (buffer)
+    ++g_freeing_recorder->freed_buffer_count;
+  delete[] buffer;
+}
+
+bool API_CALL RecordSendMessage(ComponentOwner owner,
+                                void* message,
+                                uint32* serial) {
+  GetRecorder(owner)->messages.push(
+      reinterpret_cast<ipc::proto::Message*>(message));
+  ++GetRecorder(owner)->object_count;
+  return true;
+}
+
+bool API_CALL RecordSendMessageWithReply(ComponentOwner owner,
+                                         void* message,
+                                         int time_out,
+                                         void** reply) {
+  RecordSendMessage(owner, message, NULL);
+  *reply = GetRecorder(owner)->next_reply.release();
+  return *reply != NULL;
+}
+
+// Tests the PluginComponentAdaptor in the plugin side without loading a
+// plugin, so the message runtime is always shared with the test.
+class PluginComponentAdaptorTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    g_freeing_recorder = &recorder_;
+    ComponentCallbacks callbacks = {
+      &recorder_,
+      RecordSend,
+      RecordSendWithReply,
+      IgnorePauseResume,
+      IgnorePauseResume,
+      IgnoreRemoveComponent,
+      RecordFreeBuffer,
+    };
+    adaptor_.reset(new ime_goopy::components::PluginComponentAdaptor(
+        callbacks, new MockedPluginComponent("component1")));
+    adaptor_->Registered(kComponentID);
+  }
+
+  virtual void TearDown() {
+    adaptor_.reset(NULL);
+    g_freeing_recorder = NULL;
+  }
+
+  // Sets the version 2 callbacks with the message runtime |runtime|.
+  void SetCallbacksV2(const void* runtime) {
+    ComponentCallbacksV2 callbacks = {
+      runtime,
+      RecordSendMessage,
+      RecordSendMessageWithReply,
+    };
+    adaptor_->SetCallbacksV2(callbacks);
+  }
+
+  // Pops the next recorded message and checks its type and reply mode.
+  void CheckNextMessage(uint32 type, bool is_reply) {
+    ASSERT_FALSE(recorder_.messages.empty());
+    scoped_ptr<ipc::proto::Message> mptr(recorder_.messages.front());
+    recorder_.messages.pop();
+    EXPECT_EQ(type, mptr->type());
+    EXPECT_EQ(is_reply,
+              mptr->reply_mode() == ipc::proto::Message::IS_REPLY);
+  }
+
+  CallbackRecorder recorder_;
+  scoped_ptr<ime_goopy::components::PluginComponentAdaptor> adaptor_;
+};
+
 class PluginWrapperTest : public ::testing::Test {
  protected:
   PluginWrapperTest() { }
@@ -61,6 +203,7 @@ class PluginWrapperTest : public ::testing::Test {
 TEST_F(PluginWrapperTest, ListComponentsTest) {
   scoped_ptr<ime_goopy::components::PluginInstance> dll(
       new ime_goopy::components::PluginInstance(kPluginName));
+  EXPECT_EQ(kPluginApiVersion, dll->api_version());
   ipc::proto::MessagePayload payload;
   int component_count = dll->ListComponents(&payload);
   ASSERT_GT(component_count, 0);
@@ -86,6 +229,60 @@ TEST_F(PluginWrapperTest, ListComponentsTest) {
   }
 }
 
+TEST_F(PluginWrapperTest, LazyLoadTest) {
+  scoped_ptr<ime_goopy::components::PluginInstance> dll(
+      new ime_goopy::components::PluginInstance(kPluginName));
+  ipc::proto::MessagePayload payload;
+  ASSERT_GT(dll->ListComponents(&payload), 0);
+  dll.reset(NULL);
+  scoped_ptr<ime_goopy::components::PluginComponentStub> component(
+      new ime_goopy::components::PluginComponentStub(
+          kPluginName, payload.component_info(0)));
+  ASSERT_TRUE(component->IsInitialized());
+  // The ComponentInfo is served from the cache without loading the plugin.
+  ipc::proto::ComponentInfo info;
+  component->GetInfo(&info);
+  EXPECT_EQ(payload.component_info(0).string_id(), info.string_id());
+  EXPECT_FALSE(component->IsLoaded());
+  ipc::MockComponentHost host;
+  host.AddComponent(component.get());
+  EXPECT_FALSE(component->IsLoaded());
+
+  // The first message loads the plugin.
+  scoped_ptr<ipc::proto::Message> mptr(
+      NewMessageForTest(MockedPluginComponent::MSG_REQUEST_SEND,
+                        ipc::proto::Message::NEED_REPLY,
+                        ipc::kComponentDefault,
+                        kComponentID,
+                        ipc::kInputContextNone));
+  component->Handle(mptr.release());
+  EXPECT_TRUE(component->IsLoaded());
+  mptr.reset(host.PopOutgoingMessage());
+  ASSERT_TRUE(mptr.get());
+  EXPECT_EQ(MockedPluginComponent::MSG_TEST_MESSAGE, mptr->type());
+  mptr.reset(host.PopOutgoingMessage());
+  ASSERT_TRUE(mptr.get());
+  EXPECT_EQ(MockedPluginComponent::MSG_REQUEST_SEND, mptr->type());
+  EXPECT_EQ(ipc::proto::Message::IS_REPLY, mptr->reply_mode());
+
+  // The plugin is unloaded when idle and loaded again by the next message.
+  EXPECT_FALSE(component->UnloadIfIdle(base::TimeDelta::FromHours(1)));
+  EXPECT_TRUE(component->UnloadIfIdle(base::TimeDelta()));
+  EXPECT_FALSE(component->IsLoaded());
+  mptr.reset(
+      NewMessageForTest(MockedPluginComponent::MSG_REQUEST_SEND,
+                        ipc::proto::Message::NEED_REPLY,
+                        ipc::kComponentDefault,
+                        kComponentID,
+                        ipc::kInputContextNone));
+  component->Handle(mptr.release());
+  EXPECT_TRUE(component->IsLoaded());
+  mptr.reset(host.PopOutgoingMessage());
+  ASSERT_TRUE(mptr.get());
+  EXPECT_EQ(MockedPluginComponent::MSG_TEST_MESSAGE, mptr->type());
+  host.RemoveComponent(component.get());
+}
+
 TEST_F(PluginWrapperTest, MessageTest) {
   scoped_ptr<ipc::proto::Message> mptr;
   mptr.reset(
@@ -167,6 +364,103 @@ TEST_F(PluginWrapperTest, PauseResumeMessageHandlingTest) {
   ASSERT_TRUE(host_->IsMessageHandlingPaused());
 }
 
+TEST_F(PluginComponentAdaptorTest, MessageObjectTest) {
+  SetCallbacksV2(CurrentMessageRuntime());
+  adaptor_->HandleMessageObject(
+      NewMessageForTest(MockedPluginComponent::MSG_REQUEST_SEND,
+                        ipc::proto::Message::NEED_REPLY,
+                        ipc::kComponentDefault,
+                        kComponentID,
+                        ipc::kInputContextNone));
+  // Both the sent message and the reply are passed by pointer.
+  EXPECT_EQ(2, recorder_.object_count);
+  EXPECT_EQ(0, recorder_.serialized_count);
+  CheckNextMessage(MockedPluginComponent::MSG_TEST_MESSAGE, false);
+  CheckNextMessage(MockedPluginComponent::MSG_REQUEST_SEND, true);
+  EXPECT_TRUE(recorder_.messages.empty());
+}
+
+TEST_F(PluginComponentAdaptorTest, MessageObjectWithReplyTest) {
+  SetCallbacksV2(CurrentMessageRuntime());
+  recorder_.next_reply.reset(
+      NewMessageForTest(MockedPluginComponent::MSG_TEST_SEND_WITH_REPLY,
+                        ipc::proto::Message::IS_REPLY,
+                        ipc::kComponentDefault,
+                        kComponentID,
+                        ipc::kInputContextNone));
+  adaptor_->HandleMessageObject(
+      NewMessageForTest(MockedPluginComponent::MSG_REQUEST_SEND_WITH_REPLY,
+                        ipc::proto::Message::NEED_REPLY,
+                        ipc::kComponentDefault,
+                        kComponentID,
+                        ipc::kInputContextNone));
+  // The reply object is taken by the component without any buffer.
+  EXPECT_FALSE(recorder_.next_reply.get());
+  EXPECT_EQ(2, recorder_.object_count);
+  EXPECT_EQ(0, recorder_.serialized_count);
+  EXPECT_EQ(0, recorder_.freed_buffer_count);
+  CheckNextMessage(MockedPluginComponent::MSG_TEST_SEND_WITH_REPLY, false);
+  CheckNextMessage(MockedPluginComponent::MSG_REQUEST_SEND_WITH_REPLY, true);
+  EXPECT_TRUE(recorder_.messages.empty());
+}
+
+TEST_F(PluginComponentAdaptorTest, MismatchedMessageRuntimeTest) {
+  // An owner linked with another message runtime falls back to the
+  // serialized messages.
+  static const int kOtherRuntime = 0;
+  SetCallbacksV2(&kOtherRuntime);
+  recorder_.next_reply.reset(
+      NewMessageForTest(MockedPluginComponent::MSG_TEST_SEND_WITH_REPLY,
+                        ipc::proto::Message::IS_REPLY,
+                        ipc::kComponentDefault,
+                        kComponentID,
+                        ipc::kInputContextNone));
+  std::string buffer;
+  scoped_ptr<ipc::proto::Message> mptr(
+      NewMessageForTest(MockedPluginComponent::MSG_REQUEST_SEND_WITH_REPLY,
+                        ipc::proto::Message::NEED_REPLY,
+                        ipc::kComponentDefault,
+                        kComponentID,
+                        ipc::kInputContextNone));
+  mptr->SerializeToString(&buffer);
+  adaptor_->HandleMessage(buffer.data(), buffer.size());
+  EXPECT_FALSE(recorder_.next_reply.get());
+  EXPECT_EQ(0, recorder_.object_count);
+  EXPECT_EQ(2, recorder_.serialized_count);
+  EXPECT_EQ(1, recorder_.freed_buffer_count);
+  CheckNextMessage(MockedPluginComponent::MSG_TEST_SEND_WITH_REPLY, false);
+  CheckNextMessage(MockedPluginComponent::MSG_REQUEST_SEND_WITH_REPLY, true);
+  EXPECT_TRUE(recorder_.messages.empty());
+}
+
+TEST_F(PluginWrapperTest, RepeatedSendWithReplyTest) {
+  // The reply buffers handed to the plugin are recycled between the calls.
+  for (int i = 0; i < 3; ++i) {
+    scoped_ptr<ipc::proto::Message> mptr(
+        NewMessageForTest(MockedPluginComponent::MSG_TEST_SEND_WITH_REPLY,
+                          ipc::proto::Message::IS_REPLY,
+                          ipc::kComponentDefault,
+                          kComponentID,
+                          ipc::kInputContextNone));
+    host_->SetNextReplyMessage(mptr.release());
+    mptr.reset(
+        NewMessageForTest(MockedPluginComponent::MSG_REQUEST_SEND_WITH_REPLY,
+                          ipc::proto::Message::NEED_REPLY,
+                          ipc::kComponentDefault,
+                          kComponentID,
+                          ipc::kInputContextNone));
+    component_->Handle(mptr.release());
+    mptr.reset(host_->PopOutgoingMessage());
+    ASSERT_TRUE(mptr.get());
+    EXPECT_EQ(MockedPluginComponent::MSG_TEST_SEND_WITH_REPLY, mptr->type());
+    mptr.reset(host_->PopOutgoingMessage());
+    ASSERT_TRUE(mptr.get());
+    EXPECT_EQ(MockedPluginComponent::MSG_REQUEST_SEND_WITH_REPLY,
+              mptr->type());
+    EXPECT_EQ(ipc::proto::Message::IS_REPLY, mptr->reply_mode());
+  }
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
@@ -26,6 +26,7 @@
 #include "third_party/google_gadgets_for_linux/ggadget/common.h"
 #include "third_party/google_gadgets_for_linux/ggadget/div_element.h"
 #include "third_party/google_gadgets_for_linux/ggadget/elements.h"
+#include "third_party/google_gadgets_for_linux/ggadget/format_macros.h"
 #include "third_party/google_gadgets_for_linux/ggadget/linear_element.h"
 #include "third_party/google_gadgets_for_linux/ggadget/logger.h"
 #include "third_party/google_gadgets_for_linux/ggadget/menu_interface.h"
@@ -42,6 +43,10 @@ const char* kOrientationTypes[] = {
     "horizontal", "vertical"
 };
 
+// The maximum number of unused candidate elements kept for reusing. It's a
+// bit more than the candidates of a typical page.
+const size_t kMaxIdleCandidates = 10;
+
 }  // namespace
 
 namespace ime_goopy {
@@ -63,6 +68,14 @@ class CandidateListElement::Impl : public ggadget::SmallObject<> {
     ggadget::Variant selected_menu_down_icon;
   };
 
+  // A candidate element and the candidate style last applied to it, so that
+  // the element needn't be updated if a new candidate has the same look.
+  struct PooledCandidate {
+    CandidateElement* element;
+    ggadget::TextFormats formats;
+    bool selected;
+  };
+
   Impl(ggadget::View* view, CandidateListElement* owner);
   ~Impl();
 
@@ -79,6 +92,9 @@ class CandidateListElement::Impl : public ggadget::SmallObject<> {
       const std::string& text,
       const ggadget::TextFormats& formats);
 
+  // Creates a new candidate element at the end of the pool.
+  CandidateElement* CreateCandidate();
+
   // Called when on of the candidate is selected.
   void OnCandidateSelected(uint32_t id, bool commit);
 
@@ -101,6 +117,13 @@ class CandidateListElement::Impl : public ggadget::SmallObject<> {
   void UpdateCandidateUIStyle(
       CandidateElement* candidate_element, const Style& candidate_style);
 
+  // Applies the current style to a candidate of the pool.
+  void UpdatePooledCandidateStyle(PooledCandidate* candidate);
+
+  // Hides the candidate elements not used by any candidate, and destroys the
+  // unused ones exceeding kMaxIdleCandidates.
+  void HideIdleCandidates();
+
   // Update all candidates' UI/layout according to given UI and layout
   // relative variables.
   void UpdateCandidatesStyle();
@@ -108,6 +131,11 @@ class CandidateListElement::Impl : public ggadget::SmallObject<> {
   // Update all candidates' layout style.
   void UpdateCandidatesLayout();
 
+  // Sets the whole layout state of a candidate element according to the
+  // current orientation, alignment and text direction, so that a pooled
+  // element keeps nothing from the layout it was last used in.
+  void ResetCandidateLayout(CandidateElement* candidate, bool rtl);
+
   // Layout selection image according to selected_candidate_.
   void LayoutSelectionImage();
 
@@ -145,6 +173,17 @@ class CandidateListElement::Impl : public ggadget::SmallObject<> {
   // Current selected candidate.
   CandidateElement* selected_candidate_;
 
+  // All candidate elements in the same order as in linear_element_. The first
+  // candidate_count_ ones are used by the candidates, and the others are
+  // unused ones which will be reused by new candidates.
+  std::vector<PooledCandidate> candidates_;
+  size_t candidate_count_;
+
+  // Statistics of the candidate elements.
+  size_t created_candidates_;
+  size_t reused_candidates_;
+  size_t restyled_candidates_;
+
   // UI elements.
   ggadget::LinearElement* linear_element_;
   ggadget::DivElement* selection_image_element_;
@@ -184,6 +223,10 @@ CandidateListElement::Impl::Impl(
       vertical_padding_(0),
       orientation_(ORIENTATION_HORIZONTAL),
       selected_candidate_(NULL),
+      candidate_count_(0),
+      created_candidates_(0),
+      reused_candidates_(0),
+      restyled_candidates_(0),
       linear_element_(NULL),
       selection_image_element_(NULL),
       is_selection_image_on_top_(false),
@@ -219,6 +262,9 @@ CandidateListElement::Impl::Impl(
 }
 
 CandidateListElement::Impl::~Impl() {
+  DLOG("CandidateListElement statistics(created/reused/restyled): "
+       "%" PRIuS "/%" PRIuS "/%" PRIuS,
+       created_candidates_, reused_candidates_, restyled_candidates_);
   delete selection_image_element_;
   selection_image_element_ = NULL;
   if (on_theme_changed_connection_) {
@@ -245,29 +291,47 @@ void CandidateListElement::Impl::CalculateSize() {
 }
 
 void CandidateListElement::Impl::RemoveAllCandidates() {
-  linear_element_->GetChildren()->RemoveAllElements();
+  // The elements are kept for the next candidates, and the unused ones will
+  // be hidden before the next layout.
+  candidate_count_ = 0;
   selected_candidate_ = NULL;
+  owner_->QueueDraw();
 }
 
 CandidateElement* CandidateListElement::Impl::AppendCandidate(
     uint32_t id, const std::string& text) {
+  if (candidate_count_ == candidates_.size()) {
+    CandidateElement* candidate_element = CreateCandidate();
+    candidate_element->SetId(id);
+    candidate_element->SetText(text);
+    UpdatePooledCandidateStyle(&candidates_[candidate_count_++]);
+    return candidate_element;
+  }
+
+  // Reuses an unused element, only the changed text and style are updated so
+  // that the element isn't laid out again if it shows the same candidate.
+  PooledCandidate* candidate = &candidates_[candidate_count_++];
+  CandidateElement* candidate_element = candidate->element;
+  candidate_element->SetId(id);
+  candidate_element->SetVisible(true);
+  bool text_changed = candidate_element->GetText() != text;
+  if (text_changed)
+    candidate_element->SetText(text);
+  // Setting the text drops the formats of the element.
+  if (text_changed || candidate->selected ||
+      candidate->formats != candidate_formats_[id]) {
+    UpdatePooledCandidateStyle(candidate);
+  }
+  ++reused_candidates_;
+  return candidate_element;
+}
+
+CandidateElement* CandidateListElement::Impl::CreateCandidate() {
   CandidateElement* candidate_element =
       new CandidateElement(owner_->GetView(), "");
-  // Set candidate id and text.
-  candidate_element->SetId(id);
-  candidate_element->SetText(text);
 
   // Set candidate position and size.
-  UpdateCandidateUIStyle(candidate_element, candidate_style_);
-  candidate_element->SetVerticalAutoSizing(false);
-  if (orientation_ == ORIENTATION_VERTICAL &&
-      vertical_layout_candidate_aligned_) {
-    candidate_element->SetVerticalAutoSizing(true);
-    candidate_element->SetHorizontalAutoSizing(false);
-    candidate_element->SetRelativeWidth(1.0);
-  } else {
-    candidate_element->SetHorizontalAutoSizing(true);
-  }
+  ResetCandidateLayout(candidate_element, owner_->IsTextRTL());
 
   linear_element_->GetChildren()->AppendElement(candidate_element);
   // Hook candidate events.
@@ -276,7 +340,11 @@ CandidateElement* CandidateListElement::Impl::AppendCandidate(
   candidate_element->ConnectOnCandidateSelected(
       ggadget::NewSlot(this, &Impl::OnCandidateSelected));
 
-  candidate_element->SetRelativeHeight(1.0);
+  PooledCandidate candidate;
+  candidate.element = candidate_element;
+  candidate.selected = false;
+  candidates_.push_back(candidate);
+  ++created_candidates_;
   return candidate_element;
 }
 
@@ -284,9 +352,8 @@ CandidateElement* CandidateListElement::Impl::AppendCandidateWithFormat(
       uint32_t id,
       const std::string& text,
       const ggadget::TextFormats& formats) {
-  CandidateElement* candidate_element = AppendCandidate(id, text);
   candidate_formats_[id] = formats;
-  return candidate_element;
+  return AppendCandidate(id, text);
 }
 
 void CandidateListElement::Impl::OnCandidateSelected(uint32_t id, bool commit) {
@@ -301,12 +368,9 @@ void CandidateListElement::Impl::OnCandidateMenuEvent(
 
 CandidateElement* CandidateListElement::Impl::FindCandidateElementById(
     uint32_t id) {
-  const size_t candidate_size = linear_element_->GetChildren()->GetCount();
-  for (size_t i = 0; i < candidate_size; ++i) {
-    CandidateElement* candidate = static_cast<CandidateElement*>(
-        linear_element_->GetChildren()->GetItemByIndex(i));
-    if (candidate->GetId() == id)
-      return candidate;
+  for (size_t i = 0; i < candidate_count_; ++i) {
+    if (candidates_[i].element->GetId() == id)
+      return candidates_[i].element;
   }
   return NULL;
 }
@@ -383,14 +447,28 @@ void CandidateListElement::Impl::UpdateCandidateUIStyle(
   }
 }
 
+void CandidateListElement::Impl::UpdatePooledCandidateStyle(
+    PooledCandidate* candidate) {
+  UpdateCandidateUIStyle(candidate->element, candidate_style_);
+  candidate->formats = candidate_formats_[candidate->element->GetId()];
+  candidate->selected = candidate->element == selected_candidate_;
+  ++restyled_candidates_;
+}
+
 void CandidateListElement::Impl::UpdateCandidatesStyle() {
-  const size_t candidate_size = linear_element_->GetChildren()->GetCount();
-  for (size_t i = 0; i < candidate_size; ++i) {
-    CandidateElement* candidate_element =
-        static_cast<CandidateElement*>(
-            linear_element_->GetChildren()->GetItemByIndex(i));
-    UpdateCandidateUIStyle(candidate_element, candidate_style_);
+  // The unused elements are updated as well, so that they have the current
+  // style when reused.
+  for (size_t i = 0; i < candidates_.size(); ++i)
+    UpdatePooledCandidateStyle(&candidates_[i]);
+}
+
+void CandidateListElement::Impl::HideIdleCandidates() {
+  while (candidates_.size() > candidate_count_ + kMaxIdleCandidates) {
+    linear_element_->GetChildren()->RemoveElement(candidates_.back().element);
+    candidates_.pop_back();
   }
+  for (size_t i = candidate_count_; i < candidates_.size(); ++i)
+    candidates_[i].element->SetVisible(false);
 }
 
 void CandidateListElement::Impl::UpdateCandidatesLayout() {
@@ -398,24 +476,40 @@ void CandidateListElement::Impl::UpdateCandidatesLayout() {
   // 1. when vertical_layout_candidate_aligned_ == true, the candidate element
   //    should fill the width of candidate list element.
   // 2. when rtl == true, the candidates will align to the right.
-  const size_t children_count = linear_element_->GetChildren()->GetCount();
+  // The idle elements are updated as well, they may be reused before the next
+  // layout.
   bool rtl = owner_->IsTextRTL();
-  for (size_t i = 0; i < children_count; ++i) {
-    CandidateElement* candidate =
-        static_cast<CandidateElement*>(
-            linear_element_->GetChildren()->GetItemByIndex(i));
-    if (orientation_ == ORIENTATION_VERTICAL &&
-        vertical_layout_candidate_aligned_) {
-      candidate->SetRelativeWidth(1.0);
-      candidate->SetHorizontalAutoSizing(false);
-    } else {
-      candidate->SetHorizontalAutoSizing(true);
-    }
-    if (orientation_ == ORIENTATION_VERTICAL && rtl) {
-      // Aligned to the right.
-      candidate->SetRelativePinX(1.0);
-      candidate->SetRelativeX(1.0);
-    }
+  for (size_t i = 0; i < candidates_.size(); ++i)
+    ResetCandidateLayout(candidates_[i].element, rtl);
+}
+
+void CandidateListElement::Impl::ResetCandidateLayout(
+    CandidateElement* candidate, bool rtl) {
+  // The setters do nothing if the value doesn't change, so an element already
+  // in the right state isn't laid out again.
+  if (orientation_ == ORIENTATION_VERTICAL &&
+      vertical_layout_candidate_aligned_) {
+    candidate->SetVerticalAutoSizing(true);
+    candidate->SetHorizontalAutoSizing(false);
+    candidate->SetRelativeWidth(1.0);
+  } else {
+    candidate->SetVerticalAutoSizing(false);
+    candidate->SetHorizontalAutoSizing(true);
+    // The width is set by auto sizing, but it's still relative if the element
+    // was aligned.
+    if (candidate->WidthIsRelative())
+      candidate->SetPixelWidth(0);
+  }
+  candidate->SetRelativeHeight(1.0);
+  if (orientation_ == ORIENTATION_VERTICAL && rtl) {
+    // Aligned to the right.
+    candidate->SetRelativePinX(1.0);
+    candidate->SetRelativeX(1.0);
+  } else {
+    if (candidate->PinXIsRelative())
+      candidate->SetPixelPinX(0);
+    if (candidate->XIsRelative())
+      candidate->SetPixelX(0);
   }
 }
 
@@ -814,7 +908,12 @@ void CandidateListElement::SetSelectedCandidate(uint32_t id) {
   if (!candidate)
     return;
   impl_->selected_candidate_ = candidate;
-  impl_->UpdateCandidatesStyle();
+  // Only the previous and the new selected candidates change their look.
+  for (size_t i = 0; i < impl_->candidate_count_; ++i) {
+    Impl::PooledCandidate* pooled = &impl_->candidates_[i];
+    if (pooled->selected || pooled->element == candidate)
+      impl_->UpdatePooledCandidateStyle(pooled);
+  }
   QueueDraw();
 }
 
@@ -1054,6 +1153,7 @@ void CandidateListElement::DoClassRegister() {
 }
 
 void CandidateListElement::CalculateSize() {
+  impl_->HideIdleCandidates();
   BasicElement::CalculateSize();
   impl_->CalculateSize();
 }
@@ -1078,7 +1178,7 @@ void CandidateListElement::Layout() {
 
 void CandidateListElement::DoDraw(ggadget::CanvasInterface* canvas) {
   // Draw down selection image if should be.
-  if (impl_->linear_element_->GetChildren()->GetCount() != 0 &&
+  if (impl_->candidate_count_ != 0 &&
       impl_->selected_candidate_ && !impl_->is_selection_image_on_top_) {
     // Draw selection image with border.
     canvas->PushState();
@@ -1092,7 +1192,7 @@ void CandidateListElement::DoDraw(ggadget::CanvasInterface* canvas) {
   DrawChildren(canvas);
 
   // Draw up selection image if should be.
-  if (impl_->linear_element_->GetChildren()->GetCount() != 0 &&
+  if (impl_->candidate_count_ != 0 &&
       impl_->selected_candidate_ && impl_->is_selection_image_on_top_) {
     // Draw selection image with border.
     canvas->PushState();
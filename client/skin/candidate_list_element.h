@@ -207,7 +207,9 @@ class CandidateListElement : public ggadget::BasicElement {
       uint32_t id,
       const std::string& text,
       const ggadget::TextFormats& formats);
-  // Remove all candidates from candidate list.
+  // Remove all candidates from candidate list. The candidate elements are kept
+  // and reused by the candidates appended later, so the returned elements of
+  // AppendCandidate() should not be held across updates.
   void RemoveAllCandidates();
 
   // Connect a slot called when a candidate is clicked or right-clicked.
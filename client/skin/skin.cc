@@ -22,6 +22,7 @@
 #include "skin/toolbar_element.h"
 
 #include "third_party/google_gadgets_for_linux/ggadget/button_element.h"
+#include "third_party/google_gadgets_for_linux/ggadget/digest_utils.h"
 #include "third_party/google_gadgets_for_linux/ggadget/element_factory.h"
 #include "third_party/google_gadgets_for_linux/ggadget/event.h"
 #include "third_party/google_gadgets_for_linux/ggadget/file_manager_interface.h"
@@ -48,8 +49,12 @@
 #include "third_party/google_gadgets_for_linux/ggadget/view.h"
 #include "third_party/google_gadgets_for_linux/ggadget/view_host_interface.h"
 #include "third_party/google_gadgets_for_linux/ggadget/xml_dom.h"
+#include "third_party/google_gadgets_for_linux/ggadget/xml_dom_binary.h"
 #include "third_party/google_gadgets_for_linux/ggadget/xml_parser_interface.h"
 #include "third_party/google_gadgets_for_linux/ggadget/xml_utils.h"
+#if defined(OS_WIN)
+#include "third_party/google_gadgets_for_linux/ggadget/win32/thread_local_singleton_holder.h"
+#endif
 
 namespace ime_goopy {
 namespace skin {
@@ -176,6 +181,49 @@ const char* kSupportedImageSuffixes[] = {
 
 const char kValidationOptionsName[] = "skin-validation-options";
 
+// The version of the compiled views in the view cache. Change it whenever the
+// way the views are compiled changes, so that the stale caches are ignored.
+const char kViewCacheVersion[] = "1";
+const char kViewCacheFileSuffix[] = ".view";
+
+// The directory of the view cache, see Skin::SetViewCacheDirectory().
+struct ViewCacheDirectory {
+  explicit ViewCacheDirectory(const char* path) : path(path) {
+  }
+  std::string path;
+};
+
+#if defined(OS_WIN)
+// Like other globals of the skin library, the directory is set per thread.
+typedef ggadget::win32::ThreadLocalSingletonHolder<ViewCacheDirectory>
+    ViewCacheDirectoryHolder;
+#else
+class ViewCacheDirectoryHolder {
+ public:
+  static ViewCacheDirectory* GetValue() { return value_; }
+  static bool SetValue(ViewCacheDirectory* value) {
+    value_ = value;
+    return true;
+  }
+
+ private:
+  static ViewCacheDirectory* value_;
+};
+
+ViewCacheDirectory* ViewCacheDirectoryHolder::value_ = NULL;
+#endif
+
+std::string GetHexDigest(const std::string& input) {
+  std::string digest, result;
+  if (ggadget::GenerateSHA1(input, &digest)) {
+    for (size_t i = 0; i < digest.size(); ++i) {
+      ggadget::StringAppendPrintf(&result, "%02x",
+                                  static_cast<unsigned char>(digest[i]));
+    }
+  }
+  return result;
+}
+
 struct ViewInfo {
   InternalViewType type;
   const char* xml;
@@ -442,6 +490,15 @@ class Skin::Impl : public ggadget::ScriptableHelperNativeOwnedDefault {
       error_msg = ggadget::StringPrintf(
           GML_("IME_SKIN_LOAD_FAILURE", locale_.c_str()), base_path_.c_str());
     }
+    // The localized views depend on the strings, so the cached views are
+    // validated against them as well as the view files.
+    std::string strings;
+    for (ggadget::StringMap::const_iterator i = strings_map_.begin();
+         i != strings_map_.end(); ++i) {
+      strings.append(i->first).append(1, '\0');
+      strings.append(i->second).append(1, '\0');
+    }
+    strings_digest_ = GetHexDigest(strings);
 
     // Create a view early to allow Alert() during initialization.
     ggadget::scoped_ptr<ViewBundle> view(new ViewBundle(
@@ -537,10 +594,74 @@ class Skin::Impl : public ggadget::ScriptableHelperNativeOwnedDefault {
     return false;
   }
 
+  // Gets the path of the cached compiled view of a view file, and the digest
+  // of the view file and the localized strings, which the cached view must
+  // match. Returns false if the view cache is disabled.
+  bool GetCachedViewInfo(const std::string& xml,
+                         const char* filename,
+                         std::string* path,
+                         std::string* digest) const {
+    ViewCacheDirectory* directory = ViewCacheDirectoryHolder::GetValue();
+    if (!directory || !filename || !*filename)
+      return false;
+    // Each view of a skin and locale has one cache file, which is overwritten
+    // once the skin is changed.
+    std::string name = GetHexDigest(
+        base_path_ + '\0' + locale_ + '\0' + filename);
+    *digest = GetHexDigest(kViewCacheVersion + strings_digest_ + xml);
+    if (name.empty() || digest->empty())
+      return false;
+    name.append(kViewCacheFileSuffix);
+    *path = ggadget::BuildFilePath(directory->path.c_str(), name.c_str(), NULL);
+    return true;
+  }
+
+  // Loads the cached compiled view of a view file, which saves parsing and
+  // localizing the xml content.
+  bool LoadCachedView(const std::string& xml,
+                      const char* filename,
+                      ggadget::DOMDocumentInterface* xmldoc) const {
+    std::string path, digest, content;
+    if (!GetCachedViewInfo(xml, filename, &path, &digest) ||
+        !ggadget::ReadFileContents(path.c_str(), &content) ||
+        content.compare(0, digest.size(), digest) != 0) {
+      return false;
+    }
+    if (!ggadget::ParseBinaryIntoDOM(content.substr(digest.size()),
+                                     path.c_str(), xmldoc)) {
+      // Removes the partially loaded nodes, so that the view can be parsed
+      // into the document again.
+      while (ggadget::DOMNodeInterface* child = xmldoc->GetFirstChild()) {
+        xmldoc->RemoveChild(child);
+        delete child;
+      }
+      return false;
+    }
+    DLOG("Loaded view %s from cache %s", filename, path.c_str());
+    return true;
+  }
+
+  void SaveCachedView(const std::string& xml,
+                      const char* filename,
+                      const ggadget::DOMDocumentInterface* xmldoc) const {
+    std::string path, digest, data;
+    if (!GetCachedViewInfo(xml, filename, &path, &digest) ||
+        !ggadget::SerializeDOMToBinary(xmldoc, &data)) {
+      return;
+    }
+    ViewCacheDirectory* directory = ViewCacheDirectoryHolder::GetValue();
+    if (!ggadget::EnsureDirectories(directory->path.c_str()) ||
+        !ggadget::WriteFileContents(path.c_str(), digest + data)) {
+      LOG("Failed to write view cache %s", path.c_str());
+    }
+  }
+
   Skin* owner_;
 
   ggadget::StringMap manifest_info_map_;
   ggadget::StringMap strings_map_;
+  // The digest of |strings_map_|.
+  std::string strings_digest_;
 
   std::string base_path_;
   std::string locale_;
@@ -611,9 +732,15 @@ std::string Skin::GetManifestInfo(const char* key) const {
 bool Skin::ParseLocalizedXML(const std::string& xml,
                              const char* filename,
                              ggadget::DOMDocumentInterface* xmldoc) const {
-  return ggadget::GetXMLParser()->ParseContentIntoDOM(
+  if (impl_->LoadCachedView(xml, filename, xmldoc))
+    return true;
+  if (!ggadget::GetXMLParser()->ParseContentIntoDOM(
       xml, &impl_->strings_map_, filename, NULL, NULL,
-      ggadget::kEncodingFallback, xmldoc, NULL, NULL);
+      ggadget::kEncodingFallback, xmldoc, NULL, NULL)) {
+    return false;
+  }
+  impl_->SaveCachedView(xml, filename, xmldoc);
+  return true;
 }
 
 ggadget::View* Skin::GetMainView() const {
@@ -854,6 +981,13 @@ bool Skin::GetSkinManifestForLocale(const char* base_path,
       kImeSkinManifest, kImeSkinTag, base_path, locale, data);
 }
 
+// static
+void Skin::SetViewCacheDirectory(const char* directory) {
+  delete ViewCacheDirectoryHolder::GetValue();
+  ViewCacheDirectoryHolder::SetValue(
+      directory && *directory ? new ViewCacheDirectory(directory) : NULL);
+}
+
 // static
 ggadget::FileManagerInterface* Skin::GetSkinFileManagerForLocale(
     const char* base_path,
@@ -43,6 +43,27 @@
       ],
     },
   ],
+  'conditions': [
+    ['OS=="linux"', {
+      'targets': [
+        {
+          # Renders the views of a skin into image surfaces and reports the
+          # cost of the frames, see skin_benchmark.cc.
+          'target_name': 'skin_benchmark',
+          'type': 'executable',
+          'dependencies': [
+            'skin',
+            '<(DEPTH)/base/base.gyp:base',
+            '<(DEPTH)/third_party/google_gadgets_for_linux/ggadget.gyp:extensions',
+            '<(DEPTH)/third_party/google_gadgets_for_linux/ggadget.gyp:ggadget_gtk',
+          ],
+          'sources': [
+            'skin_benchmark.cc',
+          ],
+        },
+      ],
+    }],
+  ],
   # We don't add unit tests for .cc files in this directory since it's
   # over-complicated to create and initialize a skin ui element, and it's more
   # intuitive to test these code by running real cases.
@@ -199,6 +199,14 @@ class Skin : public ggadget::GadgetBase {
                                        const char* locale,
                                        ggadget::StringMap* data);
 
+  // Sets the directory to cache the compiled views of skins in, so that the
+  // views needn't be parsed and localized again the next time a skin is
+  // loaded. A cached view is used only if the view file and the localized
+  // strings are unchanged. Like other globals of the skin library, the
+  // directory is set per thread on Windows. Passing NULL or an empty string
+  // disables the cache.
+  static void SetViewCacheDirectory(const char* directory);
+
   // A utility to get an FileManagerInterface of an input method skin without
   // constructing an Skin object. If |*locale| is NULL or empty, then the
   // system locale will be used.
@@ -0,0 +1,752 @@
+/*
+  Copyright 2014 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// A benchmark of rendering the views of a skin, which doesn't need a display
+// server. It loads a skin package, updates the composing and toolbar views in
+// scripted scenarios the way the UI component does on keystrokes, and renders
+// the views into cairo image surfaces the way the window of a view host does.
+// The average cost of a frame is reported in these phases:
+//   layout:    View::Layout(), without the text shaping.
+//   shaping:   shaping the texts which aren't in the pango layout cache.
+//   draw:      View::Draw() into the buffer of the view, without the text
+//              shaping.
+//   composite: copying the buffer to the window surface.
+// together with the number of laid out elements and the allocations.
+//
+// Usage:
+//   skin_benchmark --skin=<skin package> --resources=<skin_resources.dat>
+//       [--frames=200] [--candidates=9] [--scenarios=typing,selection]
+//       [--max_frame_time=<milliseconds>]
+// If --max_frame_time is given, the benchmark fails when the average frame
+// time of any scenario exceeds it, so that it can be used as a regression gate
+// for UI latency.
+
+#include <sys/time.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "base/commandlineflags.h"
+#include "base/scoped_ptr.h"
+#include "skin/candidate_list_element.h"
+#include "skin/composition_element.h"
+#include "skin/skin.h"
+#include "skin/skin_consts.h"
+#include "skin/skin_host.h"
+#include "skin/toolbar_element.h"
+#include "third_party/google_gadgets_for_linux/extensions/extensions.h"
+#include "third_party/google_gadgets_for_linux/ggadget/button_element.h"
+#include "third_party/google_gadgets_for_linux/ggadget/canvas_interface.h"
+#include "third_party/google_gadgets_for_linux/ggadget/clip_region.h"
+#include "third_party/google_gadgets_for_linux/ggadget/file_manager_factory.h"
+#include "third_party/google_gadgets_for_linux/ggadget/file_manager_wrapper.h"
+#include "third_party/google_gadgets_for_linux/ggadget/gadget_consts.h"
+#include "third_party/google_gadgets_for_linux/ggadget/graphics_interface.h"
+#include "third_party/google_gadgets_for_linux/ggadget/gtk/cairo_graphics.h"
+#include "third_party/google_gadgets_for_linux/ggadget/gtk/pango_layout_cache.h"
+#include "third_party/google_gadgets_for_linux/ggadget/gtk/utilities.h"
+#include "third_party/google_gadgets_for_linux/ggadget/localized_file_manager.h"
+#include "third_party/google_gadgets_for_linux/ggadget/main_loop_interface.h"
+#include "third_party/google_gadgets_for_linux/ggadget/memory_options.h"
+#include "third_party/google_gadgets_for_linux/ggadget/options_interface.h"
+#include "third_party/google_gadgets_for_linux/ggadget/small_object.h"
+#include "third_party/google_gadgets_for_linux/ggadget/string_utils.h"
+#include "third_party/google_gadgets_for_linux/ggadget/text_formats.h"
+#include "third_party/google_gadgets_for_linux/ggadget/view.h"
+#include "third_party/google_gadgets_for_linux/ggadget/view_host_interface.h"
+
+DEFINE_string(skin, "", "The path of the skin package to render.");
+DEFINE_string(resources, "", "The path of the global skin resources.");
+DEFINE_int32(frames, 200, "The number of frames rendered in each scenario.");
+DEFINE_int32(candidates, 9, "The number of candidates in a page.");
+DEFINE_string(scenarios, "",
+              "Comma separated names of the scenarios to run, or empty to "
+              "run all the scenarios.");
+DEFINE_double(max_frame_time, 0,
+              "If positive, fails when the average frame time in "
+              "milliseconds of any scenario exceeds it.");
+
+// Counts the allocations of the whole program by operator new. The small
+// objects have their own allocator, which is counted separately.
+static size_t g_allocation_count = 0;
+static size_t g_allocated_bytes = 0;
+
+void* operator new(size_t size) {
+  ++g_allocation_count;
+  g_allocated_bytes += size;
+  void* p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* p) throw() {
+  free(p);
+}
+
+void operator delete[](void* p) throw() {
+  free(p);
+}
+
+namespace ime_goopy {
+namespace skin {
+namespace {
+
+using ggadget::gtk::PangoLayoutCache;
+
+uint64_t GetMicroseconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// The sums of the costs of the rendered frames.
+struct FrameStatistics {
+  FrameStatistics()
+      : frames(0), layout_time(0), shaping_time(0), draw_time(0),
+        composite_time(0), laid_out_elements(0), allocations(0),
+        allocated_bytes(0), small_allocations(0) {
+  }
+
+  int frames;
+  uint64_t layout_time;
+  uint64_t shaping_time;
+  uint64_t draw_time;
+  uint64_t composite_time;
+  uint64_t laid_out_elements;
+  uint64_t allocations;
+  uint64_t allocated_bytes;
+  uint64_t small_allocations;
+};
+
+size_t GetSmallAllocationCount() {
+  ggadget::SmallObjAllocator::Statistics statistics;
+  ggadget::AllocatorSingleton<>::Instance().GetStatistics(&statistics);
+  return statistics.allocations;
+}
+
+// A main loop which never runs the watches, because the benchmark renders the
+// frames by itself. The animations of the views are not run either.
+class IdleMainLoop : public ggadget::MainLoopInterface {
+ public:
+  IdleMainLoop() : next_watch_id_(1) {
+  }
+
+  virtual ~IdleMainLoop() {
+    while (!watches_.empty())
+      RemoveWatch(watches_.begin()->first);
+  }
+
+  virtual int AddIOReadWatch(int fd,
+                             ggadget::WatchCallbackInterface* callback) {
+    return AddWatch(IO_READ_WATCH, fd, callback);
+  }
+
+  virtual int AddIOWriteWatch(int fd,
+                              ggadget::WatchCallbackInterface* callback) {
+    return AddWatch(IO_WRITE_WATCH, fd, callback);
+  }
+
+  virtual int AddTimeoutWatch(int interval,
+                              ggadget::WatchCallbackInterface* callback) {
+    return AddWatch(TIMEOUT_WATCH, interval, callback);
+  }
+
+  virtual WatchType GetWatchType(int watch_id) {
+    WatchMap::const_iterator it = watches_.find(watch_id);
+    return it == watches_.end() ? INVALID_WATCH : it->second.type;
+  }
+
+  virtual int GetWatchData(int watch_id) {
+    WatchMap::const_iterator it = watches_.find(watch_id);
+    return it == watches_.end() ? -1 : it->second.data;
+  }
+
+  virtual void RemoveWatch(int watch_id) {
+    WatchMap::iterator it = watches_.find(watch_id);
+    if (it == watches_.end())
+      return;
+    ggadget::WatchCallbackInterface* callback = it->second.callback;
+    watches_.erase(it);
+    callback->OnRemove(this, watch_id);
+  }
+
+  virtual void Run() { }
+  virtual bool DoIteration(bool may_block) { return false; }
+  virtual void Quit() { }
+  virtual bool IsRunning() const { return false; }
+  virtual uint64_t GetCurrentTime() const { return GetMicroseconds() / 1000; }
+  virtual bool IsMainThread() const { return true; }
+  virtual void WakeUp() { }
+
+ private:
+  struct Watch {
+    WatchType type;
+    int data;
+    ggadget::WatchCallbackInterface* callback;
+  };
+  typedef std::map<int, Watch> WatchMap;
+
+  int AddWatch(WatchType type, int data,
+               ggadget::WatchCallbackInterface* callback) {
+    if (!callback)
+      return -1;
+    Watch watch = { type, data, callback };
+    watches_[next_watch_id_] = watch;
+    return next_watch_id_++;
+  }
+
+  WatchMap watches_;
+  int next_watch_id_;
+
+  DISALLOW_COPY_AND_ASSIGN(IdleMainLoop);
+};
+
+// A view host which renders its view into cairo image surfaces like the
+// window of SingleViewHost does: the view is drawn without canvas cache into a
+// buffer canvas within its clip region, and then the buffer is composited to
+// the window canvas.
+class OffscreenViewHost : public ggadget::ViewHostInterface {
+ public:
+  explicit OffscreenViewHost(Type type)
+      : type_(type),
+        view_(NULL),
+        buffer_(NULL),
+        window_(NULL),
+        draw_queued_(false),
+        shown_(false) {
+  }
+
+  virtual ~OffscreenViewHost() {
+    DestroyCanvases();
+  }
+
+  // Renders a frame of the view if it's shown, and adds the costs to
+  // |statistics|. Returns false if nothing was rendered.
+  bool Render(FrameStatistics* statistics) {
+    ggadget::View* view = ggadget::down_cast<ggadget::View*>(view_);
+    if (!view || !shown_)
+      return false;
+    PangoLayoutCache* layout_cache = PangoLayoutCache::GetDefault();
+
+    uint64_t shaping_start = layout_cache->GetShapingTime();
+    uint64_t start = GetMicroseconds();
+    view->Layout();
+    int laid_out_elements = view->GetLayoutCount();
+    if (AdjustToViewSize()) {
+      // Lays out the view again in the new size, and redraws all of it.
+      view->MarkRedraw();
+      view->Layout();
+      laid_out_elements += view->GetLayoutCount();
+    }
+    uint64_t layout_end = GetMicroseconds();
+    uint64_t layout_shaping = layout_cache->GetShapingTime() - shaping_start;
+    statistics->laid_out_elements += laid_out_elements;
+
+    if (!draw_queued_ || !buffer_) {
+      statistics->layout_time += layout_end - start - layout_shaping;
+      statistics->shaping_time += layout_shaping;
+      return false;
+    }
+    draw_queued_ = false;
+
+    buffer_->PushState();
+    buffer_->IntersectGeneralClipRegion(*view->GetClipRegion());
+    buffer_->ClearRect(0, 0, buffer_->GetWidth(), buffer_->GetHeight());
+    view->Draw(buffer_);
+    buffer_->PopState();
+    uint64_t draw_end = GetMicroseconds();
+    uint64_t draw_shaping =
+        layout_cache->GetShapingTime() - shaping_start - layout_shaping;
+
+    window_->ClearCanvas();
+    window_->DrawCanvas(0, 0, buffer_);
+    uint64_t composite_end = GetMicroseconds();
+
+    statistics->layout_time += layout_end - start - layout_shaping;
+    statistics->shaping_time += layout_shaping + draw_shaping;
+    statistics->draw_time += draw_end - layout_end - draw_shaping;
+    statistics->composite_time += composite_end - draw_end;
+    return true;
+  }
+
+  virtual Type GetType() const { return type_; }
+  virtual void Destroy() { delete this; }
+  virtual void SetView(ggadget::ViewInterface* view) {
+    DestroyCanvases();
+    view_ = view;
+    if (view)
+      ggadget::down_cast<ggadget::View*>(view)->EnableCanvasCache(false);
+  }
+  virtual ggadget::ViewInterface* GetView() const { return view_; }
+  virtual ggadget::GraphicsInterface* NewGraphics() const {
+    return new ggadget::gtk::CairoGraphics(1.0);
+  }
+  virtual void* GetNativeWidget() const { return NULL; }
+  virtual void ViewCoordToNativeWidgetCoord(double, double,
+                                            double*, double*) const { }
+  virtual void NativeWidgetCoordToViewCoord(double, double,
+                                            double*, double*) const { }
+  virtual void QueueDraw() { draw_queued_ = true; }
+  virtual void QueueResize() { draw_queued_ = true; }
+  virtual void EnableInputShapeMask(bool) { }
+  virtual void SetResizable(ggadget::ViewInterface::ResizableMode) { }
+  virtual void SetCaption(const std::string&) { }
+  virtual void SetShowCaptionAlways(bool) { }
+  virtual void SetCursor(ggadget::ViewInterface::CursorType) { }
+  virtual void ShowTooltip(const std::string&) { }
+  virtual void ShowTooltipAtPosition(const std::string&, double, double) { }
+  virtual bool ShowView(bool, int, ggadget::Slot1<bool, int>* handler) {
+    delete handler;
+    shown_ = true;
+    draw_queued_ = true;
+    return true;
+  }
+  virtual void CloseView() { shown_ = false; }
+  virtual bool ShowContextMenu(int) { return false; }
+  virtual void Alert(const ggadget::ViewInterface*, const char*) { }
+  virtual ConfirmResponse Confirm(const ggadget::ViewInterface*,
+                                  const char*, bool) {
+    return CONFIRM_NO;
+  }
+  virtual std::string Prompt(const ggadget::ViewInterface*,
+                             const char*, const char*) {
+    return std::string();
+  }
+  virtual int GetDebugMode() const {
+    return ggadget::ViewInterface::DEBUG_DISABLED;
+  }
+  virtual void SetWindowPosition(int x, int y) { }
+  virtual void GetWindowPosition(int* x, int* y) { *x = *y = 0; }
+  virtual void GetWindowSize(int* width, int* height) {
+    *width = window_ ? static_cast<int>(window_->GetWidth()) : 0;
+    *height = window_ ? static_cast<int>(window_->GetHeight()) : 0;
+  }
+  virtual void SetFocusable(bool focusable) { }
+  virtual void SetOpacity(double opacity) { }
+  virtual void SetFontScale(double scale) { }
+  virtual void SetZoom(double zoom) { }
+  virtual ggadget::Connection* ConnectOnEndMoveDrag(
+      ggadget::Slot2<void, int, int>* handler) {
+    delete handler;
+    return NULL;
+  }
+  virtual ggadget::Connection* ConnectOnShowContextMenu(
+      ggadget::Slot1<bool, ggadget::MenuInterface*>* handler) {
+    delete handler;
+    return NULL;
+  }
+  virtual void BeginResizeDrag(int, ggadget::ViewInterface::HitTest) { }
+  virtual void BeginMoveDrag(int) { }
+
+ private:
+  // Recreates the canvases if the size of the view has changed. Returns true
+  // if the canvases are recreated.
+  bool AdjustToViewSize() {
+    double width = view_->GetWidth();
+    double height = view_->GetHeight();
+    if (buffer_ && buffer_->GetWidth() == width &&
+        buffer_->GetHeight() == height)
+      return false;
+    DestroyCanvases();
+    if (width <= 0 || height <= 0)
+      return false;
+    ggadget::GraphicsInterface* graphics = view_->GetGraphics();
+    buffer_ = graphics->NewCanvas(width, height);
+    window_ = graphics->NewCanvas(width, height);
+    draw_queued_ = true;
+    return true;
+  }
+
+  void DestroyCanvases() {
+    if (buffer_)
+      buffer_->Destroy();
+    if (window_)
+      window_->Destroy();
+    buffer_ = NULL;
+    window_ = NULL;
+  }
+
+  Type type_;
+  ggadget::ViewInterface* view_;
+  ggadget::CanvasInterface* buffer_;
+  ggadget::CanvasInterface* window_;
+  bool draw_queued_;
+  bool shown_;
+
+  DISALLOW_COPY_AND_ASSIGN(OffscreenViewHost);
+};
+
+class OffscreenSkinHost : public SkinHost {
+ public:
+  OffscreenSkinHost() {
+  }
+
+  virtual ggadget::ViewHostInterface* NewViewHost(
+      ggadget::GadgetInterface* gadget,
+      ggadget::ViewHostInterface::Type type) {
+    OffscreenViewHost* view_host = new OffscreenViewHost(type);
+    view_hosts_.push_back(view_host);
+    return view_host;
+  }
+
+  virtual bool LoadFont(const char* filename) {
+    return ggadget::gtk::LoadFont(filename);
+  }
+
+  virtual bool OpenURL(const ggadget::GadgetInterface* gadget,
+                       const char* url) {
+    return false;
+  }
+
+  // Renders a frame of all the shown views.
+  void Render(FrameStatistics* statistics) {
+    for (size_t i = 0; i < view_hosts_.size(); ++i)
+      view_hosts_[i]->Render(statistics);
+  }
+
+  // Forgets the view hosts, which are destroyed with the views of a skin.
+  void Reset() {
+    view_hosts_.clear();
+  }
+
+ private:
+  std::vector<OffscreenViewHost*> view_hosts_;
+
+  DISALLOW_COPY_AND_ASSIGN(OffscreenSkinHost);
+};
+
+// The texts of the candidates and the compositions. Candidate i of page p is
+// the ((p * page size + i) % size)th text.
+const char* const kCandidateTexts[] = {
+  "\xE4\xB8\xAD\xE6\x96\x87",  // Chinese words.
+  "\xE8\xBE\x93\xE5\x85\xA5\xE6\xB3\x95",
+  "\xE8\xB0\xB7\xE6\xAD\x8C",
+  "\xE6\x8B\xBC\xE9\x9F\xB3\xE8\xBE\x93\xE5\x85\xA5",
+  "\xE5\x80\x99\xE9\x80\x89\xE8\xAF\x8D",
+  "\xE7\x95\x8C\xE9\x9D\xA2",
+  "\xE9\x94\xAE\xE7\x9B\x98",
+  "\xE6\xB5\x8B\xE8\xAF\x95\xE6\x96\x87\xE6\x9C\xAC",
+  "\xE4\xB8\xAD",
+  "\xE7\xA7\x8D",
+  "\xE9\x87\x8D",
+  "\xE4\xBC\x97",
+  "Google",  // Latin words.
+  "input",
+  "tools",
+  "candidate",
+};
+
+const char* const kRTLCandidateTexts[] = {
+  "\xD9\x85\xD8\xB1\xD8\xAD\xD8\xA8\xD8\xA7",  // Arabic words.
+  "\xD9\x84\xD9\x88\xD8\xAD\xD8\xA9",
+  "\xD8\xA7\xD9\x84\xD9\x85\xD9\x81\xD8\xA7\xD8\xAA\xD9\x8A\xD8\xAD",
+  "\xD9\x83\xD8\xAA\xD8\xA7\xD8\xA8\xD8\xA9",
+  "\xD8\xB9\xD8\xB1\xD8\xA8\xD9\x8A",
+  "\xD9\x86\xD8\xB5",
+  "\xD8\xA8\xD8\xAD\xD8\xAB",
+  "Google",
+};
+
+const char kComposition[] = "zhongwenshurufaceshi";
+const char kRTLComposition[] =
+    "\xD9\x85\xD8\xB1\xD8\xAD\xD8\xA8\xD8\xA7\xD8\xA8\xD9\x83\xD9\x85";
+
+// The number of pages a page flipping scenario flips through.
+const int kPageCount = 4;
+
+struct Scenario;
+
+// Updates the views of a skin for a frame.
+typedef void (*UpdateFunction)(const Scenario& scenario, Skin* skin,
+                               int frame);
+
+struct Scenario {
+  const char* name;
+  const char* description;
+  bool vertical_candidate_layout;
+  bool right_to_left_layout;
+  UpdateFunction update;
+};
+
+CandidateListElement* GetCandidateListElement(Skin* skin) {
+  return skin->GetElementByNameAndType<CandidateListElement>(
+      Skin::COMPOSING_VIEW, kCandidateListElement);
+}
+
+CompositionElement* GetCompositionElement(Skin* skin) {
+  return skin->GetElementByNameAndType<CompositionElement>(
+      Skin::COMPOSING_VIEW, kCompositionElement);
+}
+
+// Sets the composition to the first |length| bytes of the composition text.
+void SetComposition(const Scenario& scenario, Skin* skin, int length) {
+  CompositionElement* element = GetCompositionElement(skin);
+  if (!element)
+    return;
+  std::string text(scenario.right_to_left_layout ? kRTLComposition :
+                   kComposition);
+  // Doesn't break the UTF-8 characters of the RTL composition.
+  if (scenario.right_to_left_layout)
+    length &= ~1;
+  text.resize(std::min(text.size(), static_cast<size_t>(length)));
+  element->Clear();
+  element->SetCompositionText(text);
+  element->SetCompositionFormats(ggadget::TextFormats());
+  element->SetCompositionStatus(0, static_cast<int>(text.size()),
+                                CompositionElement::ACTIVE);
+  element->SetCaretPosition(static_cast<int>(text.size()));
+  element->UpdateUI();
+}
+
+// Sets the |page|th page of candidates.
+void SetCandidates(const Scenario& scenario, Skin* skin, int page,
+                   int selected) {
+  CandidateListElement* element = GetCandidateListElement(skin);
+  if (!element)
+    return;
+  const char* const* texts = kCandidateTexts;
+  int text_count = static_cast<int>(arraysize(kCandidateTexts));
+  if (scenario.right_to_left_layout) {
+    texts = kRTLCandidateTexts;
+    text_count = static_cast<int>(arraysize(kRTLCandidateTexts));
+  }
+  element->RemoveAllCandidates();
+  for (int i = 0; i < FLAGS_candidates; ++i) {
+    std::string text = ggadget::StringPrintf(
+        "%d. %s", i + 1, texts[(page * FLAGS_candidates + i) % text_count]);
+    element->AppendCandidateWithFormat(i, text, ggadget::TextFormats());
+  }
+  element->SetVisible(true);
+  element->SetSelectedCandidate(selected);
+
+  ggadget::ButtonElement* page_up =
+      skin->GetElementByNameAndType<ggadget::ButtonElement>(
+          Skin::COMPOSING_VIEW, kCandidateListPageUpButton);
+  if (page_up)
+    page_up->SetEnabled(page > 0);
+  ggadget::ButtonElement* page_down =
+      skin->GetElementByNameAndType<ggadget::ButtonElement>(
+          Skin::COMPOSING_VIEW, kCandidateListPageDownButton);
+  if (page_down)
+    page_down->SetEnabled(true);
+}
+
+// Types a syllable per frame: the composition grows and the candidates change
+// on every keystroke.
+void UpdateTyping(const Scenario& scenario, Skin* skin, int frame) {
+  SetComposition(scenario, skin, frame % 16 + 1);
+  SetCandidates(scenario, skin, frame, 0);
+}
+
+// Flips through a few pages of candidates.
+void UpdatePageFlip(const Scenario& scenario, Skin* skin, int frame) {
+  if (frame == 0)
+    SetComposition(scenario, skin, 16);
+  SetCandidates(scenario, skin, frame % kPageCount, 0);
+}
+
+// Moves the selection through the candidates of a page.
+void UpdateSelection(const Scenario& scenario, Skin* skin, int frame) {
+  if (frame == 0) {
+    SetComposition(scenario, skin, 16);
+    SetCandidates(scenario, skin, 0, 0);
+    return;
+  }
+  CandidateListElement* element = GetCandidateListElement(skin);
+  if (element)
+    element->SetSelectedCandidate(frame % FLAGS_candidates);
+}
+
+// Toggles the Chinese/English mode button of the toolbar.
+void UpdateToolbar(const Scenario& scenario, Skin* skin, int frame) {
+  if (frame == 0) {
+    ToolbarElement* toolbar = skin->GetElementByNameAndType<ToolbarElement>(
+        Skin::TOOLBAR_VIEW, kToolbarElement);
+    if (toolbar) {
+      toolbar->AddButton(kChineseEnglishModeButton,
+                         ggadget::LinearElement::LAYOUT_FORWARD,
+                         ToolbarElement::ALWAYS_VISIBLE);
+    }
+  }
+  if (frame % 2) {
+    skin->SetNamedButtonImagesByNames(
+        Skin::TOOLBAR_VIEW, kChineseEnglishModeButton, kEnglishModeIcon,
+        kEnglishModeDownIcon, kEnglishModeOverIcon,
+        kEnglishModeDisabledIcon);
+  } else {
+    skin->SetNamedButtonImagesByNames(
+        Skin::TOOLBAR_VIEW, kChineseEnglishModeButton, kChineseModeIcon,
+        kChineseModeDownIcon, kChineseModeOverIcon,
+        kChineseModeDisabledIcon);
+  }
+}
+
+const Scenario kScenarios[] = {
+  { "typing", "composition and candidates change on each keystroke",
+    false, false, UpdateTyping },
+  { "page_flip", "flipping through pages of candidates",
+    false, false, UpdatePageFlip },
+  { "selection", "moving the selection in a page",
+    false, false, UpdateSelection },
+  { "vertical", "typing with vertical candidate layout",
+    true, false, UpdateTyping },
+  { "rtl", "typing with right to left layout",
+    false, true, UpdateTyping },
+  { "rtl_selection", "moving the selection with right to left layout",
+    false, true, UpdateSelection },
+  { "toolbar", "toggling the mode button of the toolbar",
+    false, false, UpdateToolbar },
+};
+
+bool IsScenarioEnabled(const char* name) {
+  if (FLAGS_scenarios.empty())
+    return true;
+  std::string scenarios = "," + FLAGS_scenarios + ",";
+  return scenarios.find(std::string(",") + name + ",") != std::string::npos;
+}
+
+// Runs a scenario, and returns the average frame time in milliseconds, or a
+// negative value if the skin can't be loaded.
+double RunScenario(const Scenario& scenario, OffscreenSkinHost* host) {
+  scoped_ptr<Skin> skin(host->LoadSkin(FLAGS_skin.c_str(), "skin-benchmark",
+                                       NULL, 0, false,
+                                       scenario.vertical_candidate_layout,
+                                       scenario.right_to_left_layout));
+  if (!skin.get() || !skin->IsValid()) {
+    fprintf(stderr, "Failed to load skin: %s\n", FLAGS_skin.c_str());
+    return -1;
+  }
+  skin->ShowMainView();
+  skin->ShowComposingView();
+
+  // The first frame renders the views in the initial state, which isn't
+  // counted. Each scenario starts with an empty layout cache.
+  FrameStatistics ignored;
+  host->Render(&ignored);
+  PangoLayoutCache::GetDefault()->Clear();
+
+  FrameStatistics statistics;
+  size_t allocations = g_allocation_count;
+  size_t allocated_bytes = g_allocated_bytes;
+  size_t small_allocations = GetSmallAllocationCount();
+  for (int frame = 0; frame < FLAGS_frames; ++frame) {
+    scenario.update(scenario, skin.get(), frame);
+    host->Render(&statistics);
+  }
+  statistics.frames = FLAGS_frames;
+  statistics.allocations = g_allocation_count - allocations;
+  statistics.allocated_bytes = g_allocated_bytes - allocated_bytes;
+  statistics.small_allocations = GetSmallAllocationCount() - small_allocations;
+
+  skin->CloseAllViews();
+  skin.reset();
+  host->Reset();
+
+  double frames = statistics.frames;
+  double layout = statistics.layout_time / frames / 1000;
+  double shaping = statistics.shaping_time / frames / 1000;
+  double draw = statistics.draw_time / frames / 1000;
+  double composite = statistics.composite_time / frames / 1000;
+  double total = layout + shaping + draw + composite;
+  printf("%-14s %9.3f %9.3f %9.3f %9.3f %9.3f %9.1f %9.1f %9.0f %9.1f\n",
+         scenario.name, total, layout, shaping, draw, composite,
+         statistics.laid_out_elements / frames,
+         statistics.allocations / frames,
+         statistics.allocated_bytes / frames,
+         statistics.small_allocations / frames);
+  return total;
+}
+
+ggadget::OptionsInterface* CreateMemoryOptions(const char* name) {
+  return new ggadget::MemoryOptions;
+}
+
+bool Initialize() {
+  ggadget::SetGlobalMainLoop(new IdleMainLoop);
+  ggadget::SetOptionsFactory(CreateMemoryOptions);
+  if (!ggadget::extensions::Initialize()) {
+    fprintf(stderr, "Failed to initialize the XML parser.\n");
+    return false;
+  }
+
+  ggadget::FileManagerWrapper* file_manager = new ggadget::FileManagerWrapper;
+  ggadget::SetGlobalFileManager(file_manager);
+  ggadget::FileManagerInterface* resources =
+      ggadget::CreateFileManager(FLAGS_resources.c_str());
+  if (!resources) {
+    fprintf(stderr, "Failed to load resources: %s\n",
+            FLAGS_resources.c_str());
+    return false;
+  }
+  ggadget::FileManagerInterface* localized_resources =
+      new ggadget::LocalizedFileManager(resources);
+  if (!file_manager->RegisterFileManager(ggadget::kGlobalResourcePrefix,
+                                         localized_resources)) {
+    delete localized_resources;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+}  // namespace skin
+}  // namespace ime_goopy
+
+int main(int argc, char** argv) {
+  using ime_goopy::skin::kScenarios;
+  ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_skin.empty() || FLAGS_resources.empty() || FLAGS_frames <= 0 ||
+      FLAGS_candidates <= 0) {
+    fprintf(stderr, "Usage: %s --skin=<skin package> "
+            "--resources=<skin resources> [--frames=N] [--candidates=N] "
+            "[--scenarios=a,b] [--max_frame_time=ms]\n", argv[0]);
+    return 2;
+  }
+  if (!ime_goopy::skin::Initialize())
+    return 2;
+
+  printf("Average per frame of %d frames, %d candidates. Times are in "
+         "milliseconds.\n", FLAGS_frames, FLAGS_candidates);
+  printf("%-14s %9s %9s %9s %9s %9s %9s %9s %9s %9s\n", "scenario", "total",
+         "layout", "shaping", "draw", "composite", "elements", "news",
+         "bytes", "smallobjs");
+  ime_goopy::skin::OffscreenSkinHost host;
+  int result = 0;
+  for (size_t i = 0; i < arraysize(kScenarios); ++i) {
+    if (!ime_goopy::skin::IsScenarioEnabled(kScenarios[i].name))
+      continue;
+    double frame_time = ime_goopy::skin::RunScenario(kScenarios[i], &host);
+    if (frame_time < 0) {
+      result = 2;
+    } else if (FLAGS_max_frame_time > 0 && frame_time > FLAGS_max_frame_time) {
+      fprintf(stderr, "%s: average frame time %.3fms exceeds %.3fms (%s).\n",
+              kScenarios[i].name, frame_time, FLAGS_max_frame_time,
+              kScenarios[i].description);
+      result = 1;
+    }
+  }
+  return result;
+}
@@ -27,6 +27,8 @@ const char kSkinResourcesFileName[] = SKIN_RESOURCES_FILE;
 const char kSkinResourcesFileName[] = "skin_resources.dat";
 #endif
 
+const char kSkinViewCacheFolderName[] = "skin_cache";
+
 const char kDefaultImageSuffix[] = ".png";
 
 const char kImeSkinAPIVersion[] = "1.0.0.0";
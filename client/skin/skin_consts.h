@@ -25,6 +25,10 @@ namespace skin {
 // Skin resources file name.
 extern const char kSkinResourcesFileName[];
 
+// The name of the folder in the user data folder to cache compiled views of
+// skins.
+extern const char kSkinViewCacheFolderName[];
+
 // We use ".png" image files by default.
 extern const char kDefaultImageSuffix[];
 
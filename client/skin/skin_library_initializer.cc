@@ -22,6 +22,7 @@
 #include "base/logging.h"
 #include "base/string_utils_win.h"
 #include "common/app_utils.h"
+#include "skin/skin.h"
 #include "skin/skin_consts.h"
 #pragma push_macro("DLOG")
 #pragma push_macro("LOG")
@@ -210,6 +211,13 @@ bool SkinLibraryInitializer::Initialize() {
   if (!xml_parser) return false;
   ggadget::SetXMLParser(xml_parser);
 
+  std::wstring view_cache_folder = AppUtils::GetUserDataFilePath(
+      ime_goopy::Utf8ToWide(kSkinViewCacheFolderName));
+  if (!view_cache_folder.empty()) {
+    Skin::SetViewCacheDirectory(
+        ime_goopy::WideToUtf8(view_cache_folder).c_str());
+  }
+
   // Test if options factory is set by creating an option.
   ggadget::OptionsInterface* test_option = ggadget::CreateOptions("");
   if (!test_option)
@@ -242,6 +250,7 @@ void SkinLibraryInitializer::Finalize() {
   ggadget::SetGlobalFileManager(NULL);
   ggadget::SetGlobalMainLoop(NULL);
   ggadget::SetXMLParser(NULL);
+  Skin::SetViewCacheDirectory(NULL);
   // finalize logger
   DCHECK(data->log_listener_connection);
   if (data->log_listener_connection) {
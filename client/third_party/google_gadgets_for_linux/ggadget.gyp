@@ -181,6 +181,8 @@
         'ggadget/view_interface.h',
         'ggadget/xml_dom.cc',
         'ggadget/xml_dom.h',
+        'ggadget/xml_dom_binary.cc',
+        'ggadget/xml_dom_binary.h',
         'ggadget/xml_dom_interface.h',
         'ggadget/xml_http_request_factory.cc',
         'ggadget/xml_http_request_interface.h',
@@ -374,6 +376,61 @@
         },
       ],  # targets
     },],  # OS != win
+    ['OS=="linux"', {
+      'targets' : [
+        {
+          # The cairo graphics of ggadget, which can draw views into image
+          # surfaces without a display, e.g. for skin_benchmark.
+          'target_name': 'ggadget_gtk',
+          'type': '<(library)',
+          'dependencies': [
+            'ggadget',
+            'ggadget_sysdeps_header',
+          ],
+          'defines': [
+            'XDG_PREFIX=_ggl_xdg',
+          ],
+          'sources': [
+            'ggadget/gtk/cairo_canvas.cc',
+            'ggadget/gtk/cairo_canvas.h',
+            'ggadget/gtk/cairo_font.cc',
+            'ggadget/gtk/cairo_font.h',
+            'ggadget/gtk/cairo_graphics.cc',
+            'ggadget/gtk/cairo_graphics.h',
+            'ggadget/gtk/cairo_image_base.cc',
+            'ggadget/gtk/cairo_image_base.h',
+            'ggadget/gtk/pango_layout_cache.cc',
+            'ggadget/gtk/pango_layout_cache.h',
+            'ggadget/gtk/pixbuf_image.cc',
+            'ggadget/gtk/pixbuf_image.h',
+            'ggadget/gtk/utilities.cc',
+            'ggadget/gtk/utilities.h',
+            'ggadget/xdg/desktop_entry.cc',
+            'ggadget/xdg/desktop_entry.h',
+            'ggadget/xdg/icon_theme.cc',
+            'ggadget/xdg/icon_theme.h',
+            'ggadget/xdg/utilities.cc',
+            'ggadget/xdg/utilities.h',
+          ],
+          'cflags': [
+            '<!@(pkg-config --cflags gtk+-2.0 fontconfig)',
+          ],
+          'direct_dependent_settings': {
+            'cflags': [
+              '<!@(pkg-config --cflags gtk+-2.0)',
+            ],
+          },
+          'link_settings': {
+            'ldflags': [
+              '<!@(pkg-config --libs-only-L --libs-only-other gtk+-2.0 fontconfig)',
+            ],
+            'libraries': [
+              '<!@(pkg-config --libs-only-l gtk+-2.0 fontconfig)',
+            ],
+          },  # link_settings
+        },
+      ],  # targets
+    },],  # OS == linux
     [ 'OS=="win"', {
       'targets' : [
         {
@@ -72,6 +72,7 @@ class BasicElement::Impl : public SmallObject<> {
         pin_x_(0.0), pin_y_(0.0), ppin_x_(0.0), ppin_y_(0.0),
         rotation_(0.0),
         opacity_(1.0),
+        layout_parent_width_(0.0), layout_parent_height_(0.0),
         name_(name ? name : ""),
 #ifdef _DEBUG
         debug_color_index_(++total_debug_color_index_),
@@ -92,6 +93,8 @@ class BasicElement::Impl : public SmallObject<> {
         visibility_changed_(true),
         position_changed_(true),
         size_changed_(true),
+        layout_dirty_(true),
+        children_layout_dirty_(false),
         cache_enabled_(false),
         content_changed_(false),
         draw_queued_(false),
@@ -476,6 +479,10 @@ class BasicElement::Impl : public SmallObject<> {
       if (new_width != width_) {
         size_changed_ = true;
         width_ = new_width;
+        // The default height may depend on the width, so calculate it again
+        // in the next layout.
+        if (!height_specified_)
+          QueueLayout();
       }
     } else {
       pwidth_ = parent_width > 0.0 ? width_ / parent_width : 0.0;
@@ -496,6 +503,8 @@ class BasicElement::Impl : public SmallObject<> {
       if (new_height != height_) {
         size_changed_ = true;
         height_ = new_height;
+        if (!width_specified_)
+          QueueLayout();
       }
     } else {
       pheight_ = parent_height > 0.0 ? height_ / parent_height : 0.0;
@@ -525,11 +534,63 @@ class BasicElement::Impl : public SmallObject<> {
     }
   }
 
+  bool IsLayoutDirty() {
+    return view_->IsForcedLayout() || layout_dirty_ ||
+           children_layout_dirty_ || size_changed_;
+  }
+
+  // Only elements with relative position or size depend on the size of the
+  // parent.
+  bool IsParentSizeChanged() {
+    return (x_relative_ || y_relative_ || width_relative_ ||
+            height_relative_) &&
+           (GetParentWidth() != layout_parent_width_ ||
+            GetParentHeight() != layout_parent_height_);
+  }
+
+  void QueueLayout() {
+    layout_dirty_ = true;
+    // Let the next layout walk down to this element.
+    for (BasicElement *elm = parent_;
+         elm && !elm->impl_->children_layout_dirty_;
+         elm = elm->impl_->parent_)
+      elm->impl_->children_layout_dirty_ = true;
+  }
+
+  void CalculateChildrenSize() {
+    if (!children_)
+      return;
+    // The children of a dirty element may depend on its states in ways that
+    // are not tracked, so they are all calculated again.
+    bool force = layout_dirty_;
+    if (force)
+      view_->BeginForcedLayout();
+    children_->CalculateSize();
+    if (force)
+      view_->EndForcedLayout();
+  }
+
   void Layout() {
+    if (!IsLayoutDirty() && !IsParentSizeChanged())
+      return;
+    // Changes made from now on will be handled in the next layout.
+    bool force = layout_dirty_;
+    layout_dirty_ = false;
+    children_layout_dirty_ = false;
+    layout_parent_width_ = GetParentWidth();
+    layout_parent_height_ = GetParentHeight();
+    view_->IncreaseLayoutCount();
+
     CalculateRelativeAttributes();
     if (position_changed_ || size_changed_ || visibility_changed_) {
       AddToClipRegion(NULL);
     }
+    // A moved element changes the position of all its descendants in the
+    // view, which some of them, e.g. native widgets, depend on.
+    if (position_changed_ || visibility_changed_)
+      force = true;
+    if (force)
+      view_->BeginForcedLayout();
 
     owner_->BeforeChildrenLayout();
 
@@ -543,6 +604,9 @@ class BasicElement::Impl : public SmallObject<> {
     // the position and size of children elements to do its own layout.
     owner_->Layout();
 
+    if (force)
+      view_->EndForcedLayout();
+
     if (content_changed_) {
       // To let all associated copy elements to update their content.
       FireOnContentChangedSignal();
@@ -742,6 +806,7 @@ class BasicElement::Impl : public SmallObject<> {
   }
 
   void QueueDraw() {
+    QueueLayout();
     if ((visible_ || visibility_changed_) && !draw_queued_) {
       draw_queued_ = true;
       AddToClipRegion(NULL);
@@ -755,6 +820,7 @@ class BasicElement::Impl : public SmallObject<> {
   }
 
   void QueueDrawRect(const Rectangle &rect) {
+    QueueLayout();
     if ((visible_ || visibility_changed_) && !draw_queued_) {
       // Don't set draw_queued_, because it's only queued part of the element.
       // Other part might be queued later.
@@ -769,6 +835,7 @@ class BasicElement::Impl : public SmallObject<> {
   }
 
   void QueueDrawRegion(const ClipRegion &region) {
+    QueueLayout();
     if ((visible_ || visibility_changed_) && !draw_queued_) {
       // Don't set draw_queued_, because it's only queued part of the element.
       // Other part might be queued later.
@@ -812,13 +879,23 @@ class BasicElement::Impl : public SmallObject<> {
   void WidthChanged() {
     size_changed_ = true;
     draw_queued_ = false;
-    QueueDraw();
+    QueueSizeChangedDraw();
   }
 
   void HeightChanged() {
     size_changed_ = true;
     draw_queued_ = false;
+    QueueSizeChangedDraw();
+  }
+
+  // Unlike other changes, a size change doesn't require the whole subtree to
+  // be laid out again, because size_changed_ already causes the layout of this
+  // element, and only the children with relative position or size depend on
+  // its size.
+  void QueueSizeChangedDraw() {
+    bool layout_dirty = layout_dirty_;
     QueueDraw();
+    layout_dirty_ = layout_dirty;
   }
 
   void MarkRedraw() {
@@ -1134,6 +1211,8 @@ class BasicElement::Impl : public SmallObject<> {
   double pin_x_, pin_y_, ppin_x_, ppin_y_;
   double rotation_;
   double opacity_;
+  // The size of the parent when the element was laid out last time.
+  double layout_parent_width_, layout_parent_height_;
 
   std::string name_;
   std::string tooltip_;
@@ -1204,6 +1283,10 @@ class BasicElement::Impl : public SmallObject<> {
   bool visibility_changed_      : 1;
   bool position_changed_        : 1;
   bool size_changed_            : 1;
+  // The element itself needs layout, and so does its whole subtree.
+  bool layout_dirty_            : 1;
+  // Some descendants need layout.
+  bool children_layout_dirty_   : 1;
   bool cache_enabled_           : 1;
   bool content_changed_         : 1;
   bool draw_queued_             : 1;
@@ -1839,7 +1922,11 @@ size_t BasicElement::GetIndex() const {
 }
 
 void BasicElement::SetIndex(size_t index) {
-  impl_->index_ = index;
+  if (impl_->index_ != index) {
+    impl_->index_ = index;
+    // The default position may depend on the index.
+    impl_->QueueLayout();
+  }
 }
 
 void BasicElement::EnableCanvasCache(bool enable) {
@@ -1954,8 +2041,7 @@ void BasicElement::DrawChildren(CanvasInterface *canvas) {
 }
 
 void BasicElement::CalculateSize() {
-  if (impl_->children_)
-    impl_->children_->CalculateSize();
+  impl_->CalculateChildrenSize();
   if (!impl_->width_specified_ || !impl_->height_specified_) {
     double width, height;
     GetDefaultSize(&width, &height);
@@ -2085,6 +2171,14 @@ void BasicElement::QueueDrawRegion(const ClipRegion &region) {
   impl_->QueueDrawRegion(region);
 }
 
+void BasicElement::QueueLayout() {
+  impl_->QueueLayout();
+}
+
+bool BasicElement::IsLayoutDirty() const {
+  return impl_->IsLayoutDirty();
+}
+
 void BasicElement::MarkRedraw() {
   impl_->MarkRedraw();
 }
@@ -491,6 +491,7 @@ class BasicElement: public ScriptableHelperNativeOwnedDefault {
   /**
     * Adjusts the layout of this element and its children.
     * This method is called just before @c Draw() and after @c CalculateSize().
+    * Does nothing if the layout of the element is known to be unchanged.
     */
   void RecursiveLayout();
 
@@ -527,6 +528,22 @@ class BasicElement: public ScriptableHelperNativeOwnedDefault {
    */
   void QueueDrawRegion(const ClipRegion &region);
 
+  /**
+   * Marks the element to be laid out during the next @c View::Layout(),
+   * without requesting a redraw. @c QueueDraw() and the size setters do this
+   * implicitly. Elements whose layout depends on other states, e.g. the
+   * content of a child view, must call this when such states change.
+   */
+  void QueueLayout();
+
+  /**
+   * Checks if this element or any of its descendants needs to be laid out.
+   * The subtree of an element which doesn't need layout is skipped by
+   * @c RecursiveLayout() and @c Elements::CalculateSize(), unless the element
+   * has relative size or position and the size of its parent has changed.
+   */
+  bool IsLayoutDirty() const;
+
   /**
    * Checks to see if position of the element has changed relative to the
    * parent since the last draw. Specifically, this checks for changes in
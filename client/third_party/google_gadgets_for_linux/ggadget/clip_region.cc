@@ -14,6 +14,8 @@
   limitations under the License.
 */
 
+#include <algorithm>
+#include <limits>
 #include <vector>
 #include "build_config.h"
 #include "clip_region.h"
@@ -33,8 +35,25 @@ typedef std::vector<Rectangle> RectangleVector;
 typedef std::vector<Rectangle, LokiAllocator<Rectangle> > RectangleVector;
 #endif
 
+static const double kInfinity = std::numeric_limits<double>::max();
+
+/**
+ * The rectangles are kept in y-x banded form: they are grouped into bands
+ * sorted by y, where all rectangles of a band have the same top and bottom,
+ * and the rectangles of a band don't overlap or touch each other and are
+ * sorted by x. Bands don't overlap, and vertically adjacent bands with the
+ * same horizontal spans are coalesced. So the set operations of regions are
+ * done in a single sweep of both bands, and queries only need to look at the
+ * bands covering the queried area.
+ */
 class ClipRegion::Impl : public SmallObject<> {
  public:
+  enum Operation {
+    OP_UNION,
+    OP_INTERSECT,
+    OP_SUBTRACT
+  };
+
   Impl(double fuzzy_ratio)
     : fuzzy_ratio_(Clamp(fuzzy_ratio, 0.5, 1.0)) {
   }
@@ -70,9 +89,219 @@ class ClipRegion::Impl : public SmallObject<> {
     return false;
   }
 
+  /**
+   * Grows rect by merging it with the rectangles next to it according to the
+   * fuzzy ratio, until no more rectangle can be merged.
+   */
+  void MergeNeighbors(Rectangle *rect) {
+    bool merged = true;
+    while (merged) {
+      merged = false;
+      double bottom = rect->y + rect->h;
+      for (size_t i = FindBand(rect->y);
+           i < rectangles_.size() && rectangles_[i].y <= bottom; ++i) {
+        const Rectangle &neighbor = rectangles_[i];
+        if (!neighbor.IsInside(*rect) &&
+            MergeRectangles(*rect, neighbor, rect)) {
+          merged = true;
+          break;
+        }
+      }
+    }
+  }
+
+  /**
+   * Returns the index of the first rectangle whose bottom is below y, which
+   * is the first rectangle of the first band that may contain y.
+   */
+  size_t FindBand(double y) const {
+    size_t low = 0, high = rectangles_.size();
+    while (low < high) {
+      size_t middle = (low + high) / 2;
+      if (rectangles_[middle].y + rectangles_[middle].h <= y)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    return low;
+  }
+
+  /** Returns the end of the band starting at begin. */
+  static size_t GetBandEnd(const RectangleVector &rects, size_t begin) {
+    size_t end = begin + 1;
+    while (end < rects.size() && rects[end].y == rects[begin].y)
+      ++end;
+    return end;
+  }
+
+  static bool Apply(Operation op, bool in_a, bool in_b) {
+    switch (op) {
+      case OP_UNION:
+        return in_a || in_b;
+      case OP_INTERSECT:
+        return in_a && in_b;
+      case OP_SUBTRACT:
+        return in_a && !in_b;
+    }
+    return false;
+  }
+
+  /**
+   * Appends the band [top, bottom) to result, whose spans are the combination
+   * of the spans of a[a_begin, a_end) and b[b_begin, b_end). The band is
+   * coalesced into the previous band of result if possible.
+   */
+  static void AppendBand(const RectangleVector &a, size_t a_begin,
+                         size_t a_end, const RectangleVector &b,
+                         size_t b_begin, size_t b_end, Operation op,
+                         double top, double bottom,
+                         size_t *last_band, RectangleVector *result) {
+    size_t band = result->size();
+    // Sweep the left and right edges of the spans of both bands.
+    size_t i = a_begin * 2, j = b_begin * 2;
+    bool in_a = false, in_b = false, inside = false;
+    double left = 0;
+    while (i < a_end * 2 || j < b_end * 2) {
+      double xa = kInfinity, xb = kInfinity;
+      if (i < a_end * 2)
+        xa = (i & 1) ? a[i / 2].x + a[i / 2].w : a[i / 2].x;
+      if (j < b_end * 2)
+        xb = (j & 1) ? b[j / 2].x + b[j / 2].w : b[j / 2].x;
+      double x = std::min(xa, xb);
+      if (xa == x)
+        in_a = !(i++ & 1);
+      if (xb == x)
+        in_b = !(j++ & 1);
+      bool now = Apply(op, in_a, in_b);
+      if (now && !inside) {
+        left = x;
+      } else if (!now && inside && x > left) {
+        // Spans touching the previous one are joined.
+        if (result->size() > band &&
+            result->back().x + result->back().w == left)
+          result->back().w = x - result->back().x;
+        else
+          result->push_back(Rectangle(left, top, x - left, bottom - top));
+      }
+      inside = now;
+    }
+
+    size_t count = result->size() - band;
+    if (!count)
+      return;
+    // Coalesce with the previous band if they are adjacent and have the same
+    // spans.
+    if (*last_band < band && band - *last_band == count &&
+        (*result)[*last_band].y + (*result)[*last_band].h == top) {
+      bool same = true;
+      for (size_t k = 0; k < count && same; ++k) {
+        const Rectangle &prev = (*result)[*last_band + k];
+        const Rectangle &cur = (*result)[band + k];
+        same = (prev.x == cur.x && prev.w == cur.w);
+      }
+      if (same) {
+        for (size_t k = *last_band; k < band; ++k)
+          (*result)[k].h = bottom - (*result)[k].y;
+        result->resize(band);
+        return;
+      }
+    }
+    *last_band = band;
+  }
+
+  /**
+   * Combines the banded rectangles a and b into result with op in a single
+   * sweep of their bands.
+   */
+  static void Combine(const RectangleVector &a, const RectangleVector &b,
+                      Operation op, RectangleVector *result) {
+    result->clear();
+    size_t last_band = 0;
+    size_t ia = 0, ib = 0;
+    size_t a_end = ia < a.size() ? GetBandEnd(a, ia) : ia;
+    size_t b_end = ib < b.size() ? GetBandEnd(b, ib) : ib;
+    double y = -kInfinity;
+    while (ia < a.size() || ib < b.size()) {
+      if (op != OP_UNION && ia >= a.size())
+        break;
+      if (op == OP_INTERSECT && ib >= b.size())
+        break;
+
+      // The part of the current bands below y, where y is the bottom of the
+      // last swept slab.
+      double a_top = kInfinity, a_bottom = kInfinity;
+      double b_top = kInfinity, b_bottom = kInfinity;
+      if (ia < a.size()) {
+        a_top = std::max(a[ia].y, y);
+        a_bottom = a[ia].y + a[ia].h;
+      }
+      if (ib < b.size()) {
+        b_top = std::max(b[ib].y, y);
+        b_bottom = b[ib].y + b[ib].h;
+      }
+
+      // Sweep the slab from top to the next edge of either band.
+      double top = std::min(a_top, b_top);
+      bool in_a = (a_top == top);
+      bool in_b = (b_top == top);
+      double bottom = std::min(in_a ? a_bottom : a_top,
+                               in_b ? b_bottom : b_top);
+      AppendBand(a, ia, in_a ? a_end : ia, b, ib, in_b ? b_end : ib,
+                 op, top, bottom, &last_band, result);
+      y = bottom;
+
+      if (in_a && a_bottom <= bottom) {
+        ia = a_end;
+        a_end = ia < a.size() ? GetBandEnd(a, ia) : ia;
+      }
+      if (in_b && b_bottom <= bottom) {
+        ib = b_end;
+        b_end = ib < b.size() ? GetBandEnd(b, ib) : ib;
+      }
+    }
+  }
+
+  void Combine(const RectangleVector &another, Operation op) {
+    RectangleVector result;
+    Combine(rectangles_, another, op, &result);
+    rectangles_.swap(result);
+    UpdateExtents();
+  }
+
+  void UpdateExtents() {
+    if (rectangles_.empty()) {
+      extents_.Reset();
+      return;
+    }
+    double left = kInfinity, right = -kInfinity;
+    for (size_t i = 0; i < rectangles_.size(); i = GetBandEnd(rectangles_, i)) {
+      size_t end = GetBandEnd(rectangles_, i);
+      left = std::min(left, rectangles_[i].x);
+      right = std::max(right, rectangles_[end - 1].x + rectangles_[end - 1].w);
+    }
+    double top = rectangles_.front().y;
+    extents_.Set(left, top, right - left,
+                 rectangles_.back().y + rectangles_.back().h - top);
+  }
+
+  /** Rebuilds the banded form from the rectangles that may overlap. */
+  void Rebuild() {
+    RectangleVector rectangles;
+    rectangles.swap(rectangles_);
+    RectangleVector rect(1), result;
+    for (RectangleVector::const_iterator it = rectangles.begin();
+         it != rectangles.end(); ++it) {
+      rect[0] = *it;
+      Combine(rectangles_, rect, OP_UNION, &result);
+      rectangles_.swap(result);
+    }
+    UpdateExtents();
+  }
+
  public:
   double fuzzy_ratio_;
   RectangleVector rectangles_;
+  Rectangle extents_;
 };
 
 ClipRegion::ClipRegion()
@@ -86,6 +315,7 @@ ClipRegion::ClipRegion(double fuzzy_ratio)
 ClipRegion::ClipRegion(const ClipRegion &region)
   : impl_(new Impl(region.impl_->fuzzy_ratio_)) {
   impl_->rectangles_ = region.impl_->rectangles_;
+  impl_->extents_ = region.impl_->extents_;
 }
 
 ClipRegion::~ClipRegion() {
@@ -96,6 +326,7 @@ ClipRegion::~ClipRegion() {
 const ClipRegion& ClipRegion::operator = (const ClipRegion &region) {
   impl_->fuzzy_ratio_ = region.impl_->fuzzy_ratio_;
   impl_->rectangles_ = region.impl_->rectangles_;
+  impl_->extents_ = region.impl_->extents_;
   return *this;
 }
 
@@ -108,17 +339,42 @@ void ClipRegion::SetFuzzyRatio(double fuzzy_ratio) {
 }
 
 void ClipRegion::AddRectangle(const Rectangle &rect) {
-  if (!rect.w || !rect.h) return;
+  if (rect.w <= 0 || rect.h <= 0) return;
 
-  RectangleVector new_rectangles;
-  Rectangle big_rect(rect);
-  for (RectangleVector::iterator it = impl_->rectangles_.begin();
-       it != impl_->rectangles_.end(); ++it) {
-    if (!impl_->MergeRectangles(big_rect, *it, &big_rect))
-      new_rectangles.push_back(*it);
+  RectangleVector big_rect(1, rect);
+  if (impl_->rectangles_.empty()) {
+    impl_->rectangles_.swap(big_rect);
+    impl_->extents_ = rect;
+    return;
   }
-  new_rectangles.push_back(big_rect);
-  impl_->rectangles_.swap(new_rectangles);
+  if (rect.IsInside(impl_->extents_) && impl_->rectangles_.size() == 1)
+    return;
+  if (impl_->fuzzy_ratio_ < 1.0)
+    impl_->MergeNeighbors(&big_rect[0]);
+  impl_->Combine(big_rect, Impl::OP_UNION);
+}
+
+void ClipRegion::Union(const ClipRegion &region) {
+  if (region.impl_->rectangles_.empty())
+    return;
+  impl_->Combine(region.impl_->rectangles_, Impl::OP_UNION);
+}
+
+void ClipRegion::Intersect(const ClipRegion &region) {
+  if (impl_->rectangles_.empty())
+    return;
+  if (!impl_->extents_.Overlaps(region.impl_->extents_)) {
+    Clear();
+    return;
+  }
+  impl_->Combine(region.impl_->rectangles_, Impl::OP_INTERSECT);
+}
+
+void ClipRegion::Subtract(const ClipRegion &region) {
+  if (impl_->rectangles_.empty() ||
+      !impl_->extents_.Overlaps(region.impl_->extents_))
+    return;
+  impl_->Combine(region.impl_->rectangles_, Impl::OP_SUBTRACT);
 }
 
 bool ClipRegion::IsEmpty() const {
@@ -127,48 +383,49 @@ bool ClipRegion::IsEmpty() const {
 
 void ClipRegion::Clear() {
   impl_->rectangles_.clear();
+  impl_->extents_.Reset();
 }
 
 bool ClipRegion::IsPointIn(double x, double y) const {
-  for (RectangleVector::const_iterator it = impl_->rectangles_.begin();
-       it != impl_->rectangles_.end(); ++it)
-    if (it->IsPointIn(x, y)) return true;
+  const RectangleVector &rects = impl_->rectangles_;
+  for (size_t i = impl_->FindBand(y); i < rects.size() && rects[i].y <= y; ++i)
+    if (rects[i].IsPointIn(x, y)) return true;
   return false;
 }
 
 bool ClipRegion::Overlaps(const Rectangle &rect) const {
-  for (RectangleVector::const_iterator it = impl_->rectangles_.begin();
-       it != impl_->rectangles_.end(); ++it)
-    if (it->Overlaps(rect)) return true;
+  if (impl_->rectangles_.empty() || !impl_->extents_.Overlaps(rect))
+    return false;
+  const RectangleVector &rects = impl_->rectangles_;
+  double bottom = rect.y + rect.h;
+  for (size_t i = impl_->FindBand(rect.y);
+       i < rects.size() && rects[i].y < bottom; ++i)
+    if (rects[i].Overlaps(rect)) return true;
   return false;
 }
 
 bool ClipRegion::IsInside(const Rectangle &rect) const {
-  for (RectangleVector::const_iterator it = impl_->rectangles_.begin();
-       it != impl_->rectangles_.end(); ++it)
-    if (!it->IsInside(rect)) return false;
   // If the clip region is empty then return false.
-  return impl_->rectangles_.size() != 0;
+  return impl_->rectangles_.size() != 0 && impl_->extents_.IsInside(rect);
 }
 
 Rectangle ClipRegion::GetExtents() const {
-  RectangleVector::const_iterator it = impl_->rectangles_.begin();
-  Rectangle rect(*it);
-  for (++it; it != impl_->rectangles_.end(); ++it)
-    rect.Union(*it);
-  return rect;
+  return impl_->extents_;
 }
 
 void ClipRegion::Integerize() {
   for (RectangleVector::iterator it = impl_->rectangles_.begin();
        it != impl_->rectangles_.end(); ++it)
     it->Integerize(true);
+  // Expanded rectangles of adjacent bands may overlap.
+  impl_->Rebuild();
 }
 
 void ClipRegion::Zoom(double zoom) {
   for (RectangleVector::iterator it = impl_->rectangles_.begin();
        it != impl_->rectangles_.end(); ++it)
     it->Zoom(zoom);
+  impl_->extents_.Zoom(zoom);
 }
 
 size_t ClipRegion::GetRectangleCount() const {
@@ -42,6 +42,11 @@ template <typename R, typename P1, typename P2, typename P3, typename P4>
  *
  * The default fuzzy ratio is 1, means no merging at all. It must be greater
  * than 0.5.
+ *
+ * The rectangles are kept in y-x banded form, i.e. they don't overlap each
+ * other and are sorted by y then x, so that the set operations only take a
+ * single pass over the rectangles, and the queries only check the rectangles
+ * near the queried area.
  */
 class ClipRegion {
  public:
@@ -71,6 +76,22 @@ class ClipRegion {
    */
   void AddRectangle(const Rectangle &rect);
 
+  /**
+   * Sets the region to the union of itself and another region. Unlike
+   * AddRectangle(), the fuzzy ratio isn't applied.
+   */
+  void Union(const ClipRegion &region);
+
+  /**
+   * Sets the region to the intersection of itself and another region.
+   * Unlike the empty extent used in drawing, an empty region is treated as
+   * an empty set here.
+   */
+  void Intersect(const ClipRegion &region);
+
+  /** Removes the area of another region from the region. */
+  void Subtract(const ClipRegion &region);
+
   /**
    * Clear the region.
    */
@@ -110,7 +131,8 @@ class ClipRegion {
   void Zoom(double zoom);
 
   /**
-   * Gets number of rectangles in this region.
+   * Gets number of rectangles in this region. The rectangles don't overlap
+   * each other, and are sorted by y then x.
    */
   size_t GetRectangleCount() const;
 
@@ -370,8 +370,11 @@ class Elements::Impl : public SmallObject<> {
   void CalculateSize() {
     Children::iterator it = children_.begin();
     Children::iterator end = children_.end();
-    for (; it != end; ++it)
-      (*it)->CalculateSize();
+    for (; it != end; ++it) {
+      // The size of an unchanged subtree is the same as the last time.
+      if ((*it)->IsLayoutDirty())
+        (*it)->CalculateSize();
+    }
   }
 
   void Layout() {
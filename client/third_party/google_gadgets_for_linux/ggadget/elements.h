@@ -244,12 +244,15 @@ class Elements : public ScriptableHelperNativeOwnedDefault {
   /**
    * Calculate the size of children.
    * This method is called just before @c Layout();
+   * Children whose subtrees haven't changed keep their sizes.
    */
    void CalculateSize();
 
   /**
    * Adjusts the layout (e.g. position, etc.) of children.
    * This method is called just before @c Draw().
+   * Only the children that need layout are laid out.
+   * @see BasicElement::IsLayoutDirty()
    */
   void Layout();
 
@@ -29,6 +29,7 @@
 #include "cairo_graphics.h"
 #include "cairo_canvas.h"
 #include "cairo_font.h"
+#include "pango_layout_cache.h"
 
 namespace ggadget {
 namespace gtk {
@@ -69,6 +70,198 @@ static void SetPangoLayoutAttrFromTextFlags(PangoLayout *layout,
   pango_attr_list_unref(attr_list);
 }
 
+// Creates an untrimmed layout of the first length bytes of text, or the whole
+// text if length is -1.
+static PangoLayout *CreateTextLayout(PangoLayoutCache *cache,
+                                     const char *text, int length,
+                                     const PangoFontDescription *font,
+                                     int text_flags, double width,
+                                     CanvasInterface::Alignment align) {
+  PangoLayout *layout = cache->CreateLayout();
+  pango_layout_set_text(layout, text, length);
+  pango_layout_set_font_description(layout, font);
+  SetPangoLayoutAttrFromTextFlags(layout, text_flags, width);
+
+  // Set alignment. This is only effective when wordwrap is set
+  // because when wordwrap is unset, the width has to be
+  // -1, thus the alignment is useless.
+  if (align == CanvasInterface::ALIGN_LEFT)
+    pango_layout_set_alignment(layout, PANGO_ALIGN_LEFT);
+  else if (align == CanvasInterface::ALIGN_CENTER)
+    pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
+  else if (align == CanvasInterface::ALIGN_RIGHT)
+    pango_layout_set_alignment(layout, PANGO_ALIGN_RIGHT);
+  else if (align == CanvasInterface::ALIGN_JUSTIFY)
+    pango_layout_set_justify(layout, TRUE);
+  return layout;
+}
+
+// Gets the untrimmed layout of text, which is shared by drawing and
+// measurement. The result is valid until the next insertion into the cache.
+static const TextLayout *GetTextLayout(PangoLayoutCache *cache,
+                                       const char *text,
+                                       const PangoFontDescription *font,
+                                       int text_flags, double width,
+                                       CanvasInterface::Alignment align) {
+  PangoLayoutCache::Key key(text, font, text_flags, width, align,
+                            CanvasInterface::TRIMMING_NONE, 0);
+  const TextLayout *cached = cache->Lookup(key);
+  if (cached)
+    return cached;
+
+  TextLayout *result = new TextLayout;
+  result->layout = CreateTextLayout(cache, text, -1, font, text_flags,
+                                    width, align);
+  // Get the pixel extents(logical extents) of the layout.
+  PangoRectangle pos;
+  pango_layout_get_pixel_extents(result->layout, NULL, &pos);
+  result->width = pos.width;
+  result->height = pos.height;
+  result->line_count = pango_layout_get_line_count(result->layout);
+  return cache->Insert(key, result);
+}
+
+// Gets the layout of text trimmed to displayed_lines lines, where untrimmed
+// is the untrimmed layout of the text. The result is valid until the next
+// insertion into the cache.
+static const TextLayout *GetTrimmedTextLayout(
+    PangoLayoutCache *cache, const TextLayout *untrimmed, const char *text,
+    const PangoFontDescription *font, int text_flags, double width,
+    CanvasInterface::Alignment align, CanvasInterface::Trimming trimming,
+    int displayed_lines) {
+  PangoLayoutCache::Key key(text, font, text_flags, width, align, trimming,
+                            displayed_lines);
+  const TextLayout *cached = cache->Lookup(key);
+  if (cached)
+    return cached;
+
+  TextLayout *result = new TextLayout;
+  result->line_count = displayed_lines;
+  // We will use newtext as the content of the layout,
+  // because we have to display the trimmed text.
+  std::string newtext;
+
+  if (displayed_lines > 1) {
+    // When there are multilines, we will show the above lines first,
+    // because trimming will only occurs in the last line.
+    PangoLayoutLine *line = pango_layout_get_line(untrimmed->layout,
+                                                  displayed_lines - 2);
+    int last_line_index = line->start_index + line->length;
+    result->layout = CreateTextLayout(cache, text, last_line_index, font,
+                                      text_flags, width, align);
+
+    // The newtext contains the text that will be shown in the last line.
+    newtext = text + last_line_index;
+    result->trimmed_y =
+        untrimmed->height / untrimmed->line_count * (displayed_lines - 1);
+
+  } else {
+    // When there is only a single line, the newtext equals text.
+    newtext = text;
+  }
+  // Set the newtext as the content of the layout.
+  PangoLayout *layout = CreateTextLayout(cache, newtext.c_str(), -1, font,
+                                         text_flags, width, align);
+  PangoRectangle pos;
+
+  // This record the width of the ellipsis text.
+  int ellipsis_width = 0;
+
+  if (trimming == CanvasInterface::TRIMMING_CHARACTER_ELLIPSIS) {
+    // Pango has provided character-ellipsis trimming.
+    // FIXME: when displaying arabic, the final layout width
+    // may exceed the width we set before
+    pango_layout_set_width(layout, static_cast<int>(width) * PANGO_SCALE);
+    pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+
+  } else if (trimming == CanvasInterface::TRIMMING_PATH_ELLIPSIS) {
+    // Pango has provided path-ellipsis trimming.
+    // FIXME: when displaying arabic, the final layout width
+    // may exceed the width we set before
+    pango_layout_set_width(layout, static_cast<int>(width) * PANGO_SCALE);
+    pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_MIDDLE);
+
+  } else {
+    // We have to do other type of trimming ourselves, including
+    // "character", "word" and "word-ellipsis".
+
+    // We want every thing in a single line, so set no word wrap.
+    pango_layout_set_width(layout, -1);
+    if (trimming == CanvasInterface::TRIMMING_WORD_ELLIPSIS) {
+      // Only in this condition should we calculate the ellipsis width.
+      pango_layout_set_text(layout, kEllipsisText, -1);
+      pango_layout_get_pixel_extents(layout, NULL, &pos);
+      ellipsis_width = pos.width;
+      pango_layout_set_text(layout, newtext.c_str(), -1);
+    }
+
+    // Figure out how many characters can be displayed.
+    std::vector<int> cluster_index;
+    PangoLayoutIter *it = pango_layout_get_iter(layout);
+    // A cluster is the smallest linguistic unit that can be shaped.
+    do {
+      cluster_index.push_back(pango_layout_iter_get_index(it));
+    } while (pango_layout_iter_next_cluster(it));
+    pango_layout_iter_free(it);
+    cluster_index.push_back(static_cast<int>(newtext.size()));
+    std::sort(cluster_index.begin(), cluster_index.end());
+
+    std::vector<int>::iterator cluster_it = cluster_index.begin();
+    for (; cluster_it != cluster_index.end(); ++cluster_it) {
+      pango_layout_set_text(layout, newtext.c_str(), *cluster_it);
+      pango_layout_get_pixel_extents(layout, NULL, &pos);
+      if (pos.width > width - ellipsis_width)
+        break;
+    }
+
+    // Use conceal_index to represent the first byte that won't be displayed.
+    int conceal_index = 0;
+    if (cluster_it != cluster_index.begin())
+      conceal_index = *(--cluster_it);
+
+    // Get the text that will finally be displayed.
+    if (trimming == CanvasInterface::TRIMMING_CHARACTER) {
+      // In "character", just show the characters before the index.
+      pango_layout_set_text(layout, newtext.c_str(), conceal_index);
+    } else {
+      // In "word" or "word-ellipsis" trimming, we have to find out where
+      // last word stops. If we can't find out a reasonable position, then
+      // just do trimming as in "character".
+      PangoLogAttr *log_attrs;
+      int n_attrs;
+      pango_layout_get_log_attrs(layout, &log_attrs, &n_attrs);
+      int off = static_cast<int>(g_utf8_pointer_to_offset(newtext.c_str(),
+                                         newtext.c_str() + conceal_index));
+      while (off > 0 && !log_attrs[off].is_word_end &&
+             !log_attrs[off].is_word_start)
+        --off;
+      g_free(log_attrs);
+      if (off > 0) {
+        conceal_index =
+           static_cast<int>(g_utf8_offset_to_pointer(newtext.c_str(), off) -
+                            newtext.c_str());
+      }
+      newtext.erase(conceal_index);
+
+      // In word-ellipsis, we have to append the ellipsis manualy.
+      if (trimming == CanvasInterface::TRIMMING_WORD_ELLIPSIS)
+        newtext.append(kEllipsisText);
+
+      pango_layout_set_text(layout, newtext.c_str(), -1);
+    }
+
+    // We also have to do the horizontal alignment.
+    pango_layout_get_pixel_extents(layout, NULL, &pos);
+    if (align == CanvasInterface::ALIGN_CENTER)
+      result->trimmed_x = (width - pos.width) / 2;
+    else if (align == CanvasInterface::ALIGN_RIGHT)
+      result->trimmed_x = width - pos.width;
+  }
+
+  result->trimmed = layout;
+  return cache->Insert(key, result);
+}
+
 class CairoCanvas::Impl : public SmallObject<> {
  public:
   Impl(const CairoGraphics *graphics, double w, double h, cairo_format_t fmt)
@@ -238,13 +431,6 @@ class CairoCanvas::Impl : public SmallObject<> {
     return NULL;
   }
 
-  PangoLayout *CreatePangoLayout() {
-    // Pango layout must be created with a cairo context that isn't scaled at
-    // all. Otherwise, some text layout behavior will be wrong.
-    CairoCanvas canvas(1.0, 1, 1, CAIRO_FORMAT_ARGB32);
-    return pango_cairo_create_layout(canvas.GetContext());
-  }
-
   bool DrawTextInternal(double x, double y, double width,
                         double height, const char *text,
                         const FontInterface *f,
@@ -261,32 +447,16 @@ class CairoCanvas::Impl : public SmallObject<> {
     cairo_clip(cr_);
 
     const CairoFont *font = down_cast<const CairoFont*>(f);
-    PangoLayout *layout = CreatePangoLayout();
-    pango_layout_set_text(layout, text, -1);
-    pango_layout_set_font_description(layout, font->GetFontDescription());
-    SetPangoLayoutAttrFromTextFlags(layout, text_flags, width);
-    // Pos is used to get glyph extents in pango.
-    PangoRectangle pos;
+    PangoLayoutCache *cache = PangoLayoutCache::GetDefault();
+    const TextLayout *layout =
+        GetTextLayout(cache, text, font->GetFontDescription(), text_flags,
+                      width, align);
     // real_x and real_y represent the real position of the layout.
     double real_x = x, real_y = y;
 
-    // Set alignment. This is only effective when wordwrap is set
-    // because when wordwrap is unset, the width has to be
-    // -1, thus the alignment is useless.
-    if (align == ALIGN_LEFT)
-      pango_layout_set_alignment(layout, PANGO_ALIGN_LEFT);
-    else if (align == ALIGN_CENTER)
-      pango_layout_set_alignment(layout, PANGO_ALIGN_CENTER);
-    else if (align == ALIGN_RIGHT)
-      pango_layout_set_alignment(layout, PANGO_ALIGN_RIGHT);
-    else if (align == ALIGN_JUSTIFY)
-      pango_layout_set_justify(layout, TRUE);
-
-    // Get the pixel extents(logical extents) of the layout.
-    pango_layout_get_pixel_extents(layout, NULL, &pos);
     // Calculate number of all lines.
-    int n_lines = pango_layout_get_line_count(layout);
-    int line_height = pos.height / n_lines;
+    int n_lines = layout->line_count;
+    int line_height = layout->height / n_lines;
     // Calculate number of lines that could be displayed.
     // We should display one more line as long as there
     // are 5 pixels of blank left. This is only effective
@@ -294,159 +464,49 @@ class CairoCanvas::Impl : public SmallObject<> {
     int displayed_lines = (static_cast<int>(height) - 5) / line_height + 1;
     if (displayed_lines > n_lines) displayed_lines = n_lines;
 
-    if (trimming == TRIMMING_NONE || (pos.width <= width &&
-          pango_layout_get_line_count(layout) <= displayed_lines)) {
+    if (trimming == TRIMMING_NONE || (layout->width <= width &&
+          n_lines <= displayed_lines)) {
       // When there is no trimming, we can directly show the layout.
 
       // Set vertical alignment.
       if (valign == VALIGN_MIDDLE)
-        real_y = y + (height - pos.height) / 2;
+        real_y = y + (height - layout->height) / 2;
       else if (valign == VALIGN_BOTTOM)
-        real_y = y + height - pos.height;
+        real_y = y + height - layout->height;
 
       // When wordwrap is unset, we also have to do the horizontal alignment.
       if ((text_flags & TEXT_FLAGS_WORDWRAP) == 0) {
         if (align == ALIGN_CENTER)
-          real_x = x + (width - pos.width) / 2;
+          real_x = x + (width - layout->width) / 2;
         else if (align == ALIGN_RIGHT)
-          real_x = x + width - pos.width;
+          real_x = x + width - layout->width;
       }
 
       // Show pango layout when there is no trimming.
       cairo_move_to(cr_, real_x, real_y);
-      pango_cairo_show_layout(cr_, layout);
+      pango_cairo_show_layout(cr_, layout->layout);
 
     } else {
-      // We will use newtext as the content of the layout,
-      // because we have to display the trimmed text.
-      std::string newtext;
-
       // Set vertical alignment.
       if (valign == VALIGN_MIDDLE)
         real_y = y + (height - line_height * displayed_lines) / 2;
       else if (valign == VALIGN_BOTTOM)
         real_y = y + height - line_height * displayed_lines;
 
-      if (displayed_lines > 1) {
-        // When there are multilines, we will show the above lines first,
-        // because trimming will only occurs in the last line.
-        PangoLayoutLine *line = pango_layout_get_line(layout,
-                                                      displayed_lines - 2);
-        int last_line_index = line->start_index + line->length;
-        pango_layout_set_text(layout, text, last_line_index);
+      layout = GetTrimmedTextLayout(cache, layout, text,
+                                    font->GetFontDescription(), text_flags,
+                                    width, align, trimming, displayed_lines);
+      if (layout->layout) {
         cairo_move_to(cr_, real_x, real_y);
-        pango_cairo_show_layout(cr_, layout);
-
-        // The newtext contains the text that will be shown in the last line.
-        newtext = text + last_line_index;
-        real_y += line_height * (displayed_lines - 1);
-
-      } else {
-        // When there is only a single line, the newtext equals text.
-        newtext = text;
-      }
-      // Set the newtext as the content of the layout.
-      pango_layout_set_text(layout, newtext.c_str(), -1);
-
-      // This record the width of the ellipsis text.
-      int ellipsis_width = 0;
-
-      if (trimming == TRIMMING_CHARACTER_ELLIPSIS) {
-        // Pango has provided character-ellipsis trimming.
-        // FIXME: when displaying arabic, the final layout width
-        // may exceed the width we set before
-        pango_layout_set_width(layout, static_cast<int>(width) * PANGO_SCALE);
-        pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
-
-      } else if (trimming == TRIMMING_PATH_ELLIPSIS) {
-        // Pango has provided path-ellipsis trimming.
-        // FIXME: when displaying arabic, the final layout width
-        // may exceed the width we set before
-        pango_layout_set_width(layout, static_cast<int>(width) * PANGO_SCALE);
-        pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_MIDDLE);
-
-      } else {
-        // We have to do other type of trimming ourselves, including
-        // "character", "word" and "word-ellipsis".
-
-        // We want every thing in a single line, so set no word wrap.
-        pango_layout_set_width(layout, -1);
-        pango_layout_get_pixel_extents(layout, NULL, &pos);
-        if (trimming == TRIMMING_WORD_ELLIPSIS) {
-          // Only in this condition should we calculate the ellipsis width.
-          pango_layout_set_text(layout, kEllipsisText, -1);
-          pango_layout_get_pixel_extents(layout, NULL, &pos);
-          ellipsis_width = pos.width;
-          pango_layout_set_text(layout, newtext.c_str(), -1);
-        }
-
-        // Figure out how many characters can be displayed.
-        std::vector<int> cluster_index;
-        PangoLayoutIter *it = pango_layout_get_iter(layout);
-        // A cluster is the smallest linguistic unit that can be shaped.
-        do {
-          cluster_index.push_back(pango_layout_iter_get_index(it));
-        } while (pango_layout_iter_next_cluster(it));
-        cluster_index.push_back(static_cast<int>(newtext.size()));
-        std::sort(cluster_index.begin(), cluster_index.end());
-
-        std::vector<int>::iterator cluster_it = cluster_index.begin();
-        for (; cluster_it != cluster_index.end(); ++cluster_it) {
-          pango_layout_set_text(layout, newtext.c_str(), *cluster_it);
-          pango_layout_get_pixel_extents(layout, NULL, &pos);
-          if (pos.width > width - ellipsis_width)
-            break;
-        }
-
-        // Use conceal_index to represent the first byte that won't be displayed.
-        int conceal_index = 0;
-        if (cluster_it != cluster_index.begin())
-          conceal_index = *(--cluster_it);
-
-        // Get the text that will finally be displayed.
-        if (trimming == TRIMMING_CHARACTER) {
-          // In "character", just show the characters before the index.
-          pango_layout_set_text(layout, newtext.c_str(), conceal_index);
-        } else {
-          // In "word" or "word-ellipsis" trimming, we have to find out where
-          // last word stops. If we can't find out a reasonable position, then
-          // just do trimming as in "character".
-          PangoLogAttr *log_attrs;
-          int n_attrs;
-          pango_layout_get_log_attrs(layout, &log_attrs, &n_attrs);
-          int off = static_cast<int>(g_utf8_pointer_to_offset(newtext.c_str(),
-                                             newtext.c_str() + conceal_index));
-          while (off > 0 && !log_attrs[off].is_word_end &&
-                 !log_attrs[off].is_word_start)
-            --off;
-          if (off > 0) {
-            conceal_index =
-               static_cast<int>(g_utf8_offset_to_pointer(newtext.c_str(), off) -
-                                newtext.c_str());
-          }
-          newtext.erase(conceal_index);
-
-          // In word-ellipsis, we have to append the ellipsis manualy.
-          if (trimming == TRIMMING_WORD_ELLIPSIS)
-            newtext.append(kEllipsisText);
-
-          pango_layout_set_text(layout, newtext.c_str(), -1);
-        }
-
-        // We also have to do the horizontal alignment.
-        pango_layout_get_pixel_extents(layout, NULL, &pos);
-        if (align == ALIGN_CENTER)
-          real_x = x + (width - pos.width) / 2;
-        else if (align == ALIGN_RIGHT)
-          real_x = x + width - pos.width;
+        pango_cairo_show_layout(cr_, layout->layout);
       }
 
       // Show the trimmed text.
-      cairo_move_to(cr_, real_x, real_y);
-      pango_cairo_show_layout(cr_, layout);
+      cairo_move_to(cr_, real_x + layout->trimmed_x,
+                    real_y + layout->trimmed_y);
+      pango_cairo_show_layout(cr_, layout->trimmed);
     }
 
-    g_object_unref(layout);
     cairo_restore(cr_);
 
     return true;
@@ -795,23 +855,17 @@ bool CairoCanvas::GetTextExtents(const char *text, const FontInterface *f,
     return true;
   }
 
-  const CairoFont *font = down_cast<const CairoFont*>(f);
-  PangoLayout *layout = impl_->CreatePangoLayout();
-  pango_layout_set_text(layout, text, -1);
-  pango_layout_set_font_description(layout, font->GetFontDescription());
-
   if (in_width <= 0) {
     text_flags &= ~TEXT_FLAGS_WORDWRAP;
   }
-  SetPangoLayoutAttrFromTextFlags(layout, text_flags, in_width);
 
-  // Get the pixel extents(logical extents) of the layout.
-  int w, h;
-  pango_layout_get_pixel_size(layout, &w, &h);
-  *width = w;
-  *height = h;
-
-  g_object_unref(layout);
+  const CairoFont *font = down_cast<const CairoFont*>(f);
+  const TextLayout *layout =
+      GetTextLayout(PangoLayoutCache::GetDefault(), text,
+                    font->GetFontDescription(), text_flags, in_width,
+                    ALIGN_LEFT);
+  *width = layout->width;
+  *height = layout->height;
   return true;
 }
 
@@ -20,12 +20,17 @@
 #include <gtk/gtk.h>
 #include <glib/gthread.h>
 #include <ggadget/common.h>
+#include <ggadget/small_object.h>
 #include "main_loop.h"
 #include "utilities.h"
 
 namespace ggadget {
 namespace gtk {
 
+// Interval in milliseconds of returning the blocks cached by the main thread
+// and the spare slabs of the small object allocator to the system.
+static const int kTrimMemoryInterval = 30000;
+
 class MainLoop::Impl {
   struct WatchNode {
     MainLoopInterface::WatchType type;
@@ -68,9 +73,14 @@ class MainLoop::Impl {
                                      NULL,
                                      NodeDestroyCallback);
     ASSERT(watches_);
+    // The low priority makes the trimming wait until the main loop is idle.
+    trim_memory_source_ = g_timeout_add_full(G_PRIORITY_LOW,
+                                             kTrimMemoryInterval,
+                                             TrimMemoryCallback, NULL, NULL);
   }
 
   ~Impl() {
+    g_source_remove(trim_memory_source_);
     g_static_mutex_lock(&mutex_);
     destroyed_ = true;
     g_hash_table_foreach_remove(watches_, ForeachRemoveCallback, this);
@@ -293,8 +303,14 @@ class MainLoop::Impl {
     return false;
   }
 
+  static gboolean TrimMemoryCallback(gpointer data) {
+    AllocatorSingleton<>::Instance().TrimExcessMemory();
+    return TRUE;
+  }
+
   MainLoopInterface *main_loop_;
   GHashTable *watches_;
+  guint trim_memory_source_;
 
   GStaticMutex mutex_;
   bool destroyed_;
@@ -0,0 +1,278 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <sys/time.h>
+#include <cstring>
+#include <list>
+#include <string>
+#include <cairo.h>
+#include <pango/pangocairo.h>
+#include <ggadget/format_macros.h>
+#include <ggadget/light_map.h>
+#include <ggadget/logger.h>
+#include "pango_layout_cache.h"
+
+namespace ggadget {
+namespace gtk {
+
+// The budget of the default cache, which is enough for the texts of a few
+// views, e.g. several hundreds of candidate strings.
+static const size_t kDefaultMemoryBudget = 1024 * 1024;
+
+// The estimated memory used by a PangoLayout object without text, and by each
+// byte of its text, including the lines, glyph strings and log attributes.
+static const size_t kLayoutOverhead = 512;
+static const size_t kLayoutBytesPerTextByte = 40;
+
+static uint64_t GetMicroseconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+TextLayout::TextLayout()
+  : layout(NULL), trimmed(NULL), width(0), height(0), line_count(0),
+    trimmed_x(0), trimmed_y(0) {
+}
+
+TextLayout::~TextLayout() {
+  if (layout)
+    g_object_unref(layout);
+  if (trimmed)
+    g_object_unref(trimmed);
+}
+
+PangoLayoutCache::Key::Key(const char *text_in,
+                           const PangoFontDescription *font_in,
+                           int text_flags_in, double width_in,
+                           CanvasInterface::Alignment align_in,
+                           CanvasInterface::Trimming trimming_in,
+                           int lines_in)
+  : text(text_in), text_flags(text_flags_in), width(width_in),
+    align(align_in), trimming(trimming_in), lines(lines_in) {
+  char *font_string = pango_font_description_to_string(font_in);
+  font = font_string;
+  g_free(font_string);
+  if (trimming == CanvasInterface::TRIMMING_NONE &&
+      !(text_flags & CanvasInterface::TEXT_FLAGS_WORDWRAP)) {
+    width = -1;
+    align = CanvasInterface::ALIGN_LEFT;
+  }
+  if (trimming == CanvasInterface::TRIMMING_NONE)
+    lines = 0;
+}
+
+bool PangoLayoutCache::Key::operator<(const Key &another) const {
+  if (text_flags != another.text_flags)
+    return text_flags < another.text_flags;
+  if (width != another.width)
+    return width < another.width;
+  if (align != another.align)
+    return align < another.align;
+  if (trimming != another.trimming)
+    return trimming < another.trimming;
+  if (lines != another.lines)
+    return lines < another.lines;
+  int result = text.compare(another.text);
+  if (result != 0)
+    return result < 0;
+  return font < another.font;
+}
+
+class PangoLayoutCache::Impl {
+ public:
+  struct Entry {
+    Key key;
+    TextLayout *layout;
+    size_t memory_usage;
+
+    Entry(const Key &key_in, TextLayout *layout_in, size_t memory_usage_in)
+      : key(key_in), layout(layout_in), memory_usage(memory_usage_in) {
+    }
+  };
+  // The most recently used entry is at the front.
+  typedef std::list<Entry> EntryList;
+  typedef LightMap<Key, EntryList::iterator> EntryMap;
+
+  Impl(size_t memory_budget)
+    : context_(NULL), memory_budget_(memory_budget), memory_usage_(0),
+      hits_(0), misses_(0), evictions_(0), miss_time_(0),
+      shaping_time_(0) {
+  }
+
+  ~Impl() {
+    DLOG("PangoLayoutCache statistics(hits/misses/evictions): "
+         "%" PRIuS "/%" PRIuS "/%" PRIuS, hits_, misses_, evictions_);
+    Clear();
+    if (context_)
+      cairo_destroy(context_);
+  }
+
+  PangoLayout *CreateLayout() {
+    if (!context_) {
+      cairo_surface_t *surface =
+          cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+      context_ = cairo_create(surface);
+      cairo_surface_destroy(surface);
+    }
+    return pango_cairo_create_layout(context_);
+  }
+
+  const TextLayout *Lookup(const Key &key) {
+    EntryMap::iterator it = entries_.find(key);
+    if (it == entries_.end()) {
+      ++misses_;
+      // The layout of a missed key is shaped and inserted right away, so the
+      // time until the insertion is the shaping time.
+      miss_time_ = GetMicroseconds();
+      return NULL;
+    }
+    ++hits_;
+    // Moves the entry to the front without copying it.
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->layout;
+  }
+
+  const TextLayout *Insert(const Key &key, TextLayout *layout) {
+    ASSERT(layout);
+    ASSERT(entries_.find(key) == entries_.end());
+    if (miss_time_) {
+      shaping_time_ += GetMicroseconds() - miss_time_;
+      miss_time_ = 0;
+    }
+    size_t memory_usage = sizeof(Entry) + sizeof(TextLayout) +
+                          key.text.size() * 2 + key.font.size() * 2 +
+                          GetLayoutMemoryUsage(layout->layout) +
+                          GetLayoutMemoryUsage(layout->trimmed);
+    lru_.push_front(Entry(key, layout, memory_usage));
+    entries_[key] = lru_.begin();
+    memory_usage_ += memory_usage;
+    Evict(memory_budget_);
+    return layout;
+  }
+
+  // Evicts the least recently used entries except the most recently used one
+  // until the memory usage doesn't exceed the budget.
+  void Evict(size_t budget) {
+    while (memory_usage_ > budget && lru_.size() > 1) {
+      Entry &entry = lru_.back();
+      memory_usage_ -= entry.memory_usage;
+      entries_.erase(entry.key);
+      delete entry.layout;
+      lru_.pop_back();
+      ++evictions_;
+    }
+  }
+
+  void Clear() {
+    for (EntryList::iterator it = lru_.begin(); it != lru_.end(); ++it)
+      delete it->layout;
+    lru_.clear();
+    entries_.clear();
+    memory_usage_ = 0;
+  }
+
+  static size_t GetLayoutMemoryUsage(PangoLayout *layout) {
+    if (!layout)
+      return 0;
+    const char *text = pango_layout_get_text(layout);
+    return kLayoutOverhead +
+           (text ? strlen(text) : 0) * kLayoutBytesPerTextByte;
+  }
+
+  cairo_t *context_;
+  EntryList lru_;
+  EntryMap entries_;
+  size_t memory_budget_;
+  size_t memory_usage_;
+  size_t hits_;
+  size_t misses_;
+  size_t evictions_;
+  uint64_t miss_time_;
+  uint64_t shaping_time_;
+};
+
+PangoLayoutCache::PangoLayoutCache(size_t memory_budget)
+  : impl_(new Impl(memory_budget)) {
+}
+
+PangoLayoutCache::~PangoLayoutCache() {
+  delete impl_;
+  impl_ = NULL;
+}
+
+PangoLayoutCache *PangoLayoutCache::GetDefault() {
+  static PangoLayoutCache cache(kDefaultMemoryBudget);
+  return &cache;
+}
+
+PangoLayout *PangoLayoutCache::CreateLayout() {
+  return impl_->CreateLayout();
+}
+
+const TextLayout *PangoLayoutCache::Lookup(const Key &key) {
+  return impl_->Lookup(key);
+}
+
+const TextLayout *PangoLayoutCache::Insert(const Key &key,
+                                           TextLayout *layout) {
+  return impl_->Insert(key, layout);
+}
+
+void PangoLayoutCache::Clear() {
+  impl_->Clear();
+}
+
+void PangoLayoutCache::SetMemoryBudget(size_t memory_budget) {
+  impl_->memory_budget_ = memory_budget;
+  impl_->Evict(memory_budget);
+}
+
+size_t PangoLayoutCache::GetMemoryBudget() const {
+  return impl_->memory_budget_;
+}
+
+size_t PangoLayoutCache::GetMemoryUsage() const {
+  return impl_->memory_usage_;
+}
+
+size_t PangoLayoutCache::GetCount() const {
+  return impl_->lru_.size();
+}
+
+size_t PangoLayoutCache::GetHits() const {
+  return impl_->hits_;
+}
+
+size_t PangoLayoutCache::GetMisses() const {
+  return impl_->misses_;
+}
+
+size_t PangoLayoutCache::GetEvictions() const {
+  return impl_->evictions_;
+}
+
+uint64_t PangoLayoutCache::GetShapingTime() const {
+  return impl_->shaping_time_;
+}
+
+double PangoLayoutCache::GetHitRate() const {
+  size_t lookups = impl_->hits_ + impl_->misses_;
+  return lookups ? static_cast<double>(impl_->hits_) / lookups : 0;
+}
+
+} // namespace gtk
+} // namespace ggadget
@@ -0,0 +1,164 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef GGADGET_GTK_PANGO_LAYOUT_CACHE_H__
+#define GGADGET_GTK_PANGO_LAYOUT_CACHE_H__
+
+#include <string>
+#include <pango/pango.h>
+#include <ggadget/common.h>
+#include <ggadget/canvas_interface.h>
+
+namespace ggadget {
+namespace gtk {
+
+/**
+ * The shaped layouts of a piece of text, which can be drawn repeatedly
+ * without laying out the text again.
+ *
+ * An untrimmed layout only has @c layout, which contains the whole text. A
+ * trimmed layout has the lines above the trimmed line in @c layout, which is
+ * NULL if there is only one displayed line, and the trimmed line in
+ * @c trimmed. The layouts are released on destruction.
+ */
+struct TextLayout {
+  TextLayout();
+  ~TextLayout();
+
+  PangoLayout *layout;
+  PangoLayout *trimmed;
+  /** The logical pixel extents of @c layout. */
+  int width;
+  int height;
+  int line_count;
+  /** The position of @c trimmed relative to the top left of the text. */
+  double trimmed_x;
+  double trimmed_y;
+
+ private:
+  DISALLOW_EVIL_CONSTRUCTORS(TextLayout);
+};
+
+/**
+ * A bounded cache of the TextLayout objects shared by text drawing and
+ * measurement of all CairoCanvas objects, so that the same strings, e.g. the
+ * items of a candidate list, needn't be shaped again on every redraw.
+ *
+ * The least recently used layouts are evicted when the estimated memory used
+ * by the cached layouts exceeds the memory budget. The cache must only be
+ * used in the main thread.
+ */
+class PangoLayoutCache {
+ public:
+  /**
+   * The key of a cached layout. The width and alignment are ignored if they
+   * don't affect the layout, i.e. the text is neither word wrapped nor
+   * trimmed, so that measuring and drawing the text share the same layout.
+   */
+  struct Key {
+    /**
+     * @param text the text.
+     * @param font the font of the text.
+     * @param text_flags the text formats, see CanvasInterface::TextFlag.
+     * @param width the width of the box containing the text.
+     * @param align the horizontal alignment.
+     * @param trimming the trimming mode.
+     * @param lines the number of displayed lines of a trimmed layout, or 0 if
+     *     the layout isn't trimmed.
+     */
+    Key(const char *text, const PangoFontDescription *font, int text_flags,
+        double width, CanvasInterface::Alignment align,
+        CanvasInterface::Trimming trimming, int lines);
+
+    bool operator<(const Key &another) const;
+
+    std::string text;
+    std::string font;
+    int text_flags;
+    double width;
+    int align;
+    int trimming;
+    int lines;
+  };
+
+  /**
+   * @param memory_budget the maximum bytes of memory used by the cached
+   *     layouts.
+   */
+  explicit PangoLayoutCache(size_t memory_budget);
+  ~PangoLayoutCache();
+
+  /** Gets the cache shared by all CairoCanvas objects. */
+  static PangoLayoutCache *GetDefault();
+
+  /**
+   * Creates an empty PangoLayout suitable to be cached. The layout is created
+   * with a cairo context that isn't scaled at all, otherwise some text layout
+   * behavior will be wrong.
+   */
+  PangoLayout *CreateLayout();
+
+  /**
+   * Looks up the layout of a key, and marks it as the most recently used.
+   * @return the cached layout, or NULL if it isn't cached. It's only valid
+   *     until the next call to Insert() or Clear().
+   */
+  const TextLayout *Lookup(const Key &key);
+
+  /**
+   * Adds a layout to the cache and evicts the least recently used layouts to
+   * keep the memory usage within the budget. The new layout itself is never
+   * evicted by this call.
+   * @param key the key of the layout, which mustn't be cached already.
+   * @param layout the layout, whose ownership is taken by the cache.
+   * @return @a layout, which is only valid until the next call to Insert() or
+   *     Clear().
+   */
+  const TextLayout *Insert(const Key &key, TextLayout *layout);
+
+  /** Removes all cached layouts. The statistics are kept. */
+  void Clear();
+
+  void SetMemoryBudget(size_t memory_budget);
+  size_t GetMemoryBudget() const;
+
+  /** Gets the estimated bytes of memory used by the cached layouts. */
+  size_t GetMemoryUsage() const;
+  size_t GetCount() const;
+
+  /** The statistics of the cache. */
+  size_t GetHits() const;
+  size_t GetMisses() const;
+  size_t GetEvictions() const;
+  /** Gets the ratio of hits to lookups, or 0 if there is no lookup. */
+  double GetHitRate() const;
+  /**
+   * Gets the total microseconds spent on shaping the missed texts, i.e.
+   * between the missed lookups and the insertion of their layouts.
+   */
+  uint64_t GetShapingTime() const;
+
+ private:
+  class Impl;
+  Impl *impl_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(PangoLayoutCache);
+};
+
+} // namespace gtk
+} // namespace ggadget
+
+#endif // GGADGET_GTK_PANGO_LAYOUT_CACHE_H__
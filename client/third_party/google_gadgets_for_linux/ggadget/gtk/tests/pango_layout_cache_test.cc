@@ -0,0 +1,185 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <pango/pango.h>
+
+#include "ggadget/common.h"
+#include "ggadget/color.h"
+#include "ggadget/canvas_interface.h"
+#include "ggadget/font_interface.h"
+#include "ggadget/gtk/cairo_canvas.h"
+#include "ggadget/gtk/cairo_graphics.h"
+#include "ggadget/gtk/pango_layout_cache.h"
+#include "unittest/gtest.h"
+
+using namespace ggadget;
+using namespace ggadget::gtk;
+
+class PangoLayoutCacheTest : public testing::Test {
+ protected:
+  PangoLayoutCacheTest()
+      : font_(pango_font_description_from_string("Sans 10")) {
+  }
+
+  ~PangoLayoutCacheTest() {
+    pango_font_description_free(font_);
+  }
+
+  TextLayout *NewLayout(PangoLayoutCache *cache, const char *text) {
+    TextLayout *layout = new TextLayout;
+    layout->layout = cache->CreateLayout();
+    pango_layout_set_text(layout->layout, text, -1);
+    return layout;
+  }
+
+  PangoLayoutCache::Key MakeKey(const char *text) {
+    return PangoLayoutCache::Key(text, font_, 0, 100,
+                                 CanvasInterface::ALIGN_LEFT,
+                                 CanvasInterface::TRIMMING_NONE, 0);
+  }
+
+  PangoFontDescription *font_;
+};
+
+TEST_F(PangoLayoutCacheTest, LookupAndInsert) {
+  PangoLayoutCache cache(1024 * 1024);
+  EXPECT_TRUE(cache.Lookup(MakeKey("hello")) == NULL);
+  TextLayout *layout = NewLayout(&cache, "hello");
+  EXPECT_EQ(layout, cache.Insert(MakeKey("hello"), layout));
+  EXPECT_EQ(layout, cache.Lookup(MakeKey("hello")));
+  EXPECT_TRUE(cache.Lookup(MakeKey("world")) == NULL);
+  EXPECT_EQ(1U, cache.GetCount());
+  EXPECT_GT(cache.GetMemoryUsage(), 0U);
+  EXPECT_EQ(1U, cache.GetHits());
+  EXPECT_EQ(2U, cache.GetMisses());
+  EXPECT_DOUBLE_EQ(1.0 / 3, cache.GetHitRate());
+
+  cache.Clear();
+  EXPECT_EQ(0U, cache.GetCount());
+  EXPECT_EQ(0U, cache.GetMemoryUsage());
+  EXPECT_TRUE(cache.Lookup(MakeKey("hello")) == NULL);
+}
+
+TEST_F(PangoLayoutCacheTest, KeyNormalization) {
+  // The width and alignment don't affect texts neither wrapped nor trimmed.
+  PangoLayoutCache::Key key1("text", font_, 0, 100,
+                             CanvasInterface::ALIGN_LEFT,
+                             CanvasInterface::TRIMMING_NONE, 0);
+  PangoLayoutCache::Key key2("text", font_, 0, 50,
+                             CanvasInterface::ALIGN_RIGHT,
+                             CanvasInterface::TRIMMING_NONE, 3);
+  EXPECT_FALSE(key1 < key2);
+  EXPECT_FALSE(key2 < key1);
+
+  PangoLayoutCache::Key key3("text", font_,
+                             CanvasInterface::TEXT_FLAGS_WORDWRAP, 100,
+                             CanvasInterface::ALIGN_LEFT,
+                             CanvasInterface::TRIMMING_NONE, 0);
+  PangoLayoutCache::Key key4("text", font_,
+                             CanvasInterface::TEXT_FLAGS_WORDWRAP, 50,
+                             CanvasInterface::ALIGN_LEFT,
+                             CanvasInterface::TRIMMING_NONE, 0);
+  EXPECT_TRUE(key3 < key4 || key4 < key3);
+
+  PangoFontDescription *bold =
+      pango_font_description_from_string("Sans Bold 10");
+  PangoLayoutCache::Key key5("text", bold, 0, 100,
+                             CanvasInterface::ALIGN_LEFT,
+                             CanvasInterface::TRIMMING_NONE, 0);
+  EXPECT_TRUE(key1 < key5 || key5 < key1);
+  pango_font_description_free(bold);
+}
+
+TEST_F(PangoLayoutCacheTest, EvictLeastRecentlyUsed) {
+  PangoLayoutCache cache(1024 * 1024);
+  cache.Insert(MakeKey("a"), NewLayout(&cache, "a"));
+  size_t entry_usage = cache.GetMemoryUsage();
+  cache.Insert(MakeKey("b"), NewLayout(&cache, "b"));
+  cache.Insert(MakeKey("c"), NewLayout(&cache, "c"));
+  EXPECT_EQ(3U, cache.GetCount());
+
+  // "a" becomes the most recently used, so "b" is evicted first.
+  EXPECT_TRUE(cache.Lookup(MakeKey("a")) != NULL);
+  cache.SetMemoryBudget(entry_usage * 2);
+  EXPECT_EQ(2U, cache.GetCount());
+  EXPECT_EQ(1U, cache.GetEvictions());
+  EXPECT_TRUE(cache.Lookup(MakeKey("b")) == NULL);
+  EXPECT_TRUE(cache.Lookup(MakeKey("a")) != NULL);
+  EXPECT_TRUE(cache.Lookup(MakeKey("c")) != NULL);
+
+  cache.Insert(MakeKey("d"), NewLayout(&cache, "d"));
+  EXPECT_EQ(2U, cache.GetCount());
+  EXPECT_TRUE(cache.Lookup(MakeKey("a")) == NULL);
+  EXPECT_LE(cache.GetMemoryUsage(), cache.GetMemoryBudget());
+
+  // The newly inserted layout is kept even if it exceeds the budget.
+  cache.SetMemoryBudget(0);
+  EXPECT_EQ(1U, cache.GetCount());
+  EXPECT_TRUE(cache.Lookup(MakeKey("d")) != NULL);
+}
+
+TEST_F(PangoLayoutCacheTest, CanvasSharesLayouts) {
+  CairoGraphics gfx(1.0);
+  CanvasInterface *canvas = gfx.NewCanvas(300, 150);
+  FontInterface *font = gfx.NewFont("Sans", 10, FontInterface::STYLE_NORMAL,
+                                    FontInterface::WEIGHT_NORMAL);
+  PangoLayoutCache *cache = PangoLayoutCache::GetDefault();
+  cache->Clear();
+
+  double width1, height1, width2, height2;
+  size_t misses = cache->GetMisses();
+  ASSERT_TRUE(canvas->GetTextExtents("candidate", font, 0, 0,
+                                     &width1, &height1));
+  EXPECT_EQ(misses + 1, cache->GetMisses());
+
+  // Drawing the measured text reuses its layout without shaping it again.
+  size_t hits = cache->GetHits();
+  uint64_t shaping_time = cache->GetShapingTime();
+  EXPECT_TRUE(canvas->DrawText(0, 0, 200, 30, "candidate", font,
+                               Color(1, 0, 0), CanvasInterface::ALIGN_CENTER,
+                               CanvasInterface::VALIGN_MIDDLE,
+                               CanvasInterface::TRIMMING_NONE, 0));
+  EXPECT_EQ(hits + 1, cache->GetHits());
+  ASSERT_TRUE(canvas->GetTextExtents("candidate", font, 0, 0,
+                                     &width2, &height2));
+  EXPECT_EQ(hits + 2, cache->GetHits());
+  EXPECT_EQ(shaping_time, cache->GetShapingTime());
+  EXPECT_EQ(width1, width2);
+  EXPECT_EQ(height1, height2);
+
+  // Trimmed layouts are cached as well.
+  const char *long_text = "a long candidate which doesn't fit in the box";
+  EXPECT_TRUE(canvas->DrawText(0, 0, 50, 20, long_text, font,
+                               Color(1, 0, 0), CanvasInterface::ALIGN_LEFT,
+                               CanvasInterface::VALIGN_TOP,
+                               CanvasInterface::TRIMMING_WORD_ELLIPSIS, 0));
+  hits = cache->GetHits();
+  misses = cache->GetMisses();
+  EXPECT_TRUE(canvas->DrawText(0, 0, 50, 20, long_text, font,
+                               Color(1, 0, 0), CanvasInterface::ALIGN_LEFT,
+                               CanvasInterface::VALIGN_TOP,
+                               CanvasInterface::TRIMMING_WORD_ELLIPSIS, 0));
+  EXPECT_EQ(hits + 2, cache->GetHits());
+  EXPECT_EQ(misses, cache->GetMisses());
+
+  font->Destroy();
+  canvas->Destroy();
+}
+
+int main(int argc, char **argv) {
+  testing::ParseGTestFlags(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -15,6 +15,7 @@
 */
 
 #include <string>
+#include <list>
 #include <map>
 #include <algorithm>
 #include "common.h"
@@ -39,6 +40,12 @@ namespace {
 
 const int kPurgeTrashInterval = 60000;  // 60 seconds
 
+// Enough for the unused images of a few skins besides the images in use.
+const size_t kDefaultMemoryBudget = 8 * 1024 * 1024;
+
+// Decoded images are stored as 32-bit ARGB pixels.
+const size_t kBytesPerPixel = 4;
+
 }  // namespace
 
 namespace ggadget {
@@ -46,7 +53,20 @@ namespace ggadget {
 class ImageCache::Impl : public WatchCallbackInterface {
   class SharedImage;
   typedef LightMap<std::string, SharedImage *> ImageMap;
-  typedef LightMap<std::string, ImageInterface *> TrashImageMap;
+
+  struct TrashedImage {
+    TrashedImage(const std::string &key_in, ImageInterface *image_in,
+                 bool is_mask_in, size_t bytes_in)
+        : key(key_in), image(image_in), is_mask(is_mask_in), bytes(bytes_in) {
+    }
+    std::string key;
+    ImageInterface *image;
+    bool is_mask;
+    size_t bytes;
+  };
+  // The most recently trashed image is at the front.
+  typedef std::list<TrashedImage> TrashList;
+  typedef LightMap<std::string, TrashList::iterator> TrashImageMap;
 
   class SharedImage : public ImageInterface {
    public:
@@ -60,6 +80,7 @@ class ImageCache::Impl : public WatchCallbackInterface {
           tag_(tag),
           image_(image),
           is_mask_(is_mask),
+          bytes_(GetImageBytes(image)),
           ref_(1) {
     }
     virtual ~SharedImage() {
@@ -67,7 +88,7 @@ class ImageCache::Impl : public WatchCallbackInterface {
       DLOG("Destroy image %s", key_.c_str());
 #endif
       if (owner_)
-        owner_->Trash(key_, image_, is_mask_);
+        owner_->Trash(key_, image_, is_mask_, bytes_);
       else if (image_)
         image_->Destroy();
     }
@@ -133,11 +154,15 @@ class ImageCache::Impl : public WatchCallbackInterface {
     std::string tag_;
     ImageInterface *image_;
     bool is_mask_;
+    size_t bytes_;
     int ref_;
   };
 
  public:
-  Impl() : ref_(0), watch_id_(-1) {
+  Impl()
+      : memory_budget_(kDefaultMemoryBudget), resident_bytes_(0),
+        unused_bytes_(0), hits_(0), misses_(0), evictions_(0),
+        ref_(0), watch_id_(-1) {
 #ifdef DEBUG_IMAGE_CACHE
     DLOG("Create ImageCache: %p", this);
     num_new_local_images_ = 0;
@@ -167,6 +192,8 @@ class ImageCache::Impl : public WatchCallbackInterface {
          images_.size() + mask_images_.size(),
          num_trashed_images_, num_untrashed_images_);
 #endif
+    DLOG("ImageCache statistics(hits/misses/evictions): "
+         "%" PRIuS "/%" PRIuS "/%" PRIuS, hits_, misses_, evictions_);
     for (ImageMap::const_iterator it = images_.begin();
          it != images_.end(); ++it) {
       DLOG("!!! Image leak: %s", it->first.c_str());
@@ -216,6 +243,7 @@ class ImageCache::Impl : public WatchCallbackInterface {
         num_shared_local_images_++;
         DLOG("Local image %s found in cache.", local_key.c_str());
 #endif
+        ++hits_;
         it->second->Ref();
         return it->second;
       }
@@ -229,6 +257,7 @@ class ImageCache::Impl : public WatchCallbackInterface {
         num_shared_global_images_++;
         DLOG("Global image %s found in cache.", global_key.c_str());
 #endif
+        ++hits_;
         it->second->Ref();
         return it->second;
       }
@@ -240,15 +269,20 @@ class ImageCache::Impl : public WatchCallbackInterface {
     // Find the image in trash can first.
     if (fm) {
       img = Untrash(local_key, is_mask);
-      if (img)
+      if (img) {
+        ++hits_;
         return NewSharedImage(local_key, filename, img, is_mask);
+      }
     }
     if (global_fm) {
       img = Untrash(global_key, is_mask);
-      if (img)
+      if (img) {
+        ++hits_;
         return NewSharedImage(global_key, filename, img, is_mask);
+      }
     }
 
+    ++misses_;
     std::string data;
     std::string key;
     if (fm && fm->ReadFile(filename.c_str(), &data)) {
@@ -291,10 +325,20 @@ class ImageCache::Impl : public WatchCallbackInterface {
     SharedImage *shared_img =
         new SharedImage(this, key, tag, image, is_mask);
     (*image_map)[key] = shared_img;
+    resident_bytes_ += shared_img->bytes_;
+    Evict(memory_budget_);
     return shared_img;
   }
 
-  void Trash(const std::string &key, ImageInterface *image, bool is_mask) {
+  static size_t GetImageBytes(const ImageInterface *image) {
+    if (!image)
+      return 0;
+    return static_cast<size_t>(image->GetWidth()) *
+           static_cast<size_t>(image->GetHeight()) * kBytesPerPixel;
+  }
+
+  void Trash(const std::string &key, ImageInterface *image, bool is_mask,
+             size_t bytes) {
     ImageMap *images = is_mask ? &mask_images_ : &images_;
     images->erase(key);
 
@@ -307,7 +351,10 @@ class ImageCache::Impl : public WatchCallbackInterface {
 #endif
     TrashImageMap *trash = is_mask ? &trashed_mask_images_ : &trashed_images_;
     ASSERT(!trash->count(key));
-    (*trash)[key] = image;
+    trash_list_.push_front(TrashedImage(key, image, is_mask, bytes));
+    (*trash)[key] = trash_list_.begin();
+    unused_bytes_ += bytes;
+    Evict(memory_budget_);
   }
 
   ImageInterface* Untrash(const std::string &key, bool is_mask) {
@@ -318,31 +365,49 @@ class ImageCache::Impl : public WatchCallbackInterface {
       DLOG("Untrash image: %s", key.c_str());
       num_untrashed_images_++;
 #endif
-      ImageInterface *image = i->second;
+      ImageInterface *image = i->second->image;
+      // The bytes will be added back by NewSharedImage().
+      resident_bytes_ -= i->second->bytes;
+      unused_bytes_ -= i->second->bytes;
+      trash_list_.erase(i->second);
       trash->erase(i);
       return image;
     }
     return NULL;
   }
 
-  void PurgeTrashCan() {
+  // Destroys the least recently trashed images until the memory used by the
+  // cached images doesn't exceed the budget.
+  void Evict(size_t budget) {
+    while (resident_bytes_ > budget && !trash_list_.empty()) {
+      TrashedImage &trashed = trash_list_.back();
 #ifdef DEBUG_IMAGE_CACHE
-    DLOG("Purge trashed images: %"PRIuS,
-         trashed_images_.size() + trashed_mask_images_.size());
+      DLOG("Evict image: %s", trashed.key.c_str());
 #endif
-    for (TrashImageMap::const_iterator it = trashed_images_.begin();
-         it != trashed_images_.end(); ++it) {
-      if (it->second)
-        it->second->Destroy();
+      TrashImageMap *trash =
+          trashed.is_mask ? &trashed_mask_images_ : &trashed_images_;
+      trash->erase(trashed.key);
+      resident_bytes_ -= trashed.bytes;
+      unused_bytes_ -= trashed.bytes;
+      trashed.image->Destroy();
+      trash_list_.pop_back();
+      ++evictions_;
     }
-    trashed_images_.clear();
+  }
 
-    for (TrashImageMap::const_iterator it = trashed_mask_images_.begin();
-         it != trashed_mask_images_.end(); ++it) {
-      if (it->second)
-        it->second->Destroy();
+  void PurgeTrashCan() {
+#ifdef DEBUG_IMAGE_CACHE
+    DLOG("Purge trashed images: %"PRIuS, trash_list_.size());
+#endif
+    for (TrashList::const_iterator it = trash_list_.begin();
+         it != trash_list_.end(); ++it) {
+      it->image->Destroy();
     }
+    trash_list_.clear();
+    trashed_images_.clear();
     trashed_mask_images_.clear();
+    resident_bytes_ -= unused_bytes_;
+    unused_bytes_ = 0;
   }
 
   void Ref() {
@@ -387,10 +452,21 @@ class ImageCache::Impl : public WatchCallbackInterface {
 #endif
   }
 
+ public:
+  size_t memory_budget_;
+  // The bytes of all cached images, including the ones in the trash can.
+  size_t resident_bytes_;
+  // The bytes of the images in the trash can.
+  size_t unused_bytes_;
+  size_t hits_;
+  size_t misses_;
+  size_t evictions_;
+
  private:
   ImageMap images_;
   ImageMap mask_images_;
 
+  TrashList trash_list_;
   TrashImageMap trashed_images_;
   TrashImageMap trashed_mask_images_;
 
@@ -430,4 +506,33 @@ ImageInterface *ImageCache::LoadImage(GraphicsInterface *gfx,
   return impl_->LoadImage(gfx, fm, filename, is_mask);
 }
 
+void ImageCache::SetMemoryBudget(size_t memory_budget) {
+  impl_->memory_budget_ = memory_budget;
+  impl_->Evict(memory_budget);
+}
+
+size_t ImageCache::GetMemoryBudget() const {
+  return impl_->memory_budget_;
+}
+
+size_t ImageCache::GetResidentBytes() const {
+  return impl_->resident_bytes_;
+}
+
+size_t ImageCache::GetUnusedBytes() const {
+  return impl_->unused_bytes_;
+}
+
+size_t ImageCache::GetHits() const {
+  return impl_->hits_;
+}
+
+size_t ImageCache::GetMisses() const {
+  return impl_->misses_;
+}
+
+size_t ImageCache::GetEvictions() const {
+  return impl_->evictions_;
+}
+
 } // namespace ggadget
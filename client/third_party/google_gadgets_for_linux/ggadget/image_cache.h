@@ -34,7 +34,14 @@ namespace ggadget {
  * From the caller point of view, image objects created by ImageCache can be
  * used as normal image without any difference.
  *
- * Each View shall have its own ImageCache object.
+ * Each View shall have its own ImageCache object. All ImageCache objects (of
+ * the same thread on Windows) share the same underlying cache, so an image
+ * used by several views is only decoded once.
+ *
+ * The images no longer used by any view are kept for a while in case they
+ * are loaded again. They are released when the estimated memory used by the
+ * decoded pixels of all cached images exceeds the memory budget, the least
+ * recently released first, or when they haven't been used for a minute.
  */
 class ImageCache {
  public:
@@ -54,6 +61,27 @@ class ImageCache {
   ImageInterface *LoadImage(GraphicsInterface *gfx, FileManagerInterface *fm,
                             const std::string &filename, bool is_mask);
 
+  /**
+   * Sets the maximum bytes of the decoded pixels of the cached images. The
+   * images in use are never released, so the budget only limits how many
+   * unused images are kept.
+   */
+  void SetMemoryBudget(size_t memory_budget);
+  size_t GetMemoryBudget() const;
+
+  /** Gets the estimated bytes of the decoded pixels of all cached images. */
+  size_t GetResidentBytes() const;
+  /** Gets the estimated bytes of the decoded pixels of the unused images. */
+  size_t GetUnusedBytes() const;
+
+  /**
+   * The statistics of the cache. An image shared with another view or reused
+   * after being released is a hit, an image decoded from its file is a miss.
+   */
+  size_t GetHits() const;
+  size_t GetMisses() const;
+  size_t GetEvictions() const;
+
  private:
   class Impl;
   Impl *impl_;
@@ -49,6 +49,8 @@ class ListBoxElement::Impl : public SmallObject<> {
     item_separator_color_(new Texture(kDefaultItemSepColor, 1.0)),
     item_width_(1.0),
     item_height_(0),
+    item_pixel_width_(0),
+    item_pixel_height_(0),
     selected_index_(-2),
     pending_scroll_(0),
     item_width_specified_(false),
@@ -309,6 +311,9 @@ class ListBoxElement::Impl : public SmallObject<> {
   Texture *item_separator_color_;
   double item_width_;
   double item_height_;
+  // The item size of the last layout.
+  double item_pixel_width_;
+  double item_pixel_height_;
   EventSignal onchange_event_;
 
   // Only used for when the index is specified in XML. This is an index
@@ -762,6 +767,19 @@ void ListBoxElement::Layout() {
   double page_step = ::floor(box_height/item_height) * item_height;
   SetYPageStep(static_cast<int>(page_step > 0 ? page_step : box_height));
   SetYLineStep(static_cast<int>(std::min(item_height, box_height)));
+
+  // The default size of the items depends on the item size, which may be
+  // relative to the size of the list box.
+  double item_width = GetItemPixelWidth();
+  if (item_width != impl_->item_pixel_width_ ||
+      item_height != impl_->item_pixel_height_) {
+    impl_->item_pixel_width_ = item_width;
+    impl_->item_pixel_height_ = item_height;
+    Elements *items = GetChildren();
+    size_t count = items->GetCount();
+    for (size_t i = 0; i < count; ++i)
+      items->GetItemByIndex(i)->QueueLayout();
+  }
 }
 
 ItemElement *ListBoxElement::FindItemByString(const char *str) {
@@ -14,6 +14,7 @@
   limitations under the License.
 */
 
+#include <cstdlib>
 #include <cstring>
 #include <map>
 #include <vector>
@@ -25,6 +26,10 @@
 #include "slot.h"
 #include "string_utils.h"
 
+#if !defined(OS_WIN)
+#include <pthread.h>
+#endif
+
 namespace ggadget {
 
 // Define it to get verbose debug info about reference counting, especially
@@ -33,6 +38,141 @@ namespace ggadget {
 
 namespace internal {
 
+static const int kNoAtom = -1;
+
+// Interns property names into integer atoms. Names are registered into the
+// table when properties are registered, so that looking up a property hashes
+// the name once, and then only compares integers. Names are compared with
+// GadgetStrCmp(), so the hash ignores case unless GADGET_CASE_SENSITIVE is
+// defined. The table is shared by all threads, because the class based
+// property tables are keyed by atoms, and on Windows each view runs on its own
+// UI thread, so it's guarded by a lock.
+class AtomTable {
+ public:
+  AtomTable() : buckets_(kInitialBuckets, kNoAtom) {
+#if defined(OS_WIN)
+    InitializeCriticalSection(&lock_);
+#else
+    pthread_mutex_init(&lock_, NULL);
+#endif
+  }
+
+  ~AtomTable() {
+#if defined(OS_WIN)
+    DeleteCriticalSection(&lock_);
+#else
+    pthread_mutex_destroy(&lock_);
+#endif
+  }
+
+  // Returns the atom of name, adding it to the table if it's new.
+  int Intern(const char *name) {
+    ScopedLock lock(this);
+    size_t hash = Hash(name);
+    size_t bucket = FindBucket(name, hash);
+    if (buckets_[bucket] != kNoAtom)
+      return buckets_[bucket];
+
+    int atom = static_cast<int>(names_.size());
+    names_.push_back(strdup(name));
+    hashes_.push_back(hash);
+    buckets_[bucket] = atom;
+    if (names_.size() * 2 > buckets_.size())
+      Rehash();
+    return atom;
+  }
+
+  // Returns the atom of name, or kNoAtom if the name has never been interned,
+  // which means no property of this name has ever been registered.
+  int Find(const char *name) const {
+    ScopedLock lock(this);
+    return buckets_[FindBucket(name, Hash(name))];
+  }
+
+  const char *GetName(int atom) const {
+    // names_ may be reallocated by Intern() on another thread.
+    ScopedLock lock(this);
+    return names_[atom];
+  }
+
+ private:
+  static const size_t kInitialBuckets = 1024;
+
+  class ScopedLock {
+   public:
+    explicit ScopedLock(const AtomTable *table) : table_(table) {
+#if defined(OS_WIN)
+      EnterCriticalSection(&table_->lock_);
+#else
+      pthread_mutex_lock(&table_->lock_);
+#endif
+    }
+
+    ~ScopedLock() {
+#if defined(OS_WIN)
+      LeaveCriticalSection(&table_->lock_);
+#else
+      pthread_mutex_unlock(&table_->lock_);
+#endif
+    }
+
+   private:
+    const AtomTable *table_;
+    DISALLOW_EVIL_CONSTRUCTORS(ScopedLock);
+  };
+
+  static size_t Hash(const char *name) {
+    // FNV-1a.
+    size_t hash = 2166136261U;
+    for (; *name; name++) {
+      unsigned char c = static_cast<unsigned char>(*name);
+#ifndef GADGET_CASE_SENSITIVE
+      if (c >= 'A' && c <= 'Z')
+        c = static_cast<unsigned char>(c - 'A' + 'a');
+#endif
+      hash ^= c;
+      hash *= 16777619U;
+    }
+    return hash;
+  }
+
+  // Returns the bucket holding name, or the empty bucket to put it in.
+  size_t FindBucket(const char *name, size_t hash) const {
+    size_t mask = buckets_.size() - 1;
+    for (size_t bucket = hash & mask; ; bucket = (bucket + 1) & mask) {
+      int atom = buckets_[bucket];
+      if (atom == kNoAtom ||
+          (hashes_[atom] == hash && (strcmp(names_[atom], name) == 0 ||
+                                     GadgetStrCmp(names_[atom], name) == 0)))
+        return bucket;
+    }
+  }
+
+  void Rehash() {
+    std::vector<int> buckets(buckets_.size() * 2, kNoAtom);
+    size_t mask = buckets.size() - 1;
+    for (size_t atom = 0; atom < names_.size(); atom++) {
+      size_t bucket = hashes_[atom] & mask;
+      while (buckets[bucket] != kNoAtom)
+        bucket = (bucket + 1) & mask;
+      buckets[bucket] = static_cast<int>(atom);
+    }
+    buckets_.swap(buckets);
+  }
+
+  // The names are never freed, because atoms live as long as the program.
+  std::vector<char *> names_;
+  std::vector<size_t> hashes_;
+  std::vector<int> buckets_;
+#if defined(OS_WIN)
+  mutable CRITICAL_SECTION lock_;
+#else
+  mutable pthread_mutex_t lock_;
+#endif
+
+  DISALLOW_EVIL_CONSTRUCTORS(AtomTable);
+};
+
 class ScriptableHelperImpl : public ScriptableHelperImplInterface {
  public:
   ScriptableHelperImpl(ScriptableHelperCallbackInterface *owner);
@@ -132,35 +272,145 @@ class ScriptableHelperImpl : public ScriptableHelperImplInterface {
   static void DestroyPropertyInfo(PropertyInfo *info);
   const PropertyInfo *GetPropertyInfoInternal(const char *name);
 
+  // A flat open addressing hash table from atoms to property information.
+  // The PropertyInfo structures are allocated separately, because slots
+  // are bound to their addresses. The table doesn't own the PropertyInfo
+  // structures; use Clear() to destroy them.
+  class PropertyInfoTable {
+   public:
+    struct Entry {
+      int atom;
+      PropertyInfo *info;
+    };
+
+    PropertyInfoTable() : size_(0) { }
+
+    PropertyInfo *Find(int atom) const {
+      if (entries_.empty())
+        return NULL;
+      size_t mask = entries_.size() - 1;
+      for (size_t i = Hash(atom) & mask; ; i = (i + 1) & mask) {
+        if (entries_[i].atom == atom)
+          return entries_[i].info;
+        if (entries_[i].atom == kNoAtom)
+          return NULL;
+      }
+    }
+
+    // Returns the information of atom, which is added if it doesn't exist.
+    PropertyInfo *Get(int atom) {
+      PropertyInfo *info = Find(atom);
+      if (info)
+        return info;
+      if ((size_ + 1) * 2 > entries_.size())
+        Resize(entries_.empty() ? 8 : entries_.size() * 2);
+      info = new PropertyInfo;
+      Insert(atom, info);
+      size_++;
+      return info;
+    }
+
+    // Removes atom from the table, and returns its information.
+    PropertyInfo *Remove(int atom) {
+      if (entries_.empty())
+        return NULL;
+      size_t mask = entries_.size() - 1;
+      size_t i = Hash(atom) & mask;
+      while (entries_[i].atom != atom) {
+        if (entries_[i].atom == kNoAtom)
+          return NULL;
+        i = (i + 1) & mask;
+      }
+      PropertyInfo *info = entries_[i].info;
+      entries_[i].atom = kNoAtom;
+      size_--;
+      // Reinserts the following entries of the same cluster, so that no
+      // lookup stops at the hole.
+      for (i = (i + 1) & mask; entries_[i].atom != kNoAtom;
+           i = (i + 1) & mask) {
+        Entry entry = entries_[i];
+        entries_[i].atom = kNoAtom;
+        Insert(entry.atom, entry.info);
+      }
+      return info;
+    }
+
+    // Destroys all the property information.
+    void Clear() {
+      for (size_t i = 0; i < entries_.size(); i++) {
+        if (entries_[i].atom != kNoAtom) {
+          DestroyPropertyInfo(entries_[i].info);
+          delete entries_[i].info;
+        }
+      }
+      entries_.clear();
+      size_ = 0;
+    }
+
+    // The entries, including the empty ones whose atom is kNoAtom.
+    const std::vector<Entry> &entries() const { return entries_; }
+
+   private:
+    static size_t Hash(int atom) {
+      return static_cast<size_t>(atom) * 2654435761U;
+    }
+
+    void Insert(int atom, PropertyInfo *info) {
+      size_t mask = entries_.size() - 1;
+      size_t i = Hash(atom) & mask;
+      while (entries_[i].atom != kNoAtom)
+        i = (i + 1) & mask;
+      entries_[i].atom = atom;
+      entries_[i].info = info;
+    }
+
+    void Resize(size_t capacity) {
+      std::vector<Entry> old_entries(capacity);
+      for (size_t i = 0; i < capacity; i++)
+        old_entries[i].atom = kNoAtom;
+      old_entries.swap(entries_);
+      for (size_t i = 0; i < old_entries.size(); i++) {
+        if (old_entries[i].atom != kNoAtom)
+          Insert(old_entries[i].atom, old_entries[i].info);
+      }
+    }
+
+    std::vector<Entry> entries_;
+    size_t size_;
+  };
+
   ScriptableHelperCallbackInterface *owner_;
   mutable int ref_count_;
   bool registering_class_;
 
-  typedef LightMap<const char *, PropertyInfo,
-                   GadgetCharPtrComparator> PropertyInfoMap;
-
-  class ClassInfoMap : public LightMap<uint64_t, PropertyInfoMap> {
+  class ClassInfoMap : public LightMap<uint64_t, PropertyInfoTable> {
    public:
     ~ClassInfoMap() {
       ClassInfoMap::iterator it = this->begin();
       ClassInfoMap::iterator end = this->end();
-      for (; it != end; ++it) {
-        PropertyInfoMap::iterator prop_it = it->second.begin();
-        PropertyInfoMap::iterator prop_end = it->second.end();
-        for (; prop_it != prop_end; ++prop_it)
-          ScriptableHelperImpl::DestroyPropertyInfo(&prop_it->second);
-      }
+      for (; it != end; ++it)
+        it->second.Clear();
     }
   };
 
+  // Atoms of the names of all registered properties.
+  static AtomTable *atoms_;
   // Stores information of all properties of this object.
-  PropertyInfoMap property_info_;
+  PropertyInfoTable property_info_;
   // Stores class-based property information for all classes.
   static ClassInfoMap *all_class_info_;
   // If a class has no class-based property_info, let class_property_info_
-  // point to this map to save duplicated blank maps.
-  static PropertyInfoMap *blank_property_info_;
-  PropertyInfoMap *class_property_info_;
+  // point to this table to save duplicated blank tables.
+  static PropertyInfoTable *blank_property_info_;
+  PropertyInfoTable *class_property_info_;
+
+  // An inline cache of the last property looked up on this object. Script
+  // bridges usually access the same property several times in a row, for
+  // example, GetPropertyInfo() then SetProperty(), which then only compare
+  // the name once. cached_name_ is the interned name, and cached_info_ may be
+  // NULL if the property isn't registered on this object.
+  const char *cached_name_;
+  const PropertyInfo *cached_info_;
 
 #ifdef _DEBUG
   struct ClassStatInfo {
@@ -211,11 +461,12 @@ class ScriptableHelperImpl : public ScriptableHelperImplInterface {
 
 // Class information shall be truely static and shouldn't be destroyed when
 // exiting.
+AtomTable *ScriptableHelperImpl::atoms_ = new AtomTable;
 ScriptableHelperImpl::ClassInfoMap *ScriptableHelperImpl::all_class_info_ =
   new ScriptableHelperImpl::ClassInfoMap;
-ScriptableHelperImpl::PropertyInfoMap
+ScriptableHelperImpl::PropertyInfoTable
   *ScriptableHelperImpl::blank_property_info_ =
-    new ScriptableHelperImpl::PropertyInfoMap;
+    new ScriptableHelperImpl::PropertyInfoTable;
 
 #ifdef _DEBUG
 ScriptableHelperImpl::ClassStat ScriptableHelperImpl::class_stat_;
@@ -232,6 +483,8 @@ ScriptableHelperImpl::ScriptableHelperImpl(
       ref_count_(0),
       registering_class_(false),
       class_property_info_(NULL),
+      cached_name_(NULL),
+      cached_info_(NULL),
       inherits_from_(NULL),
       array_getter_(NULL),
       array_setter_(NULL),
@@ -246,10 +499,7 @@ ScriptableHelperImpl::~ScriptableHelperImpl() {
   ASSERT(ref_count_ == 0);
 
   // Free all owned slots.
-  for (PropertyInfoMap::iterator it = property_info_.begin();
-       it != property_info_.end(); ++it) {
-    DestroyPropertyInfo(&it->second);
-  }
+  property_info_.Clear();
 
   delete array_getter_;
   delete array_setter_;
@@ -306,9 +556,11 @@ void ScriptableHelperImpl::AddPropertyInfo(const char *name, PropertyType type,
                                            const Variant &prototype,
                                            Slot *getter, Slot *setter) {
   uint64_t class_id = owner_->GetScriptable()->GetClassId();
+  int atom = atoms_->Intern(name);
   PropertyInfo *info =
-      registering_class_ ? &(*all_class_info_)[class_id][name] :
-      &property_info_[name];
+      registering_class_ ? (*all_class_info_)[class_id].Get(atom) :
+      property_info_.Get(atom);
+  cached_name_ = NULL;
   if (info->type != PROPERTY_NOT_EXIST) {
     // A previously registered property is overriden.
     DestroyPropertyInfo(info);
@@ -585,13 +837,20 @@ const ScriptableHelperImpl::PropertyInfo *
 ScriptableHelperImpl::GetPropertyInfoInternal(const char *name) {
   EnsureRegistered();
   ASSERT(class_property_info_);
-  PropertyInfoMap::const_iterator it = property_info_.find(name);
-  bool found = it != property_info_.end();
-  if (!found) {
-    it = class_property_info_->find(name);
-    found = it != class_property_info_->end();
-  }
-  return found ? &it->second : NULL;
+  // Names usually have the same case as they were registered with, so
+  // strcmp() is enough to check the cache.
+  if (cached_name_ && strcmp(cached_name_, name) == 0)
+    return cached_info_;
+
+  int atom = atoms_->Find(name);
+  if (atom == kNoAtom)
+    return NULL;
+  const PropertyInfo *info = property_info_.Find(atom);
+  if (!info)
+    info = class_property_info_->Find(atom);
+  cached_name_ = atoms_->GetName(atom);
+  cached_info_ = info;
+  return info;
 }
 
 ScriptableInterface::PropertyType ScriptableHelperImpl::GetPropertyInfo(
@@ -738,10 +997,7 @@ class ScriptableHelperImpl::InheritedPropertiesCallback {
   }
 
   bool Callback(const char *name, PropertyType type, const Variant &value) {
-    if (owner_->property_info_.find(name) ==
-            owner_->property_info_.end() &&
-        owner_->class_property_info_->find(name) ==
-            owner_->class_property_info_->end()) {
+    if (!owner_->GetPropertyInfoInternal(name)) {
       // Only emunerate inherited properties which are not overriden by this
       // scriptable object.
       return (*callback_)(name, type, value);
@@ -769,22 +1025,30 @@ bool ScriptableHelperImpl::EnumerateProperties(
       return false;
     }
   }
-  for (PropertyInfoMap::const_iterator it = class_property_info_->begin();
-       it != class_property_info_->end(); ++it) {
-    if (property_info_.find(it->first) == property_info_.end()) {
-      ResultVariant value = GetProperty(it->first);
-      if (!(*callback)(it->first, it->second.type, value.v())) {
+  const std::vector<PropertyInfoTable::Entry> &class_entries =
+      class_property_info_->entries();
+  for (size_t i = 0; i < class_entries.size(); ++i) {
+    int atom = class_entries[i].atom;
+    if (atom != kNoAtom && !property_info_.Find(atom)) {
+      const char *name = atoms_->GetName(atom);
+      ResultVariant value = GetProperty(name);
+      if (!(*callback)(name, class_entries[i].info->type, value.v())) {
         delete callback;
         return false;
       }
     }
   }
-  for (PropertyInfoMap::const_iterator it = property_info_.begin();
-       it != property_info_.end(); ++it) {
-    ResultVariant value = GetProperty(it->first);
-    if (!(*callback)(it->first, it->second.type, value.v())) {
-      delete callback;
-      return false;
+  const std::vector<PropertyInfoTable::Entry> &entries =
+      property_info_.entries();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    int atom = entries[i].atom;
+    if (atom != kNoAtom) {
+      const char *name = atoms_->GetName(atom);
+      ResultVariant value = GetProperty(name);
+      if (!(*callback)(name, entries[i].info->type, value.v())) {
+        delete callback;
+        return false;
+      }
     }
   }
   delete callback;
@@ -805,11 +1069,14 @@ bool ScriptableHelperImpl::RemoveProperty(const char *name) {
   EnsureRegistered();
   ASSERT(class_property_info_);
 
-  PropertyInfoMap::iterator it = property_info_.find(name);
-  if (it == property_info_.end())
+  int atom = atoms_->Find(name);
+  PropertyInfo *info =
+      atom == kNoAtom ? NULL : property_info_.Remove(atom);
+  if (!info)
     return false;
-  DestroyPropertyInfo(&it->second);
-  property_info_.erase(it);
+  cached_name_ = NULL;
+  DestroyPropertyInfo(info);
+  delete info;
   return true;
 }
 
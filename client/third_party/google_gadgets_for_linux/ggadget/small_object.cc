@@ -17,1118 +17,714 @@
 
 #include "small_object.h"
 
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include <cstdlib>
-#include <climits>
 #include <cassert>
-#include <vector>
-#include <bitset>
 
-#include "format_macros.h"
 #include "logger.h"
 
-#ifdef _DEBUG
-// For special debug purpose only. Will affect performance dramatically.
-// #define DO_EXTRA_LOKI_TESTS
-// #define LOKI_CHECK_FOR_CORRUPTION
-// #define TRACE_ALLOCS
-#endif
-// #define USE_NEW_TO_ALLOCATE
-
-#ifdef TRACE_ALLOCS
-#include <valgrind/valgrind.h>
-#endif
-
 namespace ggadget
 {
 
-    /** @struct Chunk
-        @ingroup SmallObjectGroupInternal
-     Contains info about each allocated Chunk - which is a collection of
-     contiguous blocks.  Each block is the same size, as specified by the
-     FixedAllocator.  The number of blocks in a Chunk depends upon page size.
-     This is a POD-style struct with value-semantics.  All functions and data
-     are private so that they can not be changed by anything other than the
-     FixedAllocator which owns the Chunk.
-
-     @par Minimal Interface
-     For the sake of runtime efficiency, no constructor, destructor, or
-     copy-assignment operator is defined. The inline functions made by the
-     compiler should be sufficient, and perhaps faster than hand-crafted
-     functions.  The lack of these functions allows vector to create and copy
-     Chunks as needed without overhead.  The Init and Release functions do
-     what the default constructor and destructor would do.  A Chunk is not in
-     a usable state after it is constructed and before calling Init.  Nor is
-     a Chunk usable after Release is called, but before the destructor.
-
-     @par Efficiency
-     Down near the lowest level of the allocator, runtime efficiencies trump
-     almost all other considerations.  Each function does the minimum required
-     of it.  All functions should execute in constant time to prevent higher-
-     level code from unwittingly using a version of Shlemiel the Painter's
-     Algorithm.
-
-     @par Stealth Indexes
-     The first char of each empty block contains the index of the next empty
-     block.  These stealth indexes form a singly-linked list within the blocks.
-     A Chunk is corrupt if this singly-linked list has a loop or is shorter
-     than blocksAvailable_.  Much of the allocator's time and space efficiency
-     comes from how these stealth indexes are implemented.
-     */
-    class Chunk
-    {
-    private:
-        friend class FixedAllocator;
-
-        /** Initializes a just-constructed Chunk.
-         @param blockSize Number of bytes per block.
-         @param blocks Number of blocks per Chunk.
-         @return True for success, false for failure.
-         */
-        bool Init( std::size_t blockSize, unsigned char blocks );
-
-        /** Allocate a block within the Chunk.  Complexity is always O(1), and
-         this will never throw.  Does not actually "allocate" by calling
-         malloc, new, or any other function, but merely adjusts some internal
-         indexes to indicate an already allocated block is no longer available.
-         @return Pointer to block within Chunk.
-         */
-        void * Allocate( std::size_t blockSize );
-
-        /** Deallocate a block within the Chunk. Complexity is always O(1), and
-         this will never throw.  For efficiency, this assumes the address is
-         within the block and aligned along the correct byte boundary.  An
-         assertion checks the alignment, and a call to HasBlock is done from
-         within VicinityFind.  Does not actually "deallocate" by calling free,
-         delete, or other function, but merely adjusts some internal indexes to
-         indicate a block is now available.
-         */
-        void Deallocate( void * p, std::size_t blockSize );
-
-        /** Resets the Chunk back to pristine values. The available count is
-         set back to zero, and the first available index is set to the zeroth
-         block.  The stealth indexes inside each block are set to point to the
-         next block. This assumes the Chunk's data was already using Init.
-         */
-        void Reset( std::size_t blockSize, unsigned char blocks );
-
-        /// Releases the allocated block of memory.
-        void Release();
-
-        /** Determines if the Chunk has been corrupted.
-         @param numBlocks Total # of blocks in the Chunk.
-         @param blockSize # of bytes in each block.
-         @param checkIndexes True if caller wants to check indexes of available
-          blocks for corruption.  If false, then caller wants to skip some
-          tests tests just to run faster.  (Debug version does more checks, but
-          release version runs faster.)
-         @return True if Chunk is corrupt.
-         */
-        bool IsCorrupt( unsigned char numBlocks, std::size_t blockSize,
-            bool checkIndexes ) const;
-
-        /** Determines if block is available.
-         @param p Address of block managed by Chunk.
-         @param numBlocks Total # of blocks in the Chunk.
-         @param blockSize # of bytes in each block.
-         @return True if block is available, else false if allocated.
-         */
-        bool IsBlockAvailable( void * p, unsigned char numBlocks,
-            std::size_t blockSize ) const;
-
-        /// Returns true if block at address P is inside this Chunk.
-        inline bool HasBlock( void * p, std::size_t chunkLength ) const
-        {
-            unsigned char * pc = static_cast< unsigned char * >( p );
-            return ( pData_ <= pc ) && ( pc < pData_ + chunkLength );
-        }
-
-        inline bool HasAvailable( unsigned char numBlocks ) const
-        { return ( blocksAvailable_ == numBlocks ); }
-
-        inline bool IsFilled( void ) const
-        { return ( 0 == blocksAvailable_ ); }
-
-        /// Pointer to array of allocated blocks.
-        unsigned char * pData_;
-        /// Index of first empty block.
-        unsigned char firstAvailableBlock_;
-        /// Count of empty blocks.
-        unsigned char blocksAvailable_;
-    };
-
-    /** @class FixedAllocator
-        @ingroup SmallObjectGroupInternal
-     Offers services for allocating fixed-sized objects.  It has a container
-     of "containers" of fixed-size blocks.  The outer container has all the
-     Chunks.  The inner container is a Chunk which owns some blocks.
-
-     @par Class Level Invariants
-     - There is always either zero or one Chunk which is empty.
-     - If this has no empty Chunk, then emptyChunk_ is NULL.
-     - If this has an empty Chunk, then emptyChunk_ points to it.
-     - If the Chunk container is empty, then deallocChunk_ and allocChunk_
-       are NULL.
-     - If the Chunk container is not-empty, then deallocChunk_ and allocChunk_
-       are either NULL or point to Chunks within the container.
-     - allocChunk_ will often point to the last Chunk in the container since
-       it was likely allocated most recently, and therefore likely to have an
-       available block.
-     */
-    class FixedAllocator
-    {
-    private:
-
-        /** Deallocates the block at address p, and then handles the internal
-         bookkeeping needed to maintain class invariants.  This assumes that
-         deallocChunk_ points to the correct chunk.
-         */
-        void DoDeallocate( void * p );
-
-        /** Creates an empty Chunk and adds it to the end of the ChunkList.
-         All calls to the lower-level memory allocation functions occur inside
-         this function, and so the only try-catch block is inside here.
-         @return true for success, false for failure.
-         */
-        bool MakeNewChunk( void );
-
-        /** Finds the Chunk which owns the block at address p.  It starts at
-         deallocChunk_ and searches in both forwards and backwards directions
-         from there until it finds the Chunk which owns p.  This algorithm
-         should find the Chunk quickly if it is deallocChunk_ or is close to it
-         in the Chunks container.  This goes both forwards and backwards since
-         that works well for both same-order and opposite-order deallocations.
-         (Same-order = objects are deallocated in the same order in which they
-         were allocated.  Opposite order = objects are deallocated in a last to
-         first order.  Complexity is O(C) where C is count of all Chunks.  This
-         never throws.
-         @return Pointer to Chunk that owns p, or NULL if no owner found.
-         */
-        Chunk * VicinityFind( void * p ) const;
-
-        /// Not implemented.
-        FixedAllocator(const FixedAllocator&);
-        /// Not implemented.
-        FixedAllocator& operator=(const FixedAllocator&);
-
-        /// Type of container used to hold Chunks.
-        typedef std::vector< Chunk > Chunks;
-        /// Iterator through container of Chunks.
-        typedef Chunks::iterator ChunkIter;
-        /// Iterator through const container of Chunks.
-        typedef Chunks::const_iterator ChunkCIter;
-
-        /// Fewest # of objects managed by a Chunk.
-        static unsigned char MinObjectsPerChunk_;
-
-        /// Most # of objects managed by a Chunk - never exceeds UCHAR_MAX.
-        static unsigned char MaxObjectsPerChunk_;
-
-        /// Number of bytes in a single block within a Chunk.
-        std::size_t blockSize_;
-        /// Number of blocks managed by each Chunk.
-        unsigned char numBlocks_;
-
-        /// Container of Chunks.
-        Chunks chunks_;
-        /// Pointer to Chunk used for last or next allocation.
-        Chunk * allocChunk_;
-        /// Pointer to Chunk used for last or next deallocation.
-        Chunk * deallocChunk_;
-        /// Pointer to the only empty Chunk if there is one, else NULL.
-        Chunk * emptyChunk_;
-
-#ifdef _DEBUG
-        size_t allocCount_;
-        size_t deallocCount_;
-        void ReportStat();
-#endif
-
-    public:
-        /// Create a FixedAllocator which manages blocks of 'blockSize' size.
-        FixedAllocator();
-
-        /// Destroy the FixedAllocator and release all its Chunks.
-        ~FixedAllocator();
-
-        /// Initializes a FixedAllocator by calculating # of blocks per Chunk.
-        void Initialize( std::size_t blockSize, std::size_t pageSize );
-
-        /** Returns pointer to allocated memory block of fixed size - or NULL
-         if it failed to allocate.
-         */
-        void * Allocate( void );
-
-        /** Deallocate a memory block previously allocated with Allocate.  If
-         the block is not owned by this FixedAllocator, it returns false so
-         that SmallObjAllocator can call the default deallocator.  If the
-         block was found, this returns true.
-         */
-        bool Deallocate( void * p, Chunk * hint );
-
-        /// Returns block size with which the FixedAllocator was initialized.
-        inline std::size_t BlockSize() const { return blockSize_; }
-
-        /** Releases the memory used by the empty Chunk.  This will take
-         constant time under any situation.
-         @return True if empty chunk found and released, false if none empty.
-         */
-        bool TrimEmptyChunk( void );
-
-        /** Releases unused spots from ChunkList.  This takes constant time
-         with respect to # of Chunks, but actual time depends on underlying
-         memory allocator.
-         @return False if no unused spots, true if some found and released.
-         */
-        bool TrimChunkList( void );
-
-        /** Returns count of empty Chunks held by this allocator.  Complexity
-         is O(C) where C is the total number of Chunks - empty or used.
-         */
-        std::size_t CountEmptyChunks( void ) const;
-
-        /** Determines if FixedAllocator is corrupt.  Checks data members to
-         see if any have erroneous values, or violate class invariants.  It
-         also checks if any Chunk is corrupt.  Complexity is O(C) where C is
-         the number of Chunks.  If any data is corrupt, this will return true
-         in release mode, or assert in debug mode.
-         */
-        bool IsCorrupt( void ) const;
-
-        /** Returns true if the block at address p is within a Chunk owned by
-         this FixedAllocator.  Complexity is O(C) where C is the total number
-         of Chunks - empty or used.
-         */
-        const Chunk * HasBlock( void * p ) const;
-        inline Chunk * HasBlock( void * p )
-        {
-            return const_cast< Chunk * >(
-                const_cast< const FixedAllocator * >( this )->HasBlock( p ) );
-        }
-
-    };
-
-    unsigned char FixedAllocator::MinObjectsPerChunk_ = 8;
-    unsigned char FixedAllocator::MaxObjectsPerChunk_ = UCHAR_MAX;
-
-// Chunk::Init ----------------------------------------------------------------
-
-bool Chunk::Init( std::size_t blockSize, unsigned char blocks )
+namespace
 {
-    assert(blockSize > 0);
-    assert(blocks > 0);
-    // Overflow check
-    const std::size_t allocSize = blockSize * blocks;
-    assert( allocSize / blockSize == blocks);
-
-#ifdef USE_NEW_TO_ALLOCATE
-    // If this new operator fails, it will throw, and the exception will get
-    // caught one layer up.
-    pData_ = static_cast< unsigned char * >( ::operator new ( allocSize ) );
-#else
-    // malloc can't throw, so its only way to indicate an error is to return
-    // a NULL pointer, so we have to check for that.
-    pData_ = static_cast< unsigned char * >( ::std::malloc( allocSize ) );
-    if ( NULL == pData_ ) return false;
-#endif
 
-    Reset( blockSize, blocks );
-    return true;
-}
+/// Marks the header of every slab, to detect corrupted data.
+const std::size_t kSlabMagic = 0x51AB51AB;
 
-// Chunk::Reset ---------------------------------------------------------------
+/// Max # of blocks moved between a thread cache and the slabs at a time.
+const std::size_t kMaxBatchSize = 64;
 
-void Chunk::Reset(std::size_t blockSize, unsigned char blocks)
+/** @struct Slab
+    @ingroup SmallObjectGroupInternal
+ Header of a slab, at the start of its memory.  The blocks of the slab follow
+ the header.  Blocks are carved from the unused part of the slab the first
+ time they are allocated, and later reused through the free list, whose links
+ are stored in the first bytes of the free blocks.
+ */
+struct Slab
 {
-    assert(blockSize > 0);
-    assert(blocks > 0);
-    // Overflow check
-    assert((blockSize * blocks) / blockSize == blocks);
-
-    firstAvailableBlock_ = 0;
-    blocksAvailable_ = blocks;
-
-    unsigned char i = 0;
-    for ( unsigned char * p = pData_; i != blocks; p += blockSize )
-    {
-        *p = ++i;
-    }
-}
-
-// Chunk::Release -------------------------------------------------------------
+    std::size_t magic;
+    /// Index of the size class of the blocks.
+    std::size_t sizeClass;
+    /// # of blocks given out to objects or thread caches.
+    std::size_t usedBlocks;
+    /// Blocks which have been given back.
+    void * freeList;
+    /// Start of the blocks which have never been given out.
+    unsigned char * unused;
+    /// Links in the list of slabs with free blocks of the size class.
+    Slab * prev;
+    Slab * next;
+    /// Links in the list of all slabs.
+    Slab * allPrev;
+    Slab * allNext;
+};
+
+/** @struct SizeClass
+    @ingroup SmallObjectGroupInternal
+ Slabs of blocks of the same size.  Slabs which are full are in no list, so
+ that finding a free block takes constant time.
+ */
+struct SizeClass
+{
+    std::size_t blockSize;
+    std::size_t blocksPerSlab;
+    /// # of blocks moved between a thread cache and the slabs at a time.
+    std::size_t batchSize;
+    /// Slabs which have both used and free blocks.
+    Slab * partial;
+    /// An empty slab kept for the next allocation.
+    Slab * spare;
+};
+
+/// A list of free blocks in a thread cache.
+struct FreeList
+{
+    void * head;
+    std::size_t length;
+};
 
-void Chunk::Release()
+inline void * & NextBlock( void * block )
 {
-    assert( NULL != pData_ );
-#ifdef USE_NEW_TO_ALLOCATE
-    ::operator delete ( pData_ );
-#else
-    ::std::free( static_cast< void * >( pData_ ) );
-#endif
+    return *static_cast< void ** >( block );
 }
 
-// Chunk::Allocate ------------------------------------------------------------
-
-void* Chunk::Allocate(std::size_t blockSize)
+/// Returns the slab size for the requested page size, which is a power of 2
+/// and a multiple of the system page size.
+std::size_t GetSlabSize( std::size_t pageSize )
 {
-    if ( IsFilled() ) return NULL;
-
-    assert((firstAvailableBlock_ * blockSize) / blockSize ==
-        firstAvailableBlock_);
-    unsigned char * pResult = pData_ + (firstAvailableBlock_ * blockSize);
-    firstAvailableBlock_ = *pResult;
-    --blocksAvailable_;
-
-    return pResult;
+    std::size_t slabSize = static_cast< std::size_t >( sysconf( _SC_PAGESIZE ) );
+    while ( slabSize < pageSize )
+        slabSize <<= 1;
+    return slabSize;
 }
 
-// Chunk::Deallocate ----------------------------------------------------------
-
-void Chunk::Deallocate(void* p, std::size_t blockSize)
+/// Returns the base 2 logarithm of a power of 2.
+std::size_t Log2( std::size_t value )
 {
-    assert(p >= pData_);
-
-    unsigned char* toRelease = static_cast<unsigned char*>(p);
-    // Alignment check
-    assert((toRelease - pData_) % blockSize == 0);
-    unsigned char index = static_cast< unsigned char >(
-        ( toRelease - pData_ ) / blockSize);
-
-#if defined(DEBUG) || defined(_DEBUG)
-    // Check if block was already deleted.  Attempting to delete the same
-    // block more than once causes Chunk's linked-list of stealth indexes to
-    // become corrupt.  And causes count of blocksAvailable_ to be wrong.
-    if ( 0 < blocksAvailable_ )
-        assert( firstAvailableBlock_ != index );
-#endif
-
-    *toRelease = firstAvailableBlock_;
-    firstAvailableBlock_ = index;
-    // Truncation check
-    assert(firstAvailableBlock_ == (toRelease - pData_) / blockSize);
-
-    ++blocksAvailable_;
+    std::size_t result = 0;
+    while ( ( static_cast< std::size_t >( 1 ) << result ) < value )
+        ++result;
+    return result;
 }
 
-// Chunk::IsCorrupt -----------------------------------------------------------
-
-bool Chunk::IsCorrupt( unsigned char numBlocks, std::size_t blockSize,
-    bool checkIndexes ) const
+/// Locks a pthread mutex in the current scope.
+class MutexLock
 {
-
-    if ( numBlocks < blocksAvailable_ )
+public:
+    explicit MutexLock( pthread_mutex_t * mutex ) : mutex_( mutex )
     {
-        // Contents at this Chunk corrupted.  This might mean something has
-        // overwritten memory owned by the Chunks container.
-        assert( false );
-        return true;
+        pthread_mutex_lock( mutex_ );
     }
-    if ( IsFilled() )
-        // Useless to do further corruption checks if all blocks allocated.
-        return false;
-    unsigned char index = firstAvailableBlock_;
-    if ( numBlocks <= index )
+    ~MutexLock()
     {
-        // Contents at this Chunk corrupted.  This might mean something has
-        // overwritten memory owned by the Chunks container.
-        assert( false );
-        return true;
+        pthread_mutex_unlock( mutex_ );
     }
-    if ( !checkIndexes )
-        // Caller chose to skip more complex corruption tests.
-        return false;
-
-    /* If the bit at index was set in foundBlocks, then the stealth index was
-     found on the linked-list.
-     */
-    std::bitset< UCHAR_MAX > foundBlocks;
-    unsigned char * nextBlock = NULL;
-
-    /* The loop goes along singly linked-list of stealth indexes and makes sure
-     that each index is within bounds (0 <= index < numBlocks) and that the
-     index was not already found while traversing the linked-list.  The linked-
-     list should have exactly blocksAvailable_ nodes, so the for loop will not
-     check more than blocksAvailable_.  This loop can't check inside allocated
-     blocks for corruption since such blocks are not within the linked-list.
-     Contents of allocated blocks are not changed by Chunk.
-
-     Here are the types of corrupted link-lists which can be verified.  The
-     corrupt index is shown with asterisks in each example.
-
-     Type 1: Index is too big.
-      numBlocks == 64
-      blocksAvailable_ == 7
-      firstAvailableBlock_ -> 17 -> 29 -> *101*
-      There should be no indexes which are equal to or larger than the total
-      number of blocks.  Such an index would refer to a block beyond the
-      Chunk's allocated domain.
-
-     Type 2: Index is repeated.
-      numBlocks == 64
-      blocksAvailable_ == 5
-      firstAvailableBlock_ -> 17 -> 29 -> 53 -> *17* -> 29 -> 53 ...
-      No index should be repeated within the linked-list since that would
-      indicate the presence of a loop in the linked-list.
+private:
+    pthread_mutex_t * mutex_;
+    DISALLOW_EVIL_CONSTRUCTORS( MutexLock );
+};
+
+} // anonymous namespace
+
+/** @class SlabPool
+    @ingroup SmallObjectGroupInternal
+ The implementation of SmallObjAllocator.  The size classes and slabs are
+ shared by all threads and are protected by a mutex, while the thread caches
+ are only used by their own threads.
+ */
+class SlabPool
+{
+public:
+    /** @struct ThreadCache
+     Free blocks of the calling thread, and the counters of the thread which
+     haven't been added to the statistics.
      */
-    for ( unsigned char cc = 0; ; )
-    {
-        nextBlock = pData_ + ( index * blockSize );
-        foundBlocks.set( index, true );
-        ++cc;
-        if ( cc >= blocksAvailable_ )
-            // Successfully counted off number of nodes in linked-list.
-            break;
-        index = *nextBlock;
-        if ( numBlocks <= index )
-        {
-            /* This catches Type 1 corruptions as shown in above comments.
-             This implies that a block was corrupted due to a stray pointer
-             or an operation on a nearby block overran the size of the block.
-             */
-            assert( false );
-            return true;
-        }
-        if ( foundBlocks.test( index ) )
-        {
-            /* This catches Type 2 corruptions as shown in above comments.
-             This implies that a block was corrupted due to a stray pointer
-             or an operation on a nearby block overran the size of the block.
-             Or perhaps the program tried to delete a block more than once.
-             */
-            assert( false );
-            return true;
-        }
+    struct ThreadCache
+    {
+        SlabPool * pool;
+        FreeList * lists;
+        std::size_t allocations;
+        std::size_t deallocations;
+        std::size_t allocatedBytes;
+        std::size_t freedBytes;
+    };
+
+    SlabPool( std::size_t slabSize, std::size_t maxObjectSize,
+        std::size_t alignSize );
+    ~SlabPool( void );
+
+    inline void * Allocate( std::size_t numBytes )
+    {
+        const std::size_t index = GetSizeClass( numBytes );
+        ThreadCache * cache = GetThreadCache();
+        if ( NULL == cache )
+            return NULL;
+        FreeList & list = cache->lists[ index ];
+        if ( ( NULL == list.head ) && ( 0 == Refill( cache, index ) ) )
+            return NULL;
+        void * block = list.head;
+        list.head = NextBlock( block );
+        --list.length;
+        ++cache->allocations;
+        cache->allocatedBytes += classes_[ index ].blockSize;
+        return block;
     }
-    if ( foundBlocks.count() != blocksAvailable_ )
+
+    inline void Deallocate( void * p, std::size_t numBytes )
     {
-        /* This implies that the singly-linked-list of stealth indexes was
-         corrupted.  Ideally, this should have been detected within the loop.
-         */
-        assert( false );
-        return true;
+        const std::size_t index = GetSizeClass( numBytes );
+        (void) index;
+        assert( kSlabMagic == GetSlab( p )->magic );
+        assert( index == GetSlab( p )->sizeClass );
+        Deallocate( p );
     }
 
-    return false;
-}
-
-// Chunk::IsBlockAvailable ----------------------------------------------------
-
-bool Chunk::IsBlockAvailable( void * p, unsigned char numBlocks,
-    std::size_t blockSize ) const
-{
-    (void) numBlocks;
+    /// Deallocates a block which is known to be in a slab.
+    inline void Deallocate( void * p )
+    {
+        const SizeClass & sizeClass = classes_[ GetSlab( p )->sizeClass ];
+        ThreadCache * cache = GetThreadCache();
+        if ( NULL == cache )
+        {
+            MutexLock lock( &mutex_ );
+            ReturnBlock( p );
+            ++deallocations_;
+            freedBytes_ += sizeClass.blockSize;
+            return;
+        }
+        FreeList & list = cache->lists[ GetSlab( p )->sizeClass ];
+        NextBlock( p ) = list.head;
+        list.head = p;
+        ++list.length;
+        ++cache->deallocations;
+        cache->freedBytes += sizeClass.blockSize;
+        if ( list.length > 2 * sizeClass.batchSize )
+            Release( cache, &list, sizeClass.batchSize );
+    }
 
-    if ( IsFilled() )
-        return false;
+    /// Returns true if p is in one of the slabs.  Complexity is O(S).
+    bool HasBlock( void * p );
 
-    unsigned char * place = static_cast< unsigned char * >( p );
-    // Alignment check
-    assert( ( place - pData_ ) % blockSize == 0 );
-    unsigned char blockIndex = static_cast< unsigned char >(
-        ( place - pData_ ) / blockSize );
+    bool Trim( void );
+    void GetStatistics( SmallObjAllocator::Statistics * stats );
+    bool IsCorrupt( void );
 
-    unsigned char index = firstAvailableBlock_;
-    assert( numBlocks > index );
-    if ( index == blockIndex )
-        return true;
+private:
+    inline std::size_t GetSizeClass( std::size_t numBytes ) const
+    {
+        assert( 0 != numBytes );
+        return ( numBytes - 1 ) >> alignShift_;
+    }
 
-    /* If the bit at index was set in foundBlocks, then the stealth index was
-     found on the linked-list.
-     */
-    std::bitset< UCHAR_MAX > foundBlocks;
-    unsigned char * nextBlock = NULL;
-    for ( unsigned char cc = 0; ; )
+    inline Slab * GetSlab( void * p ) const
     {
-        nextBlock = pData_ + ( index * blockSize );
-        foundBlocks.set( index, true );
-        ++cc;
-        if ( cc >= blocksAvailable_ )
-            // Successfully counted off number of nodes in linked-list.
-            break;
-        index = *nextBlock;
-        if ( index == blockIndex )
-            return true;
-        assert( numBlocks > index );
-        assert( !foundBlocks.test( index ) );
+        return reinterpret_cast< Slab * >(
+            reinterpret_cast< uintptr_t >( p ) & ~( slabSize_ - 1 ) );
     }
 
-    return false;
-}
+    inline ThreadCache * GetThreadCache( void )
+    {
+        ThreadCache * cache =
+            static_cast< ThreadCache * >( pthread_getspecific( cacheKey_ ) );
+        return cache ? cache : CreateThreadCache();
+    }
 
-// FixedAllocator::FixedAllocator ---------------------------------------------
-
-FixedAllocator::FixedAllocator()
-    : blockSize_( 0 )
-    , numBlocks_( 0 )
-    , chunks_( 0 )
-    , allocChunk_( NULL )
-    , deallocChunk_( NULL )
-    , emptyChunk_( NULL )
-#ifdef _DEBUG
-    , allocCount_( 0 )
-    , deallocCount_( 0 )
-#endif
+    ThreadCache * CreateThreadCache( void );
+    static void DestroyThreadCache( void * cache );
+
+    /// Moves a batch of blocks from the slabs to a thread cache.
+    /// @return # of blocks moved.
+    std::size_t Refill( ThreadCache * cache, std::size_t index );
+    /// Moves count blocks from a thread cache to the slabs.
+    void Release( ThreadCache * cache, FreeList * list, std::size_t count );
+    /// Moves all blocks of a thread cache to the slabs.
+    void Flush( ThreadCache * cache );
+    /// Adds the counters of a thread cache to the statistics.  The mutex
+    /// must be locked.
+    void AddCounters( ThreadCache * cache );
+    /// Gives a block back to its slab.  The mutex must be locked.
+    void ReturnBlock( void * block );
+
+    Slab * CreateSlab( std::size_t index );
+    void DestroySlab( Slab * slab );
+    void AddToPartial( SizeClass & sizeClass, Slab * slab );
+    void RemoveFromPartial( SizeClass & sizeClass, Slab * slab );
+
+    const std::size_t slabSize_;
+    const std::size_t alignShift_;
+    const std::size_t headerSize_;
+    const std::size_t classCount_;
+    SizeClass * classes_;
+    /// All slabs, for HasBlock and IsCorrupt.
+    Slab * slabs_;
+    pthread_key_t cacheKey_;
+    pthread_mutex_t mutex_;
+
+    std::size_t slabCount_;
+    std::size_t releasedSlabs_;
+    std::size_t allocations_;
+    std::size_t deallocations_;
+    std::size_t allocatedBytes_;
+    std::size_t freedBytes_;
+
+    DISALLOW_EVIL_CONSTRUCTORS( SlabPool );
+};
+
+// SlabPool::SlabPool ---------------------------------------------------------
+
+SlabPool::SlabPool( std::size_t slabSize, std::size_t maxObjectSize,
+    std::size_t alignSize ) :
+    slabSize_( GetSlabSize( slabSize ) ),
+    alignShift_( Log2( alignSize ) ),
+    headerSize_( ( sizeof( Slab ) + alignSize - 1 ) & ~( alignSize - 1 ) ),
+    classCount_( ( maxObjectSize + alignSize - 1 ) >> alignShift_ ),
+    classes_( new SizeClass[ classCount_ ] ),
+    slabs_( NULL ),
+    slabCount_( 0 ),
+    releasedSlabs_( 0 ),
+    allocations_( 0 ),
+    deallocations_( 0 ),
+    allocatedBytes_( 0 ),
+    freedBytes_( 0 )
 {
+    assert( alignSize == ( static_cast< std::size_t >( 1 ) << alignShift_ ) );
+    assert( alignSize >= sizeof( void * ) );
+    assert( headerSize_ + classCount_ * alignSize <= slabSize_ );
+    for ( std::size_t i = 0; i < classCount_; ++i )
+    {
+        SizeClass & sizeClass = classes_[ i ];
+        sizeClass.blockSize = ( i + 1 ) << alignShift_;
+        sizeClass.blocksPerSlab =
+            ( slabSize_ - headerSize_ ) / sizeClass.blockSize;
+        sizeClass.batchSize = sizeClass.blocksPerSlab / 4;
+        if ( sizeClass.batchSize > kMaxBatchSize )
+            sizeClass.batchSize = kMaxBatchSize;
+        if ( 0 == sizeClass.batchSize )
+            sizeClass.batchSize = 1;
+        sizeClass.partial = NULL;
+        sizeClass.spare = NULL;
+    }
+    pthread_key_create( &cacheKey_, DestroyThreadCache );
+    pthread_mutex_init( &mutex_, NULL );
 }
 
-// FixedAllocator::~FixedAllocator --------------------------------------------
+// SlabPool::~SlabPool --------------------------------------------------------
 
-FixedAllocator::~FixedAllocator()
+SlabPool::~SlabPool( void )
 {
-#ifdef DO_EXTRA_LOKI_TESTS
-    TrimEmptyChunk();
-    assert( chunks_.empty() && "Memory leak detected!" );
-#endif
-    for ( ChunkIter i( chunks_.begin() ); i != chunks_.end(); ++i )
-       i->Release();
-}
-
-#ifdef _DEBUG
-void FixedAllocator::ReportStat() {
-  size_t active = allocCount_ - deallocCount_;
-  DLOG("FixedAllocator Stat: %zu %zu %zu %zu %zu %lf",
-       blockSize_, allocCount_, deallocCount_, active, chunks_.size(),
-       static_cast<double>(active) /
-       static_cast<double>((chunks_.size() * numBlocks_)));
+    ThreadCache * cache =
+        static_cast< ThreadCache * >( pthread_getspecific( cacheKey_ ) );
+    if ( NULL != cache )
+    {
+        pthread_setspecific( cacheKey_, NULL );
+        std::free( cache );
+    }
+    pthread_key_delete( cacheKey_ );
+    while ( NULL != slabs_ )
+        DestroySlab( slabs_ );
+    pthread_mutex_destroy( &mutex_ );
+    delete [] classes_;
 }
-#endif
 
-// FixedAllocator::Initialize -------------------------------------------------
+// SlabPool::CreateThreadCache ------------------------------------------------
 
-void FixedAllocator::Initialize( std::size_t blockSize, std::size_t pageSize )
+SlabPool::ThreadCache * SlabPool::CreateThreadCache( void )
 {
-    assert( blockSize > 0 );
-    assert( pageSize >= blockSize );
-    blockSize_ = blockSize;
-
-    std::size_t numBlocks = pageSize / blockSize;
-    if ( numBlocks > MaxObjectsPerChunk_ ) numBlocks = MaxObjectsPerChunk_;
-    else if ( numBlocks < MinObjectsPerChunk_ ) numBlocks = MinObjectsPerChunk_;
-
-    numBlocks_ = static_cast<unsigned char>(numBlocks);
-    assert(numBlocks_ == numBlocks);
+    // The lists are allocated together with the cache.
+    ThreadCache * cache = static_cast< ThreadCache * >( std::calloc( 1,
+        sizeof( ThreadCache ) + classCount_ * sizeof( FreeList ) ) );
+    if ( NULL == cache )
+        return NULL;
+    cache->pool = this;
+    cache->lists = reinterpret_cast< FreeList * >( cache + 1 );
+    if ( 0 != pthread_setspecific( cacheKey_, cache ) )
+    {
+        std::free( cache );
+        return NULL;
+    }
+    return cache;
 }
 
-// FixedAllocator::CountEmptyChunks -------------------------------------------
+// SlabPool::DestroyThreadCache -----------------------------------------------
 
-std::size_t FixedAllocator::CountEmptyChunks( void ) const
+void SlabPool::DestroyThreadCache( void * p )
 {
-#ifdef DO_EXTRA_LOKI_TESTS
-    // This code is only used for specialized tests of the allocator.
-    // It is #ifdef-ed so that its O(C) complexity does not overwhelm the
-    // functions which call it.
-    std::size_t count = 0;
-    for ( ChunkCIter it( chunks_.begin() ); it != chunks_.end(); ++it )
-    {
-        const Chunk & chunk = *it;
-        if ( chunk.HasAvailable( numBlocks_ ) )
-            ++count;
-    }
-    return count;
-#else
-    return ( NULL == emptyChunk_ ) ? 0 : 1;
-#endif
+    ThreadCache * cache = static_cast< ThreadCache * >( p );
+    cache->pool->Flush( cache );
+    std::free( cache );
 }
 
-// FixedAllocator::IsCorrupt --------------------------------------------------
+// SlabPool::Refill -----------------------------------------------------------
 
-bool FixedAllocator::IsCorrupt( void ) const
+std::size_t SlabPool::Refill( ThreadCache * cache, std::size_t index )
 {
-    const bool isEmpty = chunks_.empty();
-    ChunkCIter start( chunks_.begin() );
-    ChunkCIter last( chunks_.end() );
-    const size_t emptyChunkCount = CountEmptyChunks();
-
-    if ( isEmpty )
+    SizeClass & sizeClass = classes_[ index ];
+    FreeList & list = cache->lists[ index ];
+    MutexLock lock( &mutex_ );
+    AddCounters( cache );
+    std::size_t count = 0;
+    while ( count < sizeClass.batchSize )
     {
-        if ( start != last )
+        Slab * slab = sizeClass.partial;
+        if ( NULL == slab )
         {
-            assert( false );
-            return true;
-        }
-        if ( 0 < emptyChunkCount )
-        {
-            assert( false );
-            return true;
-        }
-        if ( NULL != deallocChunk_ )
-        {
-            assert( false );
-            return true;
+            slab = sizeClass.spare;
+            sizeClass.spare = NULL;
+            if ( NULL == slab )
+                slab = CreateSlab( index );
+            if ( NULL == slab )
+                break;
+            AddToPartial( sizeClass, slab );
         }
-        if ( NULL != allocChunk_ )
+        void * block = slab->freeList;
+        if ( NULL != block )
         {
-            assert( false );
-            return true;
+            slab->freeList = NextBlock( block );
         }
-        if ( NULL != emptyChunk_ )
+        else
         {
-            assert( false );
-            return true;
+            block = slab->unused;
+            slab->unused += sizeClass.blockSize;
         }
+        if ( ++slab->usedBlocks == sizeClass.blocksPerSlab )
+            RemoveFromPartial( sizeClass, slab );
+        NextBlock( block ) = list.head;
+        list.head = block;
+        ++count;
     }
+    list.length += count;
+    return count;
+}
 
-    else
-    {
-        const Chunk * front = &chunks_.front();
-        const Chunk * back  = &chunks_.back();
-        if ( start >= last )
-        {
-            assert( false );
-            return true;
-        }
-        if ( back < deallocChunk_ )
-        {
-            assert( false );
-            return true;
-        }
-        if ( back < allocChunk_ )
-        {
-            assert( false );
-            return true;
-        }
-        if ( front > deallocChunk_ )
-        {
-            assert( false );
-            return true;
-        }
-        if ( front > allocChunk_ )
-        {
-            assert( false );
-            return true;
-        }
+// SlabPool::Release ----------------------------------------------------------
 
-        switch ( emptyChunkCount )
-        {
-            case 0:
-                if ( emptyChunk_ != NULL )
-                {
-                    assert( false );
-                    return true;
-                }
-                break;
-            case 1:
-                if ( emptyChunk_ == NULL )
-                {
-                    assert( false );
-                    return true;
-                }
-                if ( back < emptyChunk_ )
-                {
-                    assert( false );
-                    return true;
-                }
-                if ( front > emptyChunk_ )
-                {
-                    assert( false );
-                    return true;
-                }
-                if ( !emptyChunk_->HasAvailable( numBlocks_ ) )
-                {
-                    // This may imply somebody tried to delete a block twice.
-                    assert( false );
-                    return true;
-                }
-                break;
-            default:
-                assert( false );
-                return true;
-        }
-        for ( ChunkCIter it( start ); it != last; ++it )
-        {
-            const Chunk & chunk = *it;
-            if ( chunk.IsCorrupt( numBlocks_, blockSize_, true ) )
-                return true;
-        }
+void SlabPool::Release( ThreadCache * cache, FreeList * list,
+    std::size_t count )
+{
+    MutexLock lock( &mutex_ );
+    AddCounters( cache );
+    for ( ; ( 0 < count ) && ( NULL != list->head ); --count )
+    {
+        void * block = list->head;
+        list->head = NextBlock( block );
+        --list->length;
+        ReturnBlock( block );
     }
-
-    return false;
 }
 
-// FixedAllocator::HasBlock ---------------------------------------------------
+// SlabPool::Flush ------------------------------------------------------------
 
-const Chunk * FixedAllocator::HasBlock( void * p ) const
+void SlabPool::Flush( ThreadCache * cache )
 {
-    const std::size_t chunkLength = numBlocks_ * blockSize_;
-    for ( ChunkCIter it( chunks_.begin() ); it != chunks_.end(); ++it )
+    MutexLock lock( &mutex_ );
+    AddCounters( cache );
+    for ( std::size_t i = 0; i < classCount_; ++i )
     {
-        const Chunk & chunk = *it;
-        if ( chunk.HasBlock( p, chunkLength ) )
-            return &chunk;
+        FreeList & list = cache->lists[ i ];
+        while ( NULL != list.head )
+        {
+            void * block = list.head;
+            list.head = NextBlock( block );
+            ReturnBlock( block );
+        }
+        list.length = 0;
     }
-    return NULL;
 }
 
-// FixedAllocator::TrimEmptyChunk ---------------------------------------------
+// SlabPool::AddCounters ------------------------------------------------------
+
+void SlabPool::AddCounters( ThreadCache * cache )
+{
+    allocations_ += cache->allocations;
+    deallocations_ += cache->deallocations;
+    allocatedBytes_ += cache->allocatedBytes;
+    freedBytes_ += cache->freedBytes;
+    cache->allocations = 0;
+    cache->deallocations = 0;
+    cache->allocatedBytes = 0;
+    cache->freedBytes = 0;
+}
+
+// SlabPool::ReturnBlock ------------------------------------------------------
 
-bool FixedAllocator::TrimEmptyChunk( void )
+void SlabPool::ReturnBlock( void * block )
 {
-    // prove either emptyChunk_ points nowhere, or points to a truly empty Chunk.
-    assert( ( NULL == emptyChunk_ ) || ( emptyChunk_->HasAvailable( numBlocks_ ) ) );
-    if ( NULL == emptyChunk_ ) return false;
-
-    // If emptyChunk_ points to valid Chunk, then chunk list is not empty.
-    assert( !chunks_.empty() );
-    // And there should be exactly 1 empty Chunk.
-    assert( 1 == CountEmptyChunks() );
-
-    Chunk * lastChunk = &chunks_.back();
-    if ( lastChunk != emptyChunk_ )
-        std::swap( *emptyChunk_, *lastChunk );
-    assert( lastChunk->HasAvailable( numBlocks_ ) );
-    lastChunk->Release();
-    chunks_.pop_back();
-
-    if ( chunks_.empty() )
+    Slab * slab = GetSlab( block );
+    assert( kSlabMagic == slab->magic );
+    assert( 0 < slab->usedBlocks );
+    SizeClass & sizeClass = classes_[ slab->sizeClass ];
+    if ( slab->usedBlocks == sizeClass.blocksPerSlab )
+        AddToPartial( sizeClass, slab );
+    NextBlock( block ) = slab->freeList;
+    slab->freeList = block;
+    if ( 0 != --slab->usedBlocks )
+        return;
+
+    RemoveFromPartial( sizeClass, slab );
+    if ( NULL == sizeClass.spare )
     {
-        allocChunk_ = NULL;
-        deallocChunk_ = NULL;
+        // Starts over from the beginning of the slab, which keeps the blocks
+        // given out next close to each other.
+        slab->freeList = NULL;
+        slab->unused = reinterpret_cast< unsigned char * >( slab ) +
+            headerSize_;
+        sizeClass.spare = slab;
     }
     else
     {
-        if ( deallocChunk_ == emptyChunk_ )
-        {
-            deallocChunk_ = &chunks_.front();
-            assert( deallocChunk_->blocksAvailable_ < numBlocks_ );
-        }
-        if ( allocChunk_ == emptyChunk_ )
-        {
-            allocChunk_ = &chunks_.back();
-            assert( allocChunk_->blocksAvailable_ < numBlocks_ );
-        }
+        DestroySlab( slab );
     }
+}
 
-    emptyChunk_ = NULL;
-    assert( 0 == CountEmptyChunks() );
+// SlabPool::CreateSlab -------------------------------------------------------
 
-    return true;
+Slab * SlabPool::CreateSlab( std::size_t index )
+{
+    // Maps twice the size, then unmaps the parts out of the aligned slab.
+    void * p = mmap( NULL, slabSize_ * 2, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANON, -1, 0 );
+    if ( MAP_FAILED == p )
+        return NULL;
+    const uintptr_t start = reinterpret_cast< uintptr_t >( p );
+    const uintptr_t aligned = ( start + slabSize_ - 1 ) & ~( slabSize_ - 1 );
+    if ( aligned != start )
+        munmap( p, aligned - start );
+    munmap( reinterpret_cast< void * >( aligned + slabSize_ ),
+            start + slabSize_ - aligned );
+
+    Slab * slab = reinterpret_cast< Slab * >( aligned );
+    slab->magic = kSlabMagic;
+    slab->sizeClass = index;
+    slab->usedBlocks = 0;
+    slab->freeList = NULL;
+    slab->unused = reinterpret_cast< unsigned char * >( slab ) + headerSize_;
+    slab->prev = NULL;
+    slab->next = NULL;
+    slab->allPrev = NULL;
+    slab->allNext = slabs_;
+    if ( NULL != slabs_ )
+        slabs_->allPrev = slab;
+    slabs_ = slab;
+    ++slabCount_;
+    return slab;
+}
+
+// SlabPool::DestroySlab ------------------------------------------------------
+
+void SlabPool::DestroySlab( Slab * slab )
+{
+    if ( NULL != slab->allPrev )
+        slab->allPrev->allNext = slab->allNext;
+    else
+        slabs_ = slab->allNext;
+    if ( NULL != slab->allNext )
+        slab->allNext->allPrev = slab->allPrev;
+    slab->magic = 0;
+    munmap( slab, slabSize_ );
+    --slabCount_;
+    ++releasedSlabs_;
 }
 
-// FixedAllocator::TrimChunkList ----------------------------------------------
+// SlabPool::AddToPartial -----------------------------------------------------
 
-bool FixedAllocator::TrimChunkList( void )
+void SlabPool::AddToPartial( SizeClass & sizeClass, Slab * slab )
 {
-    if ( chunks_.empty() )
-    {
-        assert( NULL == allocChunk_ );
-        assert( NULL == deallocChunk_ );
-    }
+    slab->prev = NULL;
+    slab->next = sizeClass.partial;
+    if ( NULL != sizeClass.partial )
+        sizeClass.partial->prev = slab;
+    sizeClass.partial = slab;
+}
 
-    if ( chunks_.size() == chunks_.capacity() )
-        return false;
-    // Use the "make-a-temp-and-swap" trick to remove excess capacity.
-    Chunks( chunks_ ).swap( chunks_ );
+// SlabPool::RemoveFromPartial ------------------------------------------------
 
-    return true;
+void SlabPool::RemoveFromPartial( SizeClass & sizeClass, Slab * slab )
+{
+    if ( NULL != slab->prev )
+        slab->prev->next = slab->next;
+    else
+        sizeClass.partial = slab->next;
+    if ( NULL != slab->next )
+        slab->next->prev = slab->prev;
+    slab->prev = NULL;
+    slab->next = NULL;
 }
 
-// FixedAllocator::MakeNewChunk -----------------------------------------------
+// SlabPool::HasBlock ---------------------------------------------------------
 
-bool FixedAllocator::MakeNewChunk( void )
+bool SlabPool::HasBlock( void * p )
 {
-    bool allocated = false;
-    try
+    Slab * target = GetSlab( p );
+    MutexLock lock( &mutex_ );
+    for ( Slab * slab = slabs_; NULL != slab; slab = slab->allNext )
     {
-        std::size_t size = chunks_.size();
-        // Calling chunks_.reserve *before* creating and initializing the new
-        // Chunk means that nothing is leaked by this function in case an
-        // exception is thrown from reserve.
-        if ( chunks_.capacity() == size )
-        {
-            if ( 0 == size ) size = 4;
-            chunks_.reserve( size * 2 );
-        }
-        Chunk newChunk;
-        allocated = newChunk.Init( blockSize_, numBlocks_ );
-        if ( allocated )
-            chunks_.push_back( newChunk );
-    }
-    catch ( ... )
-    {
-        allocated = false;
+        if ( slab == target )
+            return true;
     }
-    if ( !allocated ) return false;
-
-    allocChunk_ = &chunks_.back();
-    deallocChunk_ = &chunks_.front();
-    return true;
+    return false;
 }
 
-// FixedAllocator::Allocate ---------------------------------------------------
+// SlabPool::Trim -------------------------------------------------------------
 
-void * FixedAllocator::Allocate( void )
+bool SlabPool::Trim( void )
 {
-    // prove either emptyChunk_ points nowhere, or points to a truly empty Chunk.
-    assert( ( NULL == emptyChunk_ ) || ( emptyChunk_->HasAvailable( numBlocks_ ) ) );
-    assert( CountEmptyChunks() < 2 );
+    ThreadCache * cache =
+        static_cast< ThreadCache * >( pthread_getspecific( cacheKey_ ) );
+    if ( NULL != cache )
+        Flush( cache );
 
-    if ( ( NULL == allocChunk_ ) || allocChunk_->IsFilled() )
+    MutexLock lock( &mutex_ );
+    bool found = false;
+    for ( std::size_t i = 0; i < classCount_; ++i )
     {
-        if ( NULL != emptyChunk_ )
-        {
-            allocChunk_ = emptyChunk_;
-            emptyChunk_ = NULL;
-        }
-        else
+        if ( NULL != classes_[ i ].spare )
         {
-            for ( ChunkIter i( chunks_.begin() ); ; ++i )
-            {
-                if ( chunks_.end() == i )
-                {
-                    if ( !MakeNewChunk() )
-                        return NULL;
-                    break;
-                }
-                if ( !i->IsFilled() )
-                {
-                    allocChunk_ = &*i;
-                    break;
-                }
-            }
+            DestroySlab( classes_[ i ].spare );
+            classes_[ i ].spare = NULL;
+            found = true;
         }
     }
-    else if ( allocChunk_ == emptyChunk_)
-        // detach emptyChunk_ from allocChunk_, because after
-        // calling allocChunk_->Allocate(blockSize_); the chunk
-        // is no longer empty.
-        emptyChunk_ = NULL;
-
-    assert( allocChunk_ != NULL );
-    assert( !allocChunk_->IsFilled() );
-    void * place = allocChunk_->Allocate( blockSize_ );
-
-    // prove either emptyChunk_ points nowhere, or points to a truly empty Chunk.
-    assert( ( NULL == emptyChunk_ ) || ( emptyChunk_->HasAvailable( numBlocks_ ) ) );
-    assert( CountEmptyChunks() < 2 );
-
-#ifdef TRACE_ALLOCS
-    VALGRIND_PRINTF_BACKTRACE("TRACE_ALLOC: %d", static_cast<int>(blockSize_));
-#endif
-
-#ifdef _DEBUG
-    if (++allocCount_ % 10000 == 0)
-        ReportStat();
-#endif
-
-    return place;
+    return found;
 }
 
-// FixedAllocator::Deallocate -------------------------------------------------
+// SlabPool::GetStatistics ----------------------------------------------------
 
-bool FixedAllocator::Deallocate( void * p, Chunk * hint )
+void SlabPool::GetStatistics( SmallObjAllocator::Statistics * stats )
 {
-    assert(!chunks_.empty());
-    assert(&chunks_.front() <= deallocChunk_);
-    assert(&chunks_.back() >= deallocChunk_);
-    assert( &chunks_.front() <= allocChunk_ );
-    assert( &chunks_.back() >= allocChunk_ );
-    assert( CountEmptyChunks() < 2 );
-
-    Chunk * foundChunk = ( NULL == hint ) ? VicinityFind( p ) : hint;
-    if ( NULL == foundChunk )
-        return false;
-
-    assert( foundChunk->HasBlock( p, numBlocks_ * blockSize_ ) );
-#ifdef LOKI_CHECK_FOR_CORRUPTION
-    if ( foundChunk->IsCorrupt( numBlocks_, blockSize_, true ) )
-    {
-        assert( false );
-        return false;
-    }
-    if ( foundChunk->IsBlockAvailable( p, numBlocks_, blockSize_ ) )
-    {
-        assert( false );
-        return false;
-    }
-#endif
-    deallocChunk_ = foundChunk;
-    DoDeallocate(p);
-    assert( CountEmptyChunks() < 2 );
-
-#ifdef _DEBUG
-    if (++deallocCount_ % 10000 == 0)
-        ReportStat();
-#endif
-    return true;
-}
-
-// FixedAllocator::VicinityFind -----------------------------------------------
-
-Chunk * FixedAllocator::VicinityFind( void * p ) const
+    ThreadCache * cache =
+        static_cast< ThreadCache * >( pthread_getspecific( cacheKey_ ) );
+    MutexLock lock( &mutex_ );
+    if ( NULL != cache )
+        AddCounters( cache );
+    stats->slabCount = slabCount_;
+    stats->reservedBytes = slabCount_ * slabSize_;
+    stats->bytesInUse = allocatedBytes_ - freedBytes_;
+    stats->allocations = allocations_;
+    stats->deallocations = deallocations_;
+    stats->releasedSlabs = releasedSlabs_;
+}
+
+// SlabPool::IsCorrupt --------------------------------------------------------
+
+bool SlabPool::IsCorrupt( void )
 {
-    if ( chunks_.empty() ) return NULL;
-    assert(deallocChunk_);
-
-    const std::size_t chunkLength = numBlocks_ * blockSize_;
-    Chunk * lo = deallocChunk_;
-    Chunk * hi = deallocChunk_ + 1;
-    const Chunk * loBound = &chunks_.front();
-    const Chunk * hiBound = &chunks_.back() + 1;
-
-    // Special case: deallocChunk_ is the last in the array
-    if (hi == hiBound) hi = NULL;
-
-    for (;;)
+    MutexLock lock( &mutex_ );
+    std::size_t count = 0;
+    for ( Slab * slab = slabs_; NULL != slab; slab = slab->allNext )
     {
-        if (lo)
+        ++count;
+        if ( ( kSlabMagic != slab->magic ) || ( slab->sizeClass >= classCount_ ) )
         {
-            if ( lo->HasBlock( p, chunkLength ) ) return lo;
-            if ( lo == loBound )
-            {
-                lo = NULL;
-                if ( NULL == hi ) break;
-            }
-            else --lo;
+            assert( false );
+            return true;
         }
-
-        if (hi)
+        const SizeClass & sizeClass = classes_[ slab->sizeClass ];
+        unsigned char * blocks =
+            reinterpret_cast< unsigned char * >( slab ) + headerSize_;
+        if ( ( slab->unused < blocks ) ||
+             ( slab->unused > blocks +
+               sizeClass.blocksPerSlab * sizeClass.blockSize ) ||
+             ( 0 != ( slab->unused - blocks ) % sizeClass.blockSize ) )
+        {
+            assert( false );
+            return true;
+        }
+        const std::size_t carvedBlocks =
+            ( slab->unused - blocks ) / sizeClass.blockSize;
+        // Walks the free list, which can't be longer than the carved blocks.
+        std::size_t freeBlocks = 0;
+        for ( void * block = slab->freeList; NULL != block;
+              block = NextBlock( block ) )
         {
-            if ( hi->HasBlock( p, chunkLength ) ) return hi;
-            if ( ++hi == hiBound )
+            unsigned char * place = static_cast< unsigned char * >( block );
+            if ( ( freeBlocks >= carvedBlocks ) || ( place < blocks ) ||
+                 ( place >= slab->unused ) ||
+                 ( 0 != ( place - blocks ) % sizeClass.blockSize ) )
             {
-                hi = NULL;
-                if ( NULL == lo ) break;
+                assert( false );
+                return true;
             }
+            ++freeBlocks;
         }
-    }
-
-    return NULL;
-}
-
-// FixedAllocator::DoDeallocate -----------------------------------------------
-
-void FixedAllocator::DoDeallocate(void* p)
-{
-    // Show that deallocChunk_ really owns the block at address p.
-    assert( deallocChunk_->HasBlock( p, numBlocks_ * blockSize_ ) );
-    // Either of the next two assertions may fail if somebody tries to
-    // delete the same block twice.
-    assert( emptyChunk_ != deallocChunk_ );
-    assert( !deallocChunk_->HasAvailable( numBlocks_ ) );
-    // prove either emptyChunk_ points nowhere, or points to a truly empty Chunk.
-    assert( ( NULL == emptyChunk_ ) || ( emptyChunk_->HasAvailable( numBlocks_ ) ) );
-
-    // call into the chunk, will adjust the inner list but won't release memory
-    deallocChunk_->Deallocate(p, blockSize_);
-
-    if ( deallocChunk_->HasAvailable( numBlocks_ ) )
-    {
-        assert( emptyChunk_ != deallocChunk_ );
-        // deallocChunk_ is empty, but a Chunk is only released if there are 2
-        // empty chunks.  Since emptyChunk_ may only point to a previously
-        // cleared Chunk, if it points to something else besides deallocChunk_,
-        // then FixedAllocator currently has 2 empty Chunks.
-        if ( NULL != emptyChunk_ )
+        if ( freeBlocks + slab->usedBlocks != carvedBlocks )
         {
-            // If last Chunk is empty, just change what deallocChunk_
-            // points to, and release the last.  Otherwise, swap an empty
-            // Chunk with the last, and then release it.
-            Chunk * lastChunk = &chunks_.back();
-            if ( lastChunk == deallocChunk_ )
-                deallocChunk_ = emptyChunk_;
-            else if ( lastChunk != emptyChunk_ )
-                std::swap( *emptyChunk_, *lastChunk );
-            assert( lastChunk->HasAvailable( numBlocks_ ) );
-            lastChunk->Release();
-            chunks_.pop_back();
-            if ( ( allocChunk_ == lastChunk ) || allocChunk_->IsFilled() )
-                allocChunk_ = deallocChunk_;
+            assert( false );
+            return true;
         }
-        emptyChunk_ = deallocChunk_;
     }
-
-    // prove either emptyChunk_ points nowhere, or points to a truly empty Chunk.
-    assert( ( NULL == emptyChunk_ ) || ( emptyChunk_->HasAvailable( numBlocks_ ) ) );
-}
-
-// GetOffset ------------------------------------------------------------------
-/// @ingroup SmallObjectGroupInternal
-/// Calculates index into array where a FixedAllocator of numBytes is located.
-inline std::size_t GetOffset( std::size_t numBytes, std::size_t alignment )
-{
-    const std::size_t alignExtra = alignment-1;
-    return ( numBytes + alignExtra ) / alignment;
+    if ( count != slabCount_ )
+    {
+        assert( false );
+        return true;
+    }
+    return false;
 }
 
 // DefaultAllocator -----------------------------------------------------------
 /** @ingroup SmallObjectGroupInternal
  Calls the default allocator when SmallObjAllocator decides not to handle a
  request.  SmallObjAllocator calls this if the number of bytes is bigger than
- the size which can be handled by any FixedAllocator.
+ the size which can be handled by any size class.
  @param numBytes number of bytes
  @param doThrow True if this function should throw an exception, or false if it
   should indicate failure by returning a NULL pointer.
 */
 void * DefaultAllocator( std::size_t numBytes, bool doThrow )
 {
-#ifdef USE_NEW_TO_ALLOCATE
-    return doThrow ? ::operator new( numBytes ) :
-        ::operator new( numBytes, std::nothrow_t() );
-#else
     void * p = ::std::malloc( numBytes );
     if ( doThrow && ( NULL == p ) )
         throw std::bad_alloc();
     return p;
-#endif
 }
 
 // DefaultDeallocator ---------------------------------------------------------
 /** @ingroup SmallObjectGroupInternal
  Calls default deallocator when SmallObjAllocator decides not to handle a
- request.  The default deallocator could be the global delete operator or the
- free function.  The free function is the preferred default deallocator since
- it matches malloc which is the preferred default allocator.  SmallObjAllocator
- will call this if an address was not found among any of its own blocks.
+ request.  The free function matches malloc which is the default allocator.
+ SmallObjAllocator will call this if an address was not found among any of
+ its own blocks.
  */
 void DefaultDeallocator( void * p )
 {
-#ifdef USE_NEW_TO_ALLOCATE
-    ::operator delete( p );
-#else
     ::std::free( p );
-#endif
 }
 
 // SmallObjAllocator::SmallObjAllocator ---------------------------------------
 
 SmallObjAllocator::SmallObjAllocator( std::size_t pageSize,
     std::size_t maxObjectSize, std::size_t objectAlignSize ) :
-    pool_( NULL ),
+    pool_( new SlabPool( pageSize, maxObjectSize, objectAlignSize ) ),
+    pageSize_( pageSize ),
     maxSmallObjectSize_( maxObjectSize ),
     objectAlignSize_( objectAlignSize )
 {
-    assert( 0 != objectAlignSize );
-    const std::size_t allocCount = GetOffset( maxObjectSize, objectAlignSize );
-    pool_ = new FixedAllocator[ allocCount ];
-    for ( std::size_t i = 0; i < allocCount; ++i )
-        pool_[ i ].Initialize( ( i+1 ) * objectAlignSize, pageSize );
 }
 
 // SmallObjAllocator::~SmallObjAllocator --------------------------------------
 
 SmallObjAllocator::~SmallObjAllocator( void )
 {
-    delete [] pool_;
+    delete pool_;
 }
 
 SmallObjAllocator & SmallObjAllocator::Instance( std::size_t pageSize,
     std::size_t maxObjectSize, std::size_t objectAlignSize ) {
-    static SmallObjAllocator *instance = NULL;
-    static std::size_t curPageSize = 0;
-    static std::size_t curMaxObjectSize = 0;
-    static std::size_t curObjectAlignSize = 0;
+    // The initialization of function statics is thread safe.
+    static SmallObjAllocator *instance =
+        new SmallObjAllocator(pageSize, maxObjectSize, objectAlignSize);
 
-    if (!instance)
-    {
-        curPageSize = pageSize;
-        curMaxObjectSize = maxObjectSize;
-        curObjectAlignSize = objectAlignSize;
-        instance =
-            new SmallObjAllocator(pageSize, maxObjectSize, objectAlignSize);
-    } else if ( curPageSize != pageSize || curMaxObjectSize != maxObjectSize ||
-                curObjectAlignSize != objectAlignSize ) {
+    if ( instance->pageSize_ != pageSize ||
+         instance->maxSmallObjectSize_ != maxObjectSize ||
+         instance->objectAlignSize_ != objectAlignSize ) {
         LOG("Can't use multiple SmallObjAllocators with different parameters: "
             "old: (%zd, %zd, %zd) new: (%zd, %zd, %zd)",
-            curPageSize, curMaxObjectSize, curObjectAlignSize,
+            instance->pageSize_, instance->maxSmallObjectSize_,
+            instance->objectAlignSize_,
             pageSize, maxObjectSize, objectAlignSize);
         abort();
     }
@@ -1140,21 +736,14 @@ SmallObjAllocator & SmallObjAllocator::Instance( std::size_t pageSize,
 
 bool SmallObjAllocator::TrimExcessMemory( void )
 {
-    bool found = false;
-    const std::size_t allocCount = GetOffset( GetMaxObjectSize(), GetAlignment() );
-    std::size_t i = 0;
-    for ( ; i < allocCount; ++i )
-    {
-        if ( pool_[ i ].TrimEmptyChunk() )
-            found = true;
-    }
-    for ( i = 0; i < allocCount; ++i )
-    {
-        if ( pool_[ i ].TrimChunkList() )
-            found = true;
-    }
+    return pool_->Trim();
+}
 
-    return found;
+// SmallObjAllocator::GetStatistics -------------------------------------------
+
+void SmallObjAllocator::GetStatistics( Statistics * stats ) const
+{
+    pool_->GetStatistics( stats );
 }
 
 // SmallObjAllocator::Allocate ------------------------------------------------
@@ -1164,20 +753,11 @@ void * SmallObjAllocator::Allocate( std::size_t numBytes, bool doThrow )
     if ( numBytes > GetMaxObjectSize() )
         return DefaultAllocator( numBytes, doThrow );
 
-    assert( NULL != pool_ );
     if ( 0 == numBytes ) numBytes = 1;
-    const std::size_t index = GetOffset( numBytes, GetAlignment() ) - 1;
-    const std::size_t allocCount = GetOffset( GetMaxObjectSize(), GetAlignment() );
-    (void) allocCount;
-    assert( index < allocCount );
-
-    FixedAllocator & allocator = pool_[ index ];
-    assert( allocator.BlockSize() >= numBytes );
-    assert( allocator.BlockSize() < numBytes + GetAlignment() );
-    void * place = allocator.Allocate();
+    void * place = pool_->Allocate( numBytes );
 
     if ( ( NULL == place ) && TrimExcessMemory() )
-        place = allocator.Allocate();
+        place = pool_->Allocate( numBytes );
 
     if ( ( NULL == place ) && doThrow )
     {
@@ -1202,18 +782,8 @@ void SmallObjAllocator::Deallocate( void * p, std::size_t numBytes )
         DefaultDeallocator( p );
         return;
     }
-    assert( NULL != pool_ );
     if ( 0 == numBytes ) numBytes = 1;
-    const std::size_t index = GetOffset( numBytes, GetAlignment() ) - 1;
-    const std::size_t allocCount = GetOffset( GetMaxObjectSize(), GetAlignment() );
-    (void) allocCount;
-    assert( index < allocCount );
-    FixedAllocator & allocator = pool_[ index ];
-    assert( allocator.BlockSize() >= numBytes );
-    assert( allocator.BlockSize() < numBytes + GetAlignment() );
-    const bool found = allocator.Deallocate( p, NULL );
-    (void) found;
-    assert( found );
+    pool_->Deallocate( p, numBytes );
 }
 
 // SmallObjAllocator::Deallocate ----------------------------------------------
@@ -1221,30 +791,10 @@ void SmallObjAllocator::Deallocate( void * p, std::size_t numBytes )
 void SmallObjAllocator::Deallocate( void * p )
 {
     if ( NULL == p ) return;
-    assert( NULL != pool_ );
-    FixedAllocator * pAllocator = NULL;
-    const std::size_t allocCount = GetOffset( GetMaxObjectSize(), GetAlignment() );
-    Chunk * chunk = NULL;
-
-    for ( std::size_t ii = 0; ii < allocCount; ++ii )
-    {
-        chunk = pool_[ ii ].HasBlock( p );
-        if ( NULL != chunk )
-        {
-            pAllocator = &pool_[ ii ];
-            break;
-        }
-    }
-    if ( NULL == pAllocator )
-    {
+    if ( pool_->HasBlock( p ) )
+        pool_->Deallocate( p );
+    else
         DefaultDeallocator( p );
-        return;
-    }
-
-    assert( NULL != chunk );
-    const bool found = pAllocator->Deallocate( p, chunk );
-    (void) found;
-    assert( found );
 }
 
 // SmallObjAllocator::IsCorrupt -----------------------------------------------
@@ -1266,13 +816,7 @@ bool SmallObjAllocator::IsCorrupt( void ) const
         assert( false );
         return true;
     }
-    const std::size_t allocCount = GetOffset( GetMaxObjectSize(), GetAlignment() );
-    for ( std::size_t ii = 0; ii < allocCount; ++ii )
-    {
-        if ( pool_[ ii ].IsCorrupt() )
-            return true;
-    }
-    return false;
+    return pool_->IsCorrupt();
 }
 
 } // end namespace ggadget
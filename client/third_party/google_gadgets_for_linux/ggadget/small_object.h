@@ -14,7 +14,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 // Tailored by Google to remove the dependency on Loki's thread and singleton
-// modules.
+// modules, and to replace the FixedAllocator pools with thread-caching slabs.
 
 #ifndef GGADGET_SMALL_OBJECT_H__
 #define GGADGET_SMALL_OBJECT_H__
@@ -25,7 +25,7 @@
 #include <ggadget/common.h>
 
 #ifndef LOKI_DEFAULT_CHUNK_SIZE
-#define LOKI_DEFAULT_CHUNK_SIZE 4096
+#define LOKI_DEFAULT_CHUNK_SIZE 16384
 #endif
 
 #ifndef LOKI_MAX_SMALL_OBJECT_SIZE
@@ -33,7 +33,7 @@
 #endif
 
 #ifndef LOKI_DEFAULT_OBJECT_ALIGNMENT
-#define LOKI_DEFAULT_OBJECT_ALIGNMENT 4
+#define LOKI_DEFAULT_OBJECT_ALIGNMENT 16
 #endif
 
 #if defined(LOKI_SMALL_OBJECT_USE_NEW_ARRAY) && defined(_MSC_VER)
@@ -52,27 +52,48 @@ namespace ggadget
 {
 
 #if !defined(OS_WIN)
-    class FixedAllocator;
+    class SlabPool;
 
     /** @class SmallObjAllocator
         @ingroup SmallObjectGroupInternal
-     Manages pool of fixed-size allocators.
+     Manages pool of slabs for small objects.
      Designed to be a non-templated base class of AllocatorSingleton so that
      implementation details can be safely hidden in the source code file.
+
+     @par Slabs and Size Classes
+     Sizes are rounded up to a multiple of the alignment, and each resulting
+     size class is served from slabs, which are blocks of pageSize bytes
+     mapped from the system and aligned on their size, so the slab of a block
+     is found by masking its address.
+
+     @par Thread Caches
+     Each thread keeps a cache of free blocks for every size class, so most
+     allocations and deallocations take a block from or put a block to a
+     thread-local list without locking.  Blocks move between the caches and
+     the slabs in batches under a lock.  A block may be deallocated by any
+     thread.  The cache of a thread is returned to the slabs when the thread
+     exits.
+
+     @par Releasing Memory
+     A slab which becomes empty is unmapped at once, except one spare slab per
+     size class, which is kept to avoid mapping and unmapping a slab over and
+     over at its boundary.  TrimExcessMemory releases the spare slabs too.
      */
     class SmallObjAllocator
     {
     protected:
         /** The only available constructor needs certain parameters in order to
-         initialize all the FixedAllocator's.  This throws only if
-         @param pageSize # of bytes in a page of memory.
+         initialize all the size classes.
+         @param pageSize # of bytes in a slab, rounded up to a power of 2 and
+          the system page size.
          @param maxObjectSize Max # of bytes which this may allocate.
-         @param objectAlignSize # of bytes between alignment boundaries.
+         @param objectAlignSize # of bytes between alignment boundaries, a
+          power of 2 no smaller than a pointer.
          */
         SmallObjAllocator( std::size_t pageSize, std::size_t maxObjectSize,
             std::size_t objectAlignSize );
 
-        /** Destructor releases all blocks, all Chunks, and FixedAllocator's.
+        /** Destructor releases all blocks and slabs.
          Any outstanding blocks are unavailable, and should not be used after
          this destructor is called.  The destructor is deliberately non-virtual
          because it is protected, not public.
@@ -83,9 +104,29 @@ namespace ggadget
         static SmallObjAllocator & Instance( std::size_t pageSize,
             std::size_t maxObjectSize, std::size_t objectAlignSize );
     public:
-        /** Allocates a block of memory of requested size.  Complexity is often
-         constant-time, but might be O(C) where C is the number of Chunks in a
-         FixedAllocator.
+        /** Statistics of the allocator.  The counters of a thread are added up
+         whenever its cache exchanges blocks with the slabs, so the numbers of
+         the other running threads may lag behind by a batch of blocks.
+         */
+        struct Statistics
+        {
+            /// # of slabs currently mapped.
+            std::size_t slabCount;
+            /// # of bytes in the mapped slabs.
+            std::size_t reservedBytes;
+            /// # of bytes in the blocks held by objects.
+            std::size_t bytesInUse;
+            /// Total # of small blocks allocated.
+            std::size_t allocations;
+            /// Total # of small blocks deallocated.
+            std::size_t deallocations;
+            /// Total # of slabs returned to the system.
+            std::size_t releasedSlabs;
+        };
+
+        /** Allocates a block of memory of requested size.  Complexity is
+         constant-time.  Most allocations take a block from the cache of the
+         calling thread without locking.
 
          @par Exception Safety Level
          Provides either strong-exception safety, or no-throw exception-safety
@@ -115,14 +156,12 @@ namespace ggadget
         void * Allocate( std::size_t size, bool doThrow );
 
         /** Deallocates a block of memory at a given place and of a specific
-        size.  Complexity is almost always constant-time, and is O(C) only if
-        it has to search for which Chunk deallocates.  This never throws.
+        size.  Complexity is constant-time.  This never throws.
          */
         void Deallocate( void * p, std::size_t size );
 
         /** Deallocates a block of memory at a given place but of unknown size
-        size.  Complexity is O(F + C) where F is the count of FixedAllocator's
-        in the pool, and C is the number of Chunks in all FixedAllocator's.  This
+        size.  Complexity is O(S) where S is the number of slabs.  This
         does not throw exceptions.  This overloaded version of Deallocate is
         called by the nothow delete operator - which is called when the nothrow
         new operator is used, but a constructor throws an exception.
@@ -136,19 +175,24 @@ namespace ggadget
         /// Returns # of bytes between allocation boundaries.
         inline std::size_t GetAlignment() const { return objectAlignSize_; }
 
-        /** Releases empty Chunks from memory.  Complexity is O(F + C) where F
-        is the count of FixedAllocator's in the pool, and C is the number of
-        Chunks in all FixedAllocator's.  This will never throw.  This is called
-        by AllocatorSingleto::ClearExtraMemory, the new_handler function for
-        Loki's allocator, and is called internally when an allocation fails.
+        /** Returns the blocks cached by the calling thread to the slabs, and
+        releases empty slabs to the system.  Complexity is O(B + F) where B is
+        the number of blocks cached by the calling thread, and F is the count
+        of size classes.  This will never throw.  This should be called when
+        the thread becomes idle, as the gtk main loop does periodically for
+        the main thread, and is called internally when an allocation fails.
         @return True if any memory released, or false if none released.
          */
         bool TrimExcessMemory( void );
 
+        /** Fills the statistics of the allocator.  The counters of the
+        calling thread are up to date.
+         */
+        void GetStatistics( Statistics * stats ) const;
+
         /** Returns true if anything in implementation is corrupt.  Complexity
-         is O(F + C + B) where F is the count of FixedAllocator's in the pool,
-         C is the number of Chunks in all FixedAllocator's, and B is the number
-         of blocks in all Chunks.  If it determines any data is corrupted, this
+         is O(S + B) where S is the number of slabs, and B is the number of
+         free blocks in all slabs.  If it determines any data is corrupted, this
          will return true in release version, but assert in debug version at
          the line where it detects the corrupted data.  If it does not detect
          any corrupted data, it returns false.
@@ -163,8 +207,11 @@ namespace ggadget
         /// Copy-assignment operator is not implemented.
         SmallObjAllocator & operator = ( const SmallObjAllocator & );
 
-        /// Pointer to array of fixed-size allocators.
-        FixedAllocator * pool_;
+        /// Slabs, size classes and thread caches.
+        SlabPool * pool_;
+
+        /// # of bytes in a slab, as requested.
+        const std::size_t pageSize_;
 
         /// Largest object size supported by allocators.
         const std::size_t maxSmallObjectSize_;
@@ -631,6 +631,59 @@ TEST_F(BasicElementTest, TestMinHeight) {
   ASSERT_DOUBLE_EQ(150.0, m->GetPixelHeight());
 }
 
+TEST_F(BasicElementTest, TestIncrementalLayout) {
+  view_->SetSize(400, 400);
+  BasicElement *m = view_->GetChildren()->AppendElement("muffin", NULL);
+  m->SetPixelWidth(100);
+  m->SetPixelHeight(100);
+  BasicElement *relative = m->GetChildren()->AppendElement("pie", NULL);
+  relative->SetRelativeWidth(0.5);
+  relative->SetPixelHeight(10);
+  BasicElement *pixel = m->GetChildren()->AppendElement("muffin", NULL);
+  pixel->SetPixelWidth(10);
+  pixel->SetPixelHeight(10);
+  BasicElement *grandchild = pixel->GetChildren()->AppendElement("pie", NULL);
+
+  view_->Layout();
+  EXPECT_EQ(4, view_->GetLayoutCount());
+  EXPECT_DOUBLE_EQ(50.0, relative->GetPixelWidth());
+  EXPECT_FALSE(m->IsLayoutDirty());
+
+  // Nothing has changed.
+  view_->Layout();
+  EXPECT_EQ(0, view_->GetLayoutCount());
+
+  // Only the changed element and its ancestors are laid out.
+  grandchild->SetPixelX(5);
+  EXPECT_TRUE(m->IsLayoutDirty());
+  EXPECT_FALSE(relative->IsLayoutDirty());
+  view_->Layout();
+  EXPECT_EQ(3, view_->GetLayoutCount());
+
+  // A size change affects only the children with relative size or position.
+  m->SetPixelWidth(200);
+  view_->Layout();
+  EXPECT_EQ(2, view_->GetLayoutCount());
+  EXPECT_DOUBLE_EQ(100.0, relative->GetPixelWidth());
+
+  // The whole subtree of a moved element is laid out.
+  pixel->SetPixelY(20);
+  view_->Layout();
+  EXPECT_EQ(3, view_->GetLayoutCount());
+
+  grandchild->QueueLayout();
+  view_->Layout();
+  EXPECT_EQ(3, view_->GetLayoutCount());
+
+  // Removing an element changes the index of the following siblings.
+  m->GetChildren()->RemoveElement(relative);
+  EXPECT_EQ(0U, pixel->GetIndex());
+  view_->Layout();
+  EXPECT_EQ(3, view_->GetLayoutCount());
+  view_->Layout();
+  EXPECT_EQ(0, view_->GetLayoutCount());
+}
+
 int main(int argc, char *argv[]) {
   SetGlobalMainLoop(&main_loop);
   testing::ParseGTestFlags(&argc, argv);
@@ -0,0 +1,216 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <cstdlib>
+#include "ggadget/common.h"
+#include "ggadget/clip_region.h"
+#include "ggadget/math_utils.h"
+#include "unittest/gtest.h"
+
+using namespace ggadget;
+
+namespace {
+
+const int kGridSize = 32;
+
+// Checks the banded form of the region: the rectangles don't overlap, are
+// sorted by y then x, and rectangles of the same band have the same height.
+void ExpectBanded(const ClipRegion &region) {
+  size_t count = region.GetRectangleCount();
+  for (size_t i = 1; i < count; ++i) {
+    Rectangle prev = region.GetRectangle(i - 1);
+    Rectangle cur = region.GetRectangle(i);
+    EXPECT_GT(cur.w, 0);
+    EXPECT_GT(cur.h, 0);
+    if (prev.y == cur.y) {
+      EXPECT_EQ(prev.h, cur.h);
+      // Spans of a band don't touch each other.
+      EXPECT_LT(prev.x + prev.w, cur.x);
+    } else {
+      EXPECT_LE(prev.y + prev.h, cur.y);
+    }
+  }
+}
+
+// Rasterizes a region onto a grid of unit cells.
+void Rasterize(const ClipRegion &region, bool grid[kGridSize][kGridSize]) {
+  for (int y = 0; y < kGridSize; ++y)
+    for (int x = 0; x < kGridSize; ++x)
+      grid[y][x] = region.IsPointIn(x + 0.5, y + 0.5);
+}
+
+// Fills the cells covered by rect.
+void Fill(const Rectangle &rect, bool grid[kGridSize][kGridSize]) {
+  int left = static_cast<int>(rect.x), top = static_cast<int>(rect.y);
+  for (int y = top; y < top + rect.h; ++y)
+    for (int x = left; x < left + rect.w; ++x)
+      grid[y][x] = true;
+}
+
+Rectangle RandomRectangle() {
+  double x = rand() % (kGridSize - 1);
+  double y = rand() % (kGridSize - 1);
+  double w = rand() % (kGridSize - static_cast<int>(x)) + 1;
+  double h = rand() % (kGridSize - static_cast<int>(y)) + 1;
+  return Rectangle(x, y, w, h);
+}
+
+}  // namespace
+
+TEST(ClipRegionTest, AddRectangle) {
+  ClipRegion region;
+  EXPECT_TRUE(region.IsEmpty());
+  region.AddRectangle(Rectangle(0, 0, 10, 10));
+  region.AddRectangle(Rectangle(0, 0, 0, 10));
+  EXPECT_EQ(1U, region.GetRectangleCount());
+
+  // Overlapping rectangles are split into bands.
+  region.AddRectangle(Rectangle(5, 5, 10, 10));
+  ExpectBanded(region);
+  EXPECT_EQ(3U, region.GetRectangleCount());
+  EXPECT_TRUE(Rectangle(0, 0, 10, 5) == region.GetRectangle(0));
+  EXPECT_TRUE(Rectangle(0, 5, 15, 5) == region.GetRectangle(1));
+  EXPECT_TRUE(Rectangle(5, 10, 10, 5) == region.GetRectangle(2));
+  EXPECT_TRUE(Rectangle(0, 0, 15, 15) == region.GetExtents());
+
+  // Adjacent bands with the same spans are coalesced.
+  ClipRegion column;
+  column.AddRectangle(Rectangle(0, 0, 10, 10));
+  column.AddRectangle(Rectangle(0, 10, 10, 10));
+  column.AddRectangle(Rectangle(20, 0, 10, 20));
+  EXPECT_EQ(2U, column.GetRectangleCount());
+  EXPECT_TRUE(Rectangle(0, 0, 10, 20) == column.GetRectangle(0));
+  EXPECT_TRUE(Rectangle(20, 0, 10, 20) == column.GetRectangle(1));
+
+  // Touching spans are joined.
+  column.AddRectangle(Rectangle(10, 0, 10, 20));
+  EXPECT_EQ(1U, column.GetRectangleCount());
+  EXPECT_TRUE(Rectangle(0, 0, 30, 20) == column.GetRectangle(0));
+}
+
+TEST(ClipRegionTest, FuzzyRatio) {
+  ClipRegion region(0.8);
+  region.AddRectangle(Rectangle(0, 0, 10, 10));
+  region.AddRectangle(Rectangle(1, 1, 10, 10));
+  EXPECT_EQ(1U, region.GetRectangleCount());
+  EXPECT_TRUE(Rectangle(0, 0, 11, 11) == region.GetRectangle(0));
+
+  region.AddRectangle(Rectangle(100, 100, 10, 10));
+  EXPECT_EQ(2U, region.GetRectangleCount());
+}
+
+TEST(ClipRegionTest, Queries) {
+  ClipRegion region;
+  EXPECT_FALSE(region.IsInside(Rectangle(0, 0, 100, 100)));
+  EXPECT_FALSE(region.Overlaps(Rectangle(0, 0, 100, 100)));
+
+  region.AddRectangle(Rectangle(0, 0, 10, 10));
+  region.AddRectangle(Rectangle(20, 20, 10, 10));
+  EXPECT_TRUE(region.IsPointIn(5, 5));
+  EXPECT_TRUE(region.IsPointIn(25, 25));
+  EXPECT_FALSE(region.IsPointIn(15, 15));
+  EXPECT_FALSE(region.IsPointIn(10, 5));
+  EXPECT_TRUE(region.Overlaps(Rectangle(8, 8, 4, 4)));
+  EXPECT_FALSE(region.Overlaps(Rectangle(10, 10, 10, 10)));
+  EXPECT_FALSE(region.Overlaps(Rectangle(0, 10, 20, 10)));
+  EXPECT_TRUE(region.IsInside(Rectangle(0, 0, 30, 30)));
+  EXPECT_FALSE(region.IsInside(Rectangle(0, 0, 29, 30)));
+}
+
+TEST(ClipRegionTest, SetOperations) {
+  ClipRegion a, b;
+  a.AddRectangle(Rectangle(0, 0, 20, 20));
+  b.AddRectangle(Rectangle(10, 10, 20, 20));
+
+  ClipRegion intersection(a);
+  intersection.Intersect(b);
+  EXPECT_EQ(1U, intersection.GetRectangleCount());
+  EXPECT_TRUE(Rectangle(10, 10, 10, 10) == intersection.GetRectangle(0));
+
+  ClipRegion difference(a);
+  difference.Subtract(b);
+  ExpectBanded(difference);
+  EXPECT_EQ(2U, difference.GetRectangleCount());
+  EXPECT_TRUE(Rectangle(0, 0, 20, 10) == difference.GetRectangle(0));
+  EXPECT_TRUE(Rectangle(0, 10, 10, 10) == difference.GetRectangle(1));
+
+  difference.Subtract(a);
+  EXPECT_TRUE(difference.IsEmpty());
+
+  ClipRegion disjoint;
+  disjoint.AddRectangle(Rectangle(100, 100, 10, 10));
+  intersection.Intersect(disjoint);
+  EXPECT_TRUE(intersection.IsEmpty());
+}
+
+TEST(ClipRegionTest, RandomOperations) {
+  srand(0);
+  for (int round = 0; round < 200; ++round) {
+    ClipRegion a, b;
+    bool expected_a[kGridSize][kGridSize] = { { false } };
+    bool expected_b[kGridSize][kGridSize] = { { false } };
+    int n = rand() % 8 + 1;
+    for (int i = 0; i < n; ++i) {
+      Rectangle rect = RandomRectangle();
+      a.AddRectangle(rect);
+      Fill(rect, expected_a);
+      rect = RandomRectangle();
+      b.AddRectangle(rect);
+      Fill(rect, expected_b);
+    }
+    ExpectBanded(a);
+    ExpectBanded(b);
+
+    ClipRegion regions[3] = { a, a, a };
+    regions[0].Union(b);
+    regions[1].Intersect(b);
+    regions[2].Subtract(b);
+    for (int op = 0; op < 3; ++op) {
+      ExpectBanded(regions[op]);
+      bool actual[kGridSize][kGridSize];
+      Rasterize(regions[op], actual);
+      for (int y = 0; y < kGridSize; ++y) {
+        for (int x = 0; x < kGridSize; ++x) {
+          bool expected = (op == 0 ? expected_a[y][x] || expected_b[y][x] :
+                           op == 1 ? expected_a[y][x] && expected_b[y][x] :
+                           expected_a[y][x] && !expected_b[y][x]);
+          ASSERT_EQ(expected, actual[y][x])
+              << "round " << round << " op " << op << " at " << x << "," << y;
+        }
+      }
+    }
+  }
+}
+
+TEST(ClipRegionTest, IntegerizeAndZoom) {
+  ClipRegion region;
+  region.AddRectangle(Rectangle(0.5, 0.5, 10, 10));
+  region.AddRectangle(Rectangle(0.5, 10.5, 5, 5));
+  region.Integerize();
+  ExpectBanded(region);
+  EXPECT_TRUE(region.IsPointIn(0, 0));
+  EXPECT_TRUE(region.IsPointIn(10.5, 10.5));
+  EXPECT_TRUE(Rectangle(0, 0, 11, 16) == region.GetExtents());
+
+  region.Zoom(2);
+  EXPECT_TRUE(Rectangle(0, 0, 22, 32) == region.GetExtents());
+  EXPECT_TRUE(region.IsPointIn(21, 21));
+}
+
+int main(int argc, char **argv) {
+  testing::ParseGTestFlags(&argc, argv);
+  return RUN_ALL_TESTS();
+}
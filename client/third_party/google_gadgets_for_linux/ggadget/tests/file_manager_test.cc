@@ -394,6 +394,38 @@ TEST(FileManager, ZipEnumerate) {
   delete fm;
 }
 
+TEST(FileManager, ZipReadAfterModification) {
+  scoped_ptr<FileManagerInterface> fm(new ZipFileManager());
+  ASSERT_TRUE(fm->Init(base_new_gg_path, true));
+  std::string data;
+  EXPECT_FALSE(fm->FileExists("file1", NULL));
+  ASSERT_TRUE(fm->WriteFile("file1", "content1", false));
+  EXPECT_TRUE(fm->ReadFile("file1", &data));
+  EXPECT_EQ("content1", data);
+
+  // The files written after reading can be found as well.
+  ASSERT_TRUE(fm->WriteFile("dir/file2", "content2", false));
+  ASSERT_TRUE(fm->WriteFile("file3", "", false));
+  EXPECT_TRUE(fm->ReadFile("dir/file2", &data));
+  EXPECT_EQ("content2", data);
+  EXPECT_TRUE(fm->ReadFile("file1", &data));
+  EXPECT_EQ("content1", data);
+  EXPECT_TRUE(fm->ReadFile("file3", &data));
+  EXPECT_EQ("", data);
+  EXPECT_FALSE(fm->ReadFile("file4", &data));
+
+  ASSERT_TRUE(fm->WriteFile("file1", "new content1", true));
+  EXPECT_TRUE(fm->ReadFile("file1", &data));
+  EXPECT_EQ("new content1", data);
+  ASSERT_TRUE(fm->RemoveFile("dir/file2"));
+  EXPECT_FALSE(fm->FileExists("dir/file2", NULL));
+  EXPECT_FALSE(fm->ReadFile("dir/file2", &data));
+  EXPECT_TRUE(fm->ReadFile("file1", &data));
+  EXPECT_EQ("new content1", data);
+  fm.reset();
+  ggadget::unlink(base_new_gg_path);
+}
+
 TEST(FileManager, LocalizedFile) {
   static const char *locales_full[] = { "en_US", "zh_CN.UTF8", NULL };
   static const char *locales[] = { "en", "zh-CN", NULL };
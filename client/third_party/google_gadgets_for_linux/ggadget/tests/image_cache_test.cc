@@ -37,8 +37,8 @@ class MockedGraphics : public ggadget::GraphicsInterface {
   class MockedImage : public ggadget::ImageInterface {
    public:
     MockedImage(MockedGraphics *gfx, const std::string &tag,
-                bool share, bool is_mask)
-      : gfx_(gfx), tag_(tag), is_mask_(is_mask) {
+                bool share, bool is_mask, double width)
+      : gfx_(gfx), tag_(tag), is_mask_(is_mask), width_(width) {
       if (share) {
         if (is_mask) {
           EXPECT_TRUE(gfx->mask_images_.find(tag_) == gfx->mask_images_.end());
@@ -61,10 +61,10 @@ class MockedGraphics : public ggadget::GraphicsInterface {
     virtual void StretchDraw(CanvasInterface *canvas,
                              double x, double y,
                              double width, double height) const { }
-    virtual double GetWidth() const { return 0; }
-    virtual double GetHeight() const { return 0; }
+    virtual double GetWidth() const { return width_; }
+    virtual double GetHeight() const { return width_ ? 1 : 0; }
     virtual ImageInterface *MultiplyColor(const Color &color) const {
-      return new MockedImage(gfx_, tag_.c_str(), false, is_mask_);
+      return new MockedImage(gfx_, tag_.c_str(), false, is_mask_, width_);
     }
     virtual bool GetPointValue(double x, double y,
                                Color *color, double *opacity) const {
@@ -76,6 +76,7 @@ class MockedGraphics : public ggadget::GraphicsInterface {
     MockedGraphics *gfx_;
     std::string tag_;
     bool is_mask_;
+    double width_;
   };
  public:
   virtual ggadget::CanvasInterface *NewCanvas(double w, double h) const {
@@ -84,8 +85,9 @@ class MockedGraphics : public ggadget::GraphicsInterface {
   virtual ggadget::ImageInterface *NewImage(const std::string &tag,
                                             const std::string &data,
                                             bool is_mask) const {
+    // The image is as wide as the data is long, and one pixel high.
     return new MockedImage(const_cast<MockedGraphics*>(this), tag, true,
-                           is_mask);
+                           is_mask, static_cast<double>(data.size()));
   }
   virtual ggadget::FontInterface *NewFont(
       const std::string &family, double pt_size,
@@ -186,6 +188,61 @@ TEST(ImageCache, LoadImage) {
   ASSERT_FALSE(img_cache.LoadImage(&gfx, NULL, "", false));
 }
 
+TEST(ImageCache, MemoryBudget) {
+  MockedGraphics gfx;
+  local->should_fail_ = false;
+  local->data_["image-a"] = std::string(100, 'a');
+  local->data_["image-b"] = std::string(100, 'b');
+  local->data_["image-c"] = std::string(100, 'c');
+
+  // Caches of different views share the same images.
+  ImageCache cache1, cache2;
+  cache1.SetMemoryBudget(1000);
+  EXPECT_EQ(1000U, cache2.GetMemoryBudget());
+  ImageInterface *a1 = cache1.LoadImage(&gfx, &g_local_fm, "image-a", false);
+  ImageInterface *a2 = cache2.LoadImage(&gfx, &g_local_fm, "image-a", false);
+  ImageInterface *b = cache2.LoadImage(&gfx, &g_local_fm, "image-b", false);
+  EXPECT_EQ(a1, a2);
+  EXPECT_EQ(2U, gfx.images_.size());
+  EXPECT_EQ(800U, cache1.GetResidentBytes());
+  EXPECT_EQ(0U, cache1.GetUnusedBytes());
+  EXPECT_EQ(1U, cache1.GetHits());
+  EXPECT_EQ(2U, cache1.GetMisses());
+
+  // The unused images are kept until the budget is exceeded.
+  a1->Destroy();
+  EXPECT_EQ(0U, cache1.GetUnusedBytes());
+  a2->Destroy();
+  b->Destroy();
+  EXPECT_EQ(800U, cache1.GetResidentBytes());
+  EXPECT_EQ(800U, cache1.GetUnusedBytes());
+  EXPECT_EQ(2U, gfx.images_.size());
+
+  // The least recently released image is evicted first.
+  ImageInterface *c = cache1.LoadImage(&gfx, &g_local_fm, "image-c", false);
+  EXPECT_EQ(1U, cache1.GetEvictions());
+  EXPECT_EQ(800U, cache1.GetResidentBytes());
+  EXPECT_EQ(400U, cache1.GetUnusedBytes());
+  EXPECT_TRUE(gfx.images_.find("image-a") == gfx.images_.end());
+  EXPECT_TRUE(gfx.images_.find("image-b") != gfx.images_.end());
+
+  // A released image is reused without being decoded again.
+  b = cache2.LoadImage(&gfx, &g_local_fm, "image-b", false);
+  EXPECT_EQ(2U, cache1.GetHits());
+  EXPECT_EQ(3U, cache1.GetMisses());
+  EXPECT_EQ(0U, cache1.GetUnusedBytes());
+
+  // Images in use are never evicted.
+  cache1.SetMemoryBudget(0);
+  EXPECT_EQ(800U, cache1.GetResidentBytes());
+  EXPECT_EQ(1U, cache1.GetEvictions());
+  b->Destroy();
+  c->Destroy();
+  EXPECT_EQ(0U, cache1.GetResidentBytes());
+  EXPECT_EQ(3U, cache1.GetEvictions());
+  EXPECT_TRUE(gfx.images_.empty());
+}
+
 int main(int argc, char *argv[]) {
   testing::ParseGTestFlags(&argc, argv);
 
@@ -424,6 +424,42 @@ TEST_F(LinearElementTest, TestAutoStretch) {
   ASSERT_DOUBLE_EQ(15.0, c4->GetPixelWidth());
 }
 
+TEST_F(LinearElementTest, TestIncrementalLayout) {
+  linear_->SetOrientation(LinearElement::ORIENTATION_HORIZONTAL);
+  linear_->SetHorizontalAutoSizing(true);
+  linear_->SetVerticalAutoSizing(true);
+  linear_->SetPadding(5.0);
+
+  BasicElement *children[10];
+  for (int i = 0; i < 10; ++i) {
+    children[i] = linear_->GetChildren()->AppendElement("muffin", NULL);
+    children[i]->GetChildren()->AppendElement("pie", NULL);
+    children[i]->SetPixelWidth(10.0);
+    children[i]->SetPixelHeight(10.0);
+  }
+  view_->Layout();
+  ASSERT_DOUBLE_EQ(145.0, linear_->GetPixelWidth());
+  // The children moved by the first layout are laid out again with their
+  // subtrees, except the first one which stays at 0.
+  view_->Layout();
+  EXPECT_EQ(19, view_->GetLayoutCount());
+  view_->Layout();
+  EXPECT_EQ(0, view_->GetLayoutCount());
+
+  // The following siblings are moved in the same layout, and their subtrees
+  // are laid out in the next one.
+  children[8]->SetPixelWidth(20.0);
+  view_->Layout();
+  EXPECT_EQ(2, view_->GetLayoutCount());
+  EXPECT_DOUBLE_EQ(155.0, linear_->GetPixelWidth());
+  EXPECT_DOUBLE_EQ(120.0, children[8]->GetPixelX());
+  EXPECT_DOUBLE_EQ(145.0, children[9]->GetPixelX());
+  view_->Layout();
+  EXPECT_EQ(3, view_->GetLayoutCount());
+  view_->Layout();
+  EXPECT_EQ(0, view_->GetLayoutCount());
+}
+
 int main(int argc, char *argv[]) {
   SetGlobalMainLoop(&main_loop);
   testing::ParseGTestFlags(&argc, argv);
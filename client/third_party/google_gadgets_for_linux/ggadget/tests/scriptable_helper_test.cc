@@ -443,6 +443,44 @@ TEST(ScriptableHelperTest, TestRemoveProperty) {
   delete scriptable;
 }
 
+class RepeatedLookupScriptable : public BaseScriptable {
+ public:
+  DEFINE_CLASS_ID(0x1c9a4e2b7d3f4a66, BaseScriptable);
+
+  RepeatedLookupScriptable() : BaseScriptable(true, false) { }
+};
+
+TEST(ScriptableHelperTest, TestRepeatedLookups) {
+  RepeatedLookupScriptable *scriptable = new RepeatedLookupScriptable();
+  // The same buffer holds different names, like in script bridges.
+  std::string name("DoubleProperty");
+  ASSERT_EQ(ScriptableInterface::PROPERTY_NORMAL,
+            scriptable->GetPropertyInfo(name.c_str(), NULL));
+  ASSERT_TRUE(scriptable->SetProperty(name.c_str(), Variant(1.5)));
+  ASSERT_EQ(Variant(1.5), scriptable->GetProperty(name.c_str()).v());
+#ifndef GADGET_CASE_SENSITIVE
+  name = "doubleproperty";
+  ASSERT_EQ(Variant(1.5), scriptable->GetProperty(name.c_str()).v());
+#endif
+  name = "IntProperty";
+  ASSERT_TRUE(scriptable->SetProperty(name.c_str(), Variant(10)));
+  ASSERT_EQ(Variant(10), scriptable->GetProperty(name.c_str()).v());
+  name = "NoSuchProperty";
+  ASSERT_EQ(ScriptableInterface::PROPERTY_NOT_EXIST,
+            scriptable->GetPropertyInfo(name.c_str(), NULL));
+  ASSERT_EQ(ScriptableInterface::PROPERTY_NOT_EXIST,
+            scriptable->GetPropertyInfo(name.c_str(), NULL));
+  name = "DoubleProperty";
+  ASSERT_EQ(Variant(1.5), scriptable->GetProperty(name.c_str()).v());
+
+  // Removing the property drops the cached lookup.
+  ASSERT_TRUE(scriptable->RemoveProperty(name.c_str()));
+  ASSERT_EQ(ScriptableInterface::PROPERTY_NOT_EXIST,
+            scriptable->GetPropertyInfo(name.c_str(), NULL));
+  ASSERT_FALSE(scriptable->SetProperty(name.c_str(), Variant(2.5)));
+  delete scriptable;
+}
+
 int main(int argc, char **argv) {
   testing::ParseGTestFlags(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,121 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Benchmarks of SmallObjAllocator against malloc/free. It isn't run as a unit
+// test, build it with a release build and run it by hand to get meaningful
+// numbers.
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "ggadget/small_object.h"
+
+using namespace ggadget;
+
+namespace {
+
+SmallObjAllocator &GetAllocator() {
+  return AllocatorSingleton<>::Instance();
+}
+
+uint64_t GetMicroseconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// Sizes of the objects, spread over all the size classes.
+size_t RandomSize() {
+  return rand() % LOKI_MAX_SMALL_OBJECT_SIZE + 1;
+}
+
+const size_t kBenchmarkBlocks = 10000;
+const int kBenchmarkRounds = 100;
+
+void *SmallAllocate(size_t size) {
+  return GetAllocator().Allocate(size, true);
+}
+
+void SmallDeallocate(void *p, size_t size) {
+  GetAllocator().Deallocate(p, size);
+}
+
+void SystemDeallocate(void *p, size_t /* size */) {
+  free(p);
+}
+
+typedef void *(*AllocateFunc)(size_t size);
+typedef void (*DeallocateFunc)(void *p, size_t size);
+
+// Keeps the compiler from optimizing away the allocations.
+void *volatile g_sink;
+
+// Allocates and frees a block at a time.
+uint64_t BenchmarkPairs(AllocateFunc allocate, DeallocateFunc deallocate,
+                        const std::vector<size_t> &sizes) {
+  uint64_t start = GetMicroseconds();
+  for (int round = 0; round < kBenchmarkRounds; round++) {
+    for (size_t i = 0; i < sizes.size(); i++) {
+      g_sink = allocate(sizes[i]);
+      deallocate(g_sink, sizes[i]);
+    }
+  }
+  return GetMicroseconds() - start;
+}
+
+// Allocates all the blocks, then frees them in a random order.
+uint64_t BenchmarkBatches(AllocateFunc allocate, DeallocateFunc deallocate,
+                          const std::vector<size_t> &sizes,
+                          const std::vector<size_t> &order) {
+  std::vector<void *> blocks(sizes.size());
+  uint64_t start = GetMicroseconds();
+  for (int round = 0; round < kBenchmarkRounds; round++) {
+    for (size_t i = 0; i < sizes.size(); i++)
+      blocks[i] = g_sink = allocate(sizes[i]);
+    for (size_t i = 0; i < order.size(); i++)
+      deallocate(blocks[order[i]], sizes[order[i]]);
+  }
+  return GetMicroseconds() - start;
+}
+
+}  // namespace
+
+int main() {
+  srand(0);
+  std::vector<size_t> sizes, order;
+  for (size_t i = 0; i < kBenchmarkBlocks; i++) {
+    sizes.push_back(RandomSize());
+    order.push_back(i);
+  }
+  for (size_t i = order.size() - 1; i > 0; i--)
+    std::swap(order[i], order[rand() % (i + 1)]);
+
+  uint64_t small_pairs = BenchmarkPairs(SmallAllocate, SmallDeallocate, sizes);
+  uint64_t system_pairs = BenchmarkPairs(malloc, SystemDeallocate, sizes);
+  uint64_t small_batches =
+      BenchmarkBatches(SmallAllocate, SmallDeallocate, sizes, order);
+  uint64_t system_batches =
+      BenchmarkBatches(malloc, SystemDeallocate, sizes, order);
+  size_t count = kBenchmarkBlocks * kBenchmarkRounds;
+  printf("Allocation pairs: SmallObjAllocator %.1fns, malloc %.1fns\n",
+         small_pairs * 1000.0 / count, system_pairs * 1000.0 / count);
+  printf("Allocation batches: SmallObjAllocator %.1fns, malloc %.1fns\n",
+         small_batches * 1000.0 / count, system_batches * 1000.0 / count);
+  return GetAllocator().IsCorrupt() ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "ggadget/common.h"
+#include "ggadget/small_object.h"
+#include "unittest/gtest.h"
+
+using namespace ggadget;
+
+namespace {
+
+SmallObjAllocator &GetAllocator() {
+  return AllocatorSingleton<>::Instance();
+}
+
+class TestObject : public SmallObject<> {
+ public:
+  explicit TestObject(int value) : value_(value) { }
+  int value_;
+  char padding_[40];
+};
+
+}  // namespace
+
+TEST(SmallObjAllocator, AlignmentAndSizes) {
+  SmallObjAllocator &allocator = GetAllocator();
+  EXPECT_EQ(16U, allocator.GetAlignment());
+  std::vector<void *> blocks;
+  for (size_t size = 0; size <= allocator.GetMaxObjectSize() + 16; size++) {
+    void *p = allocator.Allocate(size, false);
+    ASSERT_TRUE(p != NULL);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(p) % 16) << size;
+    memset(p, 0xA5, size);
+    blocks.push_back(p);
+  }
+  for (size_t size = 0; size < blocks.size(); size++)
+    allocator.Deallocate(blocks[size], size);
+  EXPECT_FALSE(allocator.IsCorrupt());
+}
+
+TEST(SmallObjAllocator, Statistics) {
+  SmallObjAllocator &allocator = GetAllocator();
+  allocator.TrimExcessMemory();
+  SmallObjAllocator::Statistics before;
+  allocator.GetStatistics(&before);
+
+  const size_t kCount = 10000;
+  std::vector<void *> blocks;
+  for (size_t i = 0; i < kCount; i++)
+    blocks.push_back(allocator.Allocate(48, true));
+  SmallObjAllocator::Statistics stats;
+  allocator.GetStatistics(&stats);
+  EXPECT_EQ(before.allocations + kCount, stats.allocations);
+  EXPECT_EQ(before.bytesInUse + kCount * 48, stats.bytesInUse);
+  EXPECT_LT(before.slabCount, stats.slabCount);
+  EXPECT_LE(stats.bytesInUse, stats.reservedBytes);
+
+  for (size_t i = 0; i < kCount; i++)
+    allocator.Deallocate(blocks[i], 48);
+  allocator.GetStatistics(&stats);
+  EXPECT_EQ(before.deallocations + kCount, stats.deallocations);
+  EXPECT_EQ(before.bytesInUse, stats.bytesInUse);
+
+  // Empty slabs are given back to the system.
+  allocator.TrimExcessMemory();
+  allocator.GetStatistics(&stats);
+  EXPECT_EQ(before.slabCount, stats.slabCount);
+  EXPECT_EQ(before.reservedBytes, stats.reservedBytes);
+  EXPECT_LT(before.releasedSlabs, stats.releasedSlabs);
+  EXPECT_FALSE(allocator.IsCorrupt());
+}
+
+TEST(SmallObjAllocator, DeallocateUnknownSize) {
+  SmallObjAllocator &allocator = GetAllocator();
+  void *small = allocator.Allocate(24, true);
+  void *large = allocator.Allocate(allocator.GetMaxObjectSize() + 1, true);
+  allocator.Deallocate(small);
+  allocator.Deallocate(large);
+  allocator.Deallocate(NULL);
+  EXPECT_FALSE(allocator.IsCorrupt());
+}
+
+TEST(SmallObject, NewDelete) {
+  std::vector<TestObject *> objects;
+  for (int i = 0; i < 1000; i++)
+    objects.push_back(new TestObject(i));
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(i, objects[i]->value_);
+    EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(objects[i]) % 16);
+    delete objects[i];
+  }
+  TestObject *object = new (std::nothrow) TestObject(1);
+  ASSERT_TRUE(object != NULL);
+  delete object;
+}
+
+// Each thread frees the blocks allocated by the previous thread, so blocks
+// travel between the thread caches.
+struct ThreadData {
+  std::vector<void *> blocks;
+  std::vector<size_t> sizes;
+  pthread_mutex_t mutex;
+};
+
+const int kThreadCount = 4;
+const int kRounds = 200;
+const size_t kBlocksPerRound = 500;
+ThreadData g_thread_data[kThreadCount];
+
+void *StressThread(void *arg) {
+  int index = static_cast<int>(reinterpret_cast<intptr_t>(arg));
+  ThreadData *own = &g_thread_data[index];
+  ThreadData *next = &g_thread_data[(index + 1) % kThreadCount];
+  SmallObjAllocator &allocator = GetAllocator();
+  unsigned int seed = index;
+  for (int round = 0; round < kRounds; round++) {
+    std::vector<void *> blocks;
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < kBlocksPerRound; i++) {
+      size_t size = rand_r(&seed) % allocator.GetMaxObjectSize() + 1;
+      unsigned char *p =
+          static_cast<unsigned char *>(allocator.Allocate(size, true));
+      memset(p, static_cast<int>(size), size);
+      blocks.push_back(p);
+      sizes.push_back(size);
+    }
+    pthread_mutex_lock(&next->mutex);
+    next->blocks.insert(next->blocks.end(), blocks.begin(), blocks.end());
+    next->sizes.insert(next->sizes.end(), sizes.begin(), sizes.end());
+    pthread_mutex_unlock(&next->mutex);
+
+    blocks.clear();
+    sizes.clear();
+    pthread_mutex_lock(&own->mutex);
+    blocks.swap(own->blocks);
+    sizes.swap(own->sizes);
+    pthread_mutex_unlock(&own->mutex);
+    for (size_t i = 0; i < blocks.size(); i++) {
+      unsigned char *p = static_cast<unsigned char *>(blocks[i]);
+      for (size_t j = 0; j < sizes[i]; j++) {
+        if (p[j] != static_cast<unsigned char>(sizes[i])) {
+          ADD_FAILURE() << "Block overwritten: " << sizes[i];
+          break;
+        }
+      }
+      allocator.Deallocate(p, sizes[i]);
+    }
+  }
+  return NULL;
+}
+
+TEST(SmallObjAllocator, Threads) {
+  SmallObjAllocator &allocator = GetAllocator();
+  SmallObjAllocator::Statistics before;
+  allocator.GetStatistics(&before);
+
+  pthread_t threads[kThreadCount];
+  for (int i = 0; i < kThreadCount; i++)
+    pthread_mutex_init(&g_thread_data[i].mutex, NULL);
+  for (int i = 0; i < kThreadCount; i++) {
+    pthread_create(&threads[i], NULL, StressThread,
+                   reinterpret_cast<void *>(static_cast<intptr_t>(i)));
+  }
+  for (int i = 0; i < kThreadCount; i++)
+    pthread_join(threads[i], NULL);
+  for (int i = 0; i < kThreadCount; i++) {
+    for (size_t j = 0; j < g_thread_data[i].blocks.size(); j++)
+      allocator.Deallocate(g_thread_data[i].blocks[j]);
+    pthread_mutex_destroy(&g_thread_data[i].mutex);
+  }
+  EXPECT_FALSE(allocator.IsCorrupt());
+
+  // The caches of the exited threads have been flushed.
+  SmallObjAllocator::Statistics stats;
+  allocator.GetStatistics(&stats);
+  EXPECT_EQ(stats.allocations - before.allocations,
+            stats.deallocations - before.deallocations);
+  EXPECT_EQ(before.bytesInUse, stats.bytesInUse);
+}
+
+int main(int argc, char **argv) {
+  testing::ParseGTestFlags(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -108,6 +108,39 @@ TEST(TextFormats, MergeFormatIfNothave) {
   EXPECT_EQ(old_format.foreground().ToString(), format.foreground().ToString());
 }
 
+TEST(TextFormats, Equality) {
+  TextFormat format, another;
+  EXPECT_TRUE(format == another);
+  format.set_size(10);
+  EXPECT_TRUE(format != another);
+  another.set_size(10);
+  EXPECT_TRUE(format == another);
+  another.set_foreground(Color(1.0, 0, 0));
+  EXPECT_TRUE(format != another);
+  format.set_foreground(Color(0, 1.0, 0));
+  EXPECT_TRUE(format != another);
+  format.set_foreground(Color(1.0, 0, 0));
+  EXPECT_TRUE(format == another);
+
+  // Attributes inherited from the default format are not compared.
+  TextFormat default_format;
+  default_format.set_bold(true);
+  format.set_default_format(&default_format);
+  EXPECT_TRUE(format.bold());
+  EXPECT_TRUE(format == another);
+
+  TextFormats formats(1), other_formats(1);
+  formats[0].format = format;
+  formats[0].range.start = 0;
+  formats[0].range.end = 2;
+  other_formats[0].format = another;
+  other_formats[0].range.start = 0;
+  other_formats[0].range.end = 2;
+  EXPECT_TRUE(formats == other_formats);
+  other_formats[0].range.end = 3;
+  EXPECT_FALSE(formats == other_formats);
+}
+
 TEST(TextFormats, ParseMarkUpText) {
   std::string mark_up_text =
       "a"
@@ -0,0 +1,116 @@
+/*
+  Copyright 2011 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Benchmarks of the string functions in unicode_utils against the scalar
+// references. It isn't run as a unit test, build it with a release build and
+// run it by hand to get meaningful numbers.
+
+#include <sys/time.h>
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include "ggadget/unicode_utils.h"
+#include "unicode_utils_reference.h"
+
+using namespace ggadget;
+
+static uint64_t GetMicroseconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// Each corpus is converted repeatedly up to about this many bytes.
+static const size_t kBenchmarkBytes = 4 << 20;
+
+static double GetNanosecondsPerChar(uint64_t microseconds, size_t chars) {
+  return static_cast<double>(microseconds) * 1000 /
+         static_cast<double>(chars);
+}
+
+// Keeps the compiler from optimizing away the conversions.
+static volatile size_t g_sink;
+
+static void BenchmarkCorpus(const char *name, const std::string &utf8) {
+  UTF16String utf16;
+  ConvertStringUTF8ToUTF16(utf8, &utf16);
+  UTF16String utf16_result;
+  std::string utf8_result;
+  size_t rounds = kBenchmarkBytes / utf8.length();
+  size_t chars = utf16.length() * rounds;
+
+  uint64_t start = GetMicroseconds();
+  for (size_t i = 0; i < rounds; ++i)
+    g_sink = ConvertStringUTF8ToUTF16(utf8, &utf16_result);
+  uint64_t to_utf16 = GetMicroseconds() - start;
+  start = GetMicroseconds();
+  for (size_t i = 0; i < rounds; ++i)
+    g_sink = ReferenceUTF8ToUTF16(utf8, utf8.length(), &utf16_result);
+  uint64_t reference_to_utf16 = GetMicroseconds() - start;
+
+  start = GetMicroseconds();
+  for (size_t i = 0; i < rounds; ++i)
+    g_sink = ConvertStringUTF16ToUTF8(utf16, &utf8_result);
+  uint64_t to_utf8 = GetMicroseconds() - start;
+  start = GetMicroseconds();
+  for (size_t i = 0; i < rounds; ++i)
+    g_sink = ReferenceUTF16ToUTF8(utf16, utf16.length() * 3, &utf8_result);
+  uint64_t reference_to_utf8 = GetMicroseconds() - start;
+
+  start = GetMicroseconds();
+  for (size_t i = 0; i < rounds; ++i)
+    g_sink = IsLegalUTF8String(utf8);
+  uint64_t validate = GetMicroseconds() - start;
+  start = GetMicroseconds();
+  for (size_t i = 0; i < rounds; ++i)
+    g_sink = ReferenceIsLegalUTF8(utf8);
+  uint64_t reference_validate = GetMicroseconds() - start;
+
+  printf("%-10s UTF-8 to UTF-16 %6.2fns/char (scalar %6.2fns), "
+         "UTF-16 to UTF-8 %6.2fns/char (scalar %6.2fns), "
+         "validation %6.2fns/char (scalar %6.2fns)\n", name,
+         GetNanosecondsPerChar(to_utf16, chars),
+         GetNanosecondsPerChar(reference_to_utf16, chars),
+         GetNanosecondsPerChar(to_utf8, chars),
+         GetNanosecondsPerChar(reference_to_utf8, chars),
+         GetNanosecondsPerChar(validate, chars),
+         GetNanosecondsPerChar(reference_validate, chars));
+}
+
+int main() {
+  static const char kLatin[] =
+      "Candidate windows show the composition text and the candidates. ";
+  static const char kCJK[] =
+      "\xe8\xbe\x93\xe5\x85\xa5\xe6\xb3\x95\xe7\x9a\x84\xe5\x80\x99\xe9\x80"
+      "\x89\xe7\xaa\x97\xe5\x8f\xa3\xe6\x98\xbe\xe7\xa4\xba\xe7\xbc\x96\xe8"
+      "\xbe\x91\xe4\xb8\xb2\xe5\x92\x8c\xe5\x80\x99\xe9\x80\x89\xe8\xaf\x8d"
+      "\xe3\x80\x82";
+  static const char kMixed[] =
+      "\xe8\xbe\x93\xe5\x85\xa5 input \xe5\x80\x99\xe9\x80\x89 candidates, "
+      "\xe7\xbc\x96\xe8\xbe\x91\xe4\xb8\xb2 composition. ";
+  std::string latin, cjk, mixed;
+  for (int i = 0; i < 16; ++i) {
+    latin += kLatin;
+    cjk += kCJK;
+    mixed += kMixed;
+  }
+  BenchmarkCorpus("Latin", latin);
+  BenchmarkCorpus("CJK", cjk);
+  BenchmarkCorpus("Mixed", mixed);
+  // A candidate, as converted on every keystroke.
+  BenchmarkCorpus("Candidate", "\xe5\x80\x99\xe9\x80\x89 1");
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*
+  Copyright 2011 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef GGADGET_TESTS_UNICODE_UTILS_REFERENCE_H__
+#define GGADGET_TESTS_UNICODE_UTILS_REFERENCE_H__
+
+// This file is to be included by unicode_utils_test and
+// unicode_utils_benchmark.
+
+#include <string>
+#include "ggadget/unicode_utils.h"
+
+namespace ggadget {
+
+// Scalar references of the string functions, built from the per-character
+// functions. The conversions stop at NUL, at the first malformed character
+// and at the first character that doesn't fit in dest_length.
+inline size_t ReferenceUTF8ToUTF16(const std::string &src, size_t dest_length,
+                                   UTF16String *dest) {
+  dest->clear();
+  const char *p = src.c_str();
+  size_t length = src.length();
+  size_t used_length = 0;
+  UTF32Char utf32;
+  UTF16Char utf16[2];
+  while (length) {
+    size_t utf8_len = ConvertCharUTF8ToUTF32(p, length, &utf32);
+    if (!utf8_len) break;
+    size_t utf16_len = ConvertCharUTF32ToUTF16(utf32, utf16, 2);
+    if (!utf16_len || dest->length() + utf16_len > dest_length) break;
+    dest->append(utf16, utf16_len);
+    p += utf8_len;
+    length -= utf8_len;
+    used_length += utf8_len;
+  }
+  return used_length;
+}
+
+inline size_t ReferenceUTF16ToUTF8(const UTF16String &src, size_t dest_length,
+                                   std::string *dest) {
+  dest->clear();
+  const UTF16Char *p = src.c_str();
+  size_t length = src.length();
+  size_t used_length = 0;
+  UTF32Char utf32;
+  char utf8[6];
+  while (length) {
+    size_t utf16_len = ConvertCharUTF16ToUTF32(p, length, &utf32);
+    if (!utf16_len) break;
+    size_t utf8_len = ConvertCharUTF32ToUTF8(utf32, utf8, 6);
+    if (!utf8_len || dest->length() + utf8_len > dest_length) break;
+    dest->append(utf8, utf8_len);
+    p += utf16_len;
+    length -= utf16_len;
+    used_length += utf16_len;
+  }
+  return used_length;
+}
+
+inline size_t ReferenceUTF8ToUTF32(const std::string &src, UTF32String *dest) {
+  dest->clear();
+  const char *p = src.c_str();
+  size_t length = src.length();
+  size_t used_length = 0;
+  UTF32Char utf32;
+  while (length) {
+    size_t utf8_len = ConvertCharUTF8ToUTF32(p, length, &utf32);
+    if (!utf8_len) break;
+    dest->push_back(utf32);
+    p += utf8_len;
+    length -= utf8_len;
+    used_length += utf8_len;
+  }
+  return used_length;
+}
+
+inline size_t ReferenceUTF16ToUTF32(const UTF16String &src,
+                                    UTF32String *dest) {
+  dest->clear();
+  const UTF16Char *p = src.c_str();
+  size_t length = src.length();
+  size_t used_length = 0;
+  UTF32Char utf32;
+  while (length) {
+    size_t utf16_len = ConvertCharUTF16ToUTF32(p, length, &utf32);
+    if (!utf16_len) break;
+    dest->push_back(utf32);
+    p += utf16_len;
+    length -= utf16_len;
+    used_length += utf16_len;
+  }
+  return used_length;
+}
+
+inline bool ReferenceIsLegalUTF8(const std::string &src) {
+  const char *p = src.c_str();
+  size_t length = src.length();
+  while (length) {
+    size_t char_length = GetUTF8CharLength(p);
+    if (char_length > length || !IsLegalUTF8Char(p, char_length))
+      return false;
+    p += char_length;
+    length -= char_length;
+  }
+  return true;
+}
+
+inline bool ReferenceIsLegalUTF16(const UTF16String &src) {
+  const UTF16Char *p = src.c_str();
+  size_t length = src.length();
+  while (length) {
+    size_t char_length = GetUTF16CharLength(p);
+    if (!char_length || char_length > length)
+      return false;
+    p += char_length;
+    length -= char_length;
+  }
+  return true;
+}
+
+} // namespace ggadget
+
+#endif // GGADGET_TESTS_UNICODE_UTILS_REFERENCE_H__
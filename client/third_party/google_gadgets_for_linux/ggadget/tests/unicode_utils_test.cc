@@ -15,7 +15,10 @@
 */
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include "ggadget/unicode_utils.h"
+#include "unicode_utils_reference.h"
 #include "unittest/gtest.h"
 
 using namespace ggadget;
@@ -249,6 +252,162 @@ TEST(UnicodeUtils, UTF16ToUTF8Converter) {
   }
 }
 
+// Pieces of the random strings. The runs of ASCII and CJK characters are
+// long enough to cover whole vector blocks, and the rest ends them at
+// arbitrary offsets.
+static const char *const utf8_pieces[] = {
+  "The quick brown fox jumps over the lazy dog. ",
+  "abc", " ", "~",
+  "\xe4\xb8\xad\xe6\x96\x87\xe8\xbe\x93\xe5\x85\xa5\xe6\xb3\x95"
+  "\xe5\x80\x99\xe9\x80\x89\xe8\xaf\x8d\xe7\xbb\x84\xe5\x90\x88",
+  "\xe4\xb8\xad", "\xe0\xa0\x80", "\xed\x9f\xbf", "\xee\x80\x80",
+  "\xef\xbf\xbf", "\xc3\xa9", "\xc2\x80", "\xdf\xbf",
+  "\xf0\x9f\x98\x80", "\xf4\x8f\xbf\xbf",
+};
+
+static const char *const invalid_utf8_pieces[] = {
+  "\x80", "\xbf", "\xc0\xaf", "\xc1\xbf", "\xe0\x80\x80", "\xe0\x9f\xbf",
+  "\xed\xa0\x80", "\xed\xbf\xbf", "\xf0\x80\x80\x80", "\xf4\x90\x80\x80",
+  "\xf5\x80\x80\x80", "\xf8\x88\x80\x80\x80", "\xff", "\xe4\xb8", "\xe4",
+  "\xf0\x9f\x98", "\xe4\x38\xad", "\xe4\xb8\x2d",
+};
+
+static std::string RandomUTF8String(bool valid) {
+  std::string result;
+  int pieces = rand() % 12;
+  for (int i = 0; i < pieces; ++i) {
+    int kind = rand() % 20;
+    if (!valid && kind == 0) {
+      result += invalid_utf8_pieces[rand() % arraysize(invalid_utf8_pieces)];
+    } else if (!valid && kind == 1) {
+      result += '\0';
+    } else {
+      const char *piece = utf8_pieces[rand() % arraysize(utf8_pieces)];
+      for (int j = rand() % 3; j >= 0; --j)
+        result += piece;
+    }
+  }
+  return result;
+}
+
+static const UTF16Char utf16_pieces[] = {
+  'a', '~', 0x7F, 0x80, 0xE9, 0x7FF, 0x800, 0x4E2D, 0x6587, 0xD7FF,
+  0xE000, 0xFFFF,
+};
+
+static UTF16String RandomUTF16String(bool valid) {
+  UTF16String result;
+  int pieces = rand() % 12;
+  for (int i = 0; i < pieces; ++i) {
+    int kind = rand() % 20;
+    if (!valid && kind == 0) {
+      result += static_cast<UTF16Char>(0xD800 + rand() % 0x800);
+    } else if (!valid && kind == 1) {
+      result += static_cast<UTF16Char>(0);
+    } else if (kind == 2) {
+      result += static_cast<UTF16Char>(0xD800 + rand() % 0x400);
+      result += static_cast<UTF16Char>(0xDC00 + rand() % 0x400);
+    } else {
+      UTF16Char unit = utf16_pieces[rand() % arraysize(utf16_pieces)];
+      result.append(rand() % 40 + 1, unit);
+    }
+  }
+  return result;
+}
+
+TEST(UnicodeUtils, RandomUTF8Strings) {
+  srand(0);
+  UTF16Char buffer[1024];
+  for (int i = 0; i < 5000; ++i) {
+    std::string utf8 = RandomUTF8String(i % 2 == 0);
+    ASSERT_LT(utf8.length(), arraysize(buffer));
+    UTF16String expected_utf16, utf16;
+    size_t expected_length = ReferenceUTF8ToUTF16(utf8, utf8.length(),
+                                                  &expected_utf16);
+    EXPECT_EQ(expected_length, ConvertStringUTF8ToUTF16(utf8, &utf16));
+    EXPECT_TRUE(expected_utf16 == utf16);
+
+    size_t dest_length = utf8.empty() ? 0 : rand() % utf8.length();
+    size_t output_length = 0;
+    expected_length = ReferenceUTF8ToUTF16(utf8, dest_length,
+                                           &expected_utf16);
+    EXPECT_EQ(expected_length,
+              ConvertStringUTF8ToUTF16Buffer(utf8, buffer, dest_length,
+                                             &output_length));
+    EXPECT_TRUE(expected_utf16 == UTF16String(buffer, output_length));
+
+    UTF32String expected_utf32, utf32;
+    expected_length = ReferenceUTF8ToUTF32(utf8, &expected_utf32);
+    EXPECT_EQ(expected_length, ConvertStringUTF8ToUTF32(utf8, &utf32));
+    EXPECT_TRUE(expected_utf32 == utf32);
+
+    EXPECT_EQ(ReferenceIsLegalUTF8(utf8), IsLegalUTF8String(utf8));
+  }
+}
+
+TEST(UnicodeUtils, RandomUTF16Strings) {
+  srand(0);
+  char buffer[4096];
+  for (int i = 0; i < 5000; ++i) {
+    UTF16String utf16 = RandomUTF16String(i % 2 == 0);
+    ASSERT_LT(utf16.length() * 3, arraysize(buffer));
+    std::string expected_utf8, utf8;
+    size_t expected_length = ReferenceUTF16ToUTF8(utf16, utf16.length() * 3,
+                                                  &expected_utf8);
+    EXPECT_EQ(expected_length, ConvertStringUTF16ToUTF8(utf16, &utf8));
+    EXPECT_EQ(expected_utf8, utf8);
+
+    size_t dest_length = utf16.empty() ? 0 : rand() % (utf16.length() * 3);
+    size_t output_length = 0;
+    expected_length = ReferenceUTF16ToUTF8(utf16, dest_length,
+                                           &expected_utf8);
+    EXPECT_EQ(expected_length,
+              ConvertStringUTF16ToUTF8Buffer(utf16, buffer, dest_length,
+                                             &output_length));
+    EXPECT_EQ(expected_utf8, std::string(buffer, output_length));
+
+    UTF32String expected_utf32, utf32;
+    expected_length = ReferenceUTF16ToUTF32(utf16, &expected_utf32);
+    EXPECT_EQ(expected_length, ConvertStringUTF16ToUTF32(utf16, &utf32));
+    EXPECT_TRUE(expected_utf32 == utf32);
+
+    EXPECT_EQ(ReferenceIsLegalUTF16(utf16), IsLegalUTF16String(utf16));
+  }
+}
+
+TEST(UnicodeUtils, IsLegalUTF8StringAtBlockBoundaries) {
+  // Every malformed sequence at every offset of the first two blocks, with
+  // the string ending right after it or continuing with valid text.
+  for (size_t i = 0; i < arraysize(invalid_utf8_pieces); ++i) {
+    for (size_t offset = 0; offset < 70; ++offset) {
+      std::string utf8(offset, 'a');
+      utf8 += invalid_utf8_pieces[i];
+      EXPECT_FALSE(IsLegalUTF8String(utf8)) << i << " " << offset;
+      utf8 += std::string(40, 'b');
+      EXPECT_FALSE(IsLegalUTF8String(utf8)) << i << " " << offset;
+    }
+  }
+  for (size_t i = 0; i < arraysize(utf8_pieces); ++i) {
+    for (size_t offset = 0; offset < 70; ++offset) {
+      std::string utf8(offset, '\0');
+      utf8 += utf8_pieces[i];
+      EXPECT_TRUE(IsLegalUTF8String(utf8)) << i << " " << offset;
+      utf8 += std::string(40, 'b');
+      EXPECT_TRUE(IsLegalUTF8String(utf8)) << i << " " << offset;
+    }
+  }
+}
+
+TEST(UnicodeUtils, GetUTF8StringCharCount) {
+  EXPECT_EQ(0U, GetUTF8StringCharCount("", 0));
+  EXPECT_EQ(arraysize(utf32_string) - 1,
+            GetUTF8StringCharCount(utf8_string, strlen(utf8_string)));
+  std::string utf8(100, 'a');
+  utf8 += "\xe4\xb8\xad\xe6\x96\x87";
+  utf8 += std::string(20, '\0');
+  EXPECT_EQ(122U, GetUTF8StringCharCount(utf8.c_str(), utf8.length()));
+}
+
 TEST(UnicodeUtils, DetectUTFEncoding) {
   std::string encoding("Garbage");
   EXPECT_FALSE(DetectUTFEncoding(std::string(""), &encoding));
@@ -0,0 +1,152 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include "ggadget/logger.h"
+#include "ggadget/string_utils.h"
+#include "ggadget/xml_dom_binary.h"
+#include "ggadget/xml_dom_interface.h"
+#include "ggadget/xml_parser_interface.h"
+#include "unittest/gtest.h"
+#include "init_extensions.h"
+
+using namespace ggadget;
+
+StringMap g_strings;
+
+const char *kViewXML =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<view width=\"100\" height=\"&HEIGHT;\" xmlns:n=\"urn:test\">\n"
+  "  <!-- A comment which is dropped. -->\n"
+  "  <label name=\"label\" n:attr=\"&LABEL;\">&LABEL; \xE4\xB8\xAD</label>\n"
+  "  <n:div x=\"1\"><img src=\"a.png\"/></n:div>\n"
+  "  <script><![CDATA[if (a < b) c();]]></script>\n"
+  "</view>\n";
+
+// Dumps the nodes kept by the binary form, with their source positions.
+void DumpNode(const DOMNodeInterface *node, std::string *output) {
+  StringAppendPrintf(output, "%d(%d:%d)%s:%s=%s[", node->GetNodeType(),
+                     node->GetRow(), node->GetColumn(),
+                     node->GetPrefix().c_str(), node->GetLocalName().c_str(),
+                     node->GetNodeValue().c_str());
+  const DOMNamedNodeMapInterface *attributes = node->GetAttributes();
+  if (attributes) {
+    for (size_t i = 0; i < attributes->GetLength(); i++)
+      DumpNode(attributes->GetItem(i), output);
+    delete attributes;
+  }
+  for (const DOMNodeInterface *child = node->GetFirstChild();
+       child; child = child->GetNextSibling()) {
+    if (child->GetNodeType() != DOMNodeInterface::COMMENT_NODE)
+      DumpNode(child, output);
+  }
+  output->append("]");
+}
+
+DOMDocumentInterface *ParseView(const std::string &xml) {
+  DOMDocumentInterface *domdoc = GetXMLParser()->CreateDOMDocument();
+  domdoc->Ref();
+  EXPECT_TRUE(GetXMLParser()->ParseContentIntoDOM(xml, &g_strings, "view.xml",
+                                                  NULL, NULL, NULL, domdoc,
+                                                  NULL, NULL));
+  return domdoc;
+}
+
+TEST(XMLDOMBinary, RoundTrip) {
+  DOMDocumentInterface *domdoc = ParseView(kViewXML);
+  std::string data;
+  ASSERT_TRUE(SerializeDOMToBinary(domdoc, &data));
+  // The binary form is more compact than the source.
+  EXPECT_LT(data.size(), strlen(kViewXML));
+
+  DOMDocumentInterface *loaded = GetXMLParser()->CreateDOMDocument();
+  loaded->Ref();
+  ASSERT_TRUE(ParseBinaryIntoDOM(data, "view.bin", loaded));
+  std::string expected, actual;
+  DumpNode(domdoc->GetDocumentElement(), &expected);
+  DumpNode(loaded->GetDocumentElement(), &actual);
+  EXPECT_EQ(expected, actual);
+  EXPECT_NE(std::string::npos, actual.find("Label Text"));
+  EXPECT_NE(std::string::npos, actual.find("if (a < b) c();"));
+  EXPECT_EQ(std::string::npos, actual.find("comment"));
+
+  // Serializing the loaded document produces the same data.
+  std::string data2;
+  ASSERT_TRUE(SerializeDOMToBinary(loaded, &data2));
+  EXPECT_EQ(data, data2);
+  loaded->Unref();
+  domdoc->Unref();
+}
+
+TEST(XMLDOMBinary, EmptyDocument) {
+  DOMDocumentInterface *domdoc = GetXMLParser()->CreateDOMDocument();
+  domdoc->Ref();
+  std::string data;
+  EXPECT_FALSE(SerializeDOMToBinary(domdoc, &data));
+  domdoc->Unref();
+}
+
+TEST(XMLDOMBinary, CorruptedData) {
+  DOMDocumentInterface *domdoc = ParseView(kViewXML);
+  std::string data;
+  ASSERT_TRUE(SerializeDOMToBinary(domdoc, &data));
+  domdoc->Unref();
+
+  // Truncated data.
+  for (size_t size = 0; size < data.size(); size++) {
+    DOMDocumentInterface *loaded = GetXMLParser()->CreateDOMDocument();
+    loaded->Ref();
+    EXPECT_FALSE(ParseBinaryIntoDOM(data.substr(0, size), "view.bin", loaded));
+    loaded->Unref();
+  }
+
+  // Incompatible version, and trailing garbage.
+  std::string bad_data[] = { data, data + '\0' };
+  bad_data[0][4]++;
+  for (size_t i = 0; i < arraysize(bad_data); i++) {
+    DOMDocumentInterface *loaded = GetXMLParser()->CreateDOMDocument();
+    loaded->Ref();
+    EXPECT_FALSE(ParseBinaryIntoDOM(bad_data[i], "view.bin", loaded));
+    loaded->Unref();
+  }
+
+  // Random bytes mustn't crash the loader.
+  srand(0);
+  for (int round = 0; round < 1000; round++) {
+    std::string random_data(data);
+    random_data[5 + rand() % (random_data.size() - 5)] =
+        static_cast<char>(rand());
+    DOMDocumentInterface *loaded = GetXMLParser()->CreateDOMDocument();
+    loaded->Ref();
+    ParseBinaryIntoDOM(random_data, "view.bin", loaded);
+    loaded->Unref();
+  }
+}
+
+int main(int argc, char **argv) {
+  testing::ParseGTestFlags(&argc, argv);
+
+  static const char *kExtensions[] = {
+    "libxml2_xml_parser/libxml2-xml-parser",
+  };
+  INIT_EXTENSIONS(argc, argv, kExtensions);
+
+  g_strings["HEIGHT"] = "200";
+  g_strings["LABEL"] = "Label Text";
+
+  return RUN_ALL_TESTS();
+}
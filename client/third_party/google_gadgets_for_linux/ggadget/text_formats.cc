@@ -155,6 +155,17 @@ Variant TextFormat::GetFormat(const std::string& format_name) const {
   return Variant();
 }
 
+bool TextFormat::operator==(const TextFormat& another) const {
+  if (flag_ != another.flag_)
+    return false;
+#define DECLARE_FORMAT(id, type, name, capital_name, default_value) \
+  if (has_##name() && !(name##_ == another.name##_))                \
+    return false;
+#include "text_formats_decl.h"
+#undef DECLARE_FORMAT
+  return true;
+}
+
 void TextFormat::set_default_format(const TextFormat* default_format) {
   default_format_ = default_format;
   ASSERT(!default_format || !default_format_->default_format_);
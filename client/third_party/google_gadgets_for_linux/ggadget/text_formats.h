@@ -66,6 +66,12 @@ struct TextFormat {
   void SetFormat(const std::string& format_name, const Variant& value);
   // Get the value of format attribute named |format_name|.
   Variant GetFormat(const std::string& format_name) const;
+  // Returns true if both objects have the same attributes set to the same
+  // values. The default formats are not compared.
+  bool operator==(const TextFormat& another) const;
+  bool operator!=(const TextFormat& another) const {
+    return !(*this == another);
+  }
 
 #define DECLARE_FORMAT(id, type, name, capital_name, default_value)    \
  public:                                                               \
@@ -107,11 +113,17 @@ struct Range {
   int Length() const {
     return end - start;
   }
+  bool operator==(const Range& another) const {
+    return start == another.start && end == another.end;
+  }
 };
 
 struct TextFormatRange {
   TextFormat format;
   Range range;
+  bool operator==(const TextFormatRange& another) const {
+    return range == another.range && format == another.format;
+  }
 };
 
 typedef std::vector<TextFormatRange> TextFormats;
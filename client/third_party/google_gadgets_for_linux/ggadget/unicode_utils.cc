@@ -38,9 +38,29 @@
  * remains attached.
  */
 
+#include <algorithm>
 #include <cstring>
 #include <cstdlib>
 #include "unicode_utils.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GGL_UNICODE_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// The AVX2 fast paths need function-level target attributes.
+#if defined(GGL_UNICODE_SSE2) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define GGL_UNICODE_AVX2
+#include <immintrin.h>
+#endif
+
 #if defined(OS_POSIX)
 namespace std {
 template class std::basic_string<ggadget::UTF16Char>;
@@ -245,6 +265,593 @@ size_t ConvertCharUTF32ToUTF16(UTF32Char src, UTF16Char *dest,
   return ConvertCharUTF32ToUTF16Internal(src, dest, dest_length);
 }
 
+// Vectorized fast paths of the string conversions.
+//
+// Each helper below handles a prefix of its input that consists of the
+// common, always valid characters it knows about (ASCII, or the 3-byte UTF-8
+// sequences of most CJK text) and returns the length of that prefix.
+// Everything else, including NUL and every malformed sequence, is left to the
+// scalar per-character code, so the results and the error semantics are the
+// same with or without the fast paths. Helpers that store whole blocks may
+// write past the converted prefix, but never past the length they are given.
+//
+// SSE2 is part of every x86-64 CPU and is used whenever the compiler targets
+// it. The AVX2 versions are compiled with a function-level target attribute
+// and selected at runtime, so the binary still runs on older CPUs.
+
+static inline bool IsPlainASCII(UTF32Char c) {
+  return c && c < 0x80;
+}
+
+static inline bool IsSurrogate(UTF32Char c) {
+  return c >= kSurrogateHighStart && c <= kSurrogateLowEnd;
+}
+
+// Vector blocks only pay off on long runs: the runs of mixed CJK and Latin
+// text are a few characters long, and faster in the scalar loops. So a run is
+// only vectorized if the last unit of its first block belongs to it too.
+static const size_t kBlockBytes = 16;
+static const size_t kBlockUnits = 8;
+
+#if defined(GGL_UNICODE_SSE2)
+static inline unsigned int CountTrailingZeros(unsigned int mask) {
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned int>(index);
+#else
+  return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+static inline __m128i LoadBlock(const void *src) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+}
+
+static inline void StoreBlock(void *dest, __m128i block) {
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dest), block);
+}
+
+// Returns the mask of the surrogate units of a block of UTF-16 units.
+static inline __m128i GetSurrogateMask(__m128i units) {
+  return _mm_cmpeq_epi16(_mm_and_si128(units, _mm_set1_epi16(static_cast<short>(0xF800))),
+                         _mm_set1_epi16(static_cast<short>(0xD800)));
+}
+
+// Returns one bit per unit of a block of 16-bit masks.
+static inline unsigned int GetUnitMask(__m128i mask) {
+  return _mm_movemask_epi8(_mm_packs_epi16(mask, _mm_setzero_si128()));
+}
+#endif
+
+#if defined(GGL_UNICODE_AVX2)
+static bool IsAVX2Supported() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+}
+
+// A conversion that runs from a static initializer before this flag is
+// initialized simply takes the baseline path.
+static const bool g_avx2_supported = IsAVX2Supported();
+
+#define GGL_TARGET_AVX2 __attribute__((target("avx2")))
+
+GGL_TARGET_AVX2
+static inline __m256i LoadBlockAVX2(const void *src) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src));
+}
+
+GGL_TARGET_AVX2
+static inline void StoreBlockAVX2(void *dest, __m256i block) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(dest), block);
+}
+#endif
+
+// Returns the number of leading ASCII bytes, including NUL.
+static size_t SkipASCIIUTF8(const UTF8Char *src, size_t length) {
+  size_t i = 0;
+#if defined(GGL_UNICODE_SSE2)
+  if (length >= kBlockBytes && src[kBlockBytes - 1] < 0x80) {
+    for (; i + kBlockBytes <= length; i += kBlockBytes) {
+      unsigned int mask = _mm_movemask_epi8(LoadBlock(src + i));
+      if (mask)
+        return i + CountTrailingZeros(mask);
+    }
+  }
+#endif
+  while (i < length && src[i] < 0x80)
+    ++i;
+  return i;
+}
+
+// Returns the number of leading units that are not surrogates, including NUL.
+static size_t SkipBMPUTF16(const UTF16Char *src, size_t length) {
+  size_t i = 0;
+#if defined(GGL_UNICODE_SSE2)
+  if (length >= kBlockUnits && !IsSurrogate(src[kBlockUnits - 1])) {
+    for (; i + kBlockUnits <= length; i += kBlockUnits) {
+      unsigned int mask = GetUnitMask(GetSurrogateMask(LoadBlock(src + i)));
+      if (mask)
+        return i + CountTrailingZeros(mask);
+    }
+  }
+#endif
+  while (i < length && !IsSurrogate(src[i]))
+    ++i;
+  return i;
+}
+
+// Widens the leading non-NUL ASCII bytes to UTF-16 and returns their count.
+static size_t ConvertASCIIUTF8ToUTF16Baseline(const UTF8Char *src,
+                                              size_t length,
+                                              UTF16Char *dest) {
+  size_t i = 0;
+#if defined(GGL_UNICODE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  if (length >= kBlockBytes && IsPlainASCII(src[kBlockBytes - 1])) {
+    for (; i + kBlockBytes <= length; i += kBlockBytes) {
+      __m128i bytes = LoadBlock(src + i);
+      StoreBlock(dest + i, _mm_unpacklo_epi8(bytes, zero));
+      StoreBlock(dest + i + 8, _mm_unpackhi_epi8(bytes, zero));
+      // Signed comparison: only 0x01-0x7F are greater than zero.
+      unsigned int mask =
+          ~_mm_movemask_epi8(_mm_cmpgt_epi8(bytes, zero)) & 0xFFFF;
+      if (mask)
+        return i + CountTrailingZeros(mask);
+    }
+  }
+#endif
+  for (; i < length && IsPlainASCII(src[i]); ++i)
+    dest[i] = src[i];
+  return i;
+}
+
+#if defined(GGL_UNICODE_AVX2)
+GGL_TARGET_AVX2
+static size_t ConvertASCIIUTF8ToUTF16AVX2(const UTF8Char *src, size_t length,
+                                          UTF16Char *dest) {
+  const __m256i zero = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i bytes = LoadBlockAVX2(src + i);
+    StoreBlockAVX2(dest + i,
+                   _mm256_cvtepu8_epi16(_mm256_castsi256_si128(bytes)));
+    StoreBlockAVX2(dest + i + 16,
+                   _mm256_cvtepu8_epi16(_mm256_extracti128_si256(bytes, 1)));
+    unsigned int mask =
+        ~static_cast<unsigned int>(
+            _mm256_movemask_epi8(_mm256_cmpgt_epi8(bytes, zero)));
+    if (mask)
+      return i + CountTrailingZeros(mask);
+  }
+  return i;
+}
+
+// Converts the leading 3-byte sequences, ten at a time, and returns their
+// count. Sequences that would decode to overlong forms or surrogates are left
+// to the scalar code.
+GGL_TARGET_AVX2
+static size_t ConvertThreeByteUTF8ToUTF16AVX2(const UTF8Char *src,
+                                              size_t length,
+                                              UTF16Char *dest,
+                                              size_t dest_length) {
+  // Each 128-bit lane holds five sequences and one ignored byte.
+  const __m256i pattern_mask = _mm256_setr_epi8(
+      -16, -64, -64, -16, -64, -64, -16, -64, -64, -16, -64, -64,
+      -16, -64, -64, 0,
+      -16, -64, -64, -16, -64, -64, -16, -64, -64, -16, -64, -64,
+      -16, -64, -64, 0);
+  const __m256i pattern = _mm256_setr_epi8(
+      -32, -128, -128, -32, -128, -128, -32, -128, -128, -32, -128, -128,
+      -32, -128, -128, 0,
+      -32, -128, -128, -32, -128, -128, -32, -128, -128, -32, -128, -128,
+      -32, -128, -128, 0);
+  // Gathers the lead and the second byte of each sequence into a 16-bit
+  // lane, and the third byte into another.
+  const __m256i lead_shuffle = _mm256_setr_epi8(
+      1, 0, 4, 3, 7, 6, 10, 9, 13, 12, -1, -1, -1, -1, -1, -1,
+      1, 0, 4, 3, 7, 6, 10, 9, 13, 12, -1, -1, -1, -1, -1, -1);
+  const __m256i trail_shuffle = _mm256_setr_epi8(
+      2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1,
+      2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i low_six_bits = _mm256_set1_epi16(0x3F);
+
+  size_t i = 0;
+  size_t count = 0;
+  // The second lane is loaded from offset 15, so 31 bytes are read, and its
+  // store at offset 5 writes 13 units.
+  while (i + 31 <= length && count + 13 <= dest_length) {
+    __m256i bytes = _mm256_inserti128_si256(
+        _mm256_castsi128_si256(LoadBlock(src + i)), LoadBlock(src + i + 15),
+        1);
+    unsigned int byte_mask = ~static_cast<unsigned int>(_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(_mm256_and_si256(bytes, pattern_mask), pattern)));
+
+    __m256i leads = _mm256_shuffle_epi8(bytes, lead_shuffle);
+    __m256i trails = _mm256_shuffle_epi8(bytes, trail_shuffle);
+    __m256i units = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_slli_epi16(
+                _mm256_and_si256(leads, _mm256_set1_epi16(0x0F00)), 4),
+            _mm256_slli_epi16(_mm256_and_si256(leads, low_six_bits), 6)),
+        _mm256_and_si256(trails, low_six_bits));
+    __m256i overlong = _mm256_cmpeq_epi16(
+        _mm256_subs_epu16(units, _mm256_set1_epi16(0x7FF)), zero);
+    __m256i surrogate = _mm256_cmpeq_epi16(
+        _mm256_and_si256(units, _mm256_set1_epi16(static_cast<short>(0xF800))),
+        _mm256_set1_epi16(static_cast<short>(0xD800)));
+    // Two bits per 16-bit lane; only lanes 0-4 of each half carry units.
+    unsigned int unit_mask = static_cast<unsigned int>(_mm256_movemask_epi8(
+        _mm256_or_si256(overlong, surrogate))) & 0x03FF03FF;
+
+    StoreBlock(dest + count, _mm256_castsi256_si128(units));
+    StoreBlock(dest + count + 5, _mm256_extracti128_si256(units, 1));
+    if (byte_mask || unit_mask) {
+      size_t valid = 10;
+      if (byte_mask) {
+        unsigned int bit = CountTrailingZeros(byte_mask);
+        valid = bit < 16 ? bit / 3 : 5 + (bit - 16) / 3;
+      }
+      if (unit_mask) {
+        unsigned int lane = CountTrailingZeros(unit_mask) / 2;
+        valid = std::min<size_t>(valid, lane < 8 ? lane : lane - 3);
+      }
+      return count + valid;
+    }
+    i += 30;
+    count += 10;
+  }
+  return count;
+}
+#endif
+
+// Widens the leading non-NUL ASCII bytes to UTF-32 and returns their count.
+static size_t ConvertASCIIUTF8ToUTF32(const UTF8Char *src, size_t length,
+                                      UTF32Char *dest) {
+  size_t i = 0;
+#if defined(GGL_UNICODE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  if (length >= kBlockBytes && IsPlainASCII(src[kBlockBytes - 1])) {
+    for (; i + kBlockBytes <= length; i += kBlockBytes) {
+      __m128i bytes = LoadBlock(src + i);
+      __m128i low = _mm_unpacklo_epi8(bytes, zero);
+      __m128i high = _mm_unpackhi_epi8(bytes, zero);
+      StoreBlock(dest + i, _mm_unpacklo_epi16(low, zero));
+      StoreBlock(dest + i + 4, _mm_unpackhi_epi16(low, zero));
+      StoreBlock(dest + i + 8, _mm_unpacklo_epi16(high, zero));
+      StoreBlock(dest + i + 12, _mm_unpackhi_epi16(high, zero));
+      unsigned int mask =
+          ~_mm_movemask_epi8(_mm_cmpgt_epi8(bytes, zero)) & 0xFFFF;
+      if (mask)
+        return i + CountTrailingZeros(mask);
+    }
+  }
+#endif
+  for (; i < length && IsPlainASCII(src[i]); ++i)
+    dest[i] = src[i];
+  return i;
+}
+
+// Narrows the leading non-NUL ASCII units to UTF-8 and returns their count.
+static size_t ConvertASCIIUTF16ToUTF8Baseline(const UTF16Char *src,
+                                              size_t length,
+                                              UTF8Char *dest) {
+  size_t i = 0;
+#if defined(GGL_UNICODE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i limit = _mm_set1_epi16(0x80);
+  if (length >= kBlockBytes && IsPlainASCII(src[kBlockBytes - 1])) {
+    // Two blocks of units make one block of bytes.
+    for (; i + kBlockBytes <= length; i += kBlockBytes) {
+      __m128i low = LoadBlock(src + i);
+      __m128i high = LoadBlock(src + i + 8);
+      StoreBlock(dest + i, _mm_packus_epi16(low, high));
+      // Signed comparisons: units from 0x8000 on are negative.
+      __m128i low_ascii = _mm_and_si128(_mm_cmpgt_epi16(low, zero),
+                                        _mm_cmplt_epi16(low, limit));
+      __m128i high_ascii = _mm_and_si128(_mm_cmpgt_epi16(high, zero),
+                                         _mm_cmplt_epi16(high, limit));
+      unsigned int mask = ~_mm_movemask_epi8(
+          _mm_packs_epi16(low_ascii, high_ascii)) & 0xFFFF;
+      if (mask)
+        return i + CountTrailingZeros(mask);
+    }
+  }
+#endif
+  for (; i < length && IsPlainASCII(src[i]); ++i)
+    dest[i] = static_cast<UTF8Char>(src[i]);
+  return i;
+}
+
+#if defined(GGL_UNICODE_AVX2)
+GGL_TARGET_AVX2
+static size_t ConvertASCIIUTF16ToUTF8AVX2(const UTF16Char *src, size_t length,
+                                          UTF8Char *dest) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i limit = _mm256_set1_epi16(0x80);
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i low = LoadBlockAVX2(src + i);
+    __m256i high = LoadBlockAVX2(src + i + 16);
+    // The packs interleave the 128-bit lanes of their operands.
+    StoreBlockAVX2(dest + i, _mm256_permute4x64_epi64(
+        _mm256_packus_epi16(low, high), 0xD8));
+    __m256i low_ascii = _mm256_and_si256(_mm256_cmpgt_epi16(low, zero),
+                                         _mm256_cmpgt_epi16(limit, low));
+    __m256i high_ascii = _mm256_and_si256(_mm256_cmpgt_epi16(high, zero),
+                                          _mm256_cmpgt_epi16(limit, high));
+    unsigned int mask = ~static_cast<unsigned int>(_mm256_movemask_epi8(
+        _mm256_permute4x64_epi64(
+            _mm256_packs_epi16(low_ascii, high_ascii), 0xD8)));
+    if (mask)
+      return i + CountTrailingZeros(mask);
+  }
+  return i;
+}
+
+// Converts the leading units that need 3-byte sequences, eight at a time, and
+// returns their count.
+GGL_TARGET_AVX2
+static size_t ConvertThreeByteUTF16ToUTF8AVX2(const UTF16Char *src,
+                                              size_t length,
+                                              UTF8Char *dest,
+                                              size_t dest_length) {
+  // Interleave the lead, middle and last bytes of eight sequences.
+  const __m128i lead_shuffle_low = _mm_setr_epi8(
+      0, 8, -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12, -1, 5);
+  const __m128i last_shuffle_low = _mm_setr_epi8(
+      -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+  const __m128i lead_shuffle_high = _mm_setr_epi8(
+      13, -1, 6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i last_shuffle_high = _mm_setr_epi8(
+      -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i low_six_bits = _mm_set1_epi16(0x3F);
+  const __m128i trail_mark = _mm_set1_epi16(0x80);
+
+  size_t i = 0;
+  for (; i + 8 <= length && (i + 8) * 3 <= dest_length; i += 8) {
+    __m128i units = LoadBlock(src + i);
+    __m128i leads = _mm_or_si128(_mm_srli_epi16(units, 12),
+                                 _mm_set1_epi16(0xE0));
+    __m128i middles = _mm_or_si128(
+        _mm_and_si128(_mm_srli_epi16(units, 6), low_six_bits), trail_mark);
+    __m128i lasts = _mm_or_si128(_mm_and_si128(units, low_six_bits),
+                                 trail_mark);
+    __m128i leads_middles = _mm_packus_epi16(leads, middles);
+    lasts = _mm_packus_epi16(lasts, lasts);
+    StoreBlock(dest + i * 3, _mm_or_si128(
+        _mm_shuffle_epi8(leads_middles, lead_shuffle_low),
+        _mm_shuffle_epi8(lasts, last_shuffle_low)));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dest + i * 3 + 16),
+                     _mm_or_si128(
+                         _mm_shuffle_epi8(leads_middles, lead_shuffle_high),
+                         _mm_shuffle_epi8(lasts, last_shuffle_high)));
+
+    __m128i short_units = _mm_cmpeq_epi16(
+        _mm_subs_epu16(units, _mm_set1_epi16(0x7FF)), zero);
+    unsigned int mask =
+        GetUnitMask(_mm_or_si128(short_units, GetSurrogateMask(units)));
+    if (mask)
+      return i + CountTrailingZeros(mask);
+  }
+  return i;
+}
+
+// The UTF-8 validation algorithm of "Validating UTF-8 In Less Than One
+// Instruction Per Byte" (Keiser and Lemire): three table lookups classify
+// every pair of adjacent bytes, and the bytes that must be the third or the
+// fourth of a sequence are checked separately.
+static const int kTooShort = 1 << 0;
+static const int kTooLong = 1 << 1;
+static const int kOverlong3 = 1 << 2;
+static const int kTooLarge = 1 << 3;
+static const int kSurrogate = 1 << 4;
+static const int kOverlong2 = 1 << 5;
+static const int kTooLarge1000 = 1 << 6;
+static const int kOverlong4 = 1 << 6;
+static const int kTwoConts = 1 << 7;
+static const int kCarry = kTooShort | kTooLong | kTwoConts;
+
+GGL_TARGET_AVX2
+static inline __m256i LookupNibbles(__m256i table, __m256i nibbles) {
+  return _mm256_shuffle_epi8(table, nibbles);
+}
+
+GGL_TARGET_AVX2
+static inline __m256i GetHighNibbles(__m256i bytes) {
+  return _mm256_and_si256(_mm256_srli_epi16(bytes, 4), _mm256_set1_epi8(0x0F));
+}
+
+GGL_TARGET_AVX2
+static inline __m256i CheckUTF8Block(__m256i input, __m256i prev_input) {
+  // The last one, two and three bytes of the previous block shifted in.
+  __m256i carried = _mm256_permute2x128_si256(prev_input, input, 0x21);
+  __m256i prev1 = _mm256_alignr_epi8(input, carried, 15);
+  __m256i prev2 = _mm256_alignr_epi8(input, carried, 14);
+  __m256i prev3 = _mm256_alignr_epi8(input, carried, 13);
+
+// The flags above 0x7F don't fit in a signed char, so every entry is cast.
+#define C(x) static_cast<char>(x)
+#define REPEAT_LANE(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p) \
+  _mm256_setr_epi8(C(a), C(b), C(c), C(d), C(e), C(f), C(g), C(h), \
+                   C(i), C(j), C(k), C(l), C(m), C(n), C(o), C(p), \
+                   C(a), C(b), C(c), C(d), C(e), C(f), C(g), C(h), \
+                   C(i), C(j), C(k), C(l), C(m), C(n), C(o), C(p))
+  const __m256i byte_1_high = REPEAT_LANE(
+      // 0xxx: ASCII.
+      kTooLong, kTooLong, kTooLong, kTooLong,
+      kTooLong, kTooLong, kTooLong, kTooLong,
+      // 10xx: continuation.
+      kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+      // 110x: two byte lead.
+      kTooShort | kOverlong2,
+      kTooShort,
+      // 1110: three byte lead.
+      kTooShort | kOverlong3 | kSurrogate,
+      // 1111: four byte lead.
+      kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+  const __m256i byte_1_low = REPEAT_LANE(
+      kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+      kCarry | kOverlong2,
+      kCarry,
+      kCarry,
+      kCarry | kTooLarge,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+      kCarry | kTooLarge | kTooLarge1000,
+      kCarry | kTooLarge | kTooLarge1000);
+  const __m256i byte_2_high = REPEAT_LANE(
+      // 0xxx: ASCII.
+      kTooShort, kTooShort, kTooShort, kTooShort,
+      kTooShort, kTooShort, kTooShort, kTooShort,
+      // 1000, 1001, 101x: continuation.
+      kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 |
+          kOverlong4,
+      kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+      kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+      kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+      // 11xx: lead.
+      kTooShort, kTooShort, kTooShort, kTooShort);
+#undef REPEAT_LANE
+#undef C
+
+  __m256i special_cases = _mm256_and_si256(
+      _mm256_and_si256(
+          LookupNibbles(byte_1_high, GetHighNibbles(prev1)),
+          LookupNibbles(byte_1_low,
+                        _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+      LookupNibbles(byte_2_high, GetHighNibbles(input)));
+  // Only the bytes after a three or four byte lead get 0x80.
+  __m256i must_be_continuation = _mm256_and_si256(
+      _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80)),
+                      _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xF0 - 0x80))),
+      _mm256_set1_epi8(static_cast<char>(0x80)));
+  return _mm256_xor_si256(must_be_continuation, special_cases);
+}
+
+GGL_TARGET_AVX2
+static bool IsLegalUTF8StringAVX2(const UTF8Char *src, size_t length) {
+  // Non-zero where the block ends in the middle of a sequence.
+  const __m256i incomplete_limit = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1),
+      static_cast<char>(0xC0 - 1));
+  __m256i prev_input = _mm256_setzero_si256();
+  __m256i prev_incomplete = _mm256_setzero_si256();
+  __m256i error = _mm256_setzero_si256();
+  for (size_t i = 0; i < length; i += 32) {
+    __m256i input;
+    if (i + 32 <= length) {
+      input = LoadBlockAVX2(src + i);
+    } else {
+      // The padding is NUL, which is legal after complete sequences only.
+      UTF8Char tail[32] = { 0 };
+      for (size_t j = i; j < length; ++j)
+        tail[j - i] = src[j];
+      input = LoadBlockAVX2(tail);
+    }
+    if (!_mm256_movemask_epi8(input)) {
+      error = _mm256_or_si256(error, prev_incomplete);
+      prev_incomplete = _mm256_setzero_si256();
+    } else {
+      error = _mm256_or_si256(error, CheckUTF8Block(input, prev_input));
+      prev_incomplete = _mm256_subs_epu8(input, incomplete_limit);
+    }
+    if (!_mm256_testz_si256(error, error))
+      return false;
+    prev_input = input;
+  }
+  return _mm256_testz_si256(prev_incomplete, prev_incomplete) != 0;
+}
+#endif
+
+// Widens the leading units that are neither NUL nor surrogates to UTF-32 and
+// returns their count.
+static size_t ConvertBMPUTF16ToUTF32(const UTF16Char *src, size_t length,
+                                     UTF32Char *dest) {
+  size_t i = 0;
+#if defined(GGL_UNICODE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  UTF16Char last = length >= kBlockUnits ? src[kBlockUnits - 1] : 0;
+  if (last && !IsSurrogate(last)) {
+    for (; i + kBlockUnits <= length; i += kBlockUnits) {
+      __m128i units = LoadBlock(src + i);
+      StoreBlock(dest + i, _mm_unpacklo_epi16(units, zero));
+      StoreBlock(dest + i + 4, _mm_unpackhi_epi16(units, zero));
+      unsigned int mask = GetUnitMask(_mm_or_si128(
+          _mm_cmpeq_epi16(units, zero), GetSurrogateMask(units)));
+      if (mask)
+        return i + CountTrailingZeros(mask);
+    }
+  }
+#endif
+  for (; i < length && src[i] && !IsSurrogate(src[i]); ++i)
+    dest[i] = src[i];
+  return i;
+}
+
+// The AVX2 helpers leave the tails shorter than a block to the baseline ones,
+// which are called here rather than from the AVX2 code: SSE code that runs
+// while the upper halves of the AVX registers are dirty is very slow on some
+// CPUs.
+static inline size_t ConvertASCIIUTF8ToUTF16(const UTF8Char *src,
+                                             size_t length,
+                                             UTF16Char *dest) {
+  size_t i = 0;
+#if defined(GGL_UNICODE_AVX2)
+  if (g_avx2_supported && length >= 2 * kBlockBytes &&
+      IsPlainASCII(src[2 * kBlockBytes - 1]))
+    i = ConvertASCIIUTF8ToUTF16AVX2(src, length, dest);
+#endif
+  return i + ConvertASCIIUTF8ToUTF16Baseline(src + i, length - i, dest + i);
+}
+
+static inline size_t ConvertASCIIUTF16ToUTF8(const UTF16Char *src,
+                                             size_t length,
+                                             UTF8Char *dest) {
+  size_t i = 0;
+#if defined(GGL_UNICODE_AVX2)
+  if (g_avx2_supported && length >= 2 * kBlockBytes &&
+      IsPlainASCII(src[2 * kBlockBytes - 1]))
+    i = ConvertASCIIUTF16ToUTF8AVX2(src, length, dest);
+#endif
+  return i + ConvertASCIIUTF16ToUTF8Baseline(src + i, length - i, dest + i);
+}
+
+static inline size_t ConvertThreeByteUTF8ToUTF16(const UTF8Char *src,
+                                                 size_t length,
+                                                 UTF16Char *dest,
+                                                 size_t dest_length) {
+#if defined(GGL_UNICODE_AVX2)
+  // A block covers ten sequences in 31 bytes, the last one at offset 27.
+  if (g_avx2_supported && length >= 31 && (src[27] & 0xF0) == 0xE0)
+    return ConvertThreeByteUTF8ToUTF16AVX2(src, length, dest, dest_length);
+#endif
+  return 0;
+}
+
+static inline size_t ConvertThreeByteUTF16ToUTF8(const UTF16Char *src,
+                                                 size_t length,
+                                                 UTF8Char *dest,
+                                                 size_t dest_length) {
+#if defined(GGL_UNICODE_AVX2)
+  if (g_avx2_supported && length >= kBlockUnits &&
+      src[kBlockUnits - 1] >= 0x800 && !IsSurrogate(src[kBlockUnits - 1]))
+    return ConvertThreeByteUTF16ToUTF8AVX2(src, length, dest, dest_length);
+#endif
+  return 0;
+}
+
 size_t ConvertStringUTF8ToUTF32(const char *src, size_t src_length,
                                 UTF32String *dest) {
   if (!dest)
@@ -253,18 +860,29 @@ size_t ConvertStringUTF8ToUTF32(const char *src, size_t src_length,
   if (!src || !src_length)
     return 0;
 
-  dest->reserve(src_length);
+  // The result never has more characters than the source has bytes.
+  dest->resize(src_length);
+  UTF32Char *output = &(*dest)[0];
+  size_t output_length = 0;
   size_t used_length = 0;
   size_t utf8_len;
-  UTF32Char utf32;
   while (src_length && *src) {
-    utf8_len = ConvertCharUTF8ToUTF32Internal(src, src_length, &utf32);
-    if (!utf8_len) break;
-    dest->push_back(utf32);
+    if (static_cast<UTF8Char>(*src) < 0x80) {
+      utf8_len = ConvertASCIIUTF8ToUTF32(
+          reinterpret_cast<const UTF8Char *>(src), src_length,
+          output + output_length);
+      output_length += utf8_len;
+    } else {
+      utf8_len = ConvertCharUTF8ToUTF32Internal(src, src_length,
+                                                output + output_length);
+      if (!utf8_len) break;
+      ++output_length;
+    }
     used_length += utf8_len;
     src += utf8_len;
     src_length -= utf8_len;
   }
+  dest->resize(output_length);
   return used_length;
 }
 
@@ -299,6 +917,55 @@ size_t ConvertStringUTF32ToUTF8(const UTF32String &src, std::string *dest) {
   return ConvertStringUTF32ToUTF8(src.c_str(), src.length(), dest);
 }
 
+static size_t ConvertStringUTF8ToUTF16Internal(const char *src,
+                                               size_t src_length,
+                                               UTF16Char *dest,
+                                               size_t dest_length,
+                                               size_t *used_dest_length) {
+  size_t used_src_length = 0;
+  size_t utf8_len;
+  size_t utf16_len;
+  UTF16Char utf16[2] = { 0, 0 };
+  UTF32Char utf32;
+  while (src_length && *src) {
+    const UTF8Char *p = reinterpret_cast<const UTF8Char *>(src);
+    if (*p < 0x80) {
+      utf16_len = ConvertASCIIUTF8ToUTF16(
+          p, std::min(src_length, dest_length), dest);
+      utf8_len = utf16_len;
+    } else if ((*p & 0xF0) == 0xE0) {
+      utf16_len = ConvertThreeByteUTF8ToUTF16(p, src_length,
+                                              dest, dest_length);
+      utf8_len = utf16_len * 3;
+    } else {
+      utf16_len = utf8_len = 0;
+    }
+
+    if (!utf16_len) {
+      utf8_len = ConvertCharUTF8ToUTF32Internal(src, src_length, &utf32);
+      if (!utf8_len) break;
+      if (dest_length >= 2) {
+        utf16_len = ConvertCharUTF32ToUTF16Internal(utf32, dest, 2);
+        if (!utf16_len) break;
+      } else {
+        utf16_len = ConvertCharUTF32ToUTF16Internal(utf32, utf16, 2);
+        if (!utf16_len || utf16_len > dest_length)
+          break;
+        dest[0] = utf16[0];
+        if (utf16_len == 2)
+          dest[1] = utf16[1];
+      }
+    }
+    dest += utf16_len;
+    dest_length -= utf16_len;
+    *used_dest_length += utf16_len;
+    used_src_length += utf8_len;
+    src += utf8_len;
+    src_length -= utf8_len;
+  }
+  return used_src_length;
+}
+
 size_t ConvertStringUTF8ToUTF16(const char *src, size_t src_length,
                                 UTF16String *dest) {
   if (!dest)
@@ -307,22 +974,12 @@ size_t ConvertStringUTF8ToUTF16(const char *src, size_t src_length,
   if (!src || !src_length)
     return 0;
 
-  dest->reserve(src_length);
-  size_t used_length = 0;
-  size_t utf8_len;
-  size_t utf16_len;
-  UTF16Char utf16[2];
-  UTF32Char utf32;
-  while (src_length && *src) {
-    utf8_len = ConvertCharUTF8ToUTF32Internal(src, src_length, &utf32);
-    if (!utf8_len) break;
-    utf16_len = ConvertCharUTF32ToUTF16Internal(utf32, utf16, 2);
-    if (!utf16_len) break;
-    dest->append(utf16, utf16_len);
-    used_length += utf8_len;
-    src += utf8_len;
-    src_length -= utf8_len;
-  }
+  // The result never has more units than the source has bytes.
+  dest->resize(src_length);
+  size_t used_dest_length = 0;
+  size_t used_length = ConvertStringUTF8ToUTF16Internal(
+      src, src_length, &(*dest)[0], src_length, &used_dest_length);
+  dest->resize(used_dest_length);
   return used_length;
 }
 
@@ -338,43 +995,64 @@ size_t ConvertStringUTF8ToUTF16Buffer(const char *src, size_t src_length,
   *used_dest_length = 0;
   if (!dest || !dest_length || !src || !*src)
     return 0;
+  return ConvertStringUTF8ToUTF16Internal(src, src_length, dest, dest_length,
+                                          used_dest_length);
+}
 
+size_t ConvertStringUTF8ToUTF16Buffer(const std::string &src,
+                                      UTF16Char *dest, size_t dest_length,
+                                      size_t *used_dest_length) {
+  return ConvertStringUTF8ToUTF16Buffer(src.c_str(), src.length(),
+                                        dest, dest_length, used_dest_length);
+}
+
+static size_t ConvertStringUTF16ToUTF8Internal(const UTF16Char *src,
+                                               size_t src_length,
+                                               char *dest,
+                                               size_t dest_length,
+                                               size_t *used_dest_length) {
   size_t used_src_length = 0;
   size_t utf8_len;
   size_t utf16_len;
-  UTF16Char utf16[2] = { 0, 0 };
+  char utf8[4] = { 0, 0, 0, 0 };
   UTF32Char utf32;
   while (src_length && *src) {
-    utf8_len = ConvertCharUTF8ToUTF32Internal(src, src_length, &utf32);
-    if (!utf8_len) break;
-    if (dest_length >= 2) {
-      utf16_len = ConvertCharUTF32ToUTF16Internal(utf32, dest, 2);
-      if (!utf16_len) break;
+    UTF8Char *output = reinterpret_cast<UTF8Char *>(dest);
+    if (*src < 0x80) {
+      utf16_len = ConvertASCIIUTF16ToUTF8(
+          src, std::min(src_length, dest_length), output);
+      utf8_len = utf16_len;
+    } else if (*src >= 0x800) {
+      utf16_len = ConvertThreeByteUTF16ToUTF8(src, src_length,
+                                              output, dest_length);
+      utf8_len = utf16_len * 3;
     } else {
-      utf16_len = ConvertCharUTF32ToUTF16Internal(utf32, utf16, 2);
-      if (!utf16_len || utf16_len > dest_length)
-        break;
-      dest[0] = utf16[0];
-      if (utf16_len == 2)
-        dest[1] = utf16[1];
+      utf16_len = utf8_len = 0;
     }
-    dest += utf16_len;
-    dest_length -= utf16_len;
-    *used_dest_length += utf16_len;
-    used_src_length += utf8_len;
-    src += utf8_len;
-    src_length -= utf8_len;
+
+    if (!utf16_len) {
+      utf16_len = ConvertCharUTF16ToUTF32Internal(src, src_length, &utf32);
+      if (!utf16_len) break;
+      if (dest_length >= 4) {
+        utf8_len = ConvertCharUTF32ToUTF8Internal(utf32, dest, 4);
+        if (!utf8_len) break;
+      } else {
+        utf8_len = ConvertCharUTF32ToUTF8Internal(utf32, utf8, 4);
+        if (!utf8_len || utf8_len > dest_length)
+          break;
+        memcpy(dest, utf8, utf8_len);
+      }
+    }
+    dest += utf8_len;
+    dest_length -= utf8_len;
+    *used_dest_length += utf8_len;
+    used_src_length += utf16_len;
+    src += utf16_len;
+    src_length -= utf16_len;
   }
   return used_src_length;
 }
 
-size_t ConvertStringUTF8ToUTF16Buffer(const std::string &src,
-                                      UTF16Char *dest, size_t dest_length,
-                                      size_t *used_dest_length) {
-  return ConvertStringUTF8ToUTF16Buffer(src.c_str(), src.length(),
-                                        dest, dest_length, used_dest_length);
-}
-
 size_t ConvertStringUTF16ToUTF8(const UTF16Char *src, size_t src_length,
                                 std::string *dest) {
   if (!dest)
@@ -383,22 +1061,12 @@ size_t ConvertStringUTF16ToUTF8(const UTF16Char *src, size_t src_length,
   if (!src || !src_length)
     return 0;
 
-  dest->reserve(src_length * 3);
-  size_t used_length = 0;
-  size_t utf8_len;
-  size_t utf16_len;
-  char utf8[6];
-  UTF32Char utf32;
-  while (src_length && *src) {
-    utf16_len = ConvertCharUTF16ToUTF32Internal(src, src_length, &utf32);
-    if (!utf16_len) break;
-    utf8_len = ConvertCharUTF32ToUTF8Internal(utf32, utf8, 6);
-    if (!utf8_len) break;
-    dest->append(utf8, utf8_len);
-    used_length += utf16_len;
-    src += utf16_len;
-    src_length -= utf16_len;
-  }
+  // Each unit takes at most three bytes.
+  dest->resize(src_length * 3);
+  size_t used_dest_length = 0;
+  size_t used_length = ConvertStringUTF16ToUTF8Internal(
+      src, src_length, &(*dest)[0], src_length * 3, &used_dest_length);
+  dest->resize(used_dest_length);
   return used_length;
 }
 
@@ -414,32 +1082,8 @@ size_t ConvertStringUTF16ToUTF8Buffer(const UTF16Char *src, size_t src_length,
   *used_dest_length = 0;
   if (!dest || !dest_length || !src || !*src)
     return 0;
-
-  size_t used_src_length = 0;
-  size_t utf8_len;
-  size_t utf16_len;
-  char utf8[4] = { 0, 0, 0, 0 };
-  UTF32Char utf32;
-  while (src_length && *src) {
-    utf16_len = ConvertCharUTF16ToUTF32Internal(src, src_length, &utf32);
-    if (!utf16_len) break;
-    if (dest_length >= 4) {
-      utf8_len = ConvertCharUTF32ToUTF8Internal(utf32, dest, 4);
-      if (!utf8_len) break;
-    } else {
-      utf8_len = ConvertCharUTF32ToUTF8Internal(utf32, utf8, 4);
-      if (!utf8_len || utf8_len > dest_length)
-        break;
-      memcpy(dest, utf8, utf8_len);
-    }
-    dest += utf8_len;
-    dest_length -= utf8_len;
-    *used_dest_length += utf8_len;
-    used_src_length += utf16_len;
-    src += utf16_len;
-    src_length -= utf16_len;
-  }
-  return used_src_length;
+  return ConvertStringUTF16ToUTF8Internal(src, src_length, dest, dest_length,
+                                          used_dest_length);
 }
 
 size_t ConvertStringUTF16ToUTF8Buffer(const UTF16String &src,
@@ -471,18 +1115,28 @@ size_t ConvertStringUTF16ToUTF32(const UTF16Char *src, size_t src_length,
   if (!src || !src_length)
     return 0;
 
-  dest->reserve(src_length);
+  // The result never has more characters than the source has units.
+  dest->resize(src_length);
+  UTF32Char *output = &(*dest)[0];
+  size_t output_length = 0;
   size_t used_length = 0;
   size_t utf16_len;
-  UTF32Char utf32;
   while (src_length && *src) {
-    utf16_len = ConvertCharUTF16ToUTF32Internal(src, src_length, &utf32);
-    if (!utf16_len) break;
-    dest->push_back(utf32);
+    utf16_len = ConvertBMPUTF16ToUTF32(src, src_length,
+                                       output + output_length);
+    if (utf16_len) {
+      output_length += utf16_len;
+    } else {
+      utf16_len = ConvertCharUTF16ToUTF32Internal(src, src_length,
+                                                  output + output_length);
+      if (!utf16_len) break;
+      ++output_length;
+    }
     used_length += utf16_len;
     src += utf16_len;
     src_length -= utf16_len;
   }
+  dest->resize(output_length);
   return used_length;
 }
 
@@ -532,11 +1186,20 @@ size_t GetUTF8CharsLength(const char *pos, size_t char_count, size_t limit) {
 }
 
 size_t GetUTF8StringCharCount(const char *src, size_t bytes) {
+  const UTF8Char *p = reinterpret_cast<const UTF8Char *>(src);
+  size_t count = 0;
   size_t c = 0;
   while (c < bytes) {
-    c += GetUTF8CharLength(src + c);
+    if (p[c] < 0x80) {
+      size_t ascii_length = SkipASCIIUTF8(p + c, bytes - c);
+      c += ascii_length;
+      count += ascii_length;
+    } else {
+      c += GetUTF8CharLength(src + c);
+      ++count;
+    }
   }
-  return c;
+  return count;
 }
 
 bool IsLegalUTF8Char(const char *src, size_t length) {
@@ -560,7 +1223,19 @@ bool IsLegalUTF16Char(const UTF16Char *src, size_t length) {
 
 bool IsLegalUTF8String(const char *src, size_t length) {
   if (!src) return false;
+#if defined(GGL_UNICODE_AVX2)
+  if (g_avx2_supported && length >= 32)
+    return IsLegalUTF8StringAVX2(reinterpret_cast<const UTF8Char *>(src),
+                                 length);
+#endif
   while (length > 0) {
+    if (static_cast<UTF8Char>(*src) < 0x80) {
+      size_t ascii_length =
+          SkipASCIIUTF8(reinterpret_cast<const UTF8Char *>(src), length);
+      length -= ascii_length;
+      src += ascii_length;
+      continue;
+    }
     size_t char_length = GetUTF8CharLength(src);
     if (!char_length || char_length > length ||
         !IsLegalUTF8CharInternal(src, char_length))
@@ -578,6 +1253,12 @@ bool IsLegalUTF8String(const std::string &src) {
 bool IsLegalUTF16String(const UTF16Char *src, size_t length) {
   if (!src) return false;
   while (length > 0) {
+    if (*src < kSurrogateHighStart || *src > kSurrogateLowEnd) {
+      size_t bmp_length = SkipBMPUTF16(src, length);
+      length -= bmp_length;
+      src += bmp_length;
+      continue;
+    }
     size_t char_length = GetUTF16CharLength(src);
     if (!char_length || char_length > length ||
         !IsLegalUTF16Char(src, char_length))
@@ -207,6 +207,8 @@ class View::Impl : public SmallObject<> {
       scriptable_view_(NULL),
       clip_region_(0.9),
       children_(element_factory, NULL, owner),
+      layout_count_(0),
+      forced_layout_depth_(0),
 #ifdef _DEBUG
       draw_count_(0),
       view_draw_count_(0),
@@ -1201,6 +1203,7 @@ class View::Impl : public SmallObject<> {
     // Any QueueDraw() called during Layout() will be ignored, because
     // draw_queued_ is true.
     draw_queued_ = true;
+    layout_count_ = 0;
     if (theme_changed_ && events_enabled_) {
       SimpleEvent event(Event::EVENT_THEME_CHANGED);
       ScriptableEvent scriptable_event(&event, NULL, NULL);
@@ -1266,6 +1269,7 @@ class View::Impl : public SmallObject<> {
       DLOG("Draw View(%p) from canvas cache.", owner_);
 #endif
       canvas->DrawCanvas(0, 0, canvas_cache_);
+      host_region_.Clear();
       return;
 #if defined(_DEBUG) && defined(VIEW_VERBOSE_DEBUG)
     } else {
@@ -1344,8 +1348,12 @@ class View::Impl : public SmallObject<> {
 
     target->PopState();
 
-    if (target == canvas_cache_)
-      canvas->DrawCanvas(0, 0, canvas_cache_);
+    if (target == canvas_cache_) {
+      if (clip_region_enabled_ && !clip_region_.IsEmpty())
+        PresentCanvasCache(canvas);
+      else
+        canvas->DrawCanvas(0, 0, canvas_cache_);
+    }
 
 #ifdef _DEBUG
     if (owner_->GetDebugMode() & DEBUG_CLIP_REGION)
@@ -1353,6 +1361,7 @@ class View::Impl : public SmallObject<> {
 #endif
 
     clip_region_.Clear();
+    host_region_.Clear();
     need_redraw_ = false;
     content_changed_ = false;
 
@@ -1368,6 +1377,28 @@ class View::Impl : public SmallObject<> {
 #endif
   }
 
+  // Presents the canvas cache onto canvas within the clip region and the
+  // areas added by the host, the rest of canvas is kept by the host and
+  // already has the same content as the cache. The rectangles are expanded by
+  // one device pixel, so that the pixels partially covered at their edges
+  // are presented as well.
+  void PresentCanvasCache(CanvasInterface *canvas) {
+    double margin = 1.0 / graphics_->GetZoom();
+    ClipRegion present_region;
+    host_region_.Union(clip_region_);
+    size_t count = host_region_.GetRectangleCount();
+    for (size_t i = 0; i < count; ++i) {
+      Rectangle rect = host_region_.GetRectangle(i);
+      present_region.AddRectangle(Rectangle(rect.x - margin, rect.y - margin,
+                                            rect.w + margin * 2,
+                                            rect.h + margin * 2));
+    }
+    canvas->PushState();
+    canvas->IntersectGeneralClipRegion(present_region);
+    canvas->DrawCanvas(0, 0, canvas_cache_);
+    canvas->PopState();
+  }
+
 #ifdef _DEBUG
   static bool DrawRectOnCanvasCallback(double x, double y, double w, double h,
                                        CanvasInterface *canvas) {
@@ -1879,8 +1910,15 @@ class View::Impl : public SmallObject<> {
   ElementsMap all_elements_;
 
   ClipRegion clip_region_;
+  // The areas added by the host when the canvas cache is enabled. The cache
+  // is still valid there, so they're only presented without redrawing.
+  ClipRegion host_region_;
 
   Elements children_;
+  int layout_count_;
+  // Greater than 0 while laying out or calculating the size of the subtree of
+  // a dirty element.
+  int forced_layout_depth_;
 
   ElementHolder focused_element_;
   ElementHolder mouseover_element_;
@@ -2283,10 +2321,12 @@ bool View::IsClipRegionEnabled() const {
 }
 
 void View::AddRectangleToClipRegion(const Rectangle &rect) {
-  if (!impl_->enable_cache_) {
-    Rectangle view_rect(0, 0, impl_->width_, impl_->height_);
-    if (view_rect.Intersect(rect)) {
-      view_rect.Integerize(true);
+  Rectangle view_rect(0, 0, impl_->width_, impl_->height_);
+  if (view_rect.Intersect(rect)) {
+    view_rect.Integerize(true);
+    if (impl_->enable_cache_) {
+      impl_->host_region_.AddRectangle(view_rect);
+    } else {
       impl_->clip_region_.AddRectangle(view_rect);
       if (impl_->on_add_rectangle_to_clip_region_.HasActiveConnections()) {
         impl_->on_add_rectangle_to_clip_region_(
@@ -2302,6 +2342,27 @@ void View::IncreaseDrawCount() {
 #endif
 }
 
+void View::IncreaseLayoutCount() {
+  impl_->layout_count_++;
+}
+
+int View::GetLayoutCount() const {
+  return impl_->layout_count_;
+}
+
+void View::BeginForcedLayout() {
+  impl_->forced_layout_depth_++;
+}
+
+void View::EndForcedLayout() {
+  ASSERT(impl_->forced_layout_depth_ > 0);
+  impl_->forced_layout_depth_--;
+}
+
+bool View::IsForcedLayout() const {
+  return impl_->forced_layout_depth_ > 0;
+}
+
 int View::BeginAnimation(Slot0<void> *slot,
                          int start_value,
                          int end_value,
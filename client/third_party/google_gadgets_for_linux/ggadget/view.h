@@ -545,6 +545,31 @@ class View : public ViewInterface {
   /** For performance testing. */
   void IncreaseDrawCount();
 
+  /** For performance testing. Called by each element laid out. */
+  void IncreaseLayoutCount();
+
+  /**
+   * Gets the number of elements laid out by the last call of @c Layout().
+   * Elements whose layout hasn't changed are skipped, so this is usually much
+   * smaller than the number of elements in the view.
+   */
+  int GetLayoutCount() const;
+
+  /**
+   * Called by elements around laying out or calculating the size of the
+   * subtree of a dirty element, in which all elements of the subtree are
+   * processed. The calls can be nested.
+   */
+  void BeginForcedLayout();
+  void EndForcedLayout();
+
+  /**
+   * Checks if elements are being laid out between @c BeginForcedLayout() and
+   * @c EndForcedLayout(), in which case they are processed even if their
+   * layout hasn't changed.
+   */
+  bool IsForcedLayout() const;
+
  private:
   class Impl;
   Impl *impl_;
@@ -348,6 +348,8 @@ void ViewElement::Layout() {
 
 void ViewElement::QueueDrawChildView() {
   if (impl_->child_view_) {
+    // Lets Layout() lay out the child view.
+    QueueLayout();
     GetView()->QueueDraw();
   }
 }
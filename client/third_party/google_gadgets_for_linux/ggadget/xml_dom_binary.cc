@@ -0,0 +1,258 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "xml_dom_binary.h"
+
+#include "common.h"
+#include "logger.h"
+#include "xml_dom_interface.h"
+
+namespace ggadget {
+
+// The data starts with the magic and the format version, which must be
+// changed whenever the layout of the data changes.
+static const char kBinaryDOMMagic[] = "GDOM";
+static const size_t kBinaryDOMMagicSize = sizeof(kBinaryDOMMagic) - 1;
+static const char kBinaryDOMVersion = 1;
+
+// Each node starts with one of the following tags. The children of an
+// element are terminated by kEndTag.
+static const char kEndTag = 0;
+static const char kElementTag = 1;
+static const char kTextTag = 2;
+static const char kCDATATag = 3;
+
+// Protects the loader from running out of stack on corrupted data.
+static const int kMaxDepth = 256;
+
+static void WriteVarint(uint32_t value, std::string *data) {
+  while (value >= 0x80) {
+    data->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  data->push_back(static_cast<char>(value));
+}
+
+static void WriteString(const std::string &value, std::string *data) {
+  WriteVarint(static_cast<uint32_t>(value.size()), data);
+  data->append(value);
+}
+
+static void WritePosition(const DOMNodeInterface *node, std::string *data) {
+  WriteVarint(static_cast<uint32_t>(node->GetRow()), data);
+  WriteVarint(static_cast<uint32_t>(node->GetColumn()), data);
+}
+
+static void WriteElement(const DOMElementInterface *element,
+                         std::string *data) {
+  data->push_back(kElementTag);
+  WriteString(element->GetPrefix(), data);
+  WriteString(element->GetLocalName(), data);
+  WritePosition(element, data);
+
+  const DOMNamedNodeMapInterface *attributes = element->GetAttributes();
+  attributes->Ref();
+  size_t length = attributes->GetLength();
+  WriteVarint(static_cast<uint32_t>(length), data);
+  for (size_t i = 0; i < length; i++) {
+    const DOMAttrInterface *attr =
+        down_cast<const DOMAttrInterface *>(attributes->GetItem(i));
+    WriteString(attr->GetPrefix(), data);
+    WriteString(attr->GetLocalName(), data);
+    WriteString(attr->GetValue(), data);
+    WritePosition(attr, data);
+  }
+  attributes->Unref();
+
+  for (const DOMNodeInterface *child = element->GetFirstChild();
+       child; child = child->GetNextSibling()) {
+    switch (child->GetNodeType()) {
+      case DOMNodeInterface::ELEMENT_NODE:
+        WriteElement(down_cast<const DOMElementInterface *>(child), data);
+        break;
+      case DOMNodeInterface::TEXT_NODE:
+      case DOMNodeInterface::CDATA_SECTION_NODE:
+        data->push_back(
+            child->GetNodeType() == DOMNodeInterface::TEXT_NODE ?
+            kTextTag : kCDATATag);
+        WritePosition(child, data);
+        WriteString(child->GetNodeValue(), data);
+        break;
+      default:
+        break;
+    }
+  }
+  data->push_back(kEndTag);
+}
+
+bool SerializeDOMToBinary(const DOMDocumentInterface *domdoc,
+                          std::string *data) {
+  ASSERT(domdoc && data);
+  const DOMElementInterface *document_element = domdoc->GetDocumentElement();
+  if (!document_element)
+    return false;
+
+  data->assign(kBinaryDOMMagic, kBinaryDOMMagicSize);
+  data->push_back(kBinaryDOMVersion);
+  WriteElement(document_element, data);
+  return true;
+}
+
+namespace {
+
+class BinaryDOMReader {
+ public:
+  BinaryDOMReader(const std::string &data, DOMDocumentInterface *domdoc)
+      : data_(data), position_(0), domdoc_(domdoc) {
+  }
+
+  bool Read() {
+    if (data_.size() <= kBinaryDOMMagicSize ||
+        data_.compare(0, kBinaryDOMMagicSize, kBinaryDOMMagic) != 0 ||
+        data_[kBinaryDOMMagicSize] != kBinaryDOMVersion)
+      return false;
+    position_ = kBinaryDOMMagicSize + 1;
+
+    char tag;
+    return ReadTag(&tag) && tag == kElementTag &&
+           ReadElement(domdoc_, 0) && position_ == data_.size();
+  }
+
+ private:
+  bool ReadTag(char *tag) {
+    if (position_ >= data_.size())
+      return false;
+    *tag = data_[position_++];
+    return true;
+  }
+
+  bool ReadVarint(uint32_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 32 && position_ < data_.size(); shift += 7) {
+      unsigned char byte = static_cast<unsigned char>(data_[position_++]);
+      *value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool ReadString(std::string *value) {
+    uint32_t size;
+    if (!ReadVarint(&size) || size > data_.size() - position_)
+      return false;
+    value->assign(data_, position_, size);
+    position_ += size;
+    return true;
+  }
+
+  bool ReadPosition(DOMNodeInterface *node) {
+    uint32_t row, column;
+    if (!ReadVarint(&row) || !ReadVarint(&column))
+      return false;
+    node->SetRow(static_cast<int>(row));
+    node->SetColumn(static_cast<int>(column));
+    return true;
+  }
+
+  bool ReadElement(DOMNodeInterface *parent, int depth) {
+    std::string prefix, name;
+    if (depth >= kMaxDepth || !ReadString(&prefix) || !ReadString(&name))
+      return false;
+    DOMElementInterface *element = NULL;
+    domdoc_->CreateElement(name, &element);
+    if (!element || DOM_NO_ERR != parent->AppendChild(element)) {
+      delete element;
+      return false;
+    }
+    if ((!prefix.empty() && DOM_NO_ERR != element->SetPrefix(prefix)) ||
+        !ReadPosition(element))
+      return false;
+
+    uint32_t attribute_count;
+    if (!ReadVarint(&attribute_count))
+      return false;
+    for (uint32_t i = 0; i < attribute_count; i++) {
+      std::string value;
+      if (!ReadString(&prefix) || !ReadString(&name) || !ReadString(&value))
+        return false;
+      DOMAttrInterface *attr = NULL;
+      domdoc_->CreateAttribute(name, &attr);
+      if (!attr || DOM_NO_ERR != element->SetAttributeNode(attr)) {
+        delete attr;
+        return false;
+      }
+      attr->SetValue(value);
+      if ((!prefix.empty() && DOM_NO_ERR != attr->SetPrefix(prefix)) ||
+          !ReadPosition(attr))
+        return false;
+    }
+
+    char tag = kElementTag;
+    while (ReadTag(&tag) && tag != kEndTag) {
+      if (tag == kElementTag) {
+        if (!ReadElement(element, depth + 1))
+          return false;
+      } else if (tag == kTextTag || tag == kCDATATag) {
+        if (!ReadCharacterData(element, tag))
+          return false;
+      } else {
+        return false;
+      }
+    }
+    return tag == kEndTag;
+  }
+
+  bool ReadCharacterData(DOMNodeInterface *parent, char tag) {
+    uint32_t row, column;
+    std::string value;
+    if (!ReadVarint(&row) || !ReadVarint(&column) || !ReadString(&value))
+      return false;
+    DOMNodeInterface *node;
+    if (tag == kTextTag)
+      node = domdoc_->CreateTextNodeUTF8(value);
+    else
+      node = domdoc_->CreateCDATASectionUTF8(value);
+    if (!node || DOM_NO_ERR != parent->AppendChild(node)) {
+      delete node;
+      return false;
+    }
+    node->SetRow(static_cast<int>(row));
+    node->SetColumn(static_cast<int>(column));
+    return true;
+  }
+
+  const std::string &data_;
+  size_t position_;
+  DOMDocumentInterface *domdoc_;
+
+  DISALLOW_EVIL_CONSTRUCTORS(BinaryDOMReader);
+};
+
+} // anonymous namespace
+
+bool ParseBinaryIntoDOM(const std::string &data, const char *filename,
+                        DOMDocumentInterface *domdoc) {
+  ASSERT(domdoc && !domdoc->HasChildNodes());
+  BinaryDOMReader reader(data, domdoc);
+  if (!reader.Read()) {
+    LOG("Invalid binary DOM data: %s", filename);
+    return false;
+  }
+  return true;
+}
+
+} // namespace ggadget
@@ -0,0 +1,64 @@
+/*
+  Copyright 2008 Google Inc.
+
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef GGADGET_XML_DOM_BINARY_H__
+#define GGADGET_XML_DOM_BINARY_H__
+
+#include <string>
+
+namespace ggadget {
+
+class DOMDocumentInterface;
+
+/**
+ * @ingroup XMLUtilities
+ *
+ * Serializes the document element of a DOM document into a compact binary
+ * form, which can be loaded back by @c ParseBinaryIntoDOM() much faster than
+ * parsing the XML content, for example, to cache parsed and localized view
+ * files across runs.
+ *
+ * Elements, attributes, text and CDATA nodes are kept, together with their
+ * prefixes and source positions. Comments and processing instructions are
+ * dropped.
+ *
+ * @param domdoc the document to serialize.
+ * @param[out] data the serialized data.
+ * @return @c false if the document has no document element.
+ */
+bool SerializeDOMToBinary(const DOMDocumentInterface *domdoc,
+                          std::string *data);
+
+/**
+ * @ingroup XMLUtilities
+ *
+ * Loads the binary form produced by @c SerializeDOMToBinary() into a DOM
+ * document.
+ *
+ * @param data the serialized data.
+ * @param filename the name of the file the data was loaded from, for logging
+ *     purpose.
+ * @param domdoc an empty DOM document to load the data into.
+ * @return @c false if the data is corrupted or was produced by an
+ *     incompatible version. @a domdoc may contain part of the nodes in that
+ *     case.
+ */
+bool ParseBinaryIntoDOM(const std::string &data, const char *filename,
+                        DOMDocumentInterface *domdoc);
+
+} // namespace ggadget
+
+#endif // GGADGET_XML_DOM_BINARY_H__
@@ -30,6 +30,7 @@
 #include "common.h"
 #include "logger.h"
 #include "gadget_consts.h"
+#include "light_map.h"
 #include "scoped_ptr.h"
 #include "slot.h"
 #include "small_object.h"
@@ -39,12 +40,6 @@
 
 namespace ggadget {
 
-#ifdef GADGET_CASE_SENSITIVE
-static const int kZipCaseSensitivity = 1;
-#else
-static const int kZipCaseSensitivity = 2;
-#endif
-
 static const uLong kMaxFieldSize = 200000;
 static const char kZipGlobalComment[] = "Created by Google Gadgets for Linux.";
 static const char kZipReadMeFile[] = ".readme";
@@ -71,18 +66,6 @@ void StringReplace(char* path, char old_char, char new_char) {
 }
 #endif
 
-int UnzLocateFile(unzFile file, const char* szFileName, int iCaseSensitivity) {
-#if defined(OS_WIN)
-  int name_buffer_length = strlen(szFileName) + 1;
-  scoped_array<char> file_name(new char[name_buffer_length]);
-  strcpy_s(file_name.get(), name_buffer_length, szFileName);
-  StringReplace(file_name.get(), '\\', '/');
-  return ::unzLocateFile(file, file_name.get(), iCaseSensitivity);
-#elif defined(OS_POSIX)
-  return ::unzLocateFile(file, szFileName, iCaseSensitivity);
-#endif
-}
-
 int UnzGetCurrentFileInfo(unzFile file, unz_file_info* pfile_info,
                           char* szFileName, uLong fileNameBufferSize,
                           void* extraField, uLong extraFieldBufferSize,
@@ -130,7 +113,16 @@ int ZipOpenNewFileInZip(zipFile file,
 
 class ZipFileManager::Impl : public SmallObject<> {
  public:
-  Impl() : unzip_handle_(NULL), zip_handle_(NULL) {
+  // An entry of the central directory of the zip archive.
+  struct ZipEntry {
+    unz_file_pos pos;
+    uLong uncompressed_size;
+  };
+  // Maps internal file paths to their entries. The paths are compared with
+  // GadgetStrCmp() like other file managers.
+  typedef LightMap<std::string, ZipEntry, GadgetStringComparator> ZipIndex;
+
+  Impl() : unzip_handle_(NULL), zip_handle_(NULL), index_valid_(false) {
   }
 
   ~Impl() {
@@ -151,6 +143,7 @@ class ZipFileManager::Impl : public SmallObject<> {
 
     unzip_handle_ = NULL;
     zip_handle_ = NULL;
+    InvalidateIndex();
   }
 
   bool IsValid() {
@@ -222,12 +215,14 @@ class ZipFileManager::Impl : public SmallObject<> {
     if (!CheckFilePath(file, &relative_path, NULL))
       return false;
 
-    if (!SwitchToRead())
+    const ZipEntry *entry = LocateFile(relative_path);
+    if (!entry)
       return false;
 
-    if (ggadget::UnzLocateFile(unzip_handle_, relative_path.c_str(),
-                               kZipCaseSensitivity) != UNZ_OK)
+    if (entry->uncompressed_size > kMaxFileSize) {
+      LOG("File %s is too big", relative_path.c_str());
       return false;
+    }
 
     if (unzOpenCurrentFile(unzip_handle_) != UNZ_OK) {
       LOG("Can't open file %s for reading in zip archive %s.",
@@ -235,28 +230,18 @@ class ZipFileManager::Impl : public SmallObject<> {
       return false;
     }
 
+    // The size is known from the central directory, so the whole file is
+    // read at once without growing the buffer.
     bool result = true;
-    const int kChunkSize = 2048;
-    char buffer[kChunkSize];
-    while (true) {
-      int read_size = unzReadCurrentFile(unzip_handle_, buffer, kChunkSize);
-      if (read_size > 0) {
-        data->append(buffer, read_size);
-        if (data->length() > kMaxFileSize) {
-          LOG("File %s is too big", relative_path.c_str());
-          data->clear();
-          result = false;
-          break;
-        }
-      } else if (read_size < 0) {
-        LOG("Error reading file: %s in zip archive %s",
-            relative_path.c_str(), base_path_.c_str());
-        data->clear();
-        result = false;
-        break;
-      } else {
-        break;
-      }
+    unsigned size = static_cast<unsigned>(entry->uncompressed_size);
+    data->resize(size);
+    if (size > 0 &&
+        unzReadCurrentFile(unzip_handle_, &(*data)[0], size) !=
+            static_cast<int>(size)) {
+      LOG("Error reading file: %s in zip archive %s",
+          relative_path.c_str(), base_path_.c_str());
+      data->clear();
+      result = false;
     }
 
     if (unzCloseCurrentFile(unzip_handle_) != UNZ_OK) {
@@ -384,6 +369,7 @@ class ZipFileManager::Impl : public SmallObject<> {
       // Copy the temp zip file over the original zip.
       unzClose(unzip_handle_);
       unzip_handle_ = NULL;
+      InvalidateIndex();
       res = ggadget::unlink(base_path_.c_str()) == 0 &&
             CopyFile(temp_file.c_str(), base_path_.c_str());
       if (!res) {
@@ -402,11 +388,7 @@ class ZipFileManager::Impl : public SmallObject<> {
     if (!CheckFilePath(file, &relative_path, NULL))
       return false;
 
-    if (!SwitchToRead())
-      return false;
-
-    if (ggadget::UnzLocateFile(unzip_handle_, relative_path.c_str(),
-                               kZipCaseSensitivity) != UNZ_OK)
+    if (!LocateFile(relative_path))
       return false;
 
     if (into_file->empty()) {
@@ -478,9 +460,7 @@ class ZipFileManager::Impl : public SmallObject<> {
     bool result = CheckFilePath(file, &relative_path, &full_path);
     if (path) *path = full_path;
 
-    return result && SwitchToRead() &&
-           ggadget::UnzLocateFile(unzip_handle_, relative_path.c_str(),
-                                  kZipCaseSensitivity) == UNZ_OK;
+    return result && LocateFile(relative_path) != NULL;
   }
 
   bool IsDirectlyAccessible(const char *file, std::string *path) {
@@ -502,9 +482,7 @@ class ZipFileManager::Impl : public SmallObject<> {
     bool result = CheckFilePath(file, &relative_path, &full_path);
 
     unz_file_info file_info;
-    if (result && SwitchToRead() &&
-        ggadget::UnzLocateFile(unzip_handle_, relative_path.c_str(),
-                               kZipCaseSensitivity) == UNZ_OK &&
+    if (result && LocateFile(relative_path) &&
         ggadget::UnzGetCurrentFileInfo(unzip_handle_, &file_info,
                                        NULL, 0, NULL, 0, NULL, 0) == UNZ_OK) {
       struct tm tm;
@@ -645,12 +623,87 @@ class ZipFileManager::Impl : public SmallObject<> {
     }
 
     unzip_handle_ = unzOpen(base_path_.c_str());
+    InvalidateIndex();
     if (!unzip_handle_)
       LOG("Can't open zip archive %s for reading.", base_path_.c_str());
 
     return unzip_handle_ != NULL;
   }
 
+  // Makes the specified file the current file of the unzip handle, and
+  // returns its entry, or NULL if the file doesn't exist.
+  // The central directory is indexed the first time after the archive is
+  // opened for reading, instead of walked by unzLocateFile() for each lookup.
+  const ZipEntry *LocateFile(const std::string &relative_path) {
+    if (!unzip_handle_ || !index_valid_) {
+      if (!SwitchToRead() || !BuildIndex())
+        return NULL;
+    }
+
+    ZipIndex::iterator it = index_.find(relative_path);
+    if (it == index_.end())
+      return NULL;
+
+    // unzGoToFilePos can reset error flags of the handle as well.
+    if (unzGoToFilePos(unzip_handle_, &it->second.pos) != UNZ_OK) {
+      LOG("Can't locate file %s in zip archive %s.",
+          relative_path.c_str(), base_path_.c_str());
+      // The unzip handle is not usable. It'll be reopened next time.
+      unzClose(unzip_handle_);
+      unzip_handle_ = NULL;
+      InvalidateIndex();
+      return NULL;
+    }
+    return &it->second;
+  }
+
+  bool BuildIndex() {
+    ASSERT(unzip_handle_);
+    index_.clear();
+    std::vector<char> filename;
+    int res = unzGoToFirstFile(unzip_handle_);
+    while (res == UNZ_OK) {
+      unz_file_info file_info;
+      res = ggadget::UnzGetCurrentFileInfo(unzip_handle_, &file_info,
+                                           NULL, 0, NULL, 0, NULL, 0);
+      if (res != UNZ_OK)
+        break;
+      // The buffer must be big enough for the terminating '\0', which is
+      // required by the Windows version of UnzGetCurrentFileInfo.
+      filename.resize(file_info.size_filename + 1);
+      res = ggadget::UnzGetCurrentFileInfo(unzip_handle_, &file_info,
+                                           &filename[0], filename.size(),
+                                           NULL, 0, NULL, 0);
+      if (res != UNZ_OK)
+        break;
+
+      ZipEntry entry;
+      res = unzGetFilePos(unzip_handle_, &entry.pos);
+      if (res != UNZ_OK)
+        break;
+      entry.uncompressed_size = file_info.uncompressed_size;
+      // Keeps the first one of the files with the same name, which is the one
+      // unzLocateFile() finds.
+      index_.insert(std::make_pair(
+          std::string(&filename[0], file_info.size_filename), entry));
+      res = unzGoToNextFile(unzip_handle_);
+    }
+
+    if (res != UNZ_END_OF_LIST_OF_FILE) {
+      LOG("Failed to read the central directory of zip archive %s.",
+          base_path_.c_str());
+      index_.clear();
+      return false;
+    }
+    index_valid_ = true;
+    return true;
+  }
+
+  void InvalidateIndex() {
+    index_.clear();
+    index_valid_ = false;
+  }
+
   bool SwitchToWrite() {
     if (base_path_.empty())
       return false;
@@ -661,6 +714,7 @@ class ZipFileManager::Impl : public SmallObject<> {
     if (unzip_handle_) {
       unzClose(unzip_handle_);
       unzip_handle_ = NULL;
+      InvalidateIndex();
     }
 
     // If the file already exists, then try to open in append mode,
@@ -720,6 +774,11 @@ class ZipFileManager::Impl : public SmallObject<> {
 
   unzFile unzip_handle_;
   zipFile zip_handle_;
+
+  // The index of the central directory of the archive opened by
+  // unzip_handle_.
+  ZipIndex index_;
+  bool index_valid_;
 };
 
 
@@ -149,6 +149,15 @@
       ],
     }, # target: unicode_utils_test
 
+    {
+      # Not a unit test, run it by hand to compare the string conversions with
+      # the scalar references.
+      'target_name': 'unicode_utils_benchmark',
+      'sources': [
+        'ggadget/tests/unicode_utils_benchmark.cc',
+      ],
+    }, # target: unicode_utils_benchmark
+
     {
       'target_name': 'variant_unittests',
       'sources': [